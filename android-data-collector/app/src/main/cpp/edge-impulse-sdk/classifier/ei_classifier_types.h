@@ -315,12 +315,19 @@ typedef struct {
      * EXPERIMENTAL
      */
     ei_feature_t* _raw_outputs;
+    /**
+     * Impulse handle this result is being computed for (set by run_inference), so
+     * inferencing engines can keep per-handle state.
+     * INTERNAL
+     */
+    const void* _handle;
 #else
     /** padding for C bindings to make sure the struct is the same size
      * INTERNAL
      * EXPERIMENTAL
      */
     void* _padding;
+    void* _padding_handle;
 #endif
 #if EI_CLASSIFIER_HAS_VISUAL_ANOMALY || __DOXYGEN__
     /**
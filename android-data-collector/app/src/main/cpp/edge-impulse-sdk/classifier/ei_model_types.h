@@ -39,6 +39,7 @@
 
 #include "edge-impulse-sdk/classifier/ei_classifier_types.h"
 #include "edge-impulse-sdk/dsp/ei_dsp_handle.h"
+#include "edge-impulse-sdk/dsp/ei_dsp_window_state.h"
 #include "edge-impulse-sdk/dsp/numpy.hpp"
 #if EI_CLASSIFIER_USE_FULL_TFLITE || (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_AKIDA) || (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_MEMRYX)
 #include "tensorflow-lite/tensorflow/lite/c/common.h"
@@ -65,6 +66,17 @@
 #define EI_CLASSIFIER_NORDIC_AXON                16
 #define EI_CLASSIFIER_VLM_CONNECTOR              17
 
+// Inferencing engines that fill the raw output matrices held by the impulse state in place,
+// so they can be reused between inferences instead of being allocated (and freed) every time
+#ifndef EI_CLASSIFIER_REUSE_RAW_OUTPUTS
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL) || \
+    ((EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1))
+#define EI_CLASSIFIER_REUSE_RAW_OUTPUTS          1
+#else
+#define EI_CLASSIFIER_REUSE_RAW_OUTPUTS          0
+#endif
+#endif // EI_CLASSIFIER_REUSE_RAW_OUTPUTS
+
 #define EI_CLASSIFIER_SENSOR_UNKNOWN             255
 #define EI_CLASSIFIER_SENSOR_MICROPHONE          1
 #define EI_CLASSIFIER_SENSOR_ACCELEROMETER       2
@@ -437,19 +449,42 @@ typedef struct ei_impulse {
     uint32_t *freeform_outputs;
 } ei_impulse_t;
 
+/**
+ * Audio carried over between slices when running continuous DSP (MFCC / MFE / spectrogram):
+ * the part of the previous slice that didn't fill a complete frame yet.
+ */
+typedef struct {
+    float *frame;
+    size_t frame_size;
+    int frame_ix;
+    bool first_run; // only used by spectrogram / MFE v1
+} ei_dsp_cont_state_t;
+
+/**
+ * State an inferencing engine keeps for a learn block between inferences
+ * (e.g. a prepared TFLite Micro interpreter and its arena)
+ */
+typedef struct {
+    void *state;
+    void (*free_fn)(void *state);
+} ei_learning_block_state_t;
+
 class ei_impulse_state_t {
 typedef DspHandle* _dsp_handle_ptr_t;
 public:
     const ei_impulse_t *impulse; // keep a pointer to the impulse
     _dsp_handle_ptr_t *dsp_handles;
     bool is_temp_handle = false; // to know if we're using the old (stateless) API
+    uint64_t continuous_features_written = 0; // features in the run_classifier_continuous() window
     ei_impulse_state_t(const ei_impulse_t *impulse)
         : impulse(impulse)
     {
         const auto num_dsp_blocks = impulse->dsp_blocks_size;
         dsp_handles = (_dsp_handle_ptr_t*)ei_malloc(sizeof(_dsp_handle_ptr_t)*num_dsp_blocks);
+        dsp_window_states = (ei_dsp_window_state_t**)ei_malloc(sizeof(ei_dsp_window_state_t*)*num_dsp_blocks);
         for(size_t ix = 0; ix < num_dsp_blocks; ix++) {
             dsp_handles[ix] = nullptr;
+            dsp_window_states[ix] = nullptr;
         }
     }
 
@@ -460,6 +495,207 @@ public:
         return dsp_handles[ix];
     }
 
+    /**
+     * Features array (one entry per DSP block, each with a 1 x n_output_features matrix).
+     * Allocated on first use and reused for every inference on this handle.
+     * @return nullptr if allocation failed
+     */
+    ei_feature_t* get_features() {
+        if (features != nullptr) {
+            // undo bind_features()
+            if (features_buffer != nullptr) {
+                features[0].matrix->buffer = features_buffer;
+                features_buffer = nullptr;
+            }
+            // DSP blocks may reshape their output matrix, restore it
+            for (size_t ix = 0; ix < impulse->dsp_blocks_size; ix++) {
+                features[ix].matrix->rows = 1;
+                features[ix].matrix->cols = impulse->dsp_blocks[ix].n_output_features;
+            }
+            return features;
+        }
+
+        const auto num_dsp_blocks = impulse->dsp_blocks_size;
+        ei_feature_t *new_features = (ei_feature_t*)ei_calloc(num_dsp_blocks, sizeof(ei_feature_t));
+        if (new_features == nullptr) {
+            return nullptr;
+        }
+        for (size_t ix = 0; ix < num_dsp_blocks; ix++) {
+            ei::matrix_t *matrix = new ei::matrix_t(1, impulse->dsp_blocks[ix].n_output_features);
+            if (matrix == nullptr || matrix->buffer == nullptr) {
+                delete matrix;
+                features = new_features;
+                free_features();
+                return nullptr;
+            }
+            new_features[ix].matrix = matrix;
+            new_features[ix].blockId = impulse->dsp_blocks[ix].blockId;
+        }
+        features = new_features;
+        return features;
+    }
+
+    /**
+     * Let the first DSP block write its features into buffer (the input tensor of the learn block)
+     * instead of the handle's own buffer, until the next get_features() call.
+     * buffer must hold n_output_features floats.
+     */
+    void bind_features(float *buffer) {
+        if (features == nullptr) {
+            return;
+        }
+        if (features_buffer == nullptr) {
+            features_buffer = features[0].matrix->buffer;
+        }
+        features[0].matrix->buffer = buffer;
+    }
+
+    /**
+     * Raw outputs array handed to the inferencing engines (result->_raw_outputs).
+     * When EI_CLASSIFIER_REUSE_RAW_OUTPUTS is set the matrices in here survive between
+     * inferences and are freed in the destructor.
+     * @return nullptr if allocation failed
+     */
+    ei_feature_t* get_raw_outputs() {
+        if (raw_outputs == nullptr) {
+            raw_outputs_size = impulse->output_tensors_size > impulse->learning_blocks_size ?
+                impulse->output_tensors_size : impulse->learning_blocks_size;
+            raw_outputs = (ei_feature_t*)ei_calloc(raw_outputs_size, sizeof(ei_feature_t));
+            return raw_outputs;
+        }
+#if EI_CLASSIFIER_REUSE_RAW_OUTPUTS == 0
+        // matrices are owned (and freed) by run_postprocessing
+        memset(raw_outputs, 0, sizeof(ei_feature_t) * raw_outputs_size);
+#endif
+        return raw_outputs;
+    }
+
+    /**
+     * Sliding window of features (1 x nn_input_frame_size) for run_classifier_continuous()
+     * @return nullptr if allocation failed
+     */
+    ei::matrix_t* get_continuous_features() {
+        if (continuous_features == nullptr) {
+            continuous_features = new ei::matrix_t(1, impulse->nn_input_frame_size);
+            if (continuous_features->buffer == nullptr) {
+                delete continuous_features;
+                continuous_features = nullptr;
+            }
+        }
+        return continuous_features;
+    }
+
+    /**
+     * Window of raw input for DSP block ix when running continuous inference on
+     * raw / flatten / spectral analysis blocks, cleared by reset()
+     * @return nullptr if allocation failed
+     */
+    ei_dsp_window_state_t* get_dsp_window_state(size_t ix) {
+        if (dsp_window_states[ix] == nullptr) {
+            ei_dsp_window_state_t *window_state = new ei_dsp_window_state_t(
+                impulse->dsp_blocks[ix].axes_size, impulse->raw_sample_count);
+            if (window_state == nullptr || !window_state->is_valid()) {
+                delete window_state;
+                return nullptr;
+            }
+            dsp_window_states[ix] = window_state;
+        }
+        return dsp_window_states[ix];
+    }
+
+    /**
+     * Continuous audio DSP state, cleared by reset()
+     */
+    ei_dsp_cont_state_t* get_dsp_cont_state() {
+        return &dsp_cont_state;
+    }
+
+    /**
+     * Engine state for learn block ix, nullptr if the engine didn't store any (yet)
+     */
+    void* get_learning_block_state(size_t ix) {
+        if (learning_block_states == nullptr || ix >= impulse->learning_blocks_size) {
+            return nullptr;
+        }
+        return learning_block_states[ix].state;
+    }
+
+    /**
+     * Hand engine state for learn block ix over to the handle. It's freed with free_fn by
+     * free_learning_block_states() (run_classifier_deinit()) or when the handle goes away.
+     * @return false if allocation failed, state is not taken over in that case
+     */
+    bool set_learning_block_state(size_t ix, void *state, void (*free_fn)(void *state)) {
+        if (ix >= impulse->learning_blocks_size) {
+            return false;
+        }
+        if (learning_block_states == nullptr) {
+            learning_block_states = (ei_learning_block_state_t*)ei_calloc(
+                impulse->learning_blocks_size, sizeof(ei_learning_block_state_t));
+            if (learning_block_states == nullptr) {
+                return false;
+            }
+        }
+        ei_learning_block_state_t *entry = &learning_block_states[ix];
+        if (entry->state != nullptr && entry->free_fn != nullptr) {
+            entry->free_fn(entry->state);
+        }
+        entry->state = state;
+        entry->free_fn = free_fn;
+        return true;
+    }
+
+    void free_learning_block_states() {
+        if (learning_block_states == nullptr) {
+            return;
+        }
+        for (size_t ix = 0; ix < impulse->learning_blocks_size; ix++) {
+            if (learning_block_states[ix].state != nullptr && learning_block_states[ix].free_fn != nullptr) {
+                learning_block_states[ix].free_fn(learning_block_states[ix].state);
+            }
+        }
+        ei_free(learning_block_states);
+        learning_block_states = nullptr;
+    }
+
+#if EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
+    /**
+     * Classification results array (labels filled in once, values cleared on every call).
+     * run_classifier_batch() uses one slot per sample; growing the number of slots moves
+     * the storage, so it reserves the last slot before handing out any of them.
+     * @return nullptr if allocation failed
+     */
+    ei_impulse_result_classification_t* get_classification(size_t count, size_t slot = 0) {
+        const size_t stride = count > 0 ? count : 1;
+        if (classification == nullptr || slot >= classification_slots) {
+            const size_t slots = slot + 1;
+            ei_impulse_result_classification_t *new_classification = (ei_impulse_result_classification_t*)ei_calloc(
+                stride * slots, sizeof(ei_impulse_result_classification_t));
+            if (new_classification == nullptr) {
+                return nullptr;
+            }
+            for (size_t sx = 0; sx < slots; sx++) {
+                for (size_t ix = 0; ix < count; ix++) {
+#ifdef EI_DSP_RESULT_OVERRIDE
+                    new_classification[(sx * stride) + ix].label = "";
+#else
+                    new_classification[(sx * stride) + ix].label = impulse->categories[ix];
+#endif // EI_DSP_RESULT_OVERRIDE
+                }
+            }
+            ei_free(classification);
+            classification = new_classification;
+            classification_size = count;
+            classification_slots = slots;
+        }
+        ei_impulse_result_classification_t *slot_classification = classification + (slot * stride);
+        for (size_t ix = 0; ix < classification_size; ix++) {
+            slot_classification[ix].value = 0.0f;
+        }
+        return slot_classification;
+    }
+#endif // EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
+
     void reset()
     {
         for (size_t ix = 0; ix < impulse->dsp_blocks_size; ix++) {
@@ -467,7 +703,16 @@ public:
                 delete dsp_handles[ix];
                 dsp_handles[ix] = nullptr;
             }
+            if (dsp_window_states[ix] != nullptr) {
+                delete dsp_window_states[ix];
+                dsp_window_states[ix] = nullptr;
+            }
+        }
+        continuous_features_written = 0;
+        if (dsp_cont_state.frame != nullptr) {
+            ei_free(dsp_cont_state.frame);
         }
+        dsp_cont_state = { nullptr, 0, 0, false };
     }
 
     void* operator new(size_t size) {
@@ -489,7 +734,51 @@ public:
     ~ei_impulse_state_t()
     {
         reset();
+        free_learning_block_states();
         ei_free(dsp_handles);
+        ei_free(dsp_window_states);
+        free_features();
+        delete continuous_features;
+        if (raw_outputs != nullptr) {
+            for (size_t ix = 0; ix < raw_outputs_size; ix++) {
+                raw_outputs[ix].free_matrix();
+            }
+            ei_free(raw_outputs);
+        }
+#if EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
+        ei_free(classification);
+#endif
+    }
+
+private:
+    // scratch buffers, see get_features() / get_raw_outputs() / get_continuous_features() / get_classification()
+    ei_feature_t *features = nullptr;
+    float *features_buffer = nullptr; // own buffer of features[0] while bound, see bind_features()
+    ei_feature_t *raw_outputs = nullptr;
+    size_t raw_outputs_size = 0;
+    ei::matrix_t *continuous_features = nullptr;
+    ei_dsp_cont_state_t dsp_cont_state = { nullptr, 0, 0, false };
+    ei_dsp_window_state_t **dsp_window_states = nullptr;
+    ei_learning_block_state_t *learning_block_states = nullptr;
+#if EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
+    ei_impulse_result_classification_t *classification = nullptr;
+    size_t classification_size = 0;
+    size_t classification_slots = 0;
+#endif
+
+    void free_features() {
+        if (features == nullptr) {
+            return;
+        }
+        if (features_buffer != nullptr) {
+            features[0].matrix->buffer = features_buffer;
+            features_buffer = nullptr;
+        }
+        for (size_t ix = 0; ix < impulse->dsp_blocks_size; ix++) {
+            delete features[ix].matrix;
+        }
+        ei_free(features);
+        features = nullptr;
     }
 };
 
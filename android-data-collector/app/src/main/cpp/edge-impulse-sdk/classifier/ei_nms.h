@@ -49,6 +49,16 @@
 #include <cmath>
 #include <deque>
 #include <queue>
+#include <string.h>
+#include "edge-impulse-sdk/dsp/config.hpp"
+
+#if EIDSP_USE_NEON && defined(__aarch64__)
+#include <arm_neon.h>
+#define EI_NMS_NEON     1
+#elif EIDSP_USE_SSE2
+#include <emmintrin.h>
+#define EI_NMS_SSE2     1
+#endif
 
 // A pair of diagonal corners of the box.
 struct BoxCornerEncoding {
@@ -214,62 +224,363 @@ static inline void NonMaxSuppression(const float* boxes, const int num_boxes,
   }
 }
 
+// Only the highest scoring candidates enter NMS (after the score threshold), 0 = all of them.
+// Candidates below the top K are dropped even if they wouldn't overlap anything, so this only
+// changes results when more than K boxes pass the threshold (e.g. YOLO models with
+// thousands of anchors and a low threshold).
+#ifndef EI_CLASSIFIER_NMS_TOP_K
+#define EI_CLASSIFIER_NMS_TOP_K     0
+#endif
+
 /**
- * Run non-max suppression over the results array (for bounding boxes)
+ * Options for ei_nms_run()
  */
-EI_IMPULSE_ERROR ei_run_nms(
-    const ei_impulse_t *impulse,
-    std::vector<ei_impulse_result_bounding_box_t> *results,
-    float *boxes,
-    float *scores,
-    int *classes,
-    size_t bb_count,
-    bool clip_boxes,
-    const ei_object_detection_nms_config_t *nms_config) {
+typedef struct {
+    float iou_threshold;    // suppress candidates with an IoU >= this with a selected box
+    float score_threshold;  // candidates with a score <= this are rejected
+    int max_output_size;    // maximum number of selections
+    int top_k;              // only the top_k highest scoring candidates enter NMS, 0 = all
+    bool class_aware;       // only boxes of the same class suppress each other
+} ei_nms_options_t;
 
-    if (bb_count < 1) {
-        return EI_IMPULSE_OK;
+/**
+ * Candidates and selections for ei_nms_run(), as separate arrays per coordinate so the IoU of
+ * a candidate against all selected boxes is one vector loop. Grows when needed and is reused
+ * between calls (see ei_nms_get_scratch()), so NMS doesn't allocate per frame.
+ */
+typedef struct ei_nms_scratch {
+    // candidates (normalized so y1 <= y2, x1 <= x2), see ei_nms_set_box()
+    float *y1, *x1, *y2, *x2, *area, *scores;
+    int *classes;
+    // candidates that passed the score threshold, best first
+    int *order;
+    // selected boxes, copied out of the candidates in selection order
+    float *sel_y1, *sel_x1, *sel_y2, *sel_x2, *sel_area;
+    // candidate index of every selection, filled by ei_nms_run()
+    int *selected;
+    // [y1, x1, y2, x2] per candidate, for callers that don't have the boxes in an array already
+    float *boxes;
+    size_t capacity;
+    void *buffer;
+    // class aware NMS: per class, the first and the next free slot of its selections in sel_*
+    int *class_begin, *class_end;
+    size_t class_capacity;
+
+    ~ei_nms_scratch() {
+        ei_free(buffer);
+        ei_free(class_begin);
     }
+} ei_nms_scratch_t;
 
-    int *selected_indices = (int*)ei_malloc(1 * bb_count * sizeof(int));
-    float *selected_scores = (float*)ei_malloc(1 * bb_count * sizeof(float));
+/**
+ * Make room for count candidates. When it grows only the first keep candidates (and their boxes)
+ * are carried over, selections are always lost.
+ * @return false if allocation failed
+ */
+static bool ei_nms_reserve(ei_nms_scratch_t *scratch, size_t count, size_t keep = 0) {
+    if (count <= scratch->capacity) {
+        return true;
+    }
 
-    if (!scores || !boxes || !selected_indices || !selected_scores || !classes) {
-        ei_free(selected_indices);
-        ei_free(selected_scores);
-        return EI_IMPULSE_OUT_OF_MEMORY;
+    // 6 + 5 + 4 (boxes) floats, 3 ints per candidate
+    void *buffer = ei_malloc(count * ((15 * sizeof(float)) + (3 * sizeof(int))));
+    if (buffer == nullptr) {
+        return false;
+    }
+
+    ei_nms_scratch_t grown = { };
+    grown.buffer = buffer;
+    grown.capacity = count;
+
+    float *f = (float*)buffer;
+    grown.y1 = f; f += count;
+    grown.x1 = f; f += count;
+    grown.y2 = f; f += count;
+    grown.x2 = f; f += count;
+    grown.area = f; f += count;
+    grown.scores = f; f += count;
+    grown.sel_y1 = f; f += count;
+    grown.sel_x1 = f; f += count;
+    grown.sel_y2 = f; f += count;
+    grown.sel_x2 = f; f += count;
+    grown.sel_area = f; f += count;
+    grown.boxes = f; f += count * 4;
+    int *i = (int*)f;
+    grown.classes = i; i += count;
+    grown.order = i; i += count;
+    grown.selected = i;
+
+    keep = std::min(keep, scratch->capacity);
+    if (keep > 0) {
+        memcpy(grown.y1, scratch->y1, keep * sizeof(float));
+        memcpy(grown.x1, scratch->x1, keep * sizeof(float));
+        memcpy(grown.y2, scratch->y2, keep * sizeof(float));
+        memcpy(grown.x2, scratch->x2, keep * sizeof(float));
+        memcpy(grown.area, scratch->area, keep * sizeof(float));
+        memcpy(grown.scores, scratch->scores, keep * sizeof(float));
+        memcpy(grown.boxes, scratch->boxes, keep * 4 * sizeof(float));
+        memcpy(grown.classes, scratch->classes, keep * sizeof(int));
+    }
+
+    grown.class_begin = scratch->class_begin;
+    grown.class_end = scratch->class_end;
+    grown.class_capacity = scratch->class_capacity;
+
+    // take over the new arrays, the old buffer is freed by grown's destructor
+    void *old_buffer = scratch->buffer;
+    *scratch = grown;
+    grown.buffer = old_buffer;
+    grown.class_begin = nullptr;
+    return true;
+}
+
+/**
+ * Make room for the per class slots of class aware NMS (classes 0 .. count - 1)
+ * @return false if allocation failed
+ */
+static bool ei_nms_reserve_classes(ei_nms_scratch_t *scratch, size_t count) {
+    if (count <= scratch->class_capacity) {
+        return true;
+    }
+    int *class_begin = (int*)ei_malloc(count * 2 * sizeof(int));
+    if (class_begin == nullptr) {
+        return false;
     }
+    ei_free(scratch->class_begin);
+    scratch->class_begin = class_begin;
+    scratch->class_end = class_begin + count;
+    scratch->class_capacity = count;
+    return true;
+}
 
-    //  boxes: box encodings in format [y1, x1, y2, x2], shape: [num_boxes, 4]
-    //  num_boxes: number of candidates
-    //  scores: scores for candidate boxes, in the same order. shape: [num_boxes]
-    //  max_output_size: the maximum number of selections.
-    //  iou_threshold: Intersection-over-Union (IoU) threshold for NMS
-    //  score_threshold: All candidate scores below this value are rejected
-    //  soft_nms_sigma: Soft NMS parameter, used for decaying scores
-
-    int num_selected_indices;
-
-    NonMaxSuppression(
-        (const float*)boxes, // boxes
-        bb_count, // num_boxes
-        (const float*)scores, // scores
-        bb_count, // max_output_size
-        nms_config->iou_threshold, // iou_threshold
-        nms_config->confidence_threshold, // score_threshold
-        0.0f, // soft_nms_sigma
-        selected_indices,
-        selected_scores,
-        &num_selected_indices);
-
-    std::vector<ei_impulse_result_bounding_box_t> new_results;
-
-    for (size_t ix = 0; ix < (size_t)num_selected_indices; ix++) {
-
-        int out_ix = selected_indices[ix];
+/**
+ * Per thread scratch for the NMS calls in the postprocessing
+ */
+static ei_nms_scratch_t* ei_nms_get_scratch() {
+    static EIDSP_THREAD_LOCAL ei_nms_scratch_t scratch = { };
+    return &scratch;
+}
+
+/**
+ * Store candidate ix (corners in any order, like ComputeIntersectionOverUnion())
+ */
+static inline void ei_nms_set_box(ei_nms_scratch_t *scratch, size_t ix, float y1, float x1, float y2, float x2,
+                                  float score, int cls) {
+    const float y_min = std::min<float>(y1, y2);
+    const float y_max = std::max<float>(y1, y2);
+    const float x_min = std::min<float>(x1, x2);
+    const float x_max = std::max<float>(x1, x2);
+    scratch->y1[ix] = y_min;
+    scratch->x1[ix] = x_min;
+    scratch->y2[ix] = y_max;
+    scratch->x2[ix] = x_max;
+    scratch->area[ix] = (y_max - y_min) * (x_max - x_min);
+    scratch->scores[ix] = score;
+    scratch->classes[ix] = cls;
+}
+
+/**
+ * Append a candidate to the scratch (growing it if needed) and keep its corners in scratch->boxes,
+ * so decoders can collect candidates straight into the scratch instead of into a vector of boxes.
+ * @param count  candidates in the scratch so far, incremented
+ * @return false if allocation failed
+ */
+static inline bool ei_nms_add_box(ei_nms_scratch_t *scratch, size_t *count, float y1, float x1, float y2, float x2,
+                                  float score, int cls) {
+    if (*count >= scratch->capacity &&
+            !ei_nms_reserve(scratch, std::max<size_t>(64, scratch->capacity * 2), *count)) {
+        return false;
+    }
+
+    const size_t ix = (*count)++;
+    scratch->boxes[(ix * 4) + 0] = y1;
+    scratch->boxes[(ix * 4) + 1] = x1;
+    scratch->boxes[(ix * 4) + 2] = y2;
+    scratch->boxes[(ix * 4) + 3] = x2;
+    ei_nms_set_box(scratch, ix, y1, x1, y2, x2, score, cls);
+    return true;
+}
+
+/**
+ * Whether candidate c has an IoU >= iou_threshold with any of the selections in [first, n).
+ * Same math as ComputeIntersectionOverUnion(), 4 selections at a time.
+ */
+static inline bool ei_nms_is_suppressed(const ei_nms_scratch_t *s, int c, int first, int n, float iou_threshold) {
+    const float c_y1 = s->y1[c], c_x1 = s->x1[c], c_y2 = s->y2[c], c_x2 = s->x2[c], c_area = s->area[c];
+    int ix = first;
+
+#if EI_NMS_NEON
+    const float32x4_t v_y1 = vdupq_n_f32(c_y1), v_x1 = vdupq_n_f32(c_x1);
+    const float32x4_t v_y2 = vdupq_n_f32(c_y2), v_x2 = vdupq_n_f32(c_x2);
+    const float32x4_t v_area = vdupq_n_f32(c_area), v_zero = vdupq_n_f32(0.0f);
+    const float32x4_t v_thr = vdupq_n_f32(iou_threshold);
+    const uint32x4_t c_valid = vdupq_n_u32(c_area > 0 ? 0xffffffff : 0);
+    for (; ix + 4 <= n; ix += 4) {
+        float32x4_t s_area = vld1q_f32(s->sel_area + ix);
+        float32x4_t ih = vmaxq_f32(vsubq_f32(vminq_f32(v_y2, vld1q_f32(s->sel_y2 + ix)),
+                                             vmaxq_f32(v_y1, vld1q_f32(s->sel_y1 + ix))), v_zero);
+        float32x4_t iw = vmaxq_f32(vsubq_f32(vminq_f32(v_x2, vld1q_f32(s->sel_x2 + ix)),
+                                             vmaxq_f32(v_x1, vld1q_f32(s->sel_x1 + ix))), v_zero);
+        float32x4_t inter = vmulq_f32(ih, iw);
+        float32x4_t iou = vdivq_f32(inter, vsubq_f32(vaddq_f32(v_area, s_area), inter));
+        // boxes without area have an IoU of 0
+        uint32x4_t valid = vandq_u32(c_valid, vcgtq_f32(s_area, v_zero));
+        iou = vbslq_f32(valid, iou, v_zero);
+        uint32x4_t hit = vcgeq_f32(iou, v_thr);
+        if (vmaxvq_u32(hit) != 0) {
+            return true;
+        }
+    }
+#elif EI_NMS_SSE2
+    const __m128 v_y1 = _mm_set1_ps(c_y1), v_x1 = _mm_set1_ps(c_x1);
+    const __m128 v_y2 = _mm_set1_ps(c_y2), v_x2 = _mm_set1_ps(c_x2);
+    const __m128 v_area = _mm_set1_ps(c_area), v_zero = _mm_setzero_ps();
+    const __m128 v_thr = _mm_set1_ps(iou_threshold);
+    const __m128 c_valid = _mm_cmpgt_ps(v_area, v_zero);
+    for (; ix + 4 <= n; ix += 4) {
+        __m128 s_area = _mm_loadu_ps(s->sel_area + ix);
+        __m128 ih = _mm_max_ps(_mm_sub_ps(_mm_min_ps(v_y2, _mm_loadu_ps(s->sel_y2 + ix)),
+                                          _mm_max_ps(v_y1, _mm_loadu_ps(s->sel_y1 + ix))), v_zero);
+        __m128 iw = _mm_max_ps(_mm_sub_ps(_mm_min_ps(v_x2, _mm_loadu_ps(s->sel_x2 + ix)),
+                                          _mm_max_ps(v_x1, _mm_loadu_ps(s->sel_x1 + ix))), v_zero);
+        __m128 inter = _mm_mul_ps(ih, iw);
+        __m128 iou = _mm_div_ps(inter, _mm_sub_ps(_mm_add_ps(v_area, s_area), inter));
+        // boxes without area have an IoU of 0
+        __m128 valid = _mm_and_ps(c_valid, _mm_cmpgt_ps(s_area, v_zero));
+        iou = _mm_and_ps(valid, iou);
+        __m128 hit = _mm_cmpge_ps(iou, v_thr);
+        if (_mm_movemask_ps(hit) != 0) {
+            return true;
+        }
+    }
+#endif
+
+    for (; ix < n; ix++) {
+        float iou = 0.0f;
+        if (c_area > 0 && s->sel_area[ix] > 0) {
+            const float ih = std::max<float>(std::min<float>(c_y2, s->sel_y2[ix]) - std::max<float>(c_y1, s->sel_y1[ix]), 0.0f);
+            const float iw = std::max<float>(std::min<float>(c_x2, s->sel_x2[ix]) - std::max<float>(c_x1, s->sel_x1[ix]), 0.0f);
+            const float inter = ih * iw;
+            iou = inter / (c_area + s->sel_area[ix] - inter);
+        }
+        if (iou >= iou_threshold) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Hard NMS over the first count candidates in scratch (see ei_nms_set_box()). Gives the same
+ * selections as NonMaxSuppression() without soft NMS; candidates with equal scores are visited
+ * in index order. With options->class_aware boxes only suppress boxes of their own class (class
+ * indices are >= 0), so all classes are handled in one pass instead of one call per class:
+ * candidates are still visited best first, and every class keeps its selections in its own
+ * range of the sel_* arrays (sized by counting the candidates per class), so a candidate is
+ * only compared against the selections of its own class.
+ *
+ * @return number of selections, their candidate indices are in scratch->selected (best first),
+ *         -1 if allocation failed
+ */
+static int ei_nms_run(ei_nms_scratch_t *scratch, size_t count, const ei_nms_options_t *options) {
+    const float *scores = scratch->scores;
+    const int *classes = scratch->classes;
+    int *order = scratch->order;
+
+    int candidates = 0;
+    for (size_t ix = 0; ix < count; ix++) {
+        if (scores[ix] > options->score_threshold) {
+            order[candidates++] = (int)ix;
+        }
+    }
+
+    auto by_score = [scores](const int a, const int b) {
+        return scores[a] > scores[b] || (scores[a] == scores[b] && a < b);
+    };
+    if (options->top_k > 0 && candidates > options->top_k) {
+        std::partial_sort(order, order + options->top_k, order + candidates, by_score);
+        candidates = options->top_k;
+    }
+    else {
+        std::sort(order, order + candidates, by_score);
+    }
+
+    int *class_begin = nullptr;
+    int *class_end = nullptr;
+    if (options->class_aware) {
+        int class_count = 0;
+        for (int ix = 0; ix < candidates; ix++) {
+            class_count = std::max(class_count, classes[order[ix]] + 1);
+        }
+        if (!ei_nms_reserve_classes(scratch, (size_t)class_count)) {
+            return -1;
+        }
+        class_begin = scratch->class_begin;
+        class_end = scratch->class_end;
+
+        // counting sort of the selection slots: a class can't select more than its candidates
+        memset(class_end, 0, class_count * sizeof(int));
+        for (int ix = 0; ix < candidates; ix++) {
+            class_end[classes[order[ix]]]++;
+        }
+        int slot = 0;
+        for (int cls = 0; cls < class_count; cls++) {
+            class_begin[cls] = slot;
+            slot += class_end[cls];
+            class_end[cls] = class_begin[cls];
+        }
+    }
+
+    const int max_output_size = std::min(candidates, options->max_output_size);
+    int selected = 0;
+    for (int ix = 0; ix < candidates && selected < max_output_size; ix++) {
+        const int c = order[ix];
+        // selections of the candidate's class in class aware mode, otherwise all of them
+        int first = 0;
+        int slot = selected;
+        if (options->class_aware) {
+            first = class_begin[classes[c]];
+            slot = class_end[classes[c]];
+        }
+        if (ei_nms_is_suppressed(scratch, c, first, slot, options->iou_threshold)) {
+            continue;
+        }
+        scratch->sel_y1[slot] = scratch->y1[c];
+        scratch->sel_x1[slot] = scratch->x1[c];
+        scratch->sel_y2[slot] = scratch->y2[c];
+        scratch->sel_x2[slot] = scratch->x2[c];
+        scratch->sel_area[slot] = scratch->area[c];
+        if (options->class_aware) {
+            class_end[classes[c]]++;
+        }
+        scratch->selected[selected] = c;
+        selected++;
+    }
+
+    return selected;
+}
+
+/**
+ * Replace results with the selections of ei_nms_run() (boxes as passed to ei_nms_set_box())
+ */
+static void ei_nms_fill_results(
+    const ei_impulse_t *impulse,
+    const ei_nms_scratch_t *scratch,
+    const float *boxes,
+    int num_selected,
+    bool clip_boxes,
+    std::vector<ei_impulse_result_bounding_box_t> *results) {
+
+    // the vectors passed in are kept around by the postprocessing, so this doesn't allocate
+    // once they've grown to the number of boxes in a frame
+    results->clear();
+    results->reserve(num_selected);
+
+    for (int ix = 0; ix < num_selected; ix++) {
+        int out_ix = scratch->selected[ix];
         ei_impulse_result_bounding_box_t bb;
-        bb.label  = impulse->categories[classes[out_ix]];
-        bb.value  = selected_scores[ix];
+        bb.label  = impulse->categories[scratch->classes[out_ix]];
+        bb.value  = scratch->scores[out_ix];
 
         float ymin = boxes[(out_ix * 4) + 0];
         float xmin = boxes[(out_ix * 4) + 1];
@@ -287,22 +598,87 @@ EI_IMPULSE_ERROR ei_run_nms(
         bb.x      = static_cast<uint32_t>(xmin);
         bb.height = static_cast<uint32_t>(ymax) - bb.y;
         bb.width  = static_cast<uint32_t>(xmax) - bb.x;
-        new_results.push_back(bb);
+        results->push_back(bb);
 
         EI_LOGD("Found bb with label %s\n", bb.label);
     }
+}
 
-    results->clear();
+/**
+ * Run NMS over the first count candidates in scratch (boxes in scratch->boxes, see ei_nms_add_box())
+ * and replace results with the selections
+ */
+static EI_IMPULSE_ERROR ei_nms_select(
+    const ei_impulse_t *impulse,
+    ei_nms_scratch_t *scratch,
+    size_t count,
+    bool clip_boxes,
+    const ei_object_detection_nms_config_t *nms_config,
+    bool class_aware,
+    std::vector<ei_impulse_result_bounding_box_t> *results) {
+
+    ei_nms_options_t options = {
+        nms_config->iou_threshold,
+        nms_config->confidence_threshold,
+        (int)count, // max_output_size
+        EI_CLASSIFIER_NMS_TOP_K,
+        class_aware
+    };
+    int num_selected = ei_nms_run(scratch, count, &options);
+    if (num_selected < 0) {
+        return EI_IMPULSE_OUT_OF_MEMORY;
+    }
+
+    ei_nms_fill_results(impulse, scratch, scratch->boxes, num_selected, clip_boxes, results);
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * Run non-max suppression over the results array (for bounding boxes)
+ *
+ * @param boxes        [y1, x1, y2, x2] per box
+ * @param class_aware  Only suppress boxes of the same class
+ */
+EI_IMPULSE_ERROR ei_run_nms(
+    const ei_impulse_t *impulse,
+    std::vector<ei_impulse_result_bounding_box_t> *results,
+    float *boxes,
+    float *scores,
+    int *classes,
+    size_t bb_count,
+    bool clip_boxes,
+    const ei_object_detection_nms_config_t *nms_config,
+    bool class_aware = false) {
+
+    if (bb_count < 1) {
+        return EI_IMPULSE_OK;
+    }
 
-    for (size_t ix = 0; ix < new_results.size(); ix++) {
-        results->push_back(new_results[ix]);
+    ei_nms_scratch_t *scratch = ei_nms_get_scratch();
+    if (!scores || !boxes || !classes || !ei_nms_reserve(scratch, bb_count)) {
+        return EI_IMPULSE_OUT_OF_MEMORY;
     }
 
-    ei_free(selected_indices);
-    ei_free(selected_scores);
+    for (size_t ix = 0; ix < bb_count; ix++) {
+        ei_nms_set_box(scratch, ix, boxes[(ix * 4) + 0], boxes[(ix * 4) + 1], boxes[(ix * 4) + 2], boxes[(ix * 4) + 3],
+            scores[ix], classes[ix]);
+    }
 
-    return EI_IMPULSE_OK;
+    ei_nms_options_t options = {
+        nms_config->iou_threshold,
+        nms_config->confidence_threshold,
+        (int)bb_count, // max_output_size
+        EI_CLASSIFIER_NMS_TOP_K,
+        class_aware
+    };
+    int num_selected = ei_nms_run(scratch, bb_count, &options);
+    if (num_selected < 0) {
+        return EI_IMPULSE_OUT_OF_MEMORY;
+    }
 
+    ei_nms_fill_results(impulse, scratch, boxes, num_selected, clip_boxes, results);
+
+    return EI_IMPULSE_OK;
 }
 
 /**
@@ -312,13 +688,13 @@ EI_IMPULSE_ERROR ei_run_nms(
     const ei_impulse_t *impulse,
     const ei_object_detection_nms_config_t *nms_config,
     std::vector<ei_impulse_result_bounding_box_t> *results,
-    bool clip_boxes = true
+    bool clip_boxes = true,
+    bool class_aware = false
     ) {
 
     size_t bb_count = 0;
     for (size_t ix = 0; ix < results->size(); ix++) {
-        auto bb = results->at(ix);
-        if (bb.value == 0) {
+        if ((*results)[ix].value == 0) {
             continue;
         }
         bb_count++;
@@ -328,20 +704,15 @@ EI_IMPULSE_ERROR ei_run_nms(
         return EI_IMPULSE_OK;
     }
 
-    float *boxes = (float*)ei_malloc(4 * bb_count * sizeof(float));
-    float *scores = (float*)ei_malloc(1 * bb_count * sizeof(float));
-    int *classes = (int*) ei_malloc(bb_count * sizeof(int));
-
-    if (!scores || !boxes || !classes) {
-        ei_free(boxes);
-        ei_free(scores);
-        ei_free(classes);
+    ei_nms_scratch_t *scratch = ei_nms_get_scratch();
+    if (!ei_nms_reserve(scratch, bb_count)) {
         return EI_IMPULSE_OUT_OF_MEMORY;
     }
+    float *boxes = scratch->boxes;
 
     size_t box_ix = 0;
     for (size_t ix = 0; ix < results->size(); ix++) {
-        auto bb = results->at(ix);
+        const ei_impulse_result_bounding_box_t &bb = (*results)[ix];
         if (bb.value == 0) {
             continue;
         }
@@ -349,32 +720,22 @@ EI_IMPULSE_ERROR ei_run_nms(
         boxes[(box_ix * 4) + 1] = bb.x;
         boxes[(box_ix * 4) + 2] = bb.y + bb.height;
         boxes[(box_ix * 4) + 3] = bb.x + bb.width;
-        scores[box_ix] = bb.value;
 
+        // labels point into impulse->categories, only compare strings if they don't
+        int cls = 0;
         for (size_t j = 0; j < impulse->label_count; j++) {
-          if (strcmp(impulse->categories[j], bb.label) == 0)
-          classes[box_ix] = j;
+            if (impulse->categories[j] == bb.label || strcmp(impulse->categories[j], bb.label) == 0) {
+                cls = (int)j;
+                break;
+            }
         }
 
+        ei_nms_set_box(scratch, box_ix, boxes[(box_ix * 4) + 0], boxes[(box_ix * 4) + 1],
+            boxes[(box_ix * 4) + 2], boxes[(box_ix * 4) + 3], bb.value, cls);
         box_ix++;
     }
 
-    EI_IMPULSE_ERROR nms_res = ei_run_nms(impulse,
-                                          results,
-                                          boxes,
-                                          scores,
-                                          classes,
-                                          bb_count,
-                                          clip_boxes,
-                                          nms_config);
-
-
-    ei_free(boxes);
-    ei_free(scores);
-    ei_free(classes);
-
-    return nms_res;
-
+    return ei_nms_select(impulse, scratch, bb_count, clip_boxes, nms_config, class_aware, results);
 }
 
 #endif // (EI_HAS_YOLOV5 || EI_HAS_YOLOX || EI_HAS_TAO_DECODE_DETECTIONS || EI_HAS_TAO_YOLOV3 || EI_HAS_TAO_YOLOV4 || EI_HAS_YOLOV2 || EI_HAS_YOLO_PRO || EI_HAS_YOLOV11 || EI_HAS_QC_FACE_DET_LITE)
@@ -37,6 +37,18 @@
 
 #include <algorithm>
 #include <cmath>
+#include <stdint.h>
+#include <stddef.h>
+#include "edge-impulse-sdk/dsp/config.hpp"
+
+// vdivq_f32 / vcvtaq_s32_f32 are AArch64 only, 32-bit NEON uses the scalar loop
+#if EIDSP_USE_NEON && defined(__aarch64__)
+#include <arm_neon.h>
+#define EI_QUANTIZE_NEON        1
+#elif EIDSP_USE_SSE2
+#include <emmintrin.h>
+#define EI_QUANTIZE_SSE2        1
+#endif
 
 static int32_t pre_cast_quantize(float value, float scale, int32_t zero_point, bool is_signed) {
 
@@ -46,4 +58,74 @@ static int32_t pre_cast_quantize(float value, float scale, int32_t zero_point, b
     return std::min( std::max( static_cast<int32_t>(round(value / scale)) + zero_point, min_value), max_value);
 }
 
+/**
+ * Quantize a buffer of floats, same results as pre_cast_quantize() on every element.
+ * The vector code divides by the scale (rather than multiplying with 1/scale) and rounds
+ * half away from zero like round(). Values are clipped to +/-65536 before the conversion,
+ * which doesn't change the saturated result for any zero point in the int8 / uint8 range.
+ */
+static void pre_cast_quantize_buffer(const float *input, size_t n, float scale, int32_t zero_point,
+                                     bool is_signed, void *output) {
+    int8_t *out_i8 = (int8_t*)output;
+    uint8_t *out_u8 = (uint8_t*)output;
+    size_t ix = 0;
+
+#if EI_QUANTIZE_NEON
+    const float32x4_t v_scale = vdupq_n_f32(scale);
+    const float32x4_t v_max = vdupq_n_f32(65536.0f);
+    const float32x4_t v_min = vdupq_n_f32(-65536.0f);
+    const int32x4_t v_zp = vdupq_n_s32(zero_point);
+    for (; ix + 8 <= n; ix += 8) {
+        float32x4_t q0 = vdivq_f32(vld1q_f32(input + ix), v_scale);
+        float32x4_t q1 = vdivq_f32(vld1q_f32(input + ix + 4), v_scale);
+        q0 = vminq_f32(vmaxq_f32(q0, v_min), v_max);
+        q1 = vminq_f32(vmaxq_f32(q1, v_min), v_max);
+        // vcvta rounds to nearest with ties away from zero, same as round()
+        int32x4_t i0 = vaddq_s32(vcvtaq_s32_f32(q0), v_zp);
+        int32x4_t i1 = vaddq_s32(vcvtaq_s32_f32(q1), v_zp);
+        int16x8_t i16 = vcombine_s16(vqmovn_s32(i0), vqmovn_s32(i1));
+        if (is_signed) {
+            vst1_s8(out_i8 + ix, vqmovn_s16(i16));
+        }
+        else {
+            vst1_u8(out_u8 + ix, vqmovun_s16(i16));
+        }
+    }
+#elif EI_QUANTIZE_SSE2
+    const __m128 v_scale = _mm_set1_ps(scale);
+    const __m128 v_max = _mm_set1_ps(65536.0f);
+    const __m128 v_min = _mm_set1_ps(-65536.0f);
+    const __m128 v_half = _mm_set1_ps(0.5f);
+    const __m128 v_neg_half = _mm_set1_ps(-0.5f);
+    const __m128i v_zp = _mm_set1_epi32(zero_point);
+    __m128i i32[4];
+    for (; ix + 16 <= n; ix += 16) {
+        for (int jx = 0; jx < 4; jx++) {
+            __m128 q = _mm_div_ps(_mm_loadu_ps(input + ix + (jx * 4)), v_scale);
+            q = _mm_min_ps(_mm_max_ps(q, v_min), v_max);
+            // truncate, then step away from zero when the (exact) remainder is at least a half
+            __m128i t = _mm_cvttps_epi32(q);
+            __m128 frac = _mm_sub_ps(q, _mm_cvtepi32_ps(t));
+            t = _mm_sub_epi32(t, _mm_castps_si128(_mm_cmpge_ps(frac, v_half)));
+            t = _mm_add_epi32(t, _mm_castps_si128(_mm_cmple_ps(frac, v_neg_half)));
+            i32[jx] = _mm_add_epi32(t, v_zp);
+        }
+        __m128i lo = _mm_packs_epi32(i32[0], i32[1]);
+        __m128i hi = _mm_packs_epi32(i32[2], i32[3]);
+        __m128i packed = is_signed ? _mm_packs_epi16(lo, hi) : _mm_packus_epi16(lo, hi);
+        _mm_storeu_si128((__m128i*)(out_u8 + ix), packed);
+    }
+#endif
+
+    for (; ix < n; ix++) {
+        int32_t v = pre_cast_quantize(input[ix], scale, zero_point, is_signed);
+        if (is_signed) {
+            out_i8[ix] = static_cast<int8_t>(v);
+        }
+        else {
+            out_u8[ix] = static_cast<uint8_t>(v);
+        }
+    }
+}
+
 #endif  //!__EI_QUANTIZE__H__
\ No newline at end of file
@@ -47,6 +47,8 @@
 
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
 #include "edge-impulse-sdk/porting/ei_logging.h"
+#include "edge-impulse-sdk/dsp/ei_profiler.h"
+#include "edge-impulse-sdk/dsp/ei_memory_accounting.h"
 #include <memory>
 
 #if EI_CLASSIFIER_LOAD_ANOMALY_H
@@ -96,6 +98,10 @@
 // This file has an implicit dependency on ei_run_dsp.h, so must come after that include!
 #include "model-parameters/model_variables.h"
 
+// run_classifier_continuous() also slides raw, flatten and spectral analysis blocks over the
+// window (not only MFCC, MFE and spectrogram), applications can check for this at compile time
+#define EI_CLASSIFIER_CONTINUOUS_WINDOW_BLOCKS 1
+
 #ifdef __cplusplus
 namespace {
 #endif // __cplusplus
@@ -111,10 +117,6 @@ EI_IMPULSE_ERROR ei_scale_fmatrix(ei_learning_block_t *block, ei::matrix_t *fmat
 EI_IMPULSE_ERROR ei_unscale_fmatrix(ei_learning_block_t *block, ei::matrix_t *fmatrix);
 #endif // EI_CLASSIFIER_LOAD_IMAGE_SCALING
 
-/* Private variables ------------------------------------------------------- */
-
-static uint64_t classifier_continuous_features_written = 0;
-
 /* Private functions ------------------------------------------------------- */
 
 /* These functions (up to Public functions section) are not exposed to end-user,
@@ -147,7 +149,11 @@ extern "C" EI_IMPULSE_ERROR run_inference(
     ei_impulse_result_t *result,
     bool debug = false)
 {
+    EI_PROFILE_HANDLE(handle);
+    EI_PROFILE_SCOPE("inference");
+    EI_MEMORY_STAGE(EI_MEMORY_STAGE_INFERENCE);
     auto& impulse = handle->impulse;
+    result->_handle = handle;
     for (size_t ix = 0; ix < impulse->learning_blocks_size; ix++) {
 
         ei_learning_block_t block = impulse->learning_blocks[ix];
@@ -197,110 +203,22 @@ extern "C" EI_IMPULSE_ERROR run_inference(
 }
 
 /**
- * @brief      Process a complete impulse
+ * @brief      Run the DSP blocks (and data normalization) of an impulse
  *
- * @param      impulse  struct with information about model and DSP
- * @param      signal   Sample data
- * @param      result   Output classifier results
- * @param      handle   Handle from open_impulse. nullptr for backward compatibility
- * @param[in]  debug    Debug output enable
+ * @param      handle    Impulse handle
+ * @param      signal    Sample data
+ * @param      features  Output features, one entry per DSP block (see get_features())
+ * @param      result    Output classifier results, timing.dsp_us is set here
  *
  * @return     The ei impulse error.
  */
-extern "C" EI_IMPULSE_ERROR process_impulse(ei_impulse_handle_t *handle,
-                                            signal_t *signal,
-                                            ei_impulse_result_t *result,
-                                            bool debug = false)
+static EI_IMPULSE_ERROR run_impulse_dsp(ei_impulse_handle_t *handle,
+                                        signal_t *signal,
+                                        ei_feature_t *features,
+                                        ei_impulse_result_t *result)
 {
-    if ((handle == nullptr) || (handle->impulse  == nullptr) || (result  == nullptr) || (signal  == nullptr)) {
-        return EI_IMPULSE_INFERENCE_ERROR;
-    }
-
-    memset(result, 0, sizeof(ei_impulse_result_t));
-
-#if EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
-    static std::vector<ei_impulse_result_classification_t> classification_results;
-    classification_results.clear(); // todo, should not clear and re-gen this every time...
-
-    if (handle->impulse->results_type == EI_CLASSIFIER_TYPE_CLASSIFICATION ||
-        handle->impulse->results_type == EI_CLASSIFIER_TYPE_REGRESSION) {
-    #ifdef EI_DSP_RESULT_OVERRIDE
-        for (size_t ix = 0; ix < EI_DSP_RESULT_OVERRIDE; ix++) {
-            ei_impulse_result_classification_t classification = {
-                .label = "",
-                .value = 0.0f
-            };
-            classification_results.push_back(classification);
-        }
-    #else
-        for (size_t ix = 0; ix < handle->impulse->label_count; ix++) {
-            ei_impulse_result_classification_t classification = {
-                .label = handle->impulse->categories[ix],
-                .value = 0.0f
-            };
-            classification_results.push_back(classification);
-        }
-    #endif // EI_DSP_RESULT_OVERRIDE
-    }
-
-    result->classification = classification_results.data();
-#endif // EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
-
-    uint8_t num_results = handle->impulse->output_tensors_size;
-
-    std::unique_ptr<ei_feature_t[]> raw_results_ptr(new ei_feature_t[num_results]);
-
-    result->_raw_outputs = raw_results_ptr.get();
-    memset(result->_raw_outputs, 0, sizeof(ei_feature_t) * num_results);
-
-    EI_IMPULSE_ERROR res = EI_IMPULSE_OK;
-    (void)res; // Get around -Werror=unused-variable if neither of the calls below are compiled in (e.g. unit-tests/hr)
-
-#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_VLM_CONNECTOR)
-    // Shortcut for vlm models
-    res = run_vlm_inference(handle, signal, 0, result, handle->impulse->learning_blocks[0].config, false);
-    if (res != EI_IMPULSE_OK) {
-        return res;
-    }
-    res = run_postprocessing(handle, result);
-    return res;
-#endif // EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_VLM_CONNECTOR
-#if (EI_CLASSIFIER_QUANTIZATION_ENABLED == 1 && (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TENSAIFLOW || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_ONNX_TIDL) || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_DRPAI || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_ATON)
-    // Shortcut for quantized image models
-    ei_learning_block_t block = handle->impulse->learning_blocks[0];
-    if (can_run_classifier_image_quantized(handle->impulse, block) == EI_IMPULSE_OK) {
-        res = run_classifier_image_quantized(handle->impulse, signal, result, debug);
-        if (res != EI_IMPULSE_OK) {
-            return res;
-        }
-        res = run_postprocessing(handle, result);
-        ei_result_struct_timing_us_to_ms(result);
-        return res;
-    }
-#endif // EI_CLASSIFIER_QUANTIZATION_ENABLED == 1 && (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TENSAIFLOW || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_ONNX_TIDL) || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_DRPAI || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_ATON
-    uint32_t block_num = handle->impulse->dsp_blocks_size;
-
-    // smart pointer to features array
-    std::unique_ptr<ei_feature_t[]> features_ptr(new ei_feature_t[block_num]);
-    ei_feature_t* features = features_ptr.get();
-
-    if (features == nullptr) {
-        ei_printf("ERR: Out of memory, can't allocate features\n");
-        return EI_IMPULSE_ALLOC_FAILED;
-    }
-
-    memset(features, 0, sizeof(ei_feature_t) * block_num);
-
-    // have it outside of the loop to avoid going out of scope
-    std::unique_ptr<std::unique_ptr<ei::matrix_t>[]> matrix_ptrs_ptr(new std::unique_ptr<ei::matrix_t>[block_num]);
-    std::unique_ptr<ei::matrix_t> *matrix_ptrs = matrix_ptrs_ptr.get();
-
-    if (matrix_ptrs == nullptr) {
-        delete[] matrix_ptrs;
-        ei_printf("ERR: Out of memory, can't allocate matrix_ptrs\n");
-        return EI_IMPULSE_ALLOC_FAILED;
-    }
-
+    EI_PROFILE_SCOPE("dsp");
+    EI_MEMORY_STAGE(EI_MEMORY_STAGE_DSP);
     uint64_t dsp_start_us = ei_read_timer_us();
 
     size_t out_features_index = 0;
@@ -308,21 +226,6 @@ extern "C" EI_IMPULSE_ERROR process_impulse(ei_impulse_handle_t *handle,
     for (size_t ix = 0; ix < handle->impulse->dsp_blocks_size; ix++) {
         ei_model_dsp_t block = handle->impulse->dsp_blocks[ix];
 
-        matrix_ptrs[ix] = std::unique_ptr<ei::matrix_t>(new ei::matrix_t(1, block.n_output_features));
-        if (matrix_ptrs[ix] == nullptr) {
-            ei_printf("ERR: Out of memory, can't allocate matrix_ptrs[%lu]\n", (unsigned long)ix);
-            return EI_IMPULSE_ALLOC_FAILED;
-        }
-
-        if (matrix_ptrs[ix]->buffer == nullptr) {
-            ei_printf("ERR: Out of memory, can't allocate matrix_ptrs[%lu]\n", (unsigned long)ix);
-            delete[] matrix_ptrs;
-            return EI_IMPULSE_ALLOC_FAILED;
-        }
-
-        features[ix].matrix = matrix_ptrs[ix].get();
-        features[ix].blockId = block.blockId;
-
         if (out_features_index + block.n_output_features > handle->impulse->nn_input_frame_size) {
             ei_printf("ERR: Would write outside feature buffer\n");
             return EI_IMPULSE_DSP_ERROR;
@@ -387,6 +290,136 @@ extern "C" EI_IMPULSE_ERROR process_impulse(ei_impulse_handle_t *handle,
 
     result->timing.dsp_us = ei_read_timer_us() - dsp_start_us;
 
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * @brief      Let a single DSP block write straight into the float32 input tensor of a single
+ *             TFLite learn block (no copy between DSP and inference). No-op for any other
+ *             impulse, the features then stay in the handle's buffer and are copied (or
+ *             quantized) into the tensor by the inferencing engine.
+ *
+ * @param      handle    Impulse handle
+ * @param      features  Features from get_features()
+ */
+static void bind_features_to_input_tensor(ei_impulse_handle_t *handle, ei_feature_t *features)
+{
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL) && (EI_CLASSIFIER_DSP_ONLY == 0)
+    const ei_impulse_t *impulse = handle->impulse;
+    if (impulse->dsp_blocks_size != 1 || impulse->learning_blocks_size != 1) {
+        return;
+    }
+    ei_learning_block_t block = impulse->learning_blocks[0];
+    if (block.infer_fn != run_nn_inference || block.input_block_ids_size != 1 ||
+        block.input_block_ids[0] != features[0].blockId) {
+        return;
+    }
+
+    float *input_buffer = ei_tflite_get_input_buffer(handle,
+        (ei_learning_block_config_tflite_graph_t*)block.config, impulse->dsp_blocks[0].n_output_features);
+    if (input_buffer != nullptr) {
+        handle->state.bind_features(input_buffer);
+    }
+#else
+    (void)handle;
+    (void)features;
+#endif
+}
+
+/**
+ * @brief      Process a complete impulse
+ *
+ * @param      impulse  struct with information about model and DSP
+ * @param      signal   Sample data
+ * @param      result   Output classifier results
+ * @param      handle   Handle from open_impulse. nullptr for backward compatibility
+ * @param[in]  debug    Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+extern "C" EI_IMPULSE_ERROR process_impulse(ei_impulse_handle_t *handle,
+                                            signal_t *signal,
+                                            ei_impulse_result_t *result,
+                                            bool debug = false)
+{
+    if ((handle == nullptr) || (handle->impulse  == nullptr) || (result  == nullptr) || (signal  == nullptr)) {
+        return EI_IMPULSE_INFERENCE_ERROR;
+    }
+
+    // counts the inferences in the profile of the handle
+    EI_PROFILE_HANDLE(handle);
+    EI_PROFILE_SCOPE("impulse");
+    EI_MEMORY_COUNT_INFERENCE();
+
+    memset(result, 0, sizeof(ei_impulse_result_t));
+
+    EI_MEMORY_STAGE_BEGIN(results, EI_MEMORY_STAGE_RESULTS);
+
+#if EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
+    if (handle->impulse->results_type == EI_CLASSIFIER_TYPE_CLASSIFICATION ||
+        handle->impulse->results_type == EI_CLASSIFIER_TYPE_REGRESSION) {
+    #ifdef EI_DSP_RESULT_OVERRIDE
+        result->classification = handle->state.get_classification(EI_DSP_RESULT_OVERRIDE);
+    #else
+        result->classification = handle->state.get_classification(handle->impulse->label_count);
+    #endif // EI_DSP_RESULT_OVERRIDE
+        if (result->classification == nullptr) {
+            ei_printf("ERR: Out of memory, can't allocate classification results\n");
+            return EI_IMPULSE_ALLOC_FAILED;
+        }
+    }
+#endif // EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
+
+    result->_raw_outputs = handle->state.get_raw_outputs();
+    if (result->_raw_outputs == nullptr) {
+        ei_printf("ERR: Out of memory, can't allocate raw outputs\n");
+        return EI_IMPULSE_ALLOC_FAILED;
+    }
+    EI_MEMORY_STAGE_END(results);
+
+    EI_IMPULSE_ERROR res = EI_IMPULSE_OK;
+    (void)res; // Get around -Werror=unused-variable if neither of the calls below are compiled in (e.g. unit-tests/hr)
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_VLM_CONNECTOR)
+    // Shortcut for vlm models
+    res = run_vlm_inference(handle, signal, 0, result, handle->impulse->learning_blocks[0].config, false);
+    if (res != EI_IMPULSE_OK) {
+        return res;
+    }
+    res = run_postprocessing(handle, result);
+    return res;
+#endif // EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_VLM_CONNECTOR
+#if (EI_CLASSIFIER_QUANTIZATION_ENABLED == 1 && (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TENSAIFLOW || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_ONNX_TIDL) || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_DRPAI || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_ATON)
+    // Shortcut for quantized image models
+    ei_learning_block_t block = handle->impulse->learning_blocks[0];
+    if (can_run_classifier_image_quantized(handle->impulse, block) == EI_IMPULSE_OK) {
+        result->_handle = handle;
+        res = run_classifier_image_quantized(handle->impulse, signal, result, debug);
+        if (res != EI_IMPULSE_OK) {
+            return res;
+        }
+        res = run_postprocessing(handle, result);
+        ei_result_struct_timing_us_to_ms(result);
+        return res;
+    }
+#endif // EI_CLASSIFIER_QUANTIZATION_ENABLED == 1 && (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TENSAIFLOW || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_ONNX_TIDL) || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_DRPAI || EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_ATON
+    uint32_t block_num = handle->impulse->dsp_blocks_size;
+
+    // features (and their matrices) are owned by the handle and reused between calls
+    EI_MEMORY_STAGE_BEGIN(input, EI_MEMORY_STAGE_INPUT);
+    ei_feature_t* features = handle->state.get_features();
+    if (features == nullptr) {
+        ei_printf("ERR: Out of memory, can't allocate features\n");
+        return EI_IMPULSE_ALLOC_FAILED;
+    }
+    bind_features_to_input_tensor(handle, features);
+    EI_MEMORY_STAGE_END(input);
+
+    res = run_impulse_dsp(handle, signal, features, result);
+    if (res != EI_IMPULSE_OK) {
+        return res;
+    }
+
     if (debug) {
         ei_printf("Features (%d ms.): ", result->timing.dsp);
         for (size_t ix = 0; ix < block_num; ix++) {
@@ -426,6 +459,175 @@ extern "C" EI_IMPULSE_ERROR process_impulse(ei_impulse_handle_t *handle,
 #endif
 }
 
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL) && (EI_CLASSIFIER_DSP_ONLY == 0)
+/**
+ * @brief      Run a batch of samples through the impulse with a single interpreter Invoke().
+ *             Only for impulses with one TFLite learn block, see process_impulse_batch().
+ *
+ * @return     EI_IMPULSE_UNSUPPORTED_INFERENCING_ENGINE if the model can't be batched
+ *             (nothing has run yet in that case), otherwise the ei impulse error.
+ */
+static EI_IMPULSE_ERROR process_impulse_batch_tflite(ei_impulse_handle_t *handle,
+                                                     signal_t *signals,
+                                                     size_t n,
+                                                     ei_impulse_result_t *results,
+                                                     bool debug)
+{
+    ei_learning_block_t block = handle->impulse->learning_blocks[0];
+    if (handle->impulse->learning_blocks_size != 1 || block.infer_fn != run_nn_inference) {
+        return EI_IMPULSE_UNSUPPORTED_INFERENCING_ENGINE;
+    }
+
+    for (size_t ix = 0; ix < n; ix++) {
+#if EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
+        ei_impulse_result_classification_t *classification = results[ix].classification;
+        memset(&results[ix], 0, sizeof(ei_impulse_result_t));
+        results[ix].classification = classification;
+#else
+        memset(&results[ix], 0, sizeof(ei_impulse_result_t));
+#endif
+        results[ix]._handle = handle;
+        results[ix]._raw_outputs = handle->state.get_raw_outputs();
+        if (results[ix]._raw_outputs == nullptr) {
+            ei_printf("ERR: Out of memory, can't allocate raw outputs\n");
+            return EI_IMPULSE_ALLOC_FAILED;
+        }
+    }
+
+    if (debug) {
+        ei_printf("Running impulse (batch of %d)...\n", (int)n);
+    }
+
+    auto get_features = [&](size_t ix, ei_feature_t **fmatrix) -> EI_IMPULSE_ERROR {
+        // features are reused for every sample, they're copied into the input tensor right away
+        ei_feature_t *features = handle->state.get_features();
+        if (features == nullptr) {
+            ei_printf("ERR: Out of memory, can't allocate features\n");
+            return EI_IMPULSE_ALLOC_FAILED;
+        }
+
+        EI_IMPULSE_ERROR res = run_impulse_dsp(handle, &signals[ix], features, &results[ix]);
+        if (res != EI_IMPULSE_OK) {
+            return res;
+        }
+
+#if EI_CLASSIFIER_LOAD_IMAGE_SCALING
+        uint64_t start_scale_matrix_us = ei_read_timer_us();
+        res = ei_scale_fmatrix(&block, features[0].matrix);
+        if (res != EI_IMPULSE_OK) {
+            return res;
+        }
+        results[ix].timing.dsp_us += ei_read_timer_us() - start_scale_matrix_us;
+#endif
+
+        *fmatrix = features;
+        return EI_IMPULSE_OK;
+    };
+
+    auto process_output = [&](size_t ix) -> EI_IMPULSE_ERROR {
+        EI_IMPULSE_ERROR res = run_postprocessing(handle, &results[ix]);
+        // without EI_CLASSIFIER_REUSE_RAW_OUTPUTS postprocessing frees the raw output
+        // matrices, so clear the (shared) array before the next row is copied in
+        handle->state.get_raw_outputs();
+        ei_result_struct_timing_us_to_ms(&results[ix]);
+        return res;
+    };
+
+    EI_IMPULSE_ERROR res = run_nn_inference_batch(handle->impulse, n, 0,
+        (uint32_t*)block.input_block_ids, block.input_block_ids_size,
+        results, block.config, get_features, process_output);
+    if (res != EI_IMPULSE_OK) {
+        return res;
+    }
+
+    if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
+        return EI_IMPULSE_CANCELED;
+    }
+
+    return EI_IMPULSE_OK;
+}
+#endif // (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL) && (EI_CLASSIFIER_DSP_ONLY == 0)
+
+/**
+ * @brief      Process a batch of complete impulses. With the full TFLite engine the learn
+ *             block runs once for the whole batch, otherwise this is process_impulse() in a loop.
+ *
+ * @param      handle   Handle from open_impulse
+ * @param      signals  Array of n samples
+ * @param[in]  n        Number of samples
+ * @param      results  Array of n output classifier results
+ * @param[in]  debug    Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+extern "C" EI_IMPULSE_ERROR process_impulse_batch(ei_impulse_handle_t *handle,
+                                                  signal_t *signals,
+                                                  size_t n,
+                                                  ei_impulse_result_t *results,
+                                                  bool debug = false)
+{
+    if ((handle == nullptr) || (handle->impulse  == nullptr) || (results  == nullptr) || (signals  == nullptr)) {
+        return EI_IMPULSE_INFERENCE_ERROR;
+    }
+
+    EI_PROFILE_HANDLE(handle);
+
+    // other result types point into per-handle postprocessing state, which the next sample overwrites
+    if (handle->impulse->results_type != EI_CLASSIFIER_TYPE_CLASSIFICATION &&
+        handle->impulse->results_type != EI_CLASSIFIER_TYPE_REGRESSION) {
+        ei_printf("ERR: Batched inference is only supported for classification and regression\n");
+        return EI_IMPULSE_LAST_LAYER_NOT_SUPPORTED;
+    }
+#if EI_CLASSIFIER_HAS_VISUAL_ANOMALY
+    ei_printf("ERR: Batched inference is not supported for visual anomaly detection\n");
+    return EI_IMPULSE_LAST_LAYER_NOT_SUPPORTED;
+#endif
+
+#if EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
+    #ifdef EI_DSP_RESULT_OVERRIDE
+    const size_t classification_count = EI_DSP_RESULT_OVERRIDE;
+    #else
+    const size_t classification_count = handle->impulse->label_count;
+    #endif // EI_DSP_RESULT_OVERRIDE
+
+    // slot 0 is used by process_impulse(), results[ix] gets slot ix + 1.
+    // Reserve the last slot first, as growing the storage moves it.
+    if (n > 0 && handle->state.get_classification(classification_count, n) == nullptr) {
+        ei_printf("ERR: Out of memory, can't allocate classification results\n");
+        return EI_IMPULSE_ALLOC_FAILED;
+    }
+    for (size_t ix = 0; ix < n; ix++) {
+        results[ix].classification = handle->state.get_classification(classification_count, ix + 1);
+    }
+#endif // EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL) && (EI_CLASSIFIER_DSP_ONLY == 0)
+    if (n > 1) {
+        EI_IMPULSE_ERROR res = process_impulse_batch_tflite(handle, signals, n, results, debug);
+        if (res != EI_IMPULSE_UNSUPPORTED_INFERENCING_ENGINE) {
+            return res;
+        }
+    }
+#endif // (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL) && (EI_CLASSIFIER_DSP_ONLY == 0)
+
+    for (size_t ix = 0; ix < n; ix++) {
+#if EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
+        ei_impulse_result_classification_t *classification = results[ix].classification;
+#endif
+        EI_IMPULSE_ERROR res = process_impulse(handle, &signals[ix], &results[ix], debug);
+        if (res != EI_IMPULSE_OK) {
+            return res;
+        }
+#if EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
+        // move the values out of slot 0 before the next sample overwrites them
+        memcpy(classification, results[ix].classification, classification_count * sizeof(ei_impulse_result_classification_t));
+        results[ix].classification = classification;
+#endif
+    }
+
+    return EI_IMPULSE_OK;
+}
+
 /**
  * @brief      Opens an impulse
  *
@@ -460,35 +662,29 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *hand
         return EI_IMPULSE_INFERENCE_ERROR;
     }
 
+    // counts the inferences in the profile of the handle
+    EI_PROFILE_HANDLE(handle);
+    EI_PROFILE_SCOPE("impulse");
+    EI_MEMORY_COUNT_INFERENCE();
+
     memset(result, 0, sizeof(ei_impulse_result_t));
 
-#if EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
-    static std::vector<ei_impulse_result_classification_t> classification_results;
-    classification_results.clear(); // todo, should not clear and re-gen this every time...
+    EI_MEMORY_STAGE_BEGIN(results, EI_MEMORY_STAGE_RESULTS);
 
+#if EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
     if (handle->impulse->results_type == EI_CLASSIFIER_TYPE_CLASSIFICATION ||
         handle->impulse->results_type == EI_CLASSIFIER_TYPE_REGRESSION) {
     #ifdef EI_DSP_RESULT_OVERRIDE
-        for (size_t ix = 0; ix < EI_DSP_RESULT_OVERRIDE; ix++) {
-            ei_impulse_result_classification_t classification = {
-                .label = "",
-                .value = 0.0f
-            };
-            classification_results.push_back(classification);
-        }
+        result->classification = handle->state.get_classification(EI_DSP_RESULT_OVERRIDE);
     #else
-        for (size_t ix = 0; ix < handle->impulse->label_count; ix++) {
-            ei_impulse_result_classification_t classification = {
-                .label = handle->impulse->categories[ix],
-                .value = 0.0f
-            };
-            classification_results.push_back(classification);
+        result->classification = handle->state.get_classification(handle->impulse->label_count);
+    #endif // EI_DSP_RESULT_OVERRIDE
+        if (result->classification == nullptr) {
+            ei_printf("ERR: Out of memory, can't allocate classification results\n");
+            return EI_IMPULSE_ALLOC_FAILED;
         }
-    #endif
     }
 
-    result->classification = classification_results.data();
-
 #else // EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 1
 
     for (int i = 0; i < handle->impulse->label_count; i++) {
@@ -498,19 +694,26 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *hand
 
 #endif // EI_IMPULSE_RESULT_CLASSIFICATION_IS_STATICALLY_ALLOCATED == 0
 
-    // smart pointer to results array
-    std::unique_ptr<ei_feature_t[]> raw_results_ptr(new ei_feature_t[handle->impulse->learning_blocks_size]);
-    result->_raw_outputs = raw_results_ptr.get();
-    memset(result->_raw_outputs, 0, sizeof(ei_feature_t) * handle->impulse->learning_blocks_size);
+    result->_raw_outputs = handle->state.get_raw_outputs();
+    if (result->_raw_outputs == nullptr) {
+        ei_printf("ERR: Out of memory, can't allocate raw outputs\n");
+        return EI_IMPULSE_ALLOC_FAILED;
+    }
+    EI_MEMORY_STAGE_END(results);
 
     auto impulse = handle->impulse;
-    static ei::matrix_t static_features_matrix(1, impulse->nn_input_frame_size);
-    if (!static_features_matrix.buffer) {
+    // sliding window of features, owned by the handle so multiple handles can run concurrently
+    ei::matrix_t *continuous_features = handle->state.get_continuous_features();
+    if (continuous_features == nullptr) {
+        ei_printf("ERR: Out of memory, can't allocate continuous features\n");
         return EI_IMPULSE_ALLOC_FAILED;
     }
+    ei_dsp_cont_state_t *dsp_cont_state = handle->state.get_dsp_cont_state();
 
     EI_IMPULSE_ERROR ei_impulse_error = EI_IMPULSE_OK;
 
+    EI_PROFILE_BEGIN(dsp, "dsp");
+    EI_MEMORY_STAGE_BEGIN(dsp, EI_MEMORY_STAGE_DSP);
     uint64_t dsp_start_us = ei_read_timer_us();
 
     size_t out_features_index = 0;
@@ -524,9 +727,12 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *hand
         }
 
         ei::matrix_t fm(1, block.n_output_features,
-                        static_features_matrix.buffer + out_features_index);
+                        continuous_features->buffer + out_features_index);
 
-        int (*extract_fn_slice)(ei::signal_t *signal, ei::matrix_t *output_matrix, void *config, const float frequency, matrix_size_t *out_matrix_size);
+        int (*extract_fn_slice)(ei::signal_t *signal, ei::matrix_t *output_matrix, void *config, const float frequency, matrix_size_t *out_matrix_size, ei_dsp_cont_state_t *cont_state) = nullptr;
+        // blocks that don't frame their input keep a window of raw data instead, and write all
+        // of their features once that window is full
+        int (*extract_fn_window)(ei::signal_t *signal, ei::matrix_t *output_matrix, void *config, const float frequency, matrix_size_t *out_matrix_size, ei_dsp_window_state_t *window_state) = nullptr;
 
         /* Switch to the slice version of the mfcc feature extract function */
         if (block.extract_fn == extract_mfcc_features) {
@@ -538,11 +744,33 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *hand
         else if (block.extract_fn == extract_mfe_features) {
             extract_fn_slice = &extract_mfe_per_slice_features;
         }
+        else if (block.extract_fn == extract_raw_features) {
+            extract_fn_window = &extract_raw_per_slice_features;
+        }
+        else if (block.extract_fn == extract_flatten_features) {
+            extract_fn_window = &extract_flatten_per_slice_features;
+        }
+        else if (block.extract_fn == extract_spectral_analysis_features) {
+            extract_fn_window = &extract_spectral_analysis_per_slice_features;
+        }
+        else if (block.extract_fn == extract_image_features) {
+            ei_printf("ERR: Image blocks have no overlapping windows to run continuously, use run_classifier() for every frame instead\n");
+            return EI_IMPULSE_DSP_ERROR;
+        }
         else {
-            ei_printf("ERR: Unknown extract function, only MFCC, MFE and spectrogram supported\n");
+            ei_printf("ERR: Unknown extract function, only MFCC, MFE, spectrogram, raw, flatten and spectral analysis supported\n");
             return EI_IMPULSE_DSP_ERROR;
         }
 
+        ei_dsp_window_state_t *window_state = nullptr;
+        if (extract_fn_window) {
+            window_state = handle->state.get_dsp_window_state(ix);
+            if (window_state == nullptr) {
+                ei_printf("ERR: Out of memory, can't allocate continuous window\n");
+                return EI_IMPULSE_ALLOC_FAILED;
+            }
+        }
+
         matrix_size_t features_written;
 
 #if EIDSP_SIGNAL_C_FN_POINTER
@@ -550,11 +778,18 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *hand
             ei_printf("ERR: EIDSP_SIGNAL_C_FN_POINTER can only be used when all axes are selected for DSP blocks\n");
             return EI_IMPULSE_DSP_ERROR;
         }
-        int ret = extract_fn_slice(signal, &fm, block.config, impulse->frequency, &features_written);
+        ei::signal_t *block_signal = signal;
 #else
         SignalWithAxes swa(signal, block.axes, block.axes_size, impulse);
-        int ret = extract_fn_slice(swa.get_signal(), &fm, block.config, impulse->frequency, &features_written);
+        ei::signal_t *block_signal = swa.get_signal();
 #endif
+        int ret;
+        if (extract_fn_window) {
+            ret = extract_fn_window(block_signal, &fm, block.config, impulse->frequency, &features_written, window_state);
+        }
+        else {
+            ret = extract_fn_slice(block_signal, &fm, block.config, impulse->frequency, &features_written, dsp_cont_state);
+        }
 
         if (ret != EIDSP_OK) {
             ei_printf("ERR: Failed to run DSP process (%d)\n", ret);
@@ -565,57 +800,36 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *hand
             return EI_IMPULSE_CANCELED;
         }
 
-        classifier_continuous_features_written += (features_written.rows * features_written.cols);
+        handle->state.continuous_features_written += (features_written.rows * features_written.cols);
 
         out_features_index += block.n_output_features;
     }
 
     result->timing.dsp_us = ei_read_timer_us() - dsp_start_us;
+    EI_PROFILE_END(dsp);
+    EI_MEMORY_STAGE_END(dsp);
 
-    if (classifier_continuous_features_written >= impulse->nn_input_frame_size) {
+    if (handle->state.continuous_features_written >= impulse->nn_input_frame_size) {
+        EI_PROFILE_BEGIN(normalization, "dsp");
+        EI_MEMORY_STAGE_BEGIN(normalization, EI_MEMORY_STAGE_DSP);
         dsp_start_us = ei_read_timer_us();
 
-        uint32_t block_num = impulse->dsp_blocks_size + impulse->learning_blocks_size;
-
-        // smart pointer to features array
-        std::unique_ptr<ei_feature_t[]> features_ptr(new ei_feature_t[block_num]);
-        ei_feature_t* features = features_ptr.get();
+        // features (and their matrices) are owned by the handle and reused between calls
+        ei_feature_t* features = handle->state.get_features();
         if (features == nullptr) {
             ei_printf("ERR: Out of memory, can't allocate features\n");
             return EI_IMPULSE_ALLOC_FAILED;
         }
-        memset(features, 0, sizeof(ei_feature_t) * block_num);
-
-        // have it outside of the loop to avoid going out of scope
-        std::unique_ptr<ei::matrix_t> *matrix_ptrs = new std::unique_ptr<ei::matrix_t>[block_num];
-        if (matrix_ptrs == nullptr) {
-            ei_printf("ERR: Out of memory, can't allocate matrix_ptrs\n");
-            return EI_IMPULSE_ALLOC_FAILED;
-        }
+        bind_features_to_input_tensor(handle, features);
 
         out_features_index = 0;
         // iterate over every dsp block and run normalization
         for (size_t ix = 0; ix < impulse->dsp_blocks_size; ix++) {
             ei_model_dsp_t block = impulse->dsp_blocks[ix];
-            matrix_ptrs[ix] = std::unique_ptr<ei::matrix_t>(new ei::matrix_t(1, block.n_output_features));
-
-            if (matrix_ptrs[ix] == nullptr) {
-                ei_printf("ERR: Out of memory, can't allocate matrix_ptrs[%lu]\n", (unsigned long)ix);
-                return EI_IMPULSE_ALLOC_FAILED;
-            }
-
-            if (matrix_ptrs[ix]->buffer == nullptr) {
-                ei_printf("ERR: Out of memory, can't allocate matrix_ptrs[%lu]\n", (unsigned long)ix);
-                delete[] matrix_ptrs;
-                return EI_IMPULSE_ALLOC_FAILED;
-            }
-
-            features[ix].matrix = matrix_ptrs[ix].get();
-            features[ix].blockId = block.blockId;
 
             /* Create a copy of the matrix for normalization */
             for (size_t m_ix = 0; m_ix < block.n_output_features; m_ix++) {
-                features[ix].matrix->buffer[m_ix] = static_features_matrix.buffer[out_features_index + m_ix];
+                features[ix].matrix->buffer[m_ix] = continuous_features->buffer[out_features_index + m_ix];
             }
 
             if (block.extract_fn == extract_mfcc_features) {
@@ -631,6 +845,8 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *hand
         }
 
         result->timing.dsp_us += ei_read_timer_us() - dsp_start_us;
+        EI_PROFILE_END(normalization);
+        EI_MEMORY_STAGE_END(normalization);
 
         if (debug) {
             ei_printf("Feature Matrix: \n");
@@ -646,7 +862,6 @@ extern "C" EI_IMPULSE_ERROR process_impulse_continuous(ei_impulse_handle_t *hand
         if (ei_impulse_error != EI_IMPULSE_OK) {
             return ei_impulse_error;
         }
-        delete[] matrix_ptrs;
         ei_impulse_error = run_postprocessing(handle, result);
         if (ei_impulse_error != EI_IMPULSE_OK) {
             return ei_impulse_error;
@@ -862,8 +1077,6 @@ will be documented by Doxygen. */
  */
 extern "C" void run_classifier_init(void)
 {
-
-    classifier_continuous_features_written = 0;
     ei_dsp_clear_continuous_audio_state();
     init_impulse(&ei_default_impulse);
     init_postprocessing(&ei_default_impulse);
@@ -888,8 +1101,7 @@ extern "C" void run_classifier_init(void)
  */
 __attribute__((unused)) void run_classifier_init(ei_impulse_handle_t *handle)
 {
-    classifier_continuous_features_written = 0;
-    ei_dsp_clear_continuous_audio_state();
+    // continuous state (features written, audio frame) is per handle and cleared here
     init_impulse(handle);
     init_postprocessing(handle);
 #if EI_CLASSIFIER_HAS_DATA_NORMALIZATION
@@ -897,12 +1109,35 @@ __attribute__((unused)) void run_classifier_init(ei_impulse_handle_t *handle)
 #endif
 }
 
+#if EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL
+/**
+ * @brief Initialize an impulse handle and set the runtime options for its TFLite interpreters.
+ *
+ * Same as [run_classifier_init()](#run_classifier_init-1), and sets the thread count, XNNPACK and
+ * CPU affinity that are used when the interpreters for `handle` are built. Interpreters that exist
+ * already are released and rebuilt on the next inference. `run_classifier_deinit()` resets the
+ * options to `EI_TFLITE_RUNTIME_OPTIONS_DEFAULT`.
+ *
+ * **Blocking**: yes
+ *
+ * @param[in]   handle struct with information about model and DSP
+ * @param[in]   options Runtime options for the interpreters, copied
+ */
+__attribute__((unused)) void run_classifier_init(ei_impulse_handle_t *handle, const ei_tflite_runtime_options_t *options)
+{
+    ei_tflite_set_runtime_options(handle, options);
+    run_classifier_init(handle);
+}
+#endif // EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL
+
 /**
  * @brief Deletes static variables when running preprocessing and inference continuously.
  *
  * Deletes internal static variables used by `run_classifier_continuous()`, which
  * includes the moving average filter (MAF). This function should be called when you
- * are done running continuous classification.
+ * are done running continuous classification. Also frees the interpreters that TFLite
+ * (Micro) keeps for the impulse between inferences, and with the full TFLite engine resets the
+ * runtime options of the impulse to `EI_TFLITE_RUNTIME_OPTIONS_DEFAULT`.
  *
  * **Blocking**: yes
  *
@@ -911,15 +1146,124 @@ __attribute__((unused)) void run_classifier_init(ei_impulse_handle_t *handle)
 extern "C" void run_classifier_deinit(void)
 {
     deinit_postprocessing(&ei_default_impulse);
+    ei_default_impulse.state.free_learning_block_states();
+#if EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL
+    ei_tflite_release_instances(&ei_default_impulse);
+#endif
+#if EIDSP_PROFILING == 1
+    EiStageProfiler::get().remove(&ei_default_impulse);
+#endif
 }
 
 __attribute__((unused)) void run_classifier_deinit(ei_impulse_handle_t *handle)
 {
     deinit_postprocessing(handle);
+    // e.g. TFLite Micro interpreters and arenas, rebuilt on the next inference
+    handle->state.free_learning_block_states();
 #if EI_CLASSIFIER_HAS_DATA_NORMALIZATION
     deinit_data_normalization(handle);
 #endif
+#if EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL
+    ei_tflite_release_instances(handle);
+#endif
+#if EIDSP_PROFILING == 1
+    EiStageProfiler::get().remove(handle);
+#endif
+}
+
+#if EIDSP_PROFILING == 1
+/**
+ * @brief Clear the timings the profiler collected for `handle` (see ei_profiler_start()).
+ *
+ * @param[in]   handle struct with information about model and DSP
+ */
+__attribute__((unused)) void ei_profiler_reset(ei_impulse_handle_t *handle)
+{
+    EiStageProfiler::get().reset(handle);
+#if EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL
+    ei_tflite_reset_op_profile(handle);
+#endif
+}
+
+/**
+ * @brief Start profiling the inferences of `handle`.
+ *
+ * Clears previous timings, then times the stages of every inference: the DSP and its
+ * sub-stages (framing, FFT, filterbank, DCT, normalization), the inference and postprocessing.
+ * With the full TFLite engine every op of the model is timed as well; if the interpreters of
+ * `handle` weren't built with a profiler (`ei_tflite_runtime_options_t::enable_profiling`) they
+ * are rebuilt on the next inference, so run one inference and call `ei_profiler_reset()` before
+ * the inferences you want to measure.
+ *
+ * The profile is per handle: inferences of other handles, also when they run at the same time
+ * on other threads, are neither timed nor counted in it.
+ *
+ * **Blocking**: yes
+ *
+ * @param[in]   handle struct with information about model and DSP
+ */
+__attribute__((unused)) void ei_profiler_start(ei_impulse_handle_t *handle)
+{
+#if EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL
+    ei_tflite_enable_op_profiling(handle);
+#endif
+    ei_profiler_reset(handle);
+    EiStageProfiler::get().set_enabled(handle, true);
+}
+
+/**
+ * @brief Stop profiling the inferences of `handle`. The timings are kept until the next
+ * `ei_profiler_start()`.
+ *
+ * Stops timing the stages of `handle` and, with
+ * the full TFLite engine, takes the op profiler off the interpreters of `handle` and clears
+ * `ei_tflite_runtime_options_t::enable_profiling`, so inferences don't pay for op events after
+ * profiling and interpreters built later don't get a profiler either.
+ *
+ * **Blocking**: yes
+ *
+ * @param[in]   handle struct with information about model and DSP
+ */
+__attribute__((unused)) void ei_profiler_stop(ei_impulse_handle_t *handle)
+{
+    EiStageProfiler::get().set_enabled(handle, false);
+#if EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL
+    ei_tflite_disable_op_profiling(handle);
+#else
+    (void)handle;
+#endif
+}
+
+/**
+ * @brief Get the timings collected for `handle` since `ei_profiler_start()` (or
+ * `ei_profiler_reset()`). `report->inferences` counts the inferences of `handle` only, so the
+ * per inference stage and op averages are for that handle.
+ *
+ * Print the report with `ei_profiler_print_report()` or serialize it with
+ * `ei_profiler_report_to_json()`.
+ *
+ * @param[in]   handle struct with information about model and DSP
+ * @param[out]  report Timings per stage and per op (ops only with the full TFLite engine)
+ */
+__attribute__((unused)) void ei_profiler_get_report(ei_impulse_handle_t *handle, ei_profiler_report_t *report)
+{
+    EiStageProfiler::get().get_stages(handle, &report->stages);
+
+    report->inferences = 0;
+    for (const ei_profiler_entry_t &stage : report->stages) {
+        if (stage.name == "impulse") {
+            report->inferences = stage.count;
+        }
+    }
+
+    report->ops.clear();
+#if EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL
+    ei_tflite_get_op_profile(handle, &report->ops);
+#else
+    (void)handle;
+#endif
 }
+#endif // EIDSP_PROFILING == 1
 
 /**
  * @brief Run preprocessing (DSP) on new slice of raw features. Add output features
@@ -1100,6 +1444,67 @@ __attribute__((unused)) EI_IMPULSE_ERROR run_classifier(
     return process_impulse(impulse, signal, result, debug);
 }
 
+/**
+ * @brief Run the classifier over a batch of raw features arrays.
+ *
+ *
+ * Overloaded function [run_classifier_batch()](#run_classifier_batch-1) that defaults to the single impulse.
+ *
+ * **Blocking**: yes
+ *
+ * @param[in] signals Array of `n` `signal_t` structs, each like the `signal` argument of `run_classifier()`.
+ * @param[in] n Number of signals (and results).
+ * @param[out] results Array of `n` ei_impulse_result_t structs, `results[ix]` holds the output for `signals[ix]`.
+ * @param[in] debug Print internal preprocessing and inference debugging information via `ei_printf()`.
+ *
+ * @return Error code as defined by `EI_IMPULSE_ERROR` enum. Will be `EI_IMPULSE_OK` if inference
+ *  completed successfully for all signals.
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_batch(
+    signal_t *signals,
+    size_t n,
+    ei_impulse_result_t *results,
+    bool debug = false)
+{
+    return process_impulse_batch(&ei_default_impulse, signals, n, results, debug);
+}
+
+/**
+ * @brief Run the classifier over a batch of raw features arrays.
+ *
+ *
+ * Runs the DSP for every signal, then (with the full TFLite engine, `EI_CLASSIFIER_USE_FULL_TFLITE`)
+ * resizes the model input to a batch of `n` and runs the neural network once for all of them. The
+ * input stays resized until the next call with a different `n` (or a call to `run_classifier()`).
+ * Models that can't be resized (e.g. a fixed batch of 1 in a reshape), and other inferencing engines,
+ * fall back to one `run_classifier()` call per signal.
+ *
+ * Only classification and regression impulses are supported. The classification arrays in `results`
+ * are owned by the handle and stay valid until the next `run_classifier_batch()` call.
+ *
+ * **Blocking**: yes
+ *
+ * @param[in] impulse Pointer to an `ei_impulse_handle_t` struct that contains the model and
+ *  preprocessing information.
+ * @param[in] signals Array of `n` `signal_t` structs, each like the `signal` argument of `run_classifier()`.
+ * @param[in] n Number of signals (and results).
+ * @param[out] results Array of `n` ei_impulse_result_t structs, `results[ix]` holds the output for `signals[ix]`.
+ *  `timing.classification` is the time of the batched inference divided by `n`.
+ * @param[in] debug Print internal preprocessing and inference debugging information via `ei_printf()`.
+ *
+ * @return Error code as defined by `EI_IMPULSE_ERROR` enum. Will be `EI_IMPULSE_OK` if inference
+ *  completed successfully for all signals.
+ */
+__attribute__((unused)) EI_IMPULSE_ERROR run_classifier_batch(
+    ei_impulse_handle_t *impulse,
+    signal_t *signals,
+    size_t n,
+    ei_impulse_result_t *results,
+    bool debug = false)
+{
+    return process_impulse_batch(impulse, signals, n, results, debug);
+}
+
 #if EI_CLASSIFIER_FREEFORM_OUTPUT
 /**
  * Set the location for freeform outputs. For impulses with freeform output the application needs to allocate
@@ -40,6 +40,8 @@
 #include "edge-impulse-sdk/dsp/speechpy/speechpy.hpp"
 #include "edge-impulse-sdk/classifier/ei_signal_with_range.h"
 #include "edge-impulse-sdk/dsp/ei_flatten.h"
+#include "edge-impulse-sdk/dsp/ei_dsp_window_state.h"
+#include "edge-impulse-sdk/dsp/image/kernels.hpp"
 #include "model-parameters/model_metadata.h"
 
 #if EI_CLASSIFIER_HR_ENABLED
@@ -84,10 +86,9 @@ using namespace ei;
 float ei_dsp_image_buffer[EI_DSP_IMAGE_BUFFER_STATIC_SIZE];
 #endif
 
-// this is the frame we work on... allocate it statically so we share between invocations
-static float *ei_dsp_cont_current_frame = nullptr;
-static size_t ei_dsp_cont_current_frame_size = 0;
-static int ei_dsp_cont_current_frame_ix = 0;
+// continuous audio state for the *_per_slice_features() overloads without a state argument,
+// run_classifier_continuous() uses the state owned by the impulse handle instead
+static ei_dsp_cont_state_t ei_dsp_cont_default_state = { nullptr, 0, 0, false };
 
 __attribute__((unused)) int extract_hr_features(
     signal_t *signal,
@@ -218,7 +219,260 @@ __attribute__((unused)) int extract_flatten_features(signal_t *signal, matrix_t
     return ret;
 }
 
-static class speechpy::processing::preemphasis *preemphasis;
+/**
+ * Continuous inference for the raw data block: appends the slice to the window and writes the
+ * full window (matrix_size_out is 0 x 0 until the window has filled up).
+ */
+__attribute__((unused)) int extract_raw_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float frequency, matrix_size_t *matrix_size_out, ei_dsp_window_state_t *window_state) {
+    ei_dsp_config_raw_t *config = (ei_dsp_config_raw_t*)config_ptr;
+
+    matrix_size_out->rows = 0;
+    matrix_size_out->cols = 0;
+
+    EI_TRY(window_state->push(signal));
+    if (!window_state->is_full()) {
+        return EIDSP_OK;
+    }
+
+    const size_t axes = window_state->get_axes();
+    // same bounds check as extract_raw_features()
+    size_t els_to_copy = window_state->get_window_length() * axes;
+    if (els_to_copy > output_matrix->rows * output_matrix->cols) {
+        els_to_copy = output_matrix->rows * output_matrix->cols;
+    }
+
+    for (size_t ix = 0; ix < els_to_copy; ix++) {
+        output_matrix->buffer[ix] = window_state->get(ix % axes, ix / axes) * config->scale_axes;
+    }
+
+    matrix_size_out->rows = 1;
+    matrix_size_out->cols = output_matrix->rows * output_matrix->cols;
+    return EIDSP_OK;
+}
+
+/**
+ * Continuous inference for the flatten block. The statistics come from the running sums of the
+ * window, so a slice costs O(slice length) rather than O(window length).
+ */
+__attribute__((unused)) int extract_flatten_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float frequency, matrix_size_t *matrix_size_out, ei_dsp_window_state_t *window_state) {
+    ei_dsp_config_flatten_t *config = (ei_dsp_config_flatten_t*)config_ptr;
+
+    matrix_size_out->rows = 0;
+    matrix_size_out->cols = 0;
+
+    EI_TRY(window_state->push(signal));
+    if (!window_state->is_full()) {
+        return EIDSP_OK;
+    }
+
+    const size_t axes = window_state->get_axes();
+    uint32_t features_per_axis = config->average + config->minimum + config->maximum + config->rms +
+        config->stdev + config->skewness + config->kurtosis + (config->moving_avg_num_windows ? 1 : 0);
+    if (output_matrix->rows * output_matrix->cols != features_per_axis * axes) {
+        EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+    }
+
+    const float scale = config->scale_axes;
+    const float abs_scale = fabsf(scale);
+
+    // moving average goes over the means of the last N windows (not N slices), like flatten_class
+    if (config->moving_avg_num_windows) {
+        EI_TRY(window_state->push_window_means(scale, config->moving_avg_num_windows));
+    }
+
+    size_t out_ix = 0;
+    for (size_t axis = 0; axis < axes; axis++) {
+        double mean, m2, m3, m4;
+        window_state->get_moments(axis, &mean, &m2, &m3, &m4);
+
+        if (config->average) {
+            output_matrix->buffer[out_ix++] = (float)mean * scale;
+        }
+        if (config->minimum) {
+            output_matrix->buffer[out_ix++] = (scale < 0 ? window_state->get_max(axis) : window_state->get_min(axis)) * scale;
+        }
+        if (config->maximum) {
+            output_matrix->buffer[out_ix++] = (scale < 0 ? window_state->get_min(axis) : window_state->get_max(axis)) * scale;
+        }
+        if (config->rms) {
+            output_matrix->buffer[out_ix++] = (float)sqrt(m2 + (mean * mean)) * abs_scale;
+        }
+        if (config->stdev) {
+            output_matrix->buffer[out_ix++] = (float)sqrt(m2) * abs_scale;
+        }
+        // numpy::skew / numpy::kurtosis return 0 / -3 for a constant signal
+        if (config->skewness) {
+            float skew = m2 == 0.0 ? 0.0f : (float)(m3 / pow(m2, 1.5));
+            output_matrix->buffer[out_ix++] = scale < 0 ? -skew : skew;
+        }
+        if (config->kurtosis) {
+            output_matrix->buffer[out_ix++] = m2 == 0.0 ? -3.0f : (float)((m4 / (m2 * m2)) - 3.0);
+        }
+        if (config->moving_avg_num_windows) {
+            output_matrix->buffer[out_ix++] = window_state->get_moving_average(axis);
+        }
+    }
+
+    output_matrix->cols = output_matrix->rows * output_matrix->cols;
+    output_matrix->rows = 1;
+
+    matrix_size_out->rows = 1;
+    matrix_size_out->cols = output_matrix->cols;
+    return EIDSP_OK;
+}
+
+/**
+ * Spectral analysis over the window, without the per-slice shortcuts (filters, wavelets,
+ * decimation and v1 need the whole window anyway)
+ */
+__attribute__((unused)) static int extract_spectral_analysis_window_features(matrix_t *output_matrix, void *config_ptr, const float frequency, ei_dsp_window_state_t *window_state) {
+    float *window = window_state->get_interleaved();
+    if (window == nullptr) {
+        EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    }
+    signal_t window_signal;
+    EI_TRY(numpy::signal_from_buffer(window, window_state->get_window_length() * window_state->get_axes(), &window_signal));
+    return extract_spectral_analysis_features(&window_signal, output_matrix, config_ptr, frequency);
+}
+
+/**
+ * Continuous inference for the spectral analysis block (FFT, implementation version 2 and up).
+ * Windows are laid out from the start of the window like welch_max_hold(), so when the slice
+ * length and the window length are multiples of the FFT hop, every full FFT frame is computed
+ * once and then reused by the next windows; only the zero padded tail frame and bin 0 (which
+ * depends on the window mean) are recalculated for every slice.
+ */
+__attribute__((unused)) int extract_spectral_analysis_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float frequency, matrix_size_t *matrix_size_out, ei_dsp_window_state_t *window_state) {
+    ei_dsp_config_spectral_analysis_t *config = (ei_dsp_config_spectral_analysis_t *)config_ptr;
+
+    matrix_size_out->rows = 0;
+    matrix_size_out->cols = 0;
+
+    EI_TRY(window_state->push(signal));
+    if (!window_state->is_full()) {
+        return EIDSP_OK;
+    }
+
+    const size_t axes = window_state->get_axes();
+    const size_t window_length = window_state->get_window_length();
+    const size_t fft_length = config->fft_length;
+    const size_t hop = config->do_fft_overlap ? fft_length / 2 : fft_length;
+
+    bool can_reuse_frames = config->implementation_version >= 2 &&
+        (config->analysis_type == nullptr || strcmp(config->analysis_type, "FFT") == 0) &&
+        config->filter_order == 0 &&
+        hop > 0 && window_length >= fft_length &&
+        window_length % hop == 0 && window_state->get_frames_pushed() % hop == 0;
+    if (config->implementation_version == 4 &&
+        (config->extra_low_freq || config->input_decimation_ratio > 1)) {
+        can_reuse_frames = false;
+    }
+
+    if (!can_reuse_frames || !window_state->init_frame_cache(fft_length, hop)) {
+        int ret = extract_spectral_analysis_window_features(output_matrix, config_ptr, frequency, window_state);
+        if (ret != EIDSP_OK) {
+            return ret;
+        }
+        matrix_size_out->rows = 1;
+        matrix_size_out->cols = output_matrix->rows * output_matrix->cols;
+        return EIDSP_OK;
+    }
+
+    // "zero" order filters only drop bins, see extract_spec_features()
+    size_t start_bin = 1;
+    size_t stop_bin = (fft_length / 2) + 1;
+    if (strcmp(config->filter_type, "low") == 0) {
+        spectral::feature::get_start_stop_bin(frequency, fft_length, config->filter_cutoff, &start_bin, &stop_bin, false);
+    }
+    else if (strcmp(config->filter_type, "high") == 0) {
+        spectral::feature::get_start_stop_bin(frequency, fft_length, config->filter_cutoff, &start_bin, &stop_bin, true);
+    }
+    const size_t fft_out_size = (fft_length / 2) + 1;
+    const size_t num_bins = stop_bin - start_bin;
+    const bool extra_stats = config->implementation_version == 4;
+    const size_t features_per_axis = 3 + (extra_stats ? 2 : 0) + num_bins;
+    if (output_matrix->rows * output_matrix->cols != features_per_axis * axes) {
+        EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+    }
+
+    ei_vector<float> fft_out(fft_out_size);
+    const float scale = config->scale_axes;
+    const float power_scale = scale * scale;
+    float *frame = window_state->get_frame_buffer();
+    float *feature_out = output_matrix->buffer;
+
+    for (size_t axis = 0; axis < axes; axis++) {
+        double mean, m2, m3, m4;
+        window_state->get_moments(axis, &mean, &m2, &m3, &m4);
+
+        // time domain features, on the scaled signal with the mean removed
+        float rms = (float)sqrt(m2) * fabsf(scale);
+        *feature_out++ = rms;
+        float stddev = rms == 0.0f ? 1e-10f : rms;
+        float stddev3 = stddev * stddev * stddev;
+        *feature_out++ = (float)(m3 * scale * scale * scale) / stddev3;
+        *feature_out++ = ((float)(m4 * power_scale * power_scale) / (stddev3 * stddev)) - 3;
+
+        // max hold over all frames
+        for (size_t ix = 0; ix < fft_out_size; ix++) {
+            fft_out[ix] = 0.0f;
+        }
+        for (size_t start = 0; start < window_length; start += hop) {
+            const float *spectrum;
+            float bin0;
+            if (start + fft_length <= window_length) {
+                double frame_sum;
+                spectrum = window_state->get_frame_spectrum(axis, start + fft_length, &frame_sum);
+                // the cached spectrum has the frame mean removed, bin 0 is the sum of (x - window mean)
+                const double dc = frame_sum - (fft_length * mean);
+                bin0 = (float)((dc * dc) / fft_length);
+            }
+            else {
+                // zero padded tail frame
+                const size_t n = window_length - start;
+                for (size_t ix = 0; ix < n; ix++) {
+                    frame[ix] = (float)(window_state->get(axis, start + ix) - mean);
+                }
+                EI_TRY(numpy::power_spectrum(frame, n, frame, fft_out_size, fft_length));
+                spectrum = frame;
+                bin0 = frame[0];
+            }
+            fft_out[0] = std::max(fft_out[0], bin0);
+            for (size_t ix = 1; ix < fft_out_size; ix++) {
+                fft_out[ix] = std::max(fft_out[ix], spectrum[ix]);
+            }
+        }
+        for (size_t ix = 0; ix < fft_out_size; ix++) {
+            fft_out[ix] *= power_scale;
+        }
+
+        if (extra_stats) {
+            matrix_t x(1, fft_out.size(), fft_out.data());
+            matrix_t out(1, 1);
+            *feature_out++ = (numpy::skew(&x, &out) == EIDSP_OK) ? (out.get_row_ptr(0)[0]) : 0.0f;
+            *feature_out++ = (numpy::kurtosis(&x, &out) == EIDSP_OK) ? (out.get_row_ptr(0)[0]) : 0.0f;
+        }
+
+        for (size_t ix = start_bin; ix < stop_bin; ix++) {
+            feature_out[ix - start_bin] = fft_out[ix];
+        }
+        if (config->do_log) {
+            numpy::zero_handling(feature_out, num_bins);
+            ei_matrix temp(num_bins, 1, feature_out);
+            numpy::log10(&temp);
+        }
+        feature_out += num_bins;
+    }
+
+    output_matrix->cols = output_matrix->rows * output_matrix->cols;
+    output_matrix->rows = 1;
+
+    matrix_size_out->rows = 1;
+    matrix_size_out->cols = output_matrix->cols;
+    return EIDSP_OK;
+}
+
+static EIDSP_THREAD_LOCAL class speechpy::processing::preemphasis *preemphasis;
 static int preemphasized_audio_signal_get_data(size_t offset, size_t length, float *out_ptr) {
     return preemphasis->get_data(offset, length, out_ptr);
 }
@@ -327,7 +581,7 @@ __attribute__((unused)) static int extract_mfcc_run_slice(signal_t *signal, matr
     return EIDSP_OK;
 }
 
-__attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency, matrix_size_t *matrix_size_out) {
+__attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency, matrix_size_t *matrix_size_out, ei_dsp_cont_state_t *cont_state) {
 #if defined(__cplusplus) && EI_C_LINKAGE == 1
     ei_printf("ERR: Continuous audio is not supported when EI_C_LINKAGE is defined\n");
     EIDSP_ERR(EIDSP_NOT_SUPPORTED);
@@ -374,9 +628,9 @@ __attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, ma
     int x;
 
     // have current frame, but wrong size? then free
-    if (ei_dsp_cont_current_frame && ei_dsp_cont_current_frame_size != frame_length_values) {
-        ei_free(ei_dsp_cont_current_frame);
-        ei_dsp_cont_current_frame = nullptr;
+    if (cont_state->frame && cont_state->frame_size != frame_length_values) {
+        ei_free(cont_state->frame);
+        cont_state->frame = nullptr;
     }
 
     int implementation_version = config.implementation_version;
@@ -384,19 +638,19 @@ __attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, ma
     // this is the offset in the signal from which we'll work
     size_t offset_in_signal = 0;
 
-    if (!ei_dsp_cont_current_frame) {
-        ei_dsp_cont_current_frame = (float*)ei_calloc(frame_length_values * sizeof(float), 1);
-        if (!ei_dsp_cont_current_frame) {
+    if (!cont_state->frame) {
+        cont_state->frame = (float*)ei_calloc(frame_length_values * sizeof(float), 1);
+        if (!cont_state->frame) {
             EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
-        ei_dsp_cont_current_frame_size = frame_length_values;
-        ei_dsp_cont_current_frame_ix = 0;
+        cont_state->frame_size = frame_length_values;
+        cont_state->frame_ix = 0;
     }
 
 
-    if ((frame_length_values) > preemphasized_audio_signal.total_length  + ei_dsp_cont_current_frame_ix) {
+    if ((frame_length_values) > preemphasized_audio_signal.total_length  + cont_state->frame_ix) {
         ei_printf("ERR: frame_length (%d) cannot be larger than signal's total length (%d) for continuous classification\n",
-            (int)frame_length_values, (int)preemphasized_audio_signal.total_length  + ei_dsp_cont_current_frame_ix);
+            (int)frame_length_values, (int)preemphasized_audio_signal.total_length  + cont_state->frame_ix);
         EIDSP_ERR(EIDSP_PARAMETER_INVALID);
     }
 
@@ -408,24 +662,24 @@ __attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, ma
         implementation_version = 2;
     }
 
-    if (ei_dsp_cont_current_frame_ix > (int)ei_dsp_cont_current_frame_size) {
-        ei_printf("ERR: ei_dsp_cont_current_frame_ix is larger than frame size (ix=%d size=%d)\n",
-            ei_dsp_cont_current_frame_ix, (int)ei_dsp_cont_current_frame_size);
+    if (cont_state->frame_ix > (int)cont_state->frame_size) {
+        ei_printf("ERR: cont_state->frame_ix is larger than frame size (ix=%d size=%d)\n",
+            cont_state->frame_ix, (int)cont_state->frame_size);
         EIDSP_ERR(EIDSP_PARAMETER_INVALID);
     }
 
     // if we still have some code from previous run
-    while (ei_dsp_cont_current_frame_ix > 0) {
-        // then from the current frame we need to read `frame_length_values - ei_dsp_cont_current_frame_ix`
+    while (cont_state->frame_ix > 0) {
+        // then from the current frame we need to read `frame_length_values - cont_state->frame_ix`
         // starting at offset 0
-        x = preemphasized_audio_signal.get_data(0, frame_length_values - ei_dsp_cont_current_frame_ix, ei_dsp_cont_current_frame + ei_dsp_cont_current_frame_ix);
+        x = preemphasized_audio_signal.get_data(0, frame_length_values - cont_state->frame_ix, cont_state->frame + cont_state->frame_ix);
         if (x != EIDSP_OK) {
             EIDSP_ERR(x);
         }
 
-        // now ei_dsp_cont_current_frame is complete
+        // now cont_state->frame is complete
         signal_t frame_signal;
-        x = numpy::signal_from_buffer(ei_dsp_cont_current_frame, frame_length_values, &frame_signal);
+        x = numpy::signal_from_buffer(cont_state->frame, frame_length_values, &frame_signal);
         if (x != EIDSP_OK) {
             EIDSP_ERR(x);
         }
@@ -437,15 +691,15 @@ __attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, ma
 
         // if there's overlap between frames we roll through
         if (frame_stride_values > 0) {
-            numpy::roll(ei_dsp_cont_current_frame, frame_length_values, -frame_stride_values);
+            numpy::roll(cont_state->frame, frame_length_values, -frame_stride_values);
         }
 
-        ei_dsp_cont_current_frame_ix -= frame_stride_values;
+        cont_state->frame_ix -= frame_stride_values;
     }
 
-    if (ei_dsp_cont_current_frame_ix < 0) {
-        offset_in_signal = -ei_dsp_cont_current_frame_ix;
-        ei_dsp_cont_current_frame_ix = 0;
+    if (cont_state->frame_ix < 0) {
+        offset_in_signal = -cont_state->frame_ix;
+        cont_state->frame_ix = 0;
     }
 
     if (offset_in_signal >= signal->total_length) {
@@ -478,17 +732,17 @@ __attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, ma
     bytes_left_end_of_frame += frame_overlap_values;
 
     if (bytes_left_end_of_frame > 0) {
-        // then read that into the ei_dsp_cont_current_frame buffer
+        // then read that into the cont_state->frame buffer
         x = preemphasized_audio_signal.get_data(
             (preemphasized_audio_signal.total_length - bytes_left_end_of_frame),
             bytes_left_end_of_frame,
-            ei_dsp_cont_current_frame);
+            cont_state->frame);
         if (x != EIDSP_OK) {
             EIDSP_ERR(x);
         }
     }
 
-    ei_dsp_cont_current_frame_ix = bytes_left_end_of_frame;
+    cont_state->frame_ix = bytes_left_end_of_frame;
 
     preemphasis = nullptr;
 
@@ -496,6 +750,10 @@ __attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, ma
 #endif
 }
 
+__attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency, matrix_size_t *matrix_size_out) {
+    return extract_mfcc_per_slice_features(signal, output_matrix, config_ptr, sampling_frequency, matrix_size_out, &ei_dsp_cont_default_state);
+}
+
 __attribute__((unused)) int extract_spectrogram_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency) {
     ei_dsp_config_spectrogram_t config = *((ei_dsp_config_spectrogram_t*)config_ptr);
 
@@ -598,7 +856,7 @@ __attribute__((unused)) static int extract_spectrogram_run_slice(signal_t *signa
     return EIDSP_OK;
 }
 
-__attribute__((unused)) int extract_spectrogram_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency, matrix_size_t *matrix_size_out) {
+__attribute__((unused)) int extract_spectrogram_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency, matrix_size_t *matrix_size_out, ei_dsp_cont_state_t *cont_state) {
 #if defined(__cplusplus) && EI_C_LINKAGE == 1
     ei_printf("ERR: Continuous audio is not supported when EI_C_LINKAGE is defined\n");
     EIDSP_ERR(EIDSP_NOT_SUPPORTED);
@@ -606,8 +864,6 @@ __attribute__((unused)) int extract_spectrogram_per_slice_features(signal_t *sig
 
     ei_dsp_config_spectrogram_t config = *((ei_dsp_config_spectrogram_t*)config_ptr);
 
-    static bool first_run = false;
-
     if (config.axes != 1) {
         EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
     }
@@ -623,11 +879,11 @@ __attribute__((unused)) int extract_spectrogram_per_slice_features(signal_t *sig
     buffer */
     if(config.implementation_version < 2) {
 
-        if (first_run == true) {
+        if (cont_state->first_run == true) {
             signal->total_length += (size_t)(config.frame_length * (float)frequency);
         }
 
-        first_run = true;
+        cont_state->first_run = true;
     }
 
     // Go from the time (e.g. 0.25 seconds to number of frames based on freq)
@@ -653,18 +909,18 @@ __attribute__((unused)) int extract_spectrogram_per_slice_features(signal_t *sig
     int x;
 
     // have current frame, but wrong size? then free
-    if (ei_dsp_cont_current_frame && ei_dsp_cont_current_frame_size != frame_length_values) {
-        ei_free(ei_dsp_cont_current_frame);
-        ei_dsp_cont_current_frame = nullptr;
+    if (cont_state->frame && cont_state->frame_size != frame_length_values) {
+        ei_free(cont_state->frame);
+        cont_state->frame = nullptr;
     }
 
-    if (!ei_dsp_cont_current_frame) {
-        ei_dsp_cont_current_frame = (float*)ei_calloc(frame_length_values * sizeof(float), 1);
-        if (!ei_dsp_cont_current_frame) {
+    if (!cont_state->frame) {
+        cont_state->frame = (float*)ei_calloc(frame_length_values * sizeof(float), 1);
+        if (!cont_state->frame) {
             EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
-        ei_dsp_cont_current_frame_size = frame_length_values;
-        ei_dsp_cont_current_frame_ix = 0;
+        cont_state->frame_size = frame_length_values;
+        cont_state->frame_ix = 0;
     }
 
     matrix_size_out->rows = 0;
@@ -673,23 +929,23 @@ __attribute__((unused)) int extract_spectrogram_per_slice_features(signal_t *sig
     // this is the offset in the signal from which we'll work
     size_t offset_in_signal = 0;
 
-    if (ei_dsp_cont_current_frame_ix > (int)ei_dsp_cont_current_frame_size) {
-        ei_printf("ERR: ei_dsp_cont_current_frame_ix is larger than frame size\n");
+    if (cont_state->frame_ix > (int)cont_state->frame_size) {
+        ei_printf("ERR: cont_state->frame_ix is larger than frame size\n");
         EIDSP_ERR(EIDSP_PARAMETER_INVALID);
     }
 
     // if we still have some code from previous run
-    while (ei_dsp_cont_current_frame_ix > 0) {
-        // then from the current frame we need to read `frame_length_values - ei_dsp_cont_current_frame_ix`
+    while (cont_state->frame_ix > 0) {
+        // then from the current frame we need to read `frame_length_values - cont_state->frame_ix`
         // starting at offset 0
-        x = signal->get_data(0, frame_length_values - ei_dsp_cont_current_frame_ix, ei_dsp_cont_current_frame + ei_dsp_cont_current_frame_ix);
+        x = signal->get_data(0, frame_length_values - cont_state->frame_ix, cont_state->frame + cont_state->frame_ix);
         if (x != EIDSP_OK) {
             EIDSP_ERR(x);
         }
 
-        // now ei_dsp_cont_current_frame is complete
+        // now cont_state->frame is complete
         signal_t frame_signal;
-        x = numpy::signal_from_buffer(ei_dsp_cont_current_frame, frame_length_values, &frame_signal);
+        x = numpy::signal_from_buffer(cont_state->frame, frame_length_values, &frame_signal);
         if (x != EIDSP_OK) {
             EIDSP_ERR(x);
         }
@@ -701,15 +957,15 @@ __attribute__((unused)) int extract_spectrogram_per_slice_features(signal_t *sig
 
         // if there's overlap between frames we roll through
         if (frame_stride_values > 0) {
-            numpy::roll(ei_dsp_cont_current_frame, frame_length_values, -frame_stride_values);
+            numpy::roll(cont_state->frame, frame_length_values, -frame_stride_values);
         }
 
-        ei_dsp_cont_current_frame_ix -= frame_stride_values;
+        cont_state->frame_ix -= frame_stride_values;
     }
 
-    if (ei_dsp_cont_current_frame_ix < 0) {
-        offset_in_signal = -ei_dsp_cont_current_frame_ix;
-        ei_dsp_cont_current_frame_ix = 0;
+    if (cont_state->frame_ix < 0) {
+        offset_in_signal = -cont_state->frame_ix;
+        cont_state->frame_ix = 0;
     }
 
     if (offset_in_signal >= signal->total_length) {
@@ -742,20 +998,20 @@ __attribute__((unused)) int extract_spectrogram_per_slice_features(signal_t *sig
     bytes_left_end_of_frame += frame_overlap_values;
 
     if (bytes_left_end_of_frame > 0) {
-        // then read that into the ei_dsp_cont_current_frame buffer
+        // then read that into the cont_state->frame buffer
         x = signal->get_data(
             (signal->total_length - bytes_left_end_of_frame),
             bytes_left_end_of_frame,
-            ei_dsp_cont_current_frame);
+            cont_state->frame);
         if (x != EIDSP_OK) {
             EIDSP_ERR(x);
         }
     }
 
-    ei_dsp_cont_current_frame_ix = bytes_left_end_of_frame;
+    cont_state->frame_ix = bytes_left_end_of_frame;
 
     if (config.implementation_version < 2) {
-        if (first_run == true) {
+        if (cont_state->first_run == true) {
             signal->total_length -= (size_t)(config.frame_length * (float)frequency);
         }
     }
@@ -764,6 +1020,10 @@ __attribute__((unused)) int extract_spectrogram_per_slice_features(signal_t *sig
 #endif
 }
 
+__attribute__((unused)) int extract_spectrogram_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency, matrix_size_t *matrix_size_out) {
+    return extract_spectrogram_per_slice_features(signal, output_matrix, config_ptr, sampling_frequency, matrix_size_out, &ei_dsp_cont_default_state);
+}
+
 
 __attribute__((unused)) int extract_mfe_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency) {
     ei_dsp_config_mfe_t config = *((ei_dsp_config_mfe_t*)config_ptr);
@@ -916,7 +1176,7 @@ __attribute__((unused)) static int extract_mfe_run_slice(signal_t *signal, matri
     return EIDSP_OK;
 }
 
-__attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency, matrix_size_t *matrix_size_out) {
+__attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency, matrix_size_t *matrix_size_out, ei_dsp_cont_state_t *cont_state) {
 #if defined(__cplusplus) && EI_C_LINKAGE == 1
     ei_printf("ERR: Continuous audio is not supported when EI_C_LINKAGE is defined\n");
     EIDSP_ERR(EIDSP_NOT_SUPPORTED);
@@ -927,8 +1187,6 @@ __attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, mat
     // signal is already the right size,
     // output matrix is not the right size, but we can start writing at offset 0 and then it's OK too
 
-    static bool first_run = false;
-
     if (config.axes != 1) {
         EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
     }
@@ -947,11 +1205,11 @@ __attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, mat
     // subtracted and there for never used. But skip the first slice to fit the feature_matrix
     // buffer
     if (config.implementation_version == 1) {
-        if (first_run == true) {
+        if (cont_state->first_run == true) {
             signal->total_length += (size_t)(config.frame_length * (float)frequency);
         }
 
-        first_run = true;
+        cont_state->first_run = true;
     }
 
     // ok all setup, let's construct the signal (with preemphasis for impl version >3)
@@ -1001,21 +1259,21 @@ __attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, mat
     int x;
 
     // have current frame, but wrong size? then free
-    if (ei_dsp_cont_current_frame && ei_dsp_cont_current_frame_size != frame_length_values) {
-        ei_free(ei_dsp_cont_current_frame);
-        ei_dsp_cont_current_frame = nullptr;
+    if (cont_state->frame && cont_state->frame_size != frame_length_values) {
+        ei_free(cont_state->frame);
+        cont_state->frame = nullptr;
     }
 
-    if (!ei_dsp_cont_current_frame) {
-        ei_dsp_cont_current_frame = (float*)ei_calloc(frame_length_values * sizeof(float), 1);
-        if (!ei_dsp_cont_current_frame) {
+    if (!cont_state->frame) {
+        cont_state->frame = (float*)ei_calloc(frame_length_values * sizeof(float), 1);
+        if (!cont_state->frame) {
             if (preemphasis) {
                 delete preemphasis;
             }
             EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
-        ei_dsp_cont_current_frame_size = frame_length_values;
-        ei_dsp_cont_current_frame_ix = 0;
+        cont_state->frame_size = frame_length_values;
+        cont_state->frame_ix = 0;
     }
 
     matrix_size_out->rows = 0;
@@ -1024,8 +1282,8 @@ __attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, mat
     // this is the offset in the signal from which we'll work
     size_t offset_in_signal = 0;
 
-    if (ei_dsp_cont_current_frame_ix > (int)ei_dsp_cont_current_frame_size) {
-        ei_printf("ERR: ei_dsp_cont_current_frame_ix is larger than frame size\n");
+    if (cont_state->frame_ix > (int)cont_state->frame_size) {
+        ei_printf("ERR: cont_state->frame_ix is larger than frame size\n");
         if (preemphasis) {
             delete preemphasis;
         }
@@ -1033,10 +1291,10 @@ __attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, mat
     }
 
     // if we still have some code from previous run
-    while (ei_dsp_cont_current_frame_ix > 0) {
-        // then from the current frame we need to read `frame_length_values - ei_dsp_cont_current_frame_ix`
+    while (cont_state->frame_ix > 0) {
+        // then from the current frame we need to read `frame_length_values - cont_state->frame_ix`
         // starting at offset 0
-        x = preemphasized_audio_signal.get_data(0, frame_length_values - ei_dsp_cont_current_frame_ix, ei_dsp_cont_current_frame + ei_dsp_cont_current_frame_ix);
+        x = preemphasized_audio_signal.get_data(0, frame_length_values - cont_state->frame_ix, cont_state->frame + cont_state->frame_ix);
         if (x != EIDSP_OK) {
             if (preemphasis) {
                 delete preemphasis;
@@ -1044,9 +1302,9 @@ __attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, mat
             EIDSP_ERR(x);
         }
 
-        // now ei_dsp_cont_current_frame is complete
+        // now cont_state->frame is complete
         signal_t frame_signal;
-        x = numpy::signal_from_buffer(ei_dsp_cont_current_frame, frame_length_values, &frame_signal);
+        x = numpy::signal_from_buffer(cont_state->frame, frame_length_values, &frame_signal);
         if (x != EIDSP_OK) {
             if (preemphasis) {
                 delete preemphasis;
@@ -1064,15 +1322,15 @@ __attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, mat
 
         // if there's overlap between frames we roll through
         if (frame_stride_values > 0) {
-            numpy::roll(ei_dsp_cont_current_frame, frame_length_values, -frame_stride_values);
+            numpy::roll(cont_state->frame, frame_length_values, -frame_stride_values);
         }
 
-        ei_dsp_cont_current_frame_ix -= frame_stride_values;
+        cont_state->frame_ix -= frame_stride_values;
     }
 
-    if (ei_dsp_cont_current_frame_ix < 0) {
-        offset_in_signal = -ei_dsp_cont_current_frame_ix;
-        ei_dsp_cont_current_frame_ix = 0;
+    if (cont_state->frame_ix < 0) {
+        offset_in_signal = -cont_state->frame_ix;
+        cont_state->frame_ix = 0;
     }
 
     if (offset_in_signal >= signal->total_length) {
@@ -1111,11 +1369,11 @@ __attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, mat
     bytes_left_end_of_frame += frame_overlap_values;
 
     if (bytes_left_end_of_frame > 0) {
-        // then read that into the ei_dsp_cont_current_frame buffer
+        // then read that into the cont_state->frame buffer
         x = preemphasized_audio_signal.get_data(
             (preemphasized_audio_signal.total_length - bytes_left_end_of_frame),
             bytes_left_end_of_frame,
-            ei_dsp_cont_current_frame);
+            cont_state->frame);
         if (x != EIDSP_OK) {
             if (preemphasis) {
                 delete preemphasis;
@@ -1124,11 +1382,11 @@ __attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, mat
         }
     }
 
-    ei_dsp_cont_current_frame_ix = bytes_left_end_of_frame;
+    cont_state->frame_ix = bytes_left_end_of_frame;
 
 
     if (config.implementation_version == 1) {
-        if (first_run == true) {
+        if (cont_state->first_run == true) {
             signal->total_length -= (size_t)(config.frame_length * (float)frequency);
         }
     }
@@ -1141,6 +1399,10 @@ __attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, mat
 #endif
 }
 
+__attribute__((unused)) int extract_mfe_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float sampling_frequency, matrix_size_t *matrix_size_out) {
+    return extract_mfe_per_slice_features(signal, output_matrix, config_ptr, sampling_frequency, matrix_size_out, &ei_dsp_cont_default_state);
+}
+
 __attribute__((unused)) int extract_image_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr, const float frequency) {
     ei_dsp_config_image_t config = *((ei_dsp_config_image_t*)config_ptr);
 
@@ -1154,40 +1416,38 @@ __attribute__((unused)) int extract_image_features(signal_t *signal, matrix_t *o
     const size_t page_size = 1024;
 #endif
 
-    // buffered read from the signal
-    size_t bytes_left = signal->total_length;
-    for (size_t ix = 0; ix < signal->total_length; ix += page_size) {
-        size_t elements_to_read = bytes_left > page_size ? page_size : bytes_left;
+    if (signal->total_length == 0) {
+        return EIDSP_OK;
+    }
 
+    // one page buffer for the whole signal
+    size_t buffer_size = signal->total_length > page_size ? page_size : signal->total_length;
 #if defined(EI_DSP_IMAGE_BUFFER_STATIC_SIZE)
-        matrix_t input_matrix(elements_to_read, config.axes, ei_dsp_image_buffer);
+    matrix_t input_matrix(buffer_size, config.axes, ei_dsp_image_buffer);
 #else
-        matrix_t input_matrix(elements_to_read, config.axes);
+    matrix_t input_matrix(buffer_size, config.axes);
 #endif
-        if (!input_matrix.buffer) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
-        }
-        signal->get_data(ix, elements_to_read, input_matrix.buffer);
+    if (!input_matrix.buffer) {
+        EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    }
 
-        for (size_t jx = 0; jx < elements_to_read; jx++) {
-            uint32_t pixel = static_cast<uint32_t>(input_matrix.buffer[jx]);
+    // buffered read from the signal
+    size_t bytes_left = signal->total_length;
+    for (size_t ix = 0; ix < signal->total_length; ix += page_size) {
+        size_t elements_to_read = bytes_left > page_size ? page_size : bytes_left;
 
-            // rgb to 0..1
-            float r = static_cast<float>(pixel >> 16 & 0xff) / 255.0f;
-            float g = static_cast<float>(pixel >> 8 & 0xff) / 255.0f;
-            float b = static_cast<float>(pixel & 0xff) / 255.0f;
+        signal->get_data(ix, elements_to_read, input_matrix.buffer);
 
-            if (channel_count == 3) {
-                output_matrix->buffer[output_ix++] = r;
-                output_matrix->buffer[output_ix++] = g;
-                output_matrix->buffer[output_ix++] = b;
-            }
-            else {
-                // ITU-R 601-2 luma transform
-                // see: https://pillow.readthedocs.io/en/stable/reference/Image.html#PIL.Image.Image.convert
-                float v = (0.299f * r) + (0.587f * g) + (0.114f * b);
-                output_matrix->buffer[output_ix++] = v;
-            }
+        // rgb to 0..1
+        if (channel_count == 3) {
+            ei::image::kernels::packed_to_rgb_f32(input_matrix.buffer, elements_to_read,
+                output_matrix->buffer + output_ix);
+            output_ix += elements_to_read * 3;
+        }
+        else {
+            ei::image::kernels::packed_to_gray_f32(input_matrix.buffer, elements_to_read,
+                output_matrix->buffer + output_ix);
+            output_ix += elements_to_read;
         }
 
         bytes_left -= elements_to_read;
@@ -1262,6 +1522,42 @@ __attribute__((unused)) int extract_drpai_features_quantized(signal_t *signal, m
 
 #if (EI_CLASSIFIER_QUANTIZATION_ENABLED == 1) && (EI_CLASSIFIER_INFERENCING_ENGINE != EI_CLASSIFIER_DRPAI)
 
+static const float ei_dsp_image_torch_mean[] = { 0.485, 0.456, 0.406 };
+static const float ei_dsp_image_torch_std[] = { 0.229, 0.224, 0.225 };
+
+/**
+ * Fill the per channel lookup tables for extract_image_features_quantized, using the
+ * same expressions as the per-pixel code so the quantized values are identical
+ */
+static void build_image_quantization_lut(float scale, float zero_point, int image_scaling,
+                                         ei::image::kernels::quantization_lut_t lut) {
+    bool fast_path = scale == 0.003921568859368563f && zero_point == -128 && image_scaling == EI_CLASSIFIER_IMAGE_SCALING_NONE;
+
+    for (int ch = 0; ch < 3; ch++) {
+        for (int ix = 0; ix < 256; ix++) {
+            if (fast_path) {
+                lut[ch][ix] = static_cast<int8_t>(static_cast<int32_t>(ix) + zero_point);
+                continue;
+            }
+
+            float v = static_cast<float>(ix);
+
+            if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_NONE) {
+                v /= 255.0f;
+            }
+            else if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_TORCH) {
+                v /= 255.0f;
+                v = (v - ei_dsp_image_torch_mean[ch]) / ei_dsp_image_torch_std[ch];
+            }
+            else if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_MIN128_127) {
+                v -= 128.0f;
+            }
+
+            lut[ch][ix] = static_cast<int8_t>(round(v / scale) + zero_point);
+        }
+    }
+}
+
 __attribute__((unused)) int extract_image_features_quantized(signal_t *signal, matrix_i8_t *output_matrix, void *config_ptr, float scale, float zero_point, const float frequency,
                                                              int image_scaling) {
     ei_dsp_config_image_t config = *((ei_dsp_config_image_t*)config_ptr);
@@ -1270,12 +1566,13 @@ __attribute__((unused)) int extract_image_features_quantized(signal_t *signal, m
 
     size_t output_ix = 0;
 
-    const int32_t iRedToGray = (int32_t)(0.299f * 65536.0f);
-    const int32_t iGreenToGray = (int32_t)(0.587f * 65536.0f);
-    const int32_t iBlueToGray = (int32_t)(0.114f * 65536.0f);
+    bool fast_path = scale == 0.003921568859368563f && zero_point == -128 && image_scaling == EI_CLASSIFIER_IMAGE_SCALING_NONE;
 
-    static const float torch_mean[] = { 0.485, 0.456, 0.406 };
-    static const float torch_std[] = { 0.229, 0.224, 0.225 };
+    // RGB quantization only depends on the channel byte, so do it once per possible value
+    ei::image::kernels::quantization_lut_t lut;
+    if (channel_count == 3) {
+        build_image_quantization_lut(scale, zero_point, image_scaling, lut);
+    }
 
 #if defined(EI_DSP_IMAGE_BUFFER_STATIC_SIZE)
     const size_t page_size = EI_DSP_IMAGE_BUFFER_STATIC_SIZE;
@@ -1283,113 +1580,72 @@ __attribute__((unused)) int extract_image_features_quantized(signal_t *signal, m
     const size_t page_size = 1024;
 #endif
 
+    if (signal->total_length == 0) {
+        return EIDSP_OK;
+    }
+
+    // one page buffer for the whole signal
+    size_t buffer_size = signal->total_length > page_size ? page_size : signal->total_length;
+#if defined(EI_DSP_IMAGE_BUFFER_STATIC_SIZE)
+    matrix_t input_matrix(buffer_size, config.axes, ei_dsp_image_buffer);
+#else
+    matrix_t input_matrix(buffer_size, config.axes);
+#endif
+    if (!input_matrix.buffer) {
+        EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    }
+
     // buffered read from the signal
     size_t bytes_left = signal->total_length;
     for (size_t ix = 0; ix < signal->total_length; ix += page_size) {
         size_t elements_to_read = bytes_left > page_size ? page_size : bytes_left;
 
-#if defined(EI_DSP_IMAGE_BUFFER_STATIC_SIZE)
-        matrix_t input_matrix(elements_to_read, config.axes, ei_dsp_image_buffer);
-#else
-        matrix_t input_matrix(elements_to_read, config.axes);
-#endif
-        if (!input_matrix.buffer) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
-        }
         signal->get_data(ix, elements_to_read, input_matrix.buffer);
 
-        for (size_t jx = 0; jx < elements_to_read; jx++) {
-            uint32_t pixel = static_cast<uint32_t>(input_matrix.buffer[jx]);
+        if (channel_count == 3) {
+            ei::image::kernels::packed_to_rgb_i8(input_matrix.buffer, elements_to_read, lut,
+                output_matrix->buffer + output_ix);
+            output_ix += elements_to_read * 3;
+        }
+        // fast code path
+        else if (fast_path) {
+            ei::image::kernels::packed_to_gray_i8_fixed(input_matrix.buffer, elements_to_read,
+                static_cast<int32_t>(zero_point), output_matrix->buffer + output_ix);
+            output_ix += elements_to_read;
+        }
+        // slow code path
+        else {
+            for (size_t jx = 0; jx < elements_to_read; jx++) {
+                uint32_t pixel = static_cast<uint32_t>(input_matrix.buffer[jx]);
 
-            if (channel_count == 3) {
-                // fast code path
-                if (scale == 0.003921568859368563f && zero_point == -128 && image_scaling == EI_CLASSIFIER_IMAGE_SCALING_NONE) {
-                    int32_t r = static_cast<int32_t>(pixel >> 16 & 0xff);
-                    int32_t g = static_cast<int32_t>(pixel >> 8 & 0xff);
-                    int32_t b = static_cast<int32_t>(pixel & 0xff);
-
-                    output_matrix->buffer[output_ix++] = static_cast<int8_t>(r + zero_point);
-                    output_matrix->buffer[output_ix++] = static_cast<int8_t>(g + zero_point);
-                    output_matrix->buffer[output_ix++] = static_cast<int8_t>(b + zero_point);
-                }
-                // slow code path
-                else {
-                    float r = static_cast<float>(pixel >> 16 & 0xff);
-                    float g = static_cast<float>(pixel >> 8 & 0xff);
-                    float b = static_cast<float>(pixel & 0xff);
-
-                    if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_NONE) {
-                        r /= 255.0f;
-                        g /= 255.0f;
-                        b /= 255.0f;
-                    }
-                    else if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_TORCH) {
-                        r /= 255.0f;
-                        g /= 255.0f;
-                        b /= 255.0f;
-
-                        r = (r - torch_mean[0]) / torch_std[0];
-                        g = (g - torch_mean[1]) / torch_std[1];
-                        b = (b - torch_mean[2]) / torch_std[2];
-                    }
-                    else if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_MIN128_127) {
-                        r -= 128.0f;
-                        g -= 128.0f;
-                        b -= 128.0f;
-                    }
-
-                    output_matrix->buffer[output_ix++] = static_cast<int8_t>(round(r / scale) + zero_point);
-                    output_matrix->buffer[output_ix++] = static_cast<int8_t>(round(g / scale) + zero_point);
-                    output_matrix->buffer[output_ix++] = static_cast<int8_t>(round(b / scale) + zero_point);
+                float r = static_cast<float>(pixel >> 16 & 0xff);
+                float g = static_cast<float>(pixel >> 8 & 0xff);
+                float b = static_cast<float>(pixel & 0xff);
+
+                if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_NONE) {
+                    r /= 255.0f;
+                    g /= 255.0f;
+                    b /= 255.0f;
                 }
-            }
-            else {
-                // fast code path
-                if (scale == 0.003921568859368563f && zero_point == -128 && image_scaling == EI_CLASSIFIER_IMAGE_SCALING_NONE) {
-                    int32_t r = static_cast<int32_t>(pixel >> 16 & 0xff);
-                    int32_t g = static_cast<int32_t>(pixel >> 8 & 0xff);
-                    int32_t b = static_cast<int32_t>(pixel & 0xff);
-
-                    // ITU-R 601-2 luma transform
-                    // see: https://pillow.readthedocs.io/en/stable/reference/Image.html#PIL.Image.Image.convert
-                    int32_t gray = (iRedToGray * r) + (iGreenToGray * g) + (iBlueToGray * b);
-                    gray >>= 16; // scale down to int8_t
-                    gray += zero_point;
-                    if (gray < - 128) gray = -128;
-                    else if (gray > 127) gray = 127;
-                    output_matrix->buffer[output_ix++] = static_cast<int8_t>(gray);
+                else if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_TORCH) {
+                    r /= 255.0f;
+                    g /= 255.0f;
+                    b /= 255.0f;
+
+                    r = (r - ei_dsp_image_torch_mean[0]) / ei_dsp_image_torch_std[0];
+                    g = (g - ei_dsp_image_torch_mean[1]) / ei_dsp_image_torch_std[1];
+                    b = (b - ei_dsp_image_torch_mean[2]) / ei_dsp_image_torch_std[2];
                 }
-                // slow code path
-                else {
-                    float r = static_cast<float>(pixel >> 16 & 0xff);
-                    float g = static_cast<float>(pixel >> 8 & 0xff);
-                    float b = static_cast<float>(pixel & 0xff);
-
-                    if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_NONE) {
-                        r /= 255.0f;
-                        g /= 255.0f;
-                        b /= 255.0f;
-                    }
-                    else if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_TORCH) {
-                        r /= 255.0f;
-                        g /= 255.0f;
-                        b /= 255.0f;
-
-                        r = (r - torch_mean[0]) / torch_std[0];
-                        g = (g - torch_mean[1]) / torch_std[1];
-                        b = (b - torch_mean[2]) / torch_std[2];
-                    }
-                    else if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_MIN128_127) {
-                        r -= 128.0f;
-                        g -= 128.0f;
-                        b -= 128.0f;
-                    }
-
-                    // ITU-R 601-2 luma transform
-                    // see: https://pillow.readthedocs.io/en/stable/reference/Image.html#PIL.Image.Image.convert
-                    float v = (0.299f * r) + (0.587f * g) + (0.114f * b);
-                    output_matrix->buffer[output_ix++] = static_cast<int8_t>(round(v / scale) + zero_point);
+                else if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_MIN128_127) {
+                    r -= 128.0f;
+                    g -= 128.0f;
+                    b -= 128.0f;
                 }
+
+                // ITU-R 601-2 luma transform
+                // see: https://pillow.readthedocs.io/en/stable/reference/Image.html#PIL.Image.Image.convert
+                float v = (0.299f * r) + (0.587f * g) + (0.114f * b);
+                output_matrix->buffer[output_ix++] = static_cast<int8_t>(round(v / scale) + zero_point);
             }
         }
 
@@ -1404,13 +1660,11 @@ __attribute__((unused)) int extract_image_features_quantized(signal_t *signal, m
  * Clear all state regarding continuous audio. Invoke this function after continuous audio loop ends.
  */
 __attribute__((unused)) int ei_dsp_clear_continuous_audio_state() {
-    if (ei_dsp_cont_current_frame) {
-        ei_free(ei_dsp_cont_current_frame);
+    if (ei_dsp_cont_default_state.frame) {
+        ei_free(ei_dsp_cont_default_state.frame);
     }
 
-    ei_dsp_cont_current_frame = nullptr;
-    ei_dsp_cont_current_frame_size = 0;
-    ei_dsp_cont_current_frame_ix = 0;
+    ei_dsp_cont_default_state = { nullptr, 0, 0, false };
 
     return EIDSP_OK;
 }
@@ -36,6 +36,7 @@
 #define _EI_CLASSIFIER_SIGNAL_WITH_AXES_H_
 
 #include "edge-impulse-sdk/dsp/numpy_types.h"
+#include "edge-impulse-sdk/dsp/numpy.hpp"
 #include "edge-impulse-sdk/dsp/returntypes.hpp"
 #include "edge-impulse-sdk/classifier/ei_model_types.h"
 
@@ -43,10 +44,19 @@
 
 using namespace ei;
 
+/**
+ * Floats SignalWithAxes reads from the original signal per get_data call (whole frames),
+ * when that signal is not backed by a buffer
+ */
+#ifndef EI_SIGNAL_WITH_AXES_CHUNK_SIZE
+#define EI_SIGNAL_WITH_AXES_CHUNK_SIZE      192
+#endif
+
 class SignalWithAxes {
 public:
     SignalWithAxes(signal_t *original_signal, EI_CLASSIFIER_DSP_AXES_INDEX_TYPE *axes, size_t axes_count, const ei_impulse_t *impulse):
-        _original_signal(original_signal), _axes(axes), _axes_count(axes_count), _impulse(impulse)
+        _original_signal(original_signal), _axes(axes), _axes_count(axes_count), _impulse(impulse),
+        _original_buffer(nullptr)
     {
 
     }
@@ -56,6 +66,9 @@ public:
             return this->_original_signal;
         }
 
+        // signals from numpy::signal_from_buffer() are gathered straight from their buffer
+        _original_buffer = numpy::signal_buffer(_original_signal);
+
         wrapped_signal.total_length = _original_signal->total_length / _impulse->raw_samples_per_frame * _axes_count;
 #ifdef __MBED__
         wrapped_signal.get_data = mbed::callback(this, &SignalWithAxes::get_data);
@@ -67,19 +80,63 @@ public:
         return &wrapped_signal;
     }
 
+    /**
+     * Selected axes of the frames covering [offset, offset + length), interleaved.
+     * The original signal is read a chunk of whole frames at a time (or not at all when
+     * it's backed by a buffer), and the axes are picked out of every frame in one pass.
+     */
     int get_data(size_t offset, size_t length, float *out_ptr) {
-        size_t offset_on_original_signal = offset / _axes_count * _impulse->raw_samples_per_frame;
-        size_t length_on_original_signal = length / _axes_count * _impulse->raw_samples_per_frame;
+        const size_t samples_per_frame = _impulse->raw_samples_per_frame;
+        size_t frame = offset / _axes_count;
+        size_t axis_ix = offset % _axes_count;
 
-        size_t out_ptr_ix = 0;
+        if (_original_buffer == nullptr && samples_per_frame > EI_SIGNAL_WITH_AXES_CHUNK_SIZE) {
+            // a frame doesn't fit the chunk, read the axes one by one
+            for (size_t ix = 0; ix < length; ix++) {
+                int r = _original_signal->get_data(
+                    (frame * samples_per_frame) + _axes[axis_ix], 1, &out_ptr[ix]);
+                if (r != 0) {
+                    return r;
+                }
+                if (++axis_ix == _axes_count) {
+                    axis_ix = 0;
+                    frame++;
+                }
+            }
+            return 0;
+        }
+
+        const size_t chunk_frames = EI_SIGNAL_WITH_AXES_CHUNK_SIZE / samples_per_frame;
 
-        for (size_t ix = offset_on_original_signal; ix < offset_on_original_signal + length_on_original_signal; ix += _impulse->raw_samples_per_frame) {
-            for (size_t axis_ix = 0; axis_ix < this->_axes_count; axis_ix++) {
-                int r = _original_signal->get_data(ix + _axes[axis_ix], 1, &out_ptr[out_ptr_ix++]);
+        while (length > 0) {
+            size_t frame_count = (axis_ix + length + _axes_count - 1) / _axes_count;
+
+            const float *frames;
+            if (_original_buffer != nullptr) {
+                frames = _original_buffer + (frame * samples_per_frame);
+            }
+            else {
+                if (frame_count > chunk_frames) {
+                    frame_count = chunk_frames;
+                }
+                int r = _original_signal->get_data(
+                    frame * samples_per_frame, frame_count * samples_per_frame, _chunk);
                 if (r != 0) {
                     return r;
                 }
+                frames = _chunk;
+            }
+
+            for (size_t fx = 0; fx < frame_count; fx++) {
+                const float *sample = frames + (fx * samples_per_frame);
+                const size_t axis_end = length < _axes_count - axis_ix ? axis_ix + length : _axes_count;
+                for (size_t ax = axis_ix; ax < axis_end; ax++) {
+                    *out_ptr++ = sample[_axes[ax]];
+                }
+                length -= axis_end - axis_ix;
+                axis_ix = 0;
             }
+            frame += frame_count;
         }
 
         return 0;
@@ -90,6 +147,8 @@ private:
     EI_CLASSIFIER_DSP_AXES_INDEX_TYPE *_axes;
     size_t _axes_count;
     const ei_impulse_t *_impulse;
+    const float *_original_buffer;
+    float _chunk[EI_SIGNAL_WITH_AXES_CHUNK_SIZE];
     signal_t wrapped_signal;
 };
 
@@ -47,6 +47,18 @@
 #include "edge-impulse-sdk/classifier/ei_aligned_malloc.h"
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
 #include "edge-impulse-sdk/classifier/inferencing_engines/engines.h"
+#include "edge-impulse-sdk/dsp/config.hpp"
+
+// vfmaq_f32, vsqrtq_f32 and vminvq_f32 are AArch64 only, 32-bit NEON uses the scalar loops
+#if EI_CLASSIFIER_HAS_ANOMALY_KMEANS
+#if EIDSP_USE_NEON && defined(__aarch64__)
+#include <arm_neon.h>
+#define EI_KMEANS_NEON      1
+#elif EIDSP_USE_SSE2
+#include <emmintrin.h>
+#define EI_KMEANS_SSE2      1
+#endif
+#endif // EI_CLASSIFIER_HAS_ANOMALY_KMEANS
 
 #ifdef __cplusplus
 namespace {
@@ -54,51 +66,272 @@ namespace {
 
 #if EI_CLASSIFIER_HAS_ANOMALY_KMEANS
 /**
- * Standard scaler, scales all values in the input vector
- * Note that this *modifies* the array in place!
- * @param input Array of input values
- * @param scale Array of scale values (obtain from StandardScaler in Python)
- * @param mean Array of mean values (obtain from StandardScaler in Python)
- * @param input_size Size of input, scale and mean arrays
+ * Feature windows scored together by kmeans_score_windows(). Every block of cluster
+ * centers is loaded once per tile instead of once per window.
+ */
+#define EI_KMEANS_BATCH_TILE        4
+
+/** Anomaly score when there are no clusters (and the upper bound of every score) */
+#define EI_KMEANS_MAX_SCORE         1000.0f
+
+/**
+ * K-means block prepared for scoring. Built from the block config on the first inference
+ * and kept in the impulse handle.
+ *
+ * The standard scaler is folded into one multiply-add per feature
+ * (z = x * inv_scale + offset), and the squared norm of every cluster center is
+ * precomputed, so the squared distance to a center is ||z||^2 - 2 z.c + ||c||^2.
+ * Centers are stored transposed (one row of cluster_stride floats per feature), so a
+ * window is scored against 4 clusters per vector operation whatever the number of
+ * features. The padding clusters have a huge norm and never win.
+ */
+typedef struct {
+    size_t axes_size;
+    size_t cluster_count;
+    size_t cluster_stride;      // cluster_count rounded up to a multiple of 4
+    float *inv_scale;           // [axes_size] 1 / scale
+    float *offset;              // [axes_size] -mean / scale
+    float *centers;             // [axes_size][cluster_stride]
+    float *center_norms;        // [cluster_stride]
+    float *max_errors;          // [cluster_stride]
+    float *input;               // [EI_KMEANS_BATCH_TILE][axes_size] windows being scored
+    void *buffer;               // aligned allocation holding the arrays above
+} ei_kmeans_anomaly_state_t;
+
+static void kmeans_anomaly_free(void *ptr) {
+    ei_kmeans_anomaly_state_t *state = (ei_kmeans_anomaly_state_t*)ptr;
+    if (state == nullptr) {
+        return;
+    }
+    if (state->buffer != nullptr) {
+        ei_aligned_free(state->buffer);
+    }
+    ei_free(state);
+}
+
+/**
+ * Fold the scaler and precompute the transposed centers and their norms
+ * @return nullptr if allocation failed
  */
-static void standard_scaler(float *input, const float *scale, const float *mean, size_t input_size) {
-    for (size_t ix = 0; ix < input_size; ix++) {
-        input[ix] = (input[ix] - mean[ix]) / scale[ix];
+static ei_kmeans_anomaly_state_t* kmeans_anomaly_create(const ei_learning_block_config_anomaly_kmeans_t *config) {
+    ei_kmeans_anomaly_state_t *state = (ei_kmeans_anomaly_state_t*)ei_calloc(1, sizeof(ei_kmeans_anomaly_state_t));
+    if (state == nullptr) {
+        return nullptr;
+    }
+
+    const size_t axes_size = config->anom_axes_size;
+    const size_t cluster_count = config->anom_cluster_count;
+    const size_t cluster_stride = (cluster_count + 3) & ~(size_t)3;
+    const size_t floats = (axes_size * 2) + (axes_size * cluster_stride) + (cluster_stride * 2) +
+        (EI_KMEANS_BATCH_TILE * axes_size);
+
+    state->buffer = ei_aligned_calloc(16, (floats > 0 ? floats : 1) * sizeof(float));
+    if (state->buffer == nullptr) {
+        kmeans_anomaly_free(state);
+        return nullptr;
+    }
+
+    state->axes_size = axes_size;
+    state->cluster_count = cluster_count;
+    state->cluster_stride = cluster_stride;
+    state->centers = (float*)state->buffer;
+    state->center_norms = state->centers + (axes_size * cluster_stride);
+    state->max_errors = state->center_norms + cluster_stride;
+    state->inv_scale = state->max_errors + cluster_stride;
+    state->offset = state->inv_scale + axes_size;
+    state->input = state->offset + axes_size;
+
+    for (size_t ix = 0; ix < axes_size; ix++) {
+        state->inv_scale[ix] = 1.0f / config->anom_scale[ix];
+        state->offset[ix] = -config->anom_mean[ix] * state->inv_scale[ix];
+    }
+
+    for (size_t cx = 0; cx < cluster_stride; cx++) {
+        if (cx >= cluster_count) {
+            state->center_norms[cx] = 1e30f;
+            continue;
+        }
+        const float *centroid = config->anom_clusters[cx].centroid;
+        double norm = 0;
+        for (size_t ix = 0; ix < axes_size; ix++) {
+            state->centers[(ix * cluster_stride) + cx] = centroid[ix];
+            norm += (double)centroid[ix] * (double)centroid[ix];
+        }
+        state->center_norms[cx] = (float)norm;
+        state->max_errors[cx] = config->anom_clusters[cx].max_error;
     }
+
+    return state;
 }
 
 /**
- * Calculate the distance between input vector and the cluster
- * @param input Array of input values (already scaled by standard_scaler)
- * @param input_size Size of the input array
- * @param cluster A cluster (number of centroids should match input_size)
+ * Get the prepared clusters of a k-means learn block. They're kept in the impulse handle;
+ * without a handle they're only for this call and *is_temp is set, free them with
+ * kmeans_anomaly_free() when done.
+ *
+ * @param      handle             Impulse handle (result->_handle), can be nullptr
+ * @param      learn_block_index  Index of the learn block in the impulse
+ * @param      config             K-means block config
+ * @param      state              Set to the prepared clusters
+ * @param      is_temp            Set if the caller needs to free the state
+ *
+ * @return  EI_IMPULSE_OK if successful
  */
-static float calculate_cluster_distance(float *input, size_t input_size, const ei_classifier_anom_cluster_t *cluster) {
-    // todo: check input_size and centroid size?
+static EI_IMPULSE_ERROR kmeans_anomaly_get_state(
+    ei_impulse_handle_t *handle,
+    uint32_t learn_block_index,
+    const ei_learning_block_config_anomaly_kmeans_t *config,
+    ei_kmeans_anomaly_state_t **state,
+    bool *is_temp)
+{
+    if (handle != nullptr) {
+        ei_kmeans_anomaly_state_t *kept_state =
+            (ei_kmeans_anomaly_state_t*)handle->state.get_learning_block_state(learn_block_index);
+        if (kept_state != nullptr) {
+            *state = kept_state;
+            *is_temp = false;
+            return EI_IMPULSE_OK;
+        }
+    }
+
+    *state = kmeans_anomaly_create(config);
+    if (*state == nullptr) {
+        ei_printf("ERR: Failed to allocate memory for anomaly clusters\n");
+        return EI_IMPULSE_OUT_OF_MEMORY;
+    }
+
+    *is_temp = true;
+    if (handle != nullptr &&
+        handle->state.set_learning_block_state(learn_block_index, *state, kmeans_anomaly_free)) {
+        *is_temp = false;
+    }
+    return EI_IMPULSE_OK;
+}
 
-    float dist = 0.0f;
-    for (size_t ix = 0; ix < input_size; ix++) {
-        dist += pow(input[ix] - cluster->centroid[ix], 2);
+/**
+ * Standard scaler, in place on the first tile_size rows of state->input
+ * @param input_norms Out: squared norm of every scaled row
+ */
+static void kmeans_scale_windows(const ei_kmeans_anomaly_state_t *state, size_t tile_size, float *input_norms) {
+    for (size_t wx = 0; wx < tile_size; wx++) {
+        float *input = state->input + (wx * state->axes_size);
+        float norm = 0.0f;
+        for (size_t ix = 0; ix < state->axes_size; ix++) {
+            input[ix] = (input[ix] * state->inv_scale[ix]) + state->offset[ix];
+            norm += input[ix] * input[ix];
+        }
+        input_norms[wx] = norm;
     }
-    return sqrt(dist) - cluster->max_error;
 }
 
 /**
- * Get minimum distance to a cluster
- * @param input Array of input values (already scaled by standard_scaler)
- * @param input_size Size of the input array
- * @param clusters Array of clusters
- * @param cluster_size Size of cluster array
+ * Minimum distance from TILE scaled windows (rows of state->input) to the edge of any
+ * cluster. Every window accumulates its dot products in the same order whatever TILE is,
+ * so a window gets the same score alone or in a batch.
+ * @param input_norms Squared norm of every window
+ * @param scores Out: TILE anomaly scores
  */
-static float get_min_distance_to_cluster(float *input, size_t input_size, const ei_classifier_anom_cluster_t *clusters, size_t cluster_size) {
-    float min = 1000.0f;
-    for (size_t ix = 0; ix < cluster_size; ix++) {
-        float dist = calculate_cluster_distance(input, input_size, &clusters[ix]);
-        if (dist < min) {
-            min = dist;
+template<size_t TILE>
+static inline void kmeans_score_windows(const ei_kmeans_anomaly_state_t *state, const float *input_norms, float *scores) {
+    const size_t axes_size = state->axes_size;
+    const float *input = state->input;
+
+#if EI_KMEANS_NEON
+    float32x4_t min_dist[TILE];
+    for (size_t wx = 0; wx < TILE; wx++) {
+        min_dist[wx] = vdupq_n_f32(EI_KMEANS_MAX_SCORE);
+    }
+    for (size_t cx = 0; cx < state->cluster_stride; cx += 4) {
+        float32x4_t dot[TILE];
+        for (size_t wx = 0; wx < TILE; wx++) {
+            dot[wx] = vdupq_n_f32(0.0f);
+        }
+        const float *centers = state->centers + cx;
+        for (size_t ix = 0; ix < axes_size; ix++) {
+            const float32x4_t c = vld1q_f32(centers + (ix * state->cluster_stride));
+            for (size_t wx = 0; wx < TILE; wx++) {
+                dot[wx] = vfmaq_n_f32(dot[wx], c, input[(wx * axes_size) + ix]);
+            }
+        }
+        const float32x4_t norms = vld1q_f32(state->center_norms + cx);
+        const float32x4_t max_errors = vld1q_f32(state->max_errors + cx);
+        for (size_t wx = 0; wx < TILE; wx++) {
+            float32x4_t dist = vfmsq_f32(vaddq_f32(norms, vdupq_n_f32(input_norms[wx])), dot[wx], vdupq_n_f32(2.0f));
+            dist = vsubq_f32(vsqrtq_f32(vmaxq_f32(dist, vdupq_n_f32(0.0f))), max_errors);
+            min_dist[wx] = vminq_f32(min_dist[wx], dist);
+        }
+    }
+    for (size_t wx = 0; wx < TILE; wx++) {
+        scores[wx] = vminvq_f32(min_dist[wx]);
+    }
+#elif EI_KMEANS_SSE2
+    __m128 min_dist[TILE];
+    for (size_t wx = 0; wx < TILE; wx++) {
+        min_dist[wx] = _mm_set1_ps(EI_KMEANS_MAX_SCORE);
+    }
+    for (size_t cx = 0; cx < state->cluster_stride; cx += 4) {
+        __m128 dot[TILE];
+        for (size_t wx = 0; wx < TILE; wx++) {
+            dot[wx] = _mm_setzero_ps();
+        }
+        const float *centers = state->centers + cx;
+        for (size_t ix = 0; ix < axes_size; ix++) {
+            const __m128 c = _mm_load_ps(centers + (ix * state->cluster_stride));
+            for (size_t wx = 0; wx < TILE; wx++) {
+                dot[wx] = _mm_add_ps(dot[wx], _mm_mul_ps(c, _mm_set1_ps(input[(wx * axes_size) + ix])));
+            }
+        }
+        const __m128 norms = _mm_load_ps(state->center_norms + cx);
+        const __m128 max_errors = _mm_load_ps(state->max_errors + cx);
+        for (size_t wx = 0; wx < TILE; wx++) {
+            __m128 dist = _mm_sub_ps(_mm_add_ps(norms, _mm_set1_ps(input_norms[wx])),
+                _mm_add_ps(dot[wx], dot[wx]));
+            dist = _mm_sub_ps(_mm_sqrt_ps(_mm_max_ps(dist, _mm_setzero_ps())), max_errors);
+            min_dist[wx] = _mm_min_ps(min_dist[wx], dist);
+        }
+    }
+    for (size_t wx = 0; wx < TILE; wx++) {
+        __m128 m = _mm_min_ps(min_dist[wx], _mm_movehl_ps(min_dist[wx], min_dist[wx]));
+        m = _mm_min_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+        scores[wx] = _mm_cvtss_f32(m);
+    }
+#else
+    for (size_t wx = 0; wx < TILE; wx++) {
+        scores[wx] = EI_KMEANS_MAX_SCORE;
+    }
+    for (size_t cx = 0; cx < state->cluster_count; cx++) {
+        float dot[TILE] = { 0 };
+        for (size_t ix = 0; ix < axes_size; ix++) {
+            const float c = state->centers[(ix * state->cluster_stride) + cx];
+            for (size_t wx = 0; wx < TILE; wx++) {
+                dot[wx] += c * input[(wx * axes_size) + ix];
+            }
+        }
+        for (size_t wx = 0; wx < TILE; wx++) {
+            float dist = state->center_norms[cx] + input_norms[wx] - (2.0f * dot[wx]);
+            dist = sqrtf(dist > 0.0f ? dist : 0.0f) - state->max_errors[cx];
+            if (dist < scores[wx]) {
+                scores[wx] = dist;
+            }
         }
     }
-    return min;
+#endif
+}
+
+/**
+ * Score the first tile_size rows of state->input (unscaled features)
+ * @param scores Out: tile_size anomaly scores
+ */
+static void kmeans_score_tile(const ei_kmeans_anomaly_state_t *state, size_t tile_size, float *scores) {
+    float input_norms[EI_KMEANS_BATCH_TILE];
+    kmeans_scale_windows(state, tile_size, input_norms);
+
+    switch (tile_size) {
+        case 1: kmeans_score_windows<1>(state, input_norms, scores); break;
+        case 2: kmeans_score_windows<2>(state, input_norms, scores); break;
+        case 3: kmeans_score_windows<3>(state, input_norms, scores); break;
+        default: kmeans_score_windows<EI_KMEANS_BATCH_TILE>(state, input_norms, scores); break;
+    }
 }
 #endif // EI_CLASSIFIER_HAS_ANOMALY_KMEANS
 
@@ -183,17 +416,28 @@ EI_IMPULSE_ERROR run_kmeans_anomaly(
 
     uint64_t anomaly_start_us = ei_read_timer_us();
 
-    float *input = (float*)ei_malloc(block_config->anom_axes_size * sizeof(float));
-    if (!input) {
-        ei_printf("Failed to allocate memory for anomaly input buffer");
-        return EI_IMPULSE_OUT_OF_MEMORY;
+    ei_kmeans_anomaly_state_t *state = nullptr;
+    bool is_temp = false;
+    EI_IMPULSE_ERROR res = kmeans_anomaly_get_state(
+        (ei_impulse_handle_t*)result->_handle, learn_block_index, block_config, &state, &is_temp);
+    if (res != EI_IMPULSE_OK) {
+        return res;
+    }
+
+    res = extract_anomaly_input_values(fmatrix, input_block_ids, input_block_ids_size, block_config->anom_axes_size, block_config->anom_axis, state->input);
+    if (res != EI_IMPULSE_OK) {
+        if (is_temp) {
+            kmeans_anomaly_free(state);
+        }
+        return res;
     }
 
-    extract_anomaly_input_values(fmatrix, input_block_ids, input_block_ids_size, block_config->anom_axes_size, block_config->anom_axis, input);
+    float anomaly;
+    kmeans_score_tile(state, 1, &anomaly);
 
-    standard_scaler(input, block_config->anom_scale, block_config->anom_mean, block_config->anom_axes_size);
-    float anomaly = get_min_distance_to_cluster(
-        input, block_config->anom_axes_size, block_config->anom_clusters, block_config->anom_cluster_count);
+    if (is_temp) {
+        kmeans_anomaly_free(state);
+    }
 
     uint64_t anomaly_end_us = ei_read_timer_us();
 
@@ -206,10 +450,75 @@ EI_IMPULSE_ERROR run_kmeans_anomaly(
     result->timing.anomaly_us = anomaly_end_us - anomaly_start_us;
     result->timing.anomaly = (int)(result->timing.anomaly_us / 1000);
     result->anomaly = anomaly;
-    ei_free(input);
 
     return EI_IMPULSE_OK;
 }
+
+/**
+ * Anomaly scores of many feature windows at once, e.g. every overlapping window of a
+ * recording. The windows are scored EI_KMEANS_BATCH_TILE at a time against the clusters
+ * kept in the handle, and get the same scores as result.anomaly from run_classifier().
+ *
+ * @param handle          Impulse handle, the impulse needs a k-means anomaly block
+ * @param features        window_count windows of features_stride floats. Each holds the
+ *                        features of the anomaly block's input DSP blocks, concatenated
+ *                        (the block picks its axes out of them, see anom_axis)
+ * @param features_stride Floats from the start of one window to the next
+ * @param window_count    Number of windows
+ * @param scores          Out: window_count anomaly scores
+ *
+ * @return EI_IMPULSE_OK if successful
+ */
+__attribute__((unused)) static EI_IMPULSE_ERROR run_kmeans_anomaly_batch(
+    ei_impulse_handle_t *handle,
+    const float *features,
+    size_t features_stride,
+    size_t window_count,
+    float *scores)
+{
+    if (handle == nullptr || features == nullptr || scores == nullptr) {
+        return EI_IMPULSE_INFERENCE_ERROR;
+    }
+
+    const ei_impulse_t *impulse = handle->impulse;
+    for (size_t learn_block_index = 0; learn_block_index < impulse->learning_blocks_size; learn_block_index++) {
+        const ei_learning_block_t *block = &impulse->learning_blocks[learn_block_index];
+        if (block->infer_fn != run_kmeans_anomaly) {
+            continue;
+        }
+
+        const ei_learning_block_config_anomaly_kmeans_t *block_config =
+            (const ei_learning_block_config_anomaly_kmeans_t*)block->config;
+
+        ei_kmeans_anomaly_state_t *state = nullptr;
+        bool is_temp = false;
+        EI_IMPULSE_ERROR res = kmeans_anomaly_get_state(handle, learn_block_index, block_config, &state, &is_temp);
+        if (res != EI_IMPULSE_OK) {
+            return res;
+        }
+
+        for (size_t window_ix = 0; window_ix < window_count; window_ix += EI_KMEANS_BATCH_TILE) {
+            const size_t tile_size = window_count - window_ix < EI_KMEANS_BATCH_TILE ?
+                window_count - window_ix : EI_KMEANS_BATCH_TILE;
+            for (size_t wx = 0; wx < tile_size; wx++) {
+                const float *window = features + ((window_ix + wx) * features_stride);
+                float *input = state->input + (wx * state->axes_size);
+                for (size_t ix = 0; ix < state->axes_size; ix++) {
+                    input[ix] = window[block_config->anom_axis[ix]];
+                }
+            }
+            kmeans_score_tile(state, tile_size, scores + window_ix);
+        }
+
+        if (is_temp) {
+            kmeans_anomaly_free(state);
+        }
+        return EI_IMPULSE_OK;
+    }
+
+    ei_printf("ERR: The impulse has no k-means anomaly block\n");
+    return EI_IMPULSE_INFERENCE_ERROR;
+}
 #endif // EI_CLASSIFIER_HAS_ANOMALY_KMEANS
 
 #if EI_CLASSIFIER_HAS_ANOMALY_GMM
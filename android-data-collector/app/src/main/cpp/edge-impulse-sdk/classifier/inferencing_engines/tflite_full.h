@@ -40,7 +40,11 @@
 #include "model-parameters/model_metadata.h"
 #include "tflite-model/trained_model_ops_define.h"
 
+#include <atomic>
 #include <thread>
+#include <mutex>
+#include <functional>
+#include <vector>
 #include "tensorflow-lite/tensorflow/lite/c/common.h"
 #include "tensorflow-lite/tensorflow/lite/interpreter.h"
 #include "tensorflow-lite/tensorflow/lite/kernels/register.h"
@@ -49,27 +53,259 @@
 #include "edge-impulse-sdk/tensorflow/lite/kernels/custom/tree_ensemble_classifier.h"
 #include "edge-impulse-sdk/classifier/ei_model_types.h"
 #include "edge-impulse-sdk/classifier/inferencing_engines/tflite_helper.h"
+#include "edge-impulse-sdk/dsp/ei_profiler.h"
 #ifdef EI_CLASSIFIER_USE_QNN_DELEGATES
 #include "QNN/TFLiteDelegate/QnnTFLiteDelegate.h"
 #elif EI_CLASSIFIER_USE_GPU_DELEGATES==1
 #include "tensorflow-lite/tensorflow/lite/delegates/gpu/delegate.h"
+#elif EI_CLASSIFIER_USE_XNNPACK_DELEGATE==1
+#include "tensorflow-lite/tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+#endif
+#if defined(__linux__)
+#include <sched.h>
 #endif
 
+/**
+ * Runtime options for the interpreters of an impulse handle, see run_classifier_init().
+ * Options are read when the interpreters are built (on the first inference).
+ */
+typedef struct {
+    /** Interpreter threads. 0 = one less than the number of cores */
+    int num_threads;
+    /**
+     * Run the graph through XNNPACK. Without EI_CLASSIFIER_USE_XNNPACK_DELEGATE this is the
+     * delegate built into the TFLite library (applied during AllocateTensors), with it the
+     * delegate is created explicitly, which enables the weight cache below.
+     */
+    bool use_xnnpack;
+    /**
+     * File for the XNNPACK weight cache (packed weights are mmapped from here on the next start
+     * instead of being repacked). Needs EI_CLASSIFIER_USE_XNNPACK_DELEGATE, nullptr to disable.
+     */
+    const char *xnnpack_weight_cache_path;
+    /**
+     * CPUs (bit n = cpu n) the inference threads are pinned to, 0 = no pinning (Linux / Android
+     * only). The calling thread is pinned the first time it runs inference and the interpreter's
+     * worker threads inherit the mask, so they don't migrate to efficiency cores.
+     * See ei_tflite_get_performance_cores_mask().
+     */
+    uint64_t cpu_affinity_mask;
+    /**
+     * Install a profiler on the interpreters that times every op while profiling is on (see
+     * ei_profiler_start()). Set by ei_profiler_start() if needed. Delegates show up as a single
+     * op unless they report their own ops (XNNPACK does when it's applied with the profiler set).
+     */
+    bool enable_profiling;
+} ei_tflite_runtime_options_t;
+
+#define EI_TFLITE_RUNTIME_OPTIONS_DEFAULT { 0, true, nullptr, 0, false }
+
+#if EIDSP_PROFILING == 1
+/**
+ * Aggregates the time of every op (and of the ops delegates report) of an interpreter,
+ * while the stage profiler is enabled and the profiler is active (see ei_profiler_stop()).
+ */
+class EiTfliteOpProfiler : public tflite::Profiler {
+public:
+    /**
+     * An inactive profiler ignores events but keeps its timings. Delegates may have kept a
+     * pointer to it, so it's deactivated rather than destroyed when profiling stops.
+     */
+    void set_active(bool active) {
+        this->active = active;
+    }
+
+    uint32_t BeginEvent(const char* tag, EventType event_type,
+                        int64_t event_metadata1, int64_t event_metadata2) override {
+        if (!active || !is_op_event(event_type) || !EiStageProfiler::enabled()) {
+            return UINT32_MAX;
+        }
+        open_event_t event = { tag, event_type, event_metadata1, event_metadata2, std::chrono::steady_clock::now() };
+        open_events.push_back(event);
+        return (uint32_t)(open_events.size() - 1);
+    }
+
+    void EndEvent(uint32_t event_handle) override {
+        if (event_handle >= open_events.size()) {
+            return;
+        }
+        const open_event_t &event = open_events[event_handle];
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - event.start;
+        add(event.tag, event.type, elapsed.count(), event.metadata1, event.metadata2);
+        // events nest, the outermost one ends last
+        if (event_handle == 0) {
+            open_events.clear();
+        }
+    }
+
+    // ops that delegates time themselves
+    void AddEvent(const char* tag, EventType event_type, uint64_t metric,
+                  int64_t event_metadata1, int64_t event_metadata2) override {
+        if (!active || !is_op_event(event_type) || !EiStageProfiler::enabled()) {
+            return;
+        }
+        add(tag, event_type, (double)metric, event_metadata1, event_metadata2);
+    }
+
+    /**
+     * Append the ops, in graph order, names prefixed with prefix
+     */
+    void get_ops(const std::string &prefix, std::vector<ei_profiler_entry_t> *out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &it : ops) {
+            out->push_back(it.second);
+            out->back().name = prefix + it.second.name;
+        }
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ops.clear();
+    }
+
+private:
+    typedef struct {
+        const char *tag;
+        EventType type;
+        int64_t metadata1;
+        int64_t metadata2;
+        std::chrono::steady_clock::time_point start;
+    } open_event_t;
+
+    static bool is_op_event(EventType event_type) {
+        return event_type == EventType::OPERATOR_INVOKE_EVENT ||
+            event_type == EventType::DELEGATE_OPERATOR_INVOKE_EVENT ||
+            event_type == EventType::DELEGATE_PROFILED_OPERATOR_INVOKE_EVENT;
+    }
+
+    void add(const char *tag, EventType event_type, double us, int64_t node_index, int64_t subgraph_index) {
+        // ops of the graph first, then the ops inside delegates (their own node numbering)
+        const bool delegate_op = event_type != EventType::OPERATOR_INVOKE_EVENT;
+        const std::tuple<bool, int64_t, int64_t> key(delegate_op, subgraph_index, node_index);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ei_profiler_entry_t &entry = ops[key];
+        if (entry.count == 0) {
+            char name[32];
+            if (delegate_op) {
+                snprintf(name, sizeof(name), " (delegate #%d)", (int)node_index);
+            }
+            else if (subgraph_index != 0) {
+                snprintf(name, sizeof(name), " (#%d, subgraph %d)", (int)node_index, (int)subgraph_index);
+            }
+            else {
+                snprintf(name, sizeof(name), " (#%d)", (int)node_index);
+            }
+            entry.name = std::string(tag ? tag : "?") + name;
+        }
+        ei_profiler_entry_add(&entry, us);
+    }
+
+    std::atomic<bool> active { true };
+    std::vector<open_event_t> open_events; // only touched by the thread that invokes
+    std::mutex mutex;
+    std::map<std::tuple<bool, int64_t, int64_t>, ei_profiler_entry_t> ops;
+};
+#endif // EIDSP_PROFILING == 1
+
 typedef struct {
     std::unique_ptr<tflite::FlatBufferModel> model;
+#if EIDSP_PROFILING == 1
+    // declared before the interpreter, which must be destroyed first
+    std::unique_ptr<EiTfliteOpProfiler> profiler;
+#endif
+#if EI_CLASSIFIER_USE_XNNPACK_DELEGATE==1
+    // declared before the interpreter, which must be destroyed first
+    tflite::Interpreter::TfLiteDelegatePtr xnnpack_delegate { nullptr, [](TfLiteDelegate*) {} };
+#endif
     std::unique_ptr<tflite::Interpreter> interpreter;
+    std::mutex invoke_mutex; // only for interpreters shared between handles (DSP blocks)
+    int batch_size = 1; // current size of the first input dimension, see ei_tflite_set_batch_size()
+    uint64_t cpu_affinity_mask = 0; // from ei_tflite_runtime_options_t, applied to every thread calling Invoke()
 } ei_tflite_state_t;
 
-std::map<uint32_t, ei_tflite_state_t*> ei_tflite_instances;
+// interpreters are keyed by (impulse handle, block id), so every handle has its own and
+// handles can run in parallel. DSP blocks (run_nn_inference_from_dsp) use a nullptr handle.
+typedef std::pair<const void*, uint32_t> ei_tflite_instance_key_t;
+
+std::map<ei_tflite_instance_key_t, ei_tflite_state_t*> ei_tflite_instances;
+std::map<const void*, ei_tflite_runtime_options_t> ei_tflite_runtime_options;
+std::mutex ei_tflite_instances_mutex;
+
+/**
+ * Pin the calling thread to the CPUs in mask (no-op for 0, or if it's pinned to mask already)
+ */
+static void ei_tflite_pin_thread(uint64_t mask) {
+#if defined(__linux__)
+    static thread_local uint64_t pinned_mask = 0;
+    if (mask == 0 || mask == pinned_mask) {
+        return;
+    }
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu = 0; cpu < 64; cpu++) {
+        if (mask & (1ULL << cpu)) {
+            CPU_SET(cpu, &cpu_set);
+        }
+    }
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+        EI_LOGW("sched_setaffinity failed, inference threads are not pinned\n");
+    }
+    // don't retry on every inference if it failed
+    pinned_mask = mask;
+#else
+    (void)mask;
+#endif
+}
+
+/**
+ * Mask of the CPUs with the highest max. frequency (the performance cores on big.LITTLE),
+ * for ei_tflite_runtime_options_t::cpu_affinity_mask.
+ * @return 0 if the frequencies can't be read (or on non-Linux targets)
+ */
+__attribute__((unused)) static uint64_t ei_tflite_get_performance_cores_mask() {
+    uint64_t mask = 0;
+#if defined(__linux__)
+    long max_freq = 0;
+    for (int cpu = 0; cpu < 64; cpu++) {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+        FILE *f = fopen(path, "r");
+        if (!f) {
+            continue;
+        }
+        long freq = 0;
+        if (fscanf(f, "%ld", &freq) == 1) {
+            if (freq > max_freq) {
+                max_freq = freq;
+                mask = 0;
+            }
+            if (freq == max_freq) {
+                mask |= (1ULL << cpu);
+            }
+        }
+        fclose(f);
+    }
+#endif
+    return mask;
+}
 
 /**
  * Construct a tflite interpreter (creates it if needed)
  */
-static EI_IMPULSE_ERROR get_interpreter(ei_learning_block_config_tflite_graph_t *block_config, tflite::Interpreter **interpreter) {
+static EI_IMPULSE_ERROR get_interpreter(const void *handle, ei_learning_block_config_tflite_graph_t *block_config, ei_tflite_state_t **state) {
+    std::lock_guard<std::mutex> lock(ei_tflite_instances_mutex);
+
+    const ei_tflite_instance_key_t key(handle, block_config->block_id);
+
     // not in the map yet...
-    if (!ei_tflite_instances.count(block_config->block_id)) {
+    if (!ei_tflite_instances.count(key)) {
+        // TFLite allocates the interpreter and its tensors with new / malloc, only what goes
+        // through ei_malloc (e.g. custom ops) shows up in the memory accounting
+        EI_MEMORY_STAGE(EI_MEMORY_STAGE_ARENA);
         ei_config_tflite_graph_t *graph_config = (ei_config_tflite_graph_t*)block_config->graph_config;
-        ei_tflite_state_t *new_state = new ei_tflite_state_t();
+        std::unique_ptr<ei_tflite_state_t> new_state(new ei_tflite_state_t());
 
         auto new_model = tflite::FlatBufferModel::BuildFromBuffer((const char*)graph_config->model, graph_config->model_size);
         new_state->model = std::move(new_model);
@@ -78,18 +314,67 @@ static EI_IMPULSE_ERROR get_interpreter(ei_learning_block_config_tflite_graph_t
             return EI_IMPULSE_TFLITE_ERROR;
         }
 
-        tflite::ops::builtin::BuiltinOpResolver resolver;
+        ei_tflite_runtime_options_t runtime_options = EI_TFLITE_RUNTIME_OPTIONS_DEFAULT;
+        if (ei_tflite_runtime_options.count(handle)) {
+            runtime_options = ei_tflite_runtime_options[handle];
+        }
+
+        int num_threads = runtime_options.num_threads;
+        if (num_threads < 1) {
+            num_threads = (int)std::thread::hardware_concurrency();
+            num_threads -= 1; // leave one thread free for the other application
+            if (num_threads < 1) {
+                num_threads = 1;
+            }
+        }
+
+        // worker threads are created from this thread (during AllocateTensors / the first Invoke)
+        // and inherit its affinity
+        new_state->cpu_affinity_mask = runtime_options.cpu_affinity_mask;
+        ei_tflite_pin_thread(runtime_options.cpu_affinity_mask);
+
+#if EI_CLASSIFIER_USE_XNNPACK_DELEGATE==1
+        // XNNPACK is applied explicitly below (if enabled), never twice
+        tflite::ops::builtin::BuiltinOpResolverWithoutDefaultDelegates resolver;
+#else
+        if (runtime_options.xnnpack_weight_cache_path) {
+            EI_LOGW("xnnpack_weight_cache_path needs EI_CLASSIFIER_USE_XNNPACK_DELEGATE=1, ignoring\n");
+        }
+        std::unique_ptr<tflite::MutableOpResolver> resolver_ptr;
+        if (runtime_options.use_xnnpack) {
+            resolver_ptr.reset(new tflite::ops::builtin::BuiltinOpResolver());
+        }
+        else {
+            resolver_ptr.reset(new tflite::ops::builtin::BuiltinOpResolverWithoutDefaultDelegates());
+        }
+        tflite::MutableOpResolver &resolver = *resolver_ptr;
+#endif
 #if EI_CLASSIFIER_HAS_TREE_ENSEMBLE_CLASSIFIER
         resolver.AddCustom("TreeEnsembleClassifier",
             tflite::ops::custom::Register_TREE_ENSEMBLE_CLASSIFIER());
 #endif
         tflite::InterpreterBuilder builder(*new_state->model, resolver);
+        // before the interpreter is built, so the default XNNPACK delegate picks it up as well
+        if (builder.SetNumThreads(num_threads) != kTfLiteOk) {
+            ei_printf("SetNumThreads failed\n");
+            return EI_IMPULSE_TFLITE_ERROR;
+        }
         builder(&new_state->interpreter);
 
         if (!new_state->interpreter) {
             ei_printf("Failed to construct interpreter\n");
             return EI_IMPULSE_TFLITE_ERROR;
         }
+
+        if (runtime_options.enable_profiling) {
+#if EIDSP_PROFILING == 1
+            // before any delegate is applied, so delegates can report their ops
+            new_state->profiler.reset(new EiTfliteOpProfiler());
+            new_state->interpreter->SetProfiler(new_state->profiler.get());
+#else
+            EI_LOGW("enable_profiling needs EIDSP_PROFILING=1, ignoring\n");
+#endif
+        }
 #ifdef EI_CLASSIFIER_USE_QNN_DELEGATES
         // Create QNN Delegate options structure.
         TfLiteQnnDelegateOptions options = TfLiteQnnDelegateOptionsDefault();
@@ -118,6 +403,23 @@ static EI_IMPULSE_ERROR get_interpreter(ei_learning_block_config_tflite_graph_t
             ei_printf("ERROR: ModifyGraphWithDelegate (GPU) failed\n");
             return EI_IMPULSE_TFLITE_ERROR;
         }
+#elif EI_CLASSIFIER_USE_XNNPACK_DELEGATE==1
+        if (runtime_options.use_xnnpack) {
+            TfLiteXNNPackDelegateOptions xnnpack_options = TfLiteXNNPackDelegateOptionsDefault();
+            xnnpack_options.num_threads = num_threads;
+            xnnpack_options.weight_cache_file_path = runtime_options.xnnpack_weight_cache_path;
+
+            new_state->xnnpack_delegate = tflite::Interpreter::TfLiteDelegatePtr(
+                TfLiteXNNPackDelegateCreate(&xnnpack_options), TfLiteXNNPackDelegateDelete);
+            if (!new_state->xnnpack_delegate) {
+                ei_printf("ERROR: Failed to create XNNPACK delegate\n");
+                return EI_IMPULSE_TFLITE_ERROR;
+            }
+            if (new_state->interpreter->ModifyGraphWithDelegate(new_state->xnnpack_delegate.get()) != kTfLiteOk) {
+                ei_printf("ERROR: ModifyGraphWithDelegate (XNNPACK) failed\n");
+                return EI_IMPULSE_TFLITE_ERROR;
+            }
+        }
 #endif
 
         if (new_state->interpreter->AllocateTensors() != kTfLiteOk) {
@@ -125,36 +427,283 @@ static EI_IMPULSE_ERROR get_interpreter(ei_learning_block_config_tflite_graph_t
             return EI_IMPULSE_TFLITE_ERROR;
         }
 
-        int hw_thread_count = (int)std::thread::hardware_concurrency();
-        hw_thread_count -= 1; // leave one thread free for the other application
-        if (hw_thread_count < 1) {
-            hw_thread_count = 1;
+        ei_tflite_instances.insert(std::make_pair(key, new_state.release()));
+    }
+
+    *state = ei_tflite_instances[key];
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * Free the interpreters created for an impulse handle (called from run_classifier_deinit)
+ */
+__attribute__((unused)) static void ei_tflite_release_instances(const void *handle) {
+    std::lock_guard<std::mutex> lock(ei_tflite_instances_mutex);
+
+    ei_tflite_runtime_options.erase(handle);
+
+    for (auto it = ei_tflite_instances.begin(); it != ei_tflite_instances.end(); ) {
+        if (it->first.first == handle) {
+            delete it->second;
+            it = ei_tflite_instances.erase(it);
         }
+        else {
+            ++it;
+        }
+    }
+}
 
-        if (new_state->interpreter->SetNumThreads(hw_thread_count) != kTfLiteOk) {
-            ei_printf("SetNumThreads failed\n");
+/**
+ * Resize the first dimension of the input tensor (the batch) and re-allocate the tensors.
+ * Fails (and restores a batch of 1) when the graph has the batch baked in, e.g. in a Reshape.
+ */
+static EI_IMPULSE_ERROR ei_tflite_set_batch_size(ei_tflite_state_t *state, int batch_size) {
+    if (state->batch_size == batch_size) {
+        return EI_IMPULSE_OK;
+    }
+
+    tflite::Interpreter *interpreter = state->interpreter.get();
+    TfLiteTensor *input = interpreter->input_tensor(0);
+    if (!input) {
+        return EI_IMPULSE_INPUT_TENSOR_WAS_NULL;
+    }
+    if (input->dims->size < 1 || input->dims->data[0] != state->batch_size) {
+        return EI_IMPULSE_UNSUPPORTED_INFERENCING_ENGINE;
+    }
+
+    std::vector<int> dims(input->dims->data, input->dims->data + input->dims->size);
+    dims[0] = batch_size;
+    if (interpreter->ResizeInputTensor(interpreter->inputs()[0], dims) != kTfLiteOk ||
+        interpreter->AllocateTensors() != kTfLiteOk) {
+        EI_LOGD("Model does not support a batch size of %d\n", batch_size);
+        dims[0] = 1;
+        interpreter->ResizeInputTensor(interpreter->inputs()[0], dims);
+        if (interpreter->AllocateTensors() != kTfLiteOk) {
+            ei_printf("AllocateTensors failed\n");
             return EI_IMPULSE_TFLITE_ERROR;
         }
+        state->batch_size = 1;
+        return EI_IMPULSE_UNSUPPORTED_INFERENCING_ENGINE;
+    }
+
+    state->batch_size = batch_size;
+    return EI_IMPULSE_OK;
+}
 
-        ei_tflite_instances.insert(std::make_pair(block_config->block_id, new_state));
+/**
+ * Copy row batch_ix (of batch_size) of every output tensor of a learn block into raw_outputs
+ */
+static EI_IMPULSE_ERROR fill_raw_outputs_from_tensors(
+    tflite::Interpreter *interpreter,
+    ei_learning_block_config_tflite_graph_t *block_config,
+    uint32_t learn_block_index,
+    ei_feature_t *raw_outputs,
+    size_t batch_ix,
+    size_t batch_size)
+{
+    for (uint32_t output_ix = 0; output_ix < block_config->output_tensors_size; output_ix++) {
+        TfLiteTensor* output_tensor = interpreter->output_tensor(block_config->output_tensors_indices[output_ix]);
+        if (output_tensor == nullptr) {
+            return EI_IMPULSE_OUTPUT_TENSOR_WAS_NULL;
+        }
+
+        // view on a single row of the (batched) tensor, so the helpers below can use bytes as-is
+        TfLiteTensor row = *output_tensor;
+        row.bytes = output_tensor->bytes / batch_size;
+        row.data.raw = output_tensor->data.raw + (row.bytes * batch_ix);
+        TfLiteTensor *output = &row;
+
+        // calculate the size of the output by iterating through dims
+        size_t output_size = 1;
+        for (int dim_num = 0; dim_num < output->dims->size; dim_num++) {
+            output_size *= output->dims->data[dim_num];
+        }
+        output_size /= batch_size;
+
+        ei_feature_t *raw_output = &raw_outputs[learn_block_index + output_ix];
+        switch (output->type) {
+            case kTfLiteFloat32: {
+                get_raw_output_matrix(raw_output, raw_output->matrix, output_size);
+                memcpy(raw_output->matrix->buffer, output->data.f, output->bytes);
+                break;
+            }
+            case kTfLiteInt8: {
+                if (block_config->dequantize_output) {
+                    get_raw_output_matrix(raw_output, raw_output->matrix, output_size);
+                    fill_output_matrix_from_tensor(output, raw_output->matrix);
+                }
+                else {
+                    get_raw_output_matrix(raw_output, raw_output->matrix_i8, output_size);
+                    memcpy(raw_output->matrix_i8->buffer, output->data.int8, output->bytes);
+                }
+                break;
+            }
+            case kTfLiteUInt8: {
+                if (block_config->dequantize_output) {
+                    get_raw_output_matrix(raw_output, raw_output->matrix, output_size);
+                    fill_output_matrix_from_tensor(output, raw_output->matrix);
+                }
+                else {
+                    get_raw_output_matrix(raw_output, raw_output->matrix_u8, output_size);
+                    memcpy(raw_output->matrix_u8->buffer, output->data.uint8, output->bytes);
+                }
+                break;
+            }
+            default: {
+                ei_printf("ERR: Cannot handle output type (%d)\n", output->type);
+                return EI_IMPULSE_OUTPUT_TENSOR_WAS_NULL;
+            }
+        }
+
+        raw_outputs[learn_block_index + output_ix].blockId = block_config->block_id + output_ix;
     }
 
-    auto tflite_state = ei_tflite_instances[block_config->block_id];
-    *interpreter = tflite_state->interpreter.get();
     return EI_IMPULSE_OK;
 }
 
+/**
+ * Float32 input buffer of the interpreter for a learn block of an impulse handle (builds the
+ * interpreter if needed), so a DSP block can write its features straight into the input tensor.
+ * The buffer moves when the tensors are re-allocated, so look it up again for every inference.
+ *
+ * @return nullptr if the input isn't float32 or doesn't hold exactly n_features values
+ */
+__attribute__((unused)) static float* ei_tflite_get_input_buffer(const void *handle,
+                                                                  ei_learning_block_config_tflite_graph_t *block_config,
+                                                                  size_t n_features) {
+    ei_tflite_state_t *tflite_state;
+    if (get_interpreter(handle, block_config, &tflite_state) != EI_IMPULSE_OK ||
+        ei_tflite_set_batch_size(tflite_state, 1) != EI_IMPULSE_OK) {
+        return nullptr;
+    }
+
+    TfLiteTensor *input = tflite_state->interpreter->input_tensor(0);
+    if (!input || input->type != kTfLiteFloat32 || input->bytes != n_features * sizeof(float)) {
+        return nullptr;
+    }
+    return input->data.f;
+}
+
+/**
+ * Set the runtime options for the interpreters of an impulse handle (see run_classifier_init()).
+ * Interpreters that were built already are freed, so they're rebuilt with the new options.
+ */
+__attribute__((unused)) static void ei_tflite_set_runtime_options(const void *handle, const ei_tflite_runtime_options_t *options) {
+    ei_tflite_release_instances(handle);
+
+    std::lock_guard<std::mutex> lock(ei_tflite_instances_mutex);
+    ei_tflite_runtime_options[handle] = *options;
+}
+
+#if EIDSP_PROFILING == 1
+/**
+ * Append the op timings of the interpreters of an impulse handle (built with enable_profiling).
+ * With several learn blocks the op names are prefixed with the block id.
+ */
+__attribute__((unused)) static void ei_tflite_get_op_profile(const void *handle, std::vector<ei_profiler_entry_t> *ops) {
+    std::lock_guard<std::mutex> lock(ei_tflite_instances_mutex);
+
+    size_t instance_count = 0;
+    for (auto &it : ei_tflite_instances) {
+        if (it.first.first == handle && it.second->profiler) {
+            instance_count++;
+        }
+    }
+
+    for (auto &it : ei_tflite_instances) {
+        if (it.first.first != handle || !it.second->profiler) {
+            continue;
+        }
+        std::string prefix = instance_count > 1 ? std::to_string(it.first.second) + "/" : "";
+        it.second->profiler->get_ops(prefix, ops);
+    }
+}
+
+/**
+ * Clear the op timings of the interpreters of an impulse handle
+ */
+__attribute__((unused)) static void ei_tflite_reset_op_profile(const void *handle) {
+    std::lock_guard<std::mutex> lock(ei_tflite_instances_mutex);
+
+    for (auto &it : ei_tflite_instances) {
+        if (it.first.first == handle && it.second->profiler) {
+            it.second->profiler->reset();
+        }
+    }
+}
+
+/**
+ * Make sure the interpreters of an impulse handle are built with a profiler. Interpreters that
+ * kept their profiler from an earlier ei_tflite_disable_op_profiling() get it back in place,
+ * others are rebuilt on the next inference.
+ */
+__attribute__((unused)) static void ei_tflite_enable_op_profiling(const void *handle) {
+    ei_tflite_runtime_options_t options = EI_TFLITE_RUNTIME_OPTIONS_DEFAULT;
+    bool all_have_profiler = true;
+    {
+        std::lock_guard<std::mutex> lock(ei_tflite_instances_mutex);
+        if (ei_tflite_runtime_options.count(handle)) {
+            options = ei_tflite_runtime_options[handle];
+        }
+        if (options.enable_profiling) {
+            return;
+        }
+        options.enable_profiling = true;
+
+        for (auto &it : ei_tflite_instances) {
+            if (it.first.first == handle && !it.second->profiler) {
+                all_have_profiler = false;
+            }
+        }
+        if (all_have_profiler) {
+            for (auto &it : ei_tflite_instances) {
+                if (it.first.first == handle) {
+                    it.second->interpreter->SetProfiler(it.second->profiler.get());
+                    it.second->profiler->set_active(true);
+                }
+            }
+            ei_tflite_runtime_options[handle] = options;
+            return;
+        }
+    }
+    ei_tflite_set_runtime_options(handle, &options);
+}
+
+/**
+ * Undo ei_tflite_enable_op_profiling(): clear enable_profiling and take the profiler off the
+ * interpreters of an impulse handle. The profilers are kept (inactive) so their timings can
+ * still be read, and the interpreters aren't rebuilt.
+ */
+__attribute__((unused)) static void ei_tflite_disable_op_profiling(const void *handle) {
+    std::lock_guard<std::mutex> lock(ei_tflite_instances_mutex);
+
+    if (ei_tflite_runtime_options.count(handle)) {
+        ei_tflite_runtime_options[handle].enable_profiling = false;
+    }
+    for (auto &it : ei_tflite_instances) {
+        if (it.first.first == handle && it.second->profiler) {
+            it.second->profiler->set_active(false);
+            it.second->interpreter->SetProfiler(nullptr);
+        }
+    }
+}
+#endif // EIDSP_PROFILING == 1
+
 extern "C" EI_IMPULSE_ERROR run_nn_inference_from_dsp(
     ei_learning_block_config_tflite_graph_t *block_config,
     signal_t *signal,
     matrix_t *output_matrix)
 {
-    tflite::Interpreter *interpreter;
-    auto interpreter_ret = get_interpreter(block_config, &interpreter);
+    ei_tflite_state_t *tflite_state;
+    auto interpreter_ret = get_interpreter(nullptr, block_config, &tflite_state);
     if (interpreter_ret != EI_IMPULSE_OK) {
         return interpreter_ret;
     }
 
+    // this interpreter is shared between all handles
+    std::lock_guard<std::mutex> lock(tflite_state->invoke_mutex);
+    tflite::Interpreter *interpreter = tflite_state->interpreter.get();
+
     TfLiteTensor *input = interpreter->input_tensor(0);
     TfLiteTensor *output = interpreter->output_tensor(0);
 
@@ -198,33 +747,36 @@ EI_IMPULSE_ERROR run_nn_inference(
 {
     ei_learning_block_config_tflite_graph_t *block_config = (ei_learning_block_config_tflite_graph_t*)config_ptr;
 
-    tflite::Interpreter *interpreter;
-    auto interpreter_ret = get_interpreter(block_config, &interpreter);
+    ei_tflite_state_t *tflite_state;
+    auto interpreter_ret = get_interpreter(result->_handle, block_config, &tflite_state);
     if (interpreter_ret != EI_IMPULSE_OK) {
         return interpreter_ret;
     }
-
-    TfLiteTensor* input = nullptr;
-    TfLiteTensor** outputs = nullptr;
-
-    // allocate outputs
-    outputs = (TfLiteTensor**)ei_malloc(block_config->output_tensors_size * sizeof(TfLiteTensor*));
+    // no-op unless run_nn_inference_batch() resized the input before
+    interpreter_ret = ei_tflite_set_batch_size(tflite_state, 1);
+    if (interpreter_ret != EI_IMPULSE_OK) {
+        return interpreter_ret;
+    }
+    tflite::Interpreter *interpreter = tflite_state->interpreter.get();
 
     // Obtain pointers to the model's input and output tensors.
-    input = interpreter->input_tensor(0);
+    // (output tensors are looked up by index again after Invoke, no need to keep an array around)
+    TfLiteTensor* input = interpreter->input_tensor(0);
 
     for (uint8_t i = 0; i < block_config->output_tensors_size; i++) {
-        outputs[i] = interpreter->output_tensor(block_config->output_tensors_indices[i]);
-        if (&outputs[i] == nullptr) {
+        TfLiteTensor* output = interpreter->output_tensor(block_config->output_tensors_indices[i]);
+        if (output == nullptr) {
             return EI_IMPULSE_OUTPUT_TENSOR_WAS_NULL;
         }
-        memset(outputs[i]->data.raw, 0, outputs[i]->bytes);
+        memset(output->data.raw, 0, output->bytes);
     }
 
     if (!input) {
         return EI_IMPULSE_INPUT_TENSOR_WAS_NULL;
     }
 
+    ei_tflite_pin_thread(tflite_state->cpu_affinity_mask);
+
     uint64_t ctx_start_us = ei_read_timer_us();
 
     auto input_res = fill_input_tensor_from_matrix(fmatrix,
@@ -248,56 +800,112 @@ EI_IMPULSE_ERROR run_nn_inference(
 
     result->timing.classification_us = ctx_end_us - ctx_start_us;
 
-    for (uint32_t output_ix = 0; output_ix < block_config->output_tensors_size; output_ix++) {
-        TfLiteTensor* output = outputs[output_ix];
-        // calculate the size of the output by iterating through dims
-        size_t output_size = 1;
-        for (int dim_num = 0; dim_num < output->dims->size; dim_num++) {
-            output_size *= output->dims->data[dim_num];
+    auto output_res = fill_raw_outputs_from_tensors(interpreter, block_config, learn_block_index, result->_raw_outputs, 0, 1);
+    if (output_res != EI_IMPULSE_OK) {
+        return output_res;
+    }
+
+    EI_LOGD("Predictions (time: %d ms.):\n", result->timing.classification);
+
+    // on Linux we're not worried about free'ing (for now)
+
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * Run a learn block over batch_size samples with a single Invoke().
+ * The input tensor is resized to batch_size (kept between calls), get_features(ix) runs the DSP
+ * for sample ix, then every row of the outputs is copied into results[ix]._raw_outputs and
+ * handed to process_output(ix).
+ *
+ * @return EI_IMPULSE_UNSUPPORTED_INFERENCING_ENGINE (before any DSP ran) if the model can't be
+ *         batched, callers should fall back to one inference per sample.
+ */
+EI_IMPULSE_ERROR run_nn_inference_batch(
+    const ei_impulse_t *impulse,
+    size_t batch_size,
+    uint32_t learn_block_index,
+    uint32_t* input_block_ids,
+    uint32_t input_block_ids_size,
+    ei_impulse_result_t *results,
+    void *config_ptr,
+    std::function<EI_IMPULSE_ERROR(size_t ix, ei_feature_t **fmatrix)> get_features,
+    std::function<EI_IMPULSE_ERROR(size_t ix)> process_output)
+{
+    ei_learning_block_config_tflite_graph_t *block_config = (ei_learning_block_config_tflite_graph_t*)config_ptr;
+
+    ei_tflite_state_t *tflite_state;
+    auto interpreter_ret = get_interpreter(results[0]._handle, block_config, &tflite_state);
+    if (interpreter_ret != EI_IMPULSE_OK) {
+        return interpreter_ret;
+    }
+    interpreter_ret = ei_tflite_set_batch_size(tflite_state, (int)batch_size);
+    if (interpreter_ret != EI_IMPULSE_OK) {
+        return interpreter_ret;
+    }
+    tflite::Interpreter *interpreter = tflite_state->interpreter.get();
+
+    TfLiteTensor* input = interpreter->input_tensor(0);
+    if (!input) {
+        return EI_IMPULSE_INPUT_TENSOR_WAS_NULL;
+    }
+
+    ei_tflite_pin_thread(tflite_state->cpu_affinity_mask);
+
+    uint64_t ctx_us = 0;
+
+    for (size_t ix = 0; ix < batch_size; ix++) {
+        ei_feature_t *fmatrix;
+        EI_IMPULSE_ERROR res = get_features(ix, &fmatrix);
+        if (res != EI_IMPULSE_OK) {
+            return res;
         }
 
-        switch (output->type) {
-            case kTfLiteFloat32: {
-                result->_raw_outputs[learn_block_index + output_ix].matrix = new matrix_t(1, output_size);
-                memcpy(result->_raw_outputs[learn_block_index + output_ix].matrix->buffer, output->data.f, output->bytes);
-                break;
-            }
-            case kTfLiteInt8: {
-                if (block_config->dequantize_output) {
-                    result->_raw_outputs[learn_block_index + output_ix].matrix = new matrix_t(1, output_size);
-                    fill_output_matrix_from_tensor(output, result->_raw_outputs[learn_block_index + output_ix].matrix);
-                }
-                else {
-                    result->_raw_outputs[learn_block_index + output_ix].matrix_i8 = new matrix_i8_t(1, output_size);
-                    memcpy(result->_raw_outputs[learn_block_index + output_ix].matrix_i8->buffer, output->data.int8, output->bytes);
-                }
-                break;
-            }
-            case kTfLiteUInt8: {
-                if (block_config->dequantize_output) {
-                    result->_raw_outputs[learn_block_index + output_ix].matrix = new matrix_t(1, output_size);
-                    fill_output_matrix_from_tensor(output, result->_raw_outputs[learn_block_index + output_ix].matrix);
-                }
-                else {
-                    result->_raw_outputs[learn_block_index + output_ix].matrix_u8 = new matrix_u8_t(1, output_size);
-                    memcpy(result->_raw_outputs[learn_block_index + output_ix].matrix_u8->buffer, output->data.uint8, output->bytes);
-                }
-                break;
-            }
-            default: {
-                ei_printf("ERR: Cannot handle output type (%d)\n", output->type);
-                return EI_IMPULSE_OUTPUT_TENSOR_WAS_NULL;
-            }
+        uint64_t ctx_start_us = ei_read_timer_us();
+
+        TfLiteTensor row = *input;
+        row.bytes = input->bytes / batch_size;
+        row.data.raw = input->data.raw + (row.bytes * ix);
+
+        res = fill_input_tensor_from_matrix(fmatrix,
+                                            results[ix]._raw_outputs,
+                                            &row,
+                                            input_block_ids,
+                                            input_block_ids_size,
+                                            impulse->dsp_blocks_size,
+                                            impulse->learning_blocks_size);
+        if (res != EI_IMPULSE_OK) {
+            return res;
         }
 
-        result->_raw_outputs[learn_block_index + output_ix].blockId = block_config->block_id + output_ix;
+        ctx_us += ei_read_timer_us() - ctx_start_us;
     }
 
-    EI_LOGD("Predictions (time: %d ms.):\n", result->timing.classification);
+    uint64_t ctx_start_us = ei_read_timer_us();
 
-    ei_free(outputs);
+    TfLiteStatus status = interpreter->Invoke();
+    if (status != kTfLiteOk) {
+        ei_printf("ERR: interpreter->Invoke() failed with %d\n", status);
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
 
-    // on Linux we're not worried about free'ing (for now)
+    ctx_us += ei_read_timer_us() - ctx_start_us;
+
+    for (size_t ix = 0; ix < batch_size; ix++) {
+        // the batch shares one Invoke(), so split its time evenly
+        results[ix].timing.classification_us = ctx_us / batch_size;
+
+        EI_IMPULSE_ERROR res = fill_raw_outputs_from_tensors(interpreter, block_config, learn_block_index,
+            results[ix]._raw_outputs, ix, batch_size);
+        if (res != EI_IMPULSE_OK) {
+            return res;
+        }
+
+        res = process_output(ix);
+        if (res != EI_IMPULSE_OK) {
+            return res;
+        }
+    }
 
     return EI_IMPULSE_OK;
 }
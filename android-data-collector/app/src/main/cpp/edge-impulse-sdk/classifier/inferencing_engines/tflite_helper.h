@@ -35,7 +35,9 @@
 #ifndef _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_HELPER_H_
 #define _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_HELPER_H_
 
+#include <string.h>
 #include "edge-impulse-sdk/classifier/ei_quantize.h"
+#include "edge-impulse-sdk/dsp/ei_memory_accounting.h"
 #if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL) || (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) || (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TENSORRT) || (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_TIDL)
 
 #if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL) || (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_TIDL)
@@ -63,6 +65,7 @@ EI_IMPULSE_ERROR fill_input_tensor_from_matrix(
     size_t fmtx_size,
     size_t omtx_size
 ) {
+    EI_MEMORY_STAGE(EI_MEMORY_STAGE_INPUT);
     size_t matrix_els = 0;
     uint32_t input_idx = 0;
 
@@ -81,28 +84,29 @@ EI_IMPULSE_ERROR fill_input_tensor_from_matrix(
         ei::matrix_t* matrix = fmatrix[0].matrix;
 #endif
 
-        matrix_els += matrix->rows * matrix->cols;
+        const size_t els = matrix->rows * matrix->cols;
+        matrix_els += els;
 
         switch (input->type) {
             case kTfLiteFloat32: {
-                for (size_t ix = 0; ix < matrix->rows * matrix->cols; ix++) {
-                    input->data.f[input_idx++] = matrix->buffer[ix];
+                if (input->bytes < (input_idx + els) * sizeof(float)) {
+                    break; // reported by the size check below
                 }
-                break;
-            }
-            case kTfLiteInt8: {
-                for (size_t ix = 0; ix < matrix->rows * matrix->cols; ix++) {
-                    float val = (float)matrix->buffer[ix];
-                    input->data.int8[input_idx++] = static_cast<int8_t>(
-                        pre_cast_quantize(val, input->params.scale, input->params.zero_point, true));
+                // the DSP block may have written straight into the tensor already (see process_impulse())
+                if (matrix->buffer != input->data.f + input_idx) {
+                    memcpy(input->data.f + input_idx, matrix->buffer, els * sizeof(float));
                 }
+                input_idx += els;
                 break;
             }
+            case kTfLiteInt8:
             case kTfLiteUInt8: {
-                for (size_t ix = 0; ix < matrix->rows * matrix->cols; ix++) {
-                    float val = (float)matrix->buffer[ix];
-                    input->data.uint8[input_idx++] = static_cast<uint8_t>(
-                        pre_cast_quantize(val, input->params.scale, input->params.zero_point, false));            }
+                if (input->bytes < input_idx + els) {
+                    break; // reported by the size check below
+                }
+                pre_cast_quantize_buffer(matrix->buffer, els, input->params.scale, input->params.zero_point,
+                    input->type == kTfLiteInt8, input->data.uint8 + input_idx);
+                input_idx += els;
                 break;
             }
             default: {
@@ -125,6 +129,7 @@ EI_IMPULSE_ERROR fill_input_tensor_from_signal(
     signal_t *signal,
     TfLiteTensor *input
 ) {
+    EI_MEMORY_STAGE(EI_MEMORY_STAGE_INPUT);
     switch (input->type) {
         case kTfLiteFloat32: {
             if (input->bytes / 4 != signal->total_length) {
@@ -296,5 +301,26 @@ EI_IMPULSE_ERROR fill_output_matrix_from_tensor(
     return EI_IMPULSE_OK;
 }
 
+/**
+ * Get a (1, output_size) matrix for a raw output. If the impulse state keeps the raw outputs
+ * between inferences (EI_CLASSIFIER_REUSE_RAW_OUTPUTS) the matrix from the previous inference
+ * is reused, otherwise a new one is allocated (and freed again in run_postprocessing).
+ * matrix is the member of raw_output's union for T (matrix, matrix_i8 or matrix_u8).
+ */
+template <typename T>
+T* get_raw_output_matrix(ei_feature_t *raw_output, T *&matrix, size_t output_size) {
+    EI_MEMORY_STAGE(EI_MEMORY_STAGE_RESULTS);
+#if EI_CLASSIFIER_REUSE_RAW_OUTPUTS == 1
+    if (matrix && raw_output->matrix_type == ei_feature_matrix_type(matrix) &&
+            matrix->buffer && matrix->rows == 1 && matrix->cols == output_size) {
+        return matrix;
+    }
+    raw_output->free_matrix();
+#endif // EI_CLASSIFIER_REUSE_RAW_OUTPUTS == 1
+    matrix = new T(1, output_size);
+    raw_output->matrix_type = ei_feature_matrix_type(matrix);
+    return matrix;
+}
+
 #endif // #if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL) || (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE)
 #endif // _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_HELPER_H_
@@ -44,6 +44,7 @@
 #include "edge-impulse-sdk/tensorflow/lite/micro/micro_interpreter.h"
 #include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated.h"
 #include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated_full.h"
+#include "edge-impulse-sdk/tensorflow/lite/schema/schema_utils.h"
 #include "edge-impulse-sdk/classifier/ei_aligned_malloc.h"
 #include "edge-impulse-sdk/classifier/ei_model_types.h"
 #include "edge-impulse-sdk/classifier/inferencing_engines/tflite_helper.h"
@@ -89,33 +90,109 @@
 #endif
 
 /**
- * Setup the TFLite runtime
+ * Keep the prepared interpreter (and its arena) of every learn block in the impulse handle
+ * between inferences, instead of building it on every call. They're freed by
+ * run_classifier_deinit(handle). Costs the arenas of all learn blocks at once rather than the
+ * largest one. Not used with EI_CLASSIFIER_ALLOCATION_STATIC (the static arena is shared by
+ * all graphs) or for graphs that keep state between invocations (variable tensors).
+ */
+#ifndef EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER
+#define EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER     1
+#endif
+
+#if EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER == 1 && !defined(EI_CLASSIFIER_ALLOCATION_STATIC)
+#define EI_TFLITE_MICRO_KEEP_INTERPRETER                1
+#else
+#define EI_TFLITE_MICRO_KEEP_INTERPRETER                0
+#endif
+
+/**
+ * Interpreter with its tensors allocated, plus the arena (and profiler) it uses
+ */
+typedef struct {
+    tflite::MicroInterpreter *interpreter;
+    void *profiler; // tflite::MicroProfiler, only with EI_CLASSIFIER_ENABLE_PROFILER
+    ei_unique_ptr_t tensor_arena;
+} ei_tflite_micro_state_t;
+
+/**
+ * Free an interpreter from inference_tflite_setup()
+ */
+static void inference_tflite_free(void *ptr) {
+    ei_tflite_micro_state_t *micro_state = (ei_tflite_micro_state_t*)ptr;
+    if (micro_state == nullptr) {
+        return;
+    }
+    delete micro_state->interpreter;
+#ifdef EI_CLASSIFIER_ENABLE_PROFILER
+    delete (tflite::MicroProfiler*)micro_state->profiler;
+#endif
+    // releases the arena after the interpreter that points into it
+    delete micro_state;
+}
+
+/**
+ * Whether the graph keeps state between invocations (variable tensors or resource variables),
+ * these start from a fresh interpreter on every inference
+ */
+static bool inference_tflite_is_stateful(const tflite::Model *model) {
+    const auto *subgraphs = model->subgraphs();
+    for (size_t ix = 0; subgraphs != nullptr && ix < subgraphs->size(); ix++) {
+        const auto *tensors = subgraphs->Get(ix)->tensors();
+        for (size_t jx = 0; tensors != nullptr && jx < tensors->size(); jx++) {
+            if (tensors->Get(jx)->is_variable()) {
+                return true;
+            }
+        }
+    }
+
+    const auto *operator_codes = model->operator_codes();
+    for (size_t ix = 0; operator_codes != nullptr && ix < operator_codes->size(); ix++) {
+        switch (tflite::GetBuiltinCode(operator_codes->Get(ix))) {
+            case tflite::BuiltinOperator_VAR_HANDLE:
+            case tflite::BuiltinOperator_ASSIGN_VARIABLE:
+            case tflite::BuiltinOperator_READ_VARIABLE:
+            case tflite::BuiltinOperator_CALL_ONCE:
+                return true;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+/**
+ * Setup the TFLite runtime: allocate the arena, build the interpreter and allocate its tensors
  *
- * @param      ctx_start_us       Pointer to the start time
- * @param      input              Pointer to input tensor
- * @param      output             Pointer to output tensor
- * @param      micro_interpreter  Pointer to interpreter (for non-compiled models)
- * @param      micro_tensor_arena Pointer to the arena that will be allocated
+ * @param      block_config       Graph to load
+ * @param      micro_state        Set to the new interpreter, free with inference_tflite_free()
+ * @param      is_stateful        Set if the graph keeps state between invocations
  *
  * @return  EI_IMPULSE_OK if successful
  */
 static EI_IMPULSE_ERROR inference_tflite_setup(
     ei_learning_block_config_tflite_graph_t *block_config,
-    uint64_t *ctx_start_us,
-    TfLiteTensor** input,
-    TfLiteTensor** outputs,
-    tflite::MicroInterpreter** micro_interpreter,
-    ei_unique_ptr_t& p_tensor_arena,
-    void** micro_profiler) {
-
-    *ctx_start_us = ei_read_timer_us();
+    ei_tflite_micro_state_t **micro_state,
+    bool *is_stateful) {
 
+    EI_MEMORY_STAGE(EI_MEMORY_STAGE_ARENA);
     ei_config_tflite_graph_t *graph_config = (ei_config_tflite_graph_t*)block_config->graph_config;
 
+    // Map the model into a usable data structure. This doesn't involve any
+    // copying or parsing, it's a very lightweight operation.
+    const tflite::Model* model = tflite::GetModel(graph_config->model);
+    if (model->version() != TFLITE_SCHEMA_VERSION) {
+        ei_printf(
+            "Model provided is schema version %d not equal "
+            "to supported version %d.",
+            model->version(), TFLITE_SCHEMA_VERSION);
+        return EI_IMPULSE_TFLITE_ERROR;
+    }
+
 #ifdef EI_CLASSIFIER_ALLOCATION_STATIC
     // Assign a no-op lambda to the "free" function in case of static arena
     static uint8_t tensor_arena[EI_CLASSIFIER_TFLITE_LARGEST_ARENA_SIZE] ALIGN(16) DEFINE_SECTION(STRINGIZE_VALUE_OF(EI_TENSOR_ARENA_LOCATION));
-    p_tensor_arena = ei_unique_ptr_t(tensor_arena, [](void*){});
+    ei_unique_ptr_t p_tensor_arena(tensor_arena, [](void*){});
 #else
     // Create an area of memory to use for input, output, and intermediate arrays.
     uint8_t *tensor_arena = (uint8_t*)ei_aligned_calloc(16, graph_config->arena_size);
@@ -123,79 +200,95 @@ static EI_IMPULSE_ERROR inference_tflite_setup(
         ei_printf("Failed to allocate TFLite arena (%zu bytes)\n", graph_config->arena_size);
         return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
     }
-    p_tensor_arena = ei_unique_ptr_t(tensor_arena, ei_aligned_free);
+    ei_unique_ptr_t p_tensor_arena(tensor_arena, ei_aligned_free);
 #endif
 
-    static bool tflite_first_run = true;
-    static uint8_t *model_arr = NULL;
-
-    if (model_arr != graph_config->model) {
-        tflite_first_run = true;
-        model_arr = (uint8_t*)graph_config->model;
-    }
-
-    static const tflite::Model* model = nullptr;
-
-    // ======
-    // Initialization code start
-    // This part can be run once, but that would require the TFLite arena
-    // to be allocated at all times, which is not ideal (e.g. when doing MFCC)
-    // ======
-    if (tflite_first_run) {
-        // Map the model into a usable data structure. This doesn't involve any
-        // copying or parsing, it's a very lightweight operation.
-        model = tflite::GetModel(graph_config->model);
-        if (model->version() != TFLITE_SCHEMA_VERSION) {
-            ei_printf(
-                "Model provided is schema version %d not equal "
-                "to supported version %d.",
-                model->version(), TFLITE_SCHEMA_VERSION);
-            return EI_IMPULSE_TFLITE_ERROR;
-        }
-        tflite_first_run = false;
-    }
-
 #ifdef EI_TFLITE_RESOLVER
     EI_TFLITE_RESOLVER
 #else
     static tflite::AllOpsResolver resolver; // needs static to match the life of the interpreter
 #endif
 
+    ei_tflite_micro_state_t *new_state = new ei_tflite_micro_state_t { nullptr, nullptr, std::move(p_tensor_arena) };
+    if (new_state == nullptr) {
+        return EI_IMPULSE_OUT_OF_MEMORY;
+    }
+
     // Build an interpreter to run the model with.
     // only create profiler when enabled
 #ifdef EI_CLASSIFIER_ENABLE_PROFILER
     tflite::MicroProfiler *profiler = new tflite::MicroProfiler;
+    new_state->profiler = (void*)profiler;
 
-    tflite::MicroInterpreter *interpreter = new tflite::MicroInterpreter(
+    new_state->interpreter = new tflite::MicroInterpreter(
         model, resolver, tensor_arena, graph_config->arena_size, nullptr, profiler);
-
-    *micro_profiler = (void*)profiler;
 #else
-    tflite::MicroInterpreter *interpreter = new tflite::MicroInterpreter(
+    new_state->interpreter = new tflite::MicroInterpreter(
         model, resolver, tensor_arena, graph_config->arena_size, nullptr, nullptr);
-
-    micro_profiler = nullptr;
 #endif
 
-    *micro_interpreter = interpreter;
-
     // Allocate memory from the tensor_arena for the model's tensors.
-    TfLiteStatus allocate_status = interpreter->AllocateTensors(true);
+    TfLiteStatus allocate_status = new_state->interpreter->AllocateTensors(true);
     if (allocate_status != kTfLiteOk) {
         ei_printf("AllocateTensors() failed");
+        inference_tflite_free(new_state);
         return EI_IMPULSE_TFLITE_ERROR;
     }
 
-    // Obtain pointers to the model's input and output tensors.
-    *input = interpreter->input(0);
-    for (uint8_t i = 0; i < block_config->output_tensors_size; i++) {
-        outputs[i] = interpreter->output(block_config->output_tensors_indices[i]);
+    *is_stateful = inference_tflite_is_stateful(model);
+    *micro_state = new_state;
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * Get a prepared interpreter for a learn block. With EI_CLASSIFIER_TFLITE_PERSISTENT_INTERPRETER
+ * it's built on the first inference and then kept in the impulse handle. Otherwise (also without
+ * a handle, or for stateful graphs) it's only for this inference and *is_temp is set, free it with
+ * inference_tflite_free() when done.
+ *
+ * @param      handle             Impulse handle (result->_handle), can be nullptr
+ * @param      learn_block_index  Index of the learn block in the impulse
+ * @param      block_config       Graph of the learn block
+ * @param      micro_state        Set to the interpreter
+ * @param      is_temp            Set if the caller needs to free the interpreter
+ *
+ * @return  EI_IMPULSE_OK if successful
+ */
+static EI_IMPULSE_ERROR inference_tflite_get_state(
+    ei_impulse_handle_t *handle,
+    uint32_t learn_block_index,
+    ei_learning_block_config_tflite_graph_t *block_config,
+    ei_tflite_micro_state_t **micro_state,
+    bool *is_temp) {
+
+#if EI_TFLITE_MICRO_KEEP_INTERPRETER
+    if (handle != nullptr) {
+        ei_tflite_micro_state_t *kept_state =
+            (ei_tflite_micro_state_t*)handle->state.get_learning_block_state(learn_block_index);
+        if (kept_state != nullptr) {
+            *micro_state = kept_state;
+            *is_temp = false;
+            return EI_IMPULSE_OK;
+        }
     }
+#else
+    (void)handle;
+    (void)learn_block_index;
+#endif
 
-    if (tflite_first_run) {
-        tflite_first_run = false;
+    bool is_stateful = false;
+    EI_IMPULSE_ERROR init_res = inference_tflite_setup(block_config, micro_state, &is_stateful);
+    if (init_res != EI_IMPULSE_OK) {
+        return init_res;
     }
 
+    *is_temp = true;
+#if EI_TFLITE_MICRO_KEEP_INTERPRETER
+    if (handle != nullptr && !is_stateful &&
+        handle->state.set_learning_block_state(learn_block_index, *micro_state, inference_tflite_free)) {
+        *is_temp = false;
+    }
+#endif
     return EI_IMPULSE_OK;
 }
 
@@ -203,11 +296,9 @@ static EI_IMPULSE_ERROR inference_tflite_setup(
  * Run TFLite model
  *
  * @param   ctx_start_us    Start time of the setup function (see above)
- * @param   output          Output tensor
  * @param   interpreter     TFLite interpreter (non-compiled models)
- * @param   tensor_arena    Allocated arena (will be freed)
  * @param   result          Struct for results
- * @param   debug           Whether to print debug info
+ * @param   micro_profiler  Profiler (only with EI_CLASSIFIER_ENABLE_PROFILER)
  *
  * @return  EI_IMPULSE_OK if successful
  */
@@ -220,7 +311,6 @@ static EI_IMPULSE_ERROR inference_tflite_run(
     // Run inference, and report any error
     TfLiteStatus invoke_status = interpreter->Invoke();
     if (invoke_status != kTfLiteOk) {
-        delete interpreter;
         ei_printf("Invoke failed (%d)\n", invoke_status);
         return EI_IMPULSE_TFLITE_ERROR;
     }
@@ -241,6 +331,11 @@ static EI_IMPULSE_ERROR inference_tflite_run(
     ei_printf("Profiling per OP group\n");
     profiler->LogTicksPerTagCsv();
     ei_printf("\n");
+
+    // the profiler lives as long as the interpreter, start over for the next inference
+    profiler->ClearEvents();
+#else
+    (void)micro_profiler;
 #endif
 
     if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
@@ -250,6 +345,68 @@ static EI_IMPULSE_ERROR inference_tflite_run(
     return EI_IMPULSE_OK;
 }
 
+/**
+ * Copy the output tensors of a learn block into result->_raw_outputs
+ *
+ * @return  EI_IMPULSE_OK if successful
+ */
+static EI_IMPULSE_ERROR inference_tflite_fill_raw_outputs(
+    tflite::MicroInterpreter* interpreter,
+    ei_learning_block_config_tflite_graph_t *block_config,
+    uint32_t learn_block_index,
+    ei_impulse_result_t *result) {
+
+    for (uint32_t output_ix = 0; output_ix < block_config->output_tensors_size; output_ix++) {
+        TfLiteTensor *output = interpreter->output(block_config->output_tensors_indices[output_ix]);
+        if (output == nullptr) {
+            return EI_IMPULSE_OUTPUT_TENSOR_WAS_NULL;
+        }
+        // calculate the size of the output by iterating through dims
+        size_t output_size = 1;
+        for (int dim_num = 0; dim_num < output->dims->size; dim_num++) {
+            output_size *= output->dims->data[dim_num];
+        }
+
+        ei_feature_t *raw_output = &result->_raw_outputs[learn_block_index + output_ix];
+        switch (output->type) {
+            case kTfLiteFloat32: {
+                get_raw_output_matrix(raw_output, raw_output->matrix, output_size);
+                memcpy(raw_output->matrix->buffer, output->data.f, output->bytes);
+                break;
+            }
+            case kTfLiteInt8: {
+                if (block_config->dequantize_output) {
+                    get_raw_output_matrix(raw_output, raw_output->matrix, output_size);
+                    fill_output_matrix_from_tensor(output, raw_output->matrix);
+                }
+                else {
+                    get_raw_output_matrix(raw_output, raw_output->matrix_i8, output_size);
+                    memcpy(raw_output->matrix_i8->buffer, output->data.int8, output->bytes);
+                }
+                break;
+            }
+            case kTfLiteUInt8: {
+                if (block_config->dequantize_output) {
+                    get_raw_output_matrix(raw_output, raw_output->matrix, output_size);
+                    fill_output_matrix_from_tensor(output, raw_output->matrix);
+                }
+                else {
+                    get_raw_output_matrix(raw_output, raw_output->matrix_u8, output_size);
+                    memcpy(raw_output->matrix_u8->buffer, output->data.uint8, output->bytes);
+                }
+                break;
+            }
+            default: {
+                ei_printf("ERR: Cannot handle output type (%d)\n", output->type);
+                return EI_IMPULSE_OUTPUT_TENSOR_WAS_NULL;
+            }
+        }
+
+        result->_raw_outputs[learn_block_index + output_ix].blockId = block_config->block_id + output_ix;
+    }
+
+    return EI_IMPULSE_OK;
+}
 
 /**
  * @brief      Do neural network inferencing over a signal (from the DSP)
@@ -265,53 +422,31 @@ EI_IMPULSE_ERROR run_nn_inference_from_dsp(
     signal_t *signal,
     matrix_t *output_matrix)
 {
-    TfLiteTensor* input = nullptr; // will be owned by TFLite
-    TfLiteTensor** outputs = (TfLiteTensor**)ei_malloc(block_config->output_tensors_size * sizeof(TfLiteTensor*));
-
-    uint64_t ctx_start_us = ei_read_timer_us();
-    ei_unique_ptr_t p_tensor_arena(nullptr, ei_aligned_free);
-
-    tflite::MicroInterpreter* interpreter;
-#ifdef EI_CLASSIFIER_ENABLE_PROFILER
-    tflite::MicroProfiler* profiler;
-#else
-    void* profiler = nullptr;
-#endif
-
-    EI_IMPULSE_ERROR init_res = inference_tflite_setup(
-        block_config,
-        &ctx_start_us,
-        &input,
-        outputs,
-        &interpreter,
-        p_tensor_arena,
-        (void**)&profiler);
-
+    // DSP blocks have no handle, so the interpreter is built for this call only
+    ei_tflite_micro_state_t *micro_state;
+    bool is_stateful;
+    EI_IMPULSE_ERROR init_res = inference_tflite_setup(block_config, &micro_state, &is_stateful);
     if (init_res != EI_IMPULSE_OK) {
         return init_res;
     }
-
-    auto input_res = fill_input_tensor_from_signal(signal, input);
-    if (input_res != EI_IMPULSE_OK) {
-        return input_res;
-    }
-
-    // Run inference, and report any error
-    TfLiteStatus invoke_status = interpreter->Invoke();
-    if (invoke_status != kTfLiteOk) {
-        ei_printf("Invoke failed (%d)\n", invoke_status);
-        return EI_IMPULSE_TFLITE_ERROR;
+    tflite::MicroInterpreter *interpreter = micro_state->interpreter;
+
+    EI_IMPULSE_ERROR res = fill_input_tensor_from_signal(signal, interpreter->input(0));
+    if (res == EI_IMPULSE_OK) {
+        // Run inference, and report any error
+        TfLiteStatus invoke_status = interpreter->Invoke();
+        if (invoke_status != kTfLiteOk) {
+            ei_printf("Invoke failed (%d)\n", invoke_status);
+            res = EI_IMPULSE_TFLITE_ERROR;
+        }
     }
-
-    auto output_res = fill_output_matrix_from_tensor(outputs[0], output_matrix);
-    if (output_res != EI_IMPULSE_OK) {
-        return output_res;
+    if (res == EI_IMPULSE_OK) {
+        res = fill_output_matrix_from_tensor(interpreter->output(block_config->output_tensors_indices[0]), output_matrix);
     }
 
-    delete interpreter;
-    ei_free(outputs);
+    inference_tflite_free(micro_state);
 
-    return EI_IMPULSE_OK;
+    return res;
 }
 
 /**
@@ -335,102 +470,47 @@ EI_IMPULSE_ERROR run_nn_inference(
 {
     ei_learning_block_config_tflite_graph_t *block_config = (ei_learning_block_config_tflite_graph_t*)config_ptr;
 
-    TfLiteTensor* input = nullptr; // will be owned by TFLite
-    TfLiteTensor** outputs = (TfLiteTensor**)ei_malloc(block_config->output_tensors_size * sizeof(TfLiteTensor*));
-
     uint64_t ctx_start_us = ei_read_timer_us();
-    ei_unique_ptr_t p_tensor_arena(nullptr, ei_aligned_free);
 
-    tflite::MicroInterpreter* interpreter;
-#ifdef EI_CLASSIFIER_ENABLE_PROFILER
-    tflite::MicroProfiler* profiler;
-#else
-    void* profiler = nullptr;
-#endif
-
-    EI_IMPULSE_ERROR init_res = inference_tflite_setup(
+    ei_tflite_micro_state_t *micro_state;
+    bool is_temp;
+    EI_IMPULSE_ERROR res = inference_tflite_get_state(
+        (ei_impulse_handle_t*)result->_handle,
+        learn_block_index,
         block_config,
-        &ctx_start_us,
-        &input,
-        outputs,
-        &interpreter,
-        p_tensor_arena,
-        (void**)&profiler);
-
-    if (init_res != EI_IMPULSE_OK) {
-        return init_res;
+        &micro_state,
+        &is_temp);
+    if (res != EI_IMPULSE_OK) {
+        return res;
     }
-
-    auto input_res = fill_input_tensor_from_matrix(fmatrix,
-                                                   result->_raw_outputs,
-                                                   input,
-                                                   input_block_ids,
-                                                   input_block_ids_size,
-                                                   impulse->dsp_blocks_size,
-                                                   impulse->learning_blocks_size);
-    if (input_res != EI_IMPULSE_OK) {
-        return input_res;
+    tflite::MicroInterpreter *interpreter = micro_state->interpreter;
+
+    res = fill_input_tensor_from_matrix(fmatrix,
+                                        result->_raw_outputs,
+                                        interpreter->input(0),
+                                        input_block_ids,
+                                        input_block_ids_size,
+                                        impulse->dsp_blocks_size,
+                                        impulse->learning_blocks_size);
+    if (res == EI_IMPULSE_OK) {
+        res = inference_tflite_run(
+            ctx_start_us,
+            interpreter,
+            result,
+            micro_state->profiler);
     }
-
-    EI_IMPULSE_ERROR run_res = inference_tflite_run(
-        ctx_start_us,
-        interpreter,
-        result,
-        profiler);
-
-    for (uint32_t output_ix = 0; output_ix < block_config->output_tensors_size; output_ix++) {
-        TfLiteTensor *output = outputs[output_ix];
-        // calculate the size of the output by iterating through dims
-        size_t output_size = 1;
-        for (int dim_num = 0; dim_num < output->dims->size; dim_num++) {
-            output_size *= output->dims->data[dim_num];
-        }
-
-        switch (output->type) {
-            case kTfLiteFloat32: {
-                result->_raw_outputs[learn_block_index + output_ix].matrix = new matrix_t(1, output_size);
-                memcpy(result->_raw_outputs[learn_block_index + output_ix].matrix->buffer, output->data.f, output->bytes);
-                break;
-            }
-            case kTfLiteInt8: {
-                if (block_config->dequantize_output) {
-                    result->_raw_outputs[learn_block_index + output_ix].matrix = new matrix_t(1, output_size);
-                    fill_output_matrix_from_tensor(output, result->_raw_outputs[learn_block_index + output_ix].matrix);
-                }
-                else {
-                    result->_raw_outputs[learn_block_index + output_ix].matrix_i8 = new matrix_i8_t(1, output_size);
-                    memcpy(result->_raw_outputs[learn_block_index + output_ix].matrix_i8->buffer, output->data.int8, output->bytes);
-                }
-                break;
-            }
-            case kTfLiteUInt8: {
-                if (block_config->dequantize_output) {
-                    result->_raw_outputs[learn_block_index + output_ix].matrix = new matrix_t(1, output_size);
-                    fill_output_matrix_from_tensor(output, result->_raw_outputs[learn_block_index + output_ix].matrix);
-                }
-                else {
-                    result->_raw_outputs[learn_block_index + output_ix].matrix_u8 = new matrix_u8_t(1, output_size);
-                    memcpy(result->_raw_outputs[learn_block_index + output_ix].matrix_u8->buffer, output->data.uint8, output->bytes);
-                }
-                break;
-            }
-            default: {
-                ei_printf("ERR: Cannot handle output type (%d)\n", output->type);
-                return EI_IMPULSE_OUTPUT_TENSOR_WAS_NULL;
-            }
+    if (res == EI_IMPULSE_OK || res == EI_IMPULSE_CANCELED) {
+        EI_IMPULSE_ERROR output_res = inference_tflite_fill_raw_outputs(interpreter, block_config, learn_block_index, result);
+        if (output_res != EI_IMPULSE_OK) {
+            res = output_res;
         }
-
-        result->_raw_outputs[learn_block_index + output_ix].blockId = block_config->block_id + output_ix;
     }
 
-    delete interpreter;
-    ei_free(outputs);
-
-    if (run_res != EI_IMPULSE_OK) {
-        return run_res;
+    if (is_temp) {
+        inference_tflite_free(micro_state);
     }
 
-    return EI_IMPULSE_OK;
+    return res;
 }
 
 #if EI_CLASSIFIER_QUANTIZATION_ENABLED == 1
@@ -449,126 +529,71 @@ EI_IMPULSE_ERROR run_nn_inference_image_quantized(
 {
     ei_learning_block_config_tflite_graph_t *block_config = (ei_learning_block_config_tflite_graph_t*)config_ptr;
 
-    uint64_t ctx_start_us;
-
-    TfLiteTensor* input = nullptr; // will be owned by TFLite
-    TfLiteTensor** outputs = (TfLiteTensor**)ei_malloc(block_config->output_tensors_size * sizeof(TfLiteTensor*));
-
-    ei_unique_ptr_t p_tensor_arena(nullptr, ei_aligned_free);
-
-    tflite::MicroInterpreter* interpreter;
-#ifdef EI_CLASSIFIER_ENABLE_PROFILER
-    tflite::MicroProfiler* profiler;
-#else
-    void* profiler = nullptr;
-#endif
-
-    EI_IMPULSE_ERROR init_res = inference_tflite_setup(
+    ei_tflite_micro_state_t *micro_state;
+    bool is_temp;
+    EI_IMPULSE_ERROR res = inference_tflite_get_state(
+        (ei_impulse_handle_t*)result->_handle,
+        learn_block_index,
         block_config,
-        &ctx_start_us,
-        &input,
-        outputs,
-        &interpreter,
-        p_tensor_arena,
-        (void**)&profiler);
-
-    if (init_res != EI_IMPULSE_OK) {
-        return init_res;
+        &micro_state,
+        &is_temp);
+    if (res != EI_IMPULSE_OK) {
+        return res;
     }
+    tflite::MicroInterpreter *interpreter = micro_state->interpreter;
+    TfLiteTensor *input = interpreter->input(0);
 
     if (input->type != TfLiteType::kTfLiteInt8 && input->type != TfLiteType::kTfLiteUInt8) {
-        return EI_IMPULSE_ONLY_SUPPORTED_FOR_IMAGES;
+        res = EI_IMPULSE_ONLY_SUPPORTED_FOR_IMAGES;
     }
 
-    uint64_t dsp_start_us = ei_read_timer_us();
-
-    // features matrix maps around the input tensor to not allocate any memory
-    ei::matrix_i8_t features_matrix(1, impulse->nn_input_frame_size, input->data.int8);
-
-    // run DSP process and quantize automatically
-    int ret = extract_image_features_quantized(signal, &features_matrix, impulse->dsp_blocks[0].config, input->params.scale, input->params.zero_point,
-        impulse->frequency, impulse->learning_blocks[0].image_scaling);
-    if (ret != EIDSP_OK) {
-        ei_printf("ERR: Failed to run DSP process (%d)\n", ret);
-        return EI_IMPULSE_DSP_ERROR;
-    }
+    if (res == EI_IMPULSE_OK) {
+        uint64_t dsp_start_us = ei_read_timer_us();
 
-    if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
-        return EI_IMPULSE_CANCELED;
-    }
+        // features matrix maps around the input tensor to not allocate any memory
+        ei::matrix_i8_t features_matrix(1, impulse->nn_input_frame_size, input->data.int8);
 
-    result->timing.dsp_us = ei_read_timer_us() - dsp_start_us;
+        // run DSP process and quantize automatically
+        int ret = extract_image_features_quantized(signal, &features_matrix, impulse->dsp_blocks[0].config, input->params.scale, input->params.zero_point,
+            impulse->frequency, impulse->learning_blocks[0].image_scaling);
+        if (ret != EIDSP_OK) {
+            ei_printf("ERR: Failed to run DSP process (%d)\n", ret);
+            res = EI_IMPULSE_DSP_ERROR;
+        }
+        else if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
+            res = EI_IMPULSE_CANCELED;
+        }
+        else {
+            result->timing.dsp_us = ei_read_timer_us() - dsp_start_us;
 
 #if EI_LOG_LEVEL == EI_LOG_LEVEL_DEBUG
-    ei_printf("Features (%d ms.): ", result->timing.dsp);
-    for (size_t ix = 0; ix < features_matrix.cols; ix++) {
-        ei_printf_float((features_matrix.buffer[ix] - input->params.zero_point) * input->params.scale);
-        ei_printf(" ");
-    }
-    ei_printf("\n");
+            ei_printf("Features (%d ms.): ", result->timing.dsp);
+            for (size_t ix = 0; ix < features_matrix.cols; ix++) {
+                ei_printf_float((features_matrix.buffer[ix] - input->params.zero_point) * input->params.scale);
+                ei_printf(" ");
+            }
+            ei_printf("\n");
 #endif
 
-    ctx_start_us = ei_read_timer_us();
-
-    EI_IMPULSE_ERROR run_res = inference_tflite_run(
-        ctx_start_us,
-        interpreter,
-        result,
-        profiler);
-
-    for (uint32_t output_ix = 0; output_ix < block_config->output_tensors_size; output_ix++) {
-        TfLiteTensor* output = outputs[output_ix];
-        // calculate the size of the output by iterating through dims
-        size_t output_size = 1;
-        for (int dim_num = 0; dim_num < output->dims->size; dim_num++) {
-            output_size *= output->dims->data[dim_num];
-        }
-
-        switch (output->type) {
-            case kTfLiteFloat32: {
-                result->_raw_outputs[learn_block_index + output_ix].matrix = new matrix_t(1, output_size);
-                memcpy(result->_raw_outputs[learn_block_index + output_ix].matrix->buffer, output->data.f, output->bytes);
-                break;
-            }
-            case kTfLiteInt8: {
-                if (block_config->dequantize_output) {
-                    result->_raw_outputs[learn_block_index + output_ix].matrix = new matrix_t(1, output_size);
-                    fill_output_matrix_from_tensor(output, result->_raw_outputs[learn_block_index + output_ix].matrix);
-                }
-                else {
-                    result->_raw_outputs[learn_block_index + output_ix].matrix_i8 = new matrix_i8_t(1, output_size);
-                    memcpy(result->_raw_outputs[learn_block_index + output_ix].matrix_i8->buffer, output->data.int8, output->bytes);
-                }
-                break;
-            }
-            case kTfLiteUInt8: {
-                if (block_config->dequantize_output) {
-                    result->_raw_outputs[learn_block_index + output_ix].matrix = new matrix_t(1, output_size);
-                    fill_output_matrix_from_tensor(output, result->_raw_outputs[learn_block_index + output_ix].matrix);
+            res = inference_tflite_run(
+                ei_read_timer_us(),
+                interpreter,
+                result,
+                micro_state->profiler);
+            if (res == EI_IMPULSE_OK || res == EI_IMPULSE_CANCELED) {
+                EI_IMPULSE_ERROR output_res = inference_tflite_fill_raw_outputs(interpreter, block_config, learn_block_index, result);
+                if (output_res != EI_IMPULSE_OK) {
+                    res = output_res;
                 }
-                else {
-                    result->_raw_outputs[learn_block_index + output_ix].matrix_u8 = new matrix_u8_t(1, output_size);
-                    memcpy(result->_raw_outputs[learn_block_index + output_ix].matrix_u8->buffer, output->data.uint8, output->bytes);
-                }
-                break;
-            }
-            default: {
-                ei_printf("ERR: Cannot handle output type (%d)\n", output->type);
-                return EI_IMPULSE_OUTPUT_TENSOR_WAS_NULL;
             }
         }
-
-        result->_raw_outputs[learn_block_index + output_ix].blockId = block_config->block_id + output_ix;
     }
 
-    delete interpreter;
-    ei_free(outputs);
-
-    if (run_res != EI_IMPULSE_OK) {
-        return run_res;
+    if (is_temp) {
+        inference_tflite_free(micro_state);
     }
 
-    return EI_IMPULSE_OK;
+    return res;
 }
 #endif // EI_CLASSIFIER_QUANTIZATION_ENABLED == 1
 
@@ -108,8 +108,190 @@ public:
         return matches;
     }
 
+    /**
+     * Set the detections for the next align() calls. Their corners, areas and centroids are
+     * only computed once, so aligning several sets of traces against the same detections
+     * (e.g. last observations and predictions) shares that work.
+     */
+    void set_detections(const ei_impulse_result_bounding_box_t *detections, size_t detection_count) {
+        det_count = detection_count;
+        det_x0.resize(det_count);
+        det_y0.resize(det_count);
+        det_x1.resize(det_count);
+        det_y1.resize(det_count);
+        det_area.resize(det_count);
+        det_cx.resize(det_count);
+        det_cy.resize(det_count);
+        for (size_t ix = 0; ix < det_count; ix++) {
+            const ei_impulse_result_bounding_box_t &d = detections[ix];
+            det_x0[ix] = d.x;
+            det_y0[ix] = d.y;
+            det_x1[ix] = d.x + d.width;
+            det_y1[ix] = d.y + d.height;
+            det_area[ix] = d.width * d.height;
+            det_cx[ix] = d.x + d.width / 2.0f;
+            det_cy[ix] = d.y + d.height / 2.0f;
+        }
+    }
+
+    /**
+     * Align traces to the detections passed to set_detections(), same matches as align() but
+     * without allocating once the buffers have grown.
+     *
+     * With IoU costs only overlapping pairs are plausible: a pair that doesn't overlap costs 1 and
+     * can't match, so it doesn't change which overlapping pairs the optimal assignment picks.
+     * The assignment is therefore solved per group of traces and detections that are connected
+     * by overlaps, which keeps every LSAP solve small in crowded scenes. Distance costs have no
+     * such bound, those are solved over all pairs.
+     *
+     * @param match  per trace, index of the matched detection or -1
+     * @param value  per trace, IoU (or distance) of the match
+     * @return sum of the values of all matches
+     */
+    float align(const ei_impulse_result_bounding_box_t *traces, size_t trace_count, int *match, float *value) {
+        for (size_t ix = 0; ix < trace_count; ix++) {
+            match[ix] = -1;
+            value[ix] = 0.0f;
+        }
+        if (trace_count == 0 || det_count == 0) {
+            return 0.0f;
+        }
+
+        const size_t nr = trace_count, nc = det_count;
+        pair_cost.resize(nr * nc);
+        for (size_t r = 0; r < nr; r++) {
+            const ei_impulse_result_bounding_box_t &tr = traces[r];
+            float *row = &pair_cost[r * nc];
+            if (use_iou) {
+                // same math as intersection_over_union()
+                const uint32_t t_x1 = tr.x + tr.width, t_y1 = tr.y + tr.height, t_area = tr.width * tr.height;
+                for (size_t c = 0; c < nc; c++) {
+                    uint32_t x_left = std::max(tr.x, det_x0[c]);
+                    uint32_t y_top = std::max(tr.y, det_y0[c]);
+                    uint32_t x_right = std::min(t_x1, det_x1[c]);
+                    uint32_t y_bottom = std::min(t_y1, det_y1[c]);
+                    float iou = 0.0f;
+                    if (!(x_right < x_left || y_bottom < y_top)) {
+                        uint32_t intersection_area = (x_right - x_left) * (y_bottom - y_top);
+                        iou = static_cast<float>(intersection_area) /
+                            static_cast<float>(t_area + det_area[c] - intersection_area);
+                    }
+                    row[c] = 1 - iou;
+                }
+            }
+            else {
+                // same math as centroid_euclidean_distance()
+                const float x1 = tr.x + tr.width / 2.0f, y1 = tr.y + tr.height / 2.0f;
+                for (size_t c = 0; c < nc; c++) {
+                    row[c] = std::sqrt(std::pow(x1 - det_cx[c], 2) + std::pow(y1 - det_cy[c], 2));
+                }
+            }
+        }
+
+        // group traces (nodes 0..nr) and detections (nodes nr..nr+nc) connected by plausible pairs
+        group.resize(nr + nc);
+        for (size_t ix = 0; ix < nr + nc; ix++) {
+            group[ix] = (int)ix;
+        }
+        for (size_t r = 0; r < nr; r++) {
+            for (size_t c = 0; c < nc; c++) {
+                // with distances everything is one group
+                if (!use_iou || pair_cost[r * nc + c] < 1.0f) {
+                    int gr = find_group((int)r), gc = find_group((int)(nr + c));
+                    if (gr != gc) {
+                        group[std::max(gr, gc)] = std::min(gr, gc);
+                    }
+                }
+            }
+        }
+
+        // bucket the nodes per group, in order (so traces before detections, both ascending)
+        group_start.assign(nr + nc + 1, 0);
+        for (size_t ix = 0; ix < nr + nc; ix++) {
+            group_start[find_group((int)ix) + 1]++;
+        }
+        for (size_t ix = 0; ix < nr + nc; ix++) {
+            group_start[ix + 1] += group_start[ix];
+        }
+        group_nodes.resize(nr + nc);
+        group_fill.assign(group_start.begin(), group_start.end() - 1);
+        for (size_t ix = 0; ix < nr + nc; ix++) {
+            group_nodes[group_fill[group[ix]]++] = (int)ix;
+        }
+
+        for (size_t g = 0; g < nr + nc; g++) {
+            const int *nodes = &group_nodes[group_start[g]];
+            const int node_count = group_start[g + 1] - group_start[g];
+            int rows = 0;
+            while (rows < node_count && nodes[rows] < (int)nr) {
+                rows++;
+            }
+            const int cols = node_count - rows;
+            if (rows == 0 || cols == 0) {
+                continue;
+            }
+
+            sub_cost.resize(rows * cols);
+            for (int i = 0; i < rows; i++) {
+                for (int j = 0; j < cols; j++) {
+                    sub_cost[i * cols + j] = pair_cost[nodes[i] * nc + (nodes[rows + j] - nr)];
+                }
+            }
+
+            alignments_a.resize(rows);
+            alignments_b.resize(cols);
+            solve(rows, cols, sub_cost.data(), false, alignments_a.data(), alignments_b.data(), &lsap);
+
+            const int num_iterations = std::min(rows, cols);
+            for (int i = 0; i < num_iterations; i++) {
+                const int trace_idx = nodes[alignments_a[i]];
+                const int detection_idx = nodes[rows + alignments_b[i]] - (int)nr;
+                const double cost = sub_cost[alignments_a[i] * cols + alignments_b[i]];
+
+                if (use_iou) {
+                    float iou = 1 - cost;
+                    if (iou > threshold) {
+                        match[trace_idx] = detection_idx;
+                        value[trace_idx] = iou;
+                    }
+                } else {
+                    if (cost < threshold) {
+                        match[trace_idx] = detection_idx;
+                        value[trace_idx] = cost;
+                    }
+                }
+            }
+        }
+
+        float total = 0;
+        for (size_t ix = 0; ix < trace_count; ix++) {
+            total += value[ix];
+        }
+        return total;
+    }
+
     float threshold;
     bool use_iou;
+
+private:
+    int find_group(int ix) {
+        while (group[ix] != ix) {
+            group[ix] = group[group[ix]];
+            ix = group[ix];
+        }
+        return ix;
+    }
+
+    // detections, see set_detections()
+    size_t det_count = 0;
+    std::vector<uint32_t> det_x0, det_y0, det_x1, det_y1, det_area;
+    std::vector<float> det_cx, det_cy;
+    // scratch for align(), kept between calls
+    std::vector<float> pair_cost;
+    std::vector<double> sub_cost;
+    std::vector<int> group, group_start, group_fill, group_nodes;
+    std::vector<int64_t> alignments_a, alignments_b;
+    rectangular_lsap_workspace lsap;
 };
 
 class GreedyAlignment {
@@ -127,8 +127,26 @@ augmenting_path(intptr_t nc, double *cost, std::vector<double>& u,
     return sink;
 }
 
+/**
+ * Scratch for solve(). The vectors keep their capacity, so solving with the same workspace
+ * again doesn't allocate unless the problem got bigger.
+ */
+struct rectangular_lsap_workspace {
+    std::vector<double> temp;
+    std::vector<double> u;
+    std::vector<double> v;
+    std::vector<double> shortestPathCosts;
+    std::vector<intptr_t> path;
+    std::vector<intptr_t> col4row;
+    std::vector<intptr_t> row4col;
+    std::vector<bool> SR;
+    std::vector<bool> SC;
+    std::vector<intptr_t> remaining;
+    std::vector<intptr_t> order;
+};
+
 static int solve(intptr_t nr, intptr_t nc, double* cost, bool maximize,
-                 int64_t* a, int64_t* b) {
+                 int64_t* a, int64_t* b, rectangular_lsap_workspace *ws) {
     // handle trivial inputs
     if (nr == 0 || nc == 0) {
         return 0;
@@ -138,7 +156,7 @@ static int solve(intptr_t nr, intptr_t nc, double* cost, bool maximize,
     bool transpose = nc < nr;
 
     // make a copy of the cost matrix if we need to modify it
-    std::vector<double> temp;
+    std::vector<double>& temp = ws->temp;
     if (transpose || maximize) {
         temp.resize(nr * nc);
 
@@ -173,15 +191,24 @@ static int solve(intptr_t nr, intptr_t nc, double* cost, bool maximize,
     }
 
     // initialize variables
-    std::vector<double> u(nr, 0);
-    std::vector<double> v(nc, 0);
-    std::vector<double> shortestPathCosts(nc);
-    std::vector<intptr_t> path(nc, -1);
-    std::vector<intptr_t> col4row(nr, -1);
-    std::vector<intptr_t> row4col(nc, -1);
-    std::vector<bool> SR(nr);
-    std::vector<bool> SC(nc);
-    std::vector<intptr_t> remaining(nc);
+    std::vector<double>& u = ws->u;
+    std::vector<double>& v = ws->v;
+    std::vector<double>& shortestPathCosts = ws->shortestPathCosts;
+    std::vector<intptr_t>& path = ws->path;
+    std::vector<intptr_t>& col4row = ws->col4row;
+    std::vector<intptr_t>& row4col = ws->row4col;
+    std::vector<bool>& SR = ws->SR;
+    std::vector<bool>& SC = ws->SC;
+    std::vector<intptr_t>& remaining = ws->remaining;
+    u.assign(nr, 0);
+    v.assign(nc, 0);
+    shortestPathCosts.assign(nc, 0);
+    path.assign(nc, -1);
+    col4row.assign(nr, -1);
+    row4col.assign(nc, -1);
+    SR.assign(nr, false);
+    SC.assign(nc, false);
+    remaining.assign(nc, 0);
 
     // iteratively build the solution
     for (intptr_t curRow = 0; curRow < nr; curRow++) {
@@ -221,8 +248,13 @@ static int solve(intptr_t nr, intptr_t nc, double* cost, bool maximize,
     }
 
     if (transpose) {
+        std::vector<intptr_t>& order = ws->order;
+        order.resize(col4row.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&col4row](intptr_t i, intptr_t j)
+                  {return col4row[i] < col4row[j];});
         intptr_t i = 0;
-        for (auto v: argsort_iter(col4row)) {
+        for (auto v: order) {
             a[i] = col4row[v];
             b[i] = v;
             i++;
@@ -238,6 +270,12 @@ static int solve(intptr_t nr, intptr_t nc, double* cost, bool maximize,
     return 0;
 }
 
+static int solve(intptr_t nr, intptr_t nc, double* cost, bool maximize,
+                 int64_t* a, int64_t* b) {
+    rectangular_lsap_workspace ws;
+    return solve(nr, nc, cost, maximize, a, b, &ws);
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
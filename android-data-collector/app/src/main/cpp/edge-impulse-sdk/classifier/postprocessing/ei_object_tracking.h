@@ -46,6 +46,7 @@
 extern ei_impulse_handle_t & ei_default_impulse;
 
 #include <vector>
+#include <new>
 #include "tinyEKF/tinyekf.hpp"
 #include "alignment/ei_alignment.hpp"
 
@@ -55,6 +56,12 @@ float clip(float num, float min_val = -3.4028235e+38, float max_val = 3.4028235e
 
 #if EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
 
+// Maximum number of traces that are open at the same time, detections that would
+// open more traces are not tracked until traces close
+#ifndef EI_CLASSIFIER_OBJECT_TRACKING_MAX_TRACES
+#define EI_CLASSIFIER_OBJECT_TRACKING_MAX_TRACES    128
+#endif
+
 typedef struct {
     float keep_grace;
 } ei_obj_tracking_params_t;
@@ -81,104 +88,166 @@ private:
     float ema_value;
 };
 
-class Trace {
+/**
+ * Pool of traces. Everything is kept in flat arrays indexed by slot, allocated once up front:
+ * the filter state is stored inline (all filters share one TinyEKFModel) and only the last two
+ * observations are kept, which is all the tracker needs. Opening a trace takes a free slot and
+ * closing it returns the slot, so tracking doesn't allocate per frame or per trace.
+ */
+class TracePool {
 public:
-    Trace(int id, int t, const ei_impulse_result_bounding_box_t& initial_bbox, uint32_t max_observations = 5)
-        : id(id), last_ground_truth_update_t(t), last_prediction(initial_bbox), max_observations(max_observations) {
-        if (max_observations < 2) {
+    TracePool(size_t capacity) : capacity(0), free_count(0), buffer(nullptr) {
+        size_t bytes = capacity * (sizeof(ei_impulse_result_bounding_box_t) * 3 +
+            sizeof(ExponentialMovingAverage) * 4 +
+            sizeof(float) * (8 + 16 + 8 + 16 + 1) +
+            sizeof(uint32_t) * 3 + sizeof(uint16_t) * 2 + sizeof(int));
+        buffer = (uint8_t*)ei_malloc(bytes);
+        if (!buffer) {
+            EI_LOGE("TracePool: failed to allocate %d traces\n", (int)capacity);
+            return;
+        }
+
+        // largest alignment first
+        uint8_t *ptr = buffer;
+        last_prediction = (ei_impulse_result_bounding_box_t*)ptr; ptr += sizeof(ei_impulse_result_bounding_box_t) * capacity;
+        observations = (ei_impulse_result_bounding_box_t*)ptr; ptr += sizeof(ei_impulse_result_bounding_box_t) * capacity * 2;
+        emas = (ExponentialMovingAverage*)ptr; ptr += sizeof(ExponentialMovingAverage) * capacity * 4;
+        centroid_x = (float*)ptr; ptr += sizeof(float) * capacity * 8;
+        centroid_P = (float*)ptr; ptr += sizeof(float) * capacity * 16;
+        width_height_x = (float*)ptr; ptr += sizeof(float) * capacity * 8;
+        width_height_P = (float*)ptr; ptr += sizeof(float) * capacity * 16;
+        trace_score = (float*)ptr; ptr += sizeof(float) * capacity;
+        id = (uint32_t*)ptr; ptr += sizeof(uint32_t) * capacity;
+        last_ground_truth_update_t = (uint32_t*)ptr; ptr += sizeof(uint32_t) * capacity;
+        max_observations = (uint32_t*)ptr; ptr += sizeof(uint32_t) * capacity;
+        free_slots = (int*)ptr; ptr += sizeof(int) * capacity;
+        observation_count = (uint16_t*)ptr; ptr += sizeof(uint16_t) * capacity;
+
+        this->capacity = capacity;
+        // hand out the low slots first
+        for (size_t ix = 0; ix < capacity; ix++) {
+            free_slots[ix] = (int)(capacity - 1 - ix);
+        }
+        free_count = capacity;
+    }
+
+    ~TracePool() {
+        ei_free(buffer);
+    }
+
+    /**
+     * Open a new trace
+     * @returns the slot of the trace, or -1 if the pool is full
+     */
+    int open(uint32_t trace_id, uint32_t t, const ei_impulse_result_bounding_box_t& initial_bbox, uint32_t max_obs = 5) {
+        if (free_count == 0) {
+            return -1;
+        }
+        if (max_obs < 2) {
             EI_LOGE("%s", "max_observations needs to be at least 2 for counting");
         }
 
-        trace_label = initial_bbox.label;
-        trace_score = initial_bbox.value;
-        observations.push_back(initial_bbox);
+        int slot = free_slots[--free_count];
+
+        id[slot] = trace_id;
+        last_ground_truth_update_t[slot] = t;
+        last_prediction[slot] = initial_bbox;
+        max_observations[slot] = max_obs;
+        trace_score[slot] = initial_bbox.value;
+        observations[slot * 2 + 1] = initial_bbox;
+        observation_count[slot] = 1;
+
         float initial_centroid[2] = { initial_bbox.x + static_cast<float>(initial_bbox.width) / 2,
                                       initial_bbox.y + static_cast<float>(initial_bbox.height) / 2 };
 
         float initial_width_height[2] = { static_cast<float>(initial_bbox.width),
                                           static_cast<float>(initial_bbox.height) };
 
-        centroid_filter = new TinyEKF(initial_centroid, 8, 2);
-        width_height_filter = new TinyEKF(initial_width_height, 8, 2);
+        filter.init(initial_centroid, &centroid_x[slot * 8], &centroid_P[slot * 16]);
+        filter.init(initial_width_height, &width_height_x[slot * 8], &width_height_P[slot * 16]);
 
         // Use x0, y0, x1, y1 for EMAs
-        xyxy_emas[0] = new ExponentialMovingAverage(this->max_observations);
-        xyxy_emas[1] = new ExponentialMovingAverage(this->max_observations);
-        xyxy_emas[2] = new ExponentialMovingAverage(this->max_observations);
-        xyxy_emas[3] = new ExponentialMovingAverage(this->max_observations);
+        for (int ix = 0; ix < 4; ix++) {
+            new (&emas[slot * 4 + ix]) ExponentialMovingAverage(max_obs);
+        }
+
+        return slot;
+    }
+
+    void close(int slot) {
+        free_slots[free_count++] = slot;
     }
 
-    ~Trace() {
-        delete centroid_filter;
-        delete width_height_filter;
-        delete xyxy_emas[0];
-        delete xyxy_emas[1];
-        delete xyxy_emas[2];
-        delete xyxy_emas[3];
+    bool full() const {
+        return free_count == 0;
     }
 
-    ei_impulse_result_bounding_box_t predict() {
-        fx_centroid[0] = centroid_filter->x[0];
-        fx_centroid[1] = centroid_filter->x[1];
-        fx_width_height[0] = width_height_filter->x[0];
-        fx_width_height[1] = width_height_filter->x[1];
+    ei_impulse_result_bounding_box_t predict(int slot) {
+        float *c_x = &centroid_x[slot * 8];
+        float *wh_x = &width_height_x[slot * 8];
 
-        centroid_filter->predict(fx_centroid);
-        width_height_filter->predict(fx_width_height);
+        filter.predict(c_x, &centroid_P[slot * 16]);
+        filter.predict(wh_x, &width_height_P[slot * 16]);
 
         ei_impulse_result_bounding_box_t p_bbox = {"", 0, 0, 0, 0, 0.0};
-        p_bbox.label = trace_label;
-        p_bbox.value = trace_score;
-        p_bbox.x = round(clip((centroid_filter->x[0] - width_height_filter->x[0] / 2), 0));
-        p_bbox.y = round(clip(centroid_filter->x[1] - width_height_filter->x[1] / 2, 0));
-        p_bbox.width = round(clip(width_height_filter->x[0], 0));
-        p_bbox.height = round(clip(width_height_filter->x[1], 0));
-        last_prediction = p_bbox;
-        EI_LOGD("predict %d %d %d %d %f\n", last_prediction.x, last_prediction.y, last_prediction.width, last_prediction.height, last_prediction.value);
-        return last_prediction;
+        p_bbox.label = last_prediction[slot].label;
+        p_bbox.value = trace_score[slot];
+        p_bbox.x = round(clip((c_x[0] - wh_x[0] / 2), 0));
+        p_bbox.y = round(clip(c_x[1] - wh_x[1] / 2, 0));
+        p_bbox.width = round(clip(wh_x[0], 0));
+        p_bbox.height = round(clip(wh_x[1], 0));
+        last_prediction[slot] = p_bbox;
+        EI_LOGD("predict %d %d %d %d %f\n", p_bbox.x, p_bbox.y, p_bbox.width, p_bbox.height, p_bbox.value);
+        return p_bbox;
     }
 
-    void update(int t, const ei_impulse_result_bounding_box_t* bbox) {
+    void update(int slot, uint32_t t, const ei_impulse_result_bounding_box_t* bbox) {
         if (bbox == nullptr) {
-            EI_LOGD("update (last prediction) %d %d %d %d %f\n", last_prediction.x, last_prediction.y, last_prediction.width, last_prediction.height, last_prediction.value);
-            bbox = &last_prediction;
+            bbox = &last_prediction[slot];
+            EI_LOGD("update (last prediction) %d %d %d %d %f\n", bbox->x, bbox->y, bbox->width, bbox->height, bbox->value);
         } else {
             EI_LOGD("update (ground truth prediction) %d %d %d %d %f\n", bbox->x, bbox->y, bbox->width, bbox->height, bbox->value);
-            last_ground_truth_update_t = t;
+            last_ground_truth_update_t[slot] = t;
         }
 
-        hx_centroid[0] = centroid_filter->x[0];
-        hx_centroid[1] = centroid_filter->x[1];
-        hx_width_height[0] = width_height_filter->x[0];
-        hx_width_height[1] = width_height_filter->x[1];
+        float *c_x = &centroid_x[slot * 8];
+        float *wh_x = &width_height_x[slot * 8];
+
+        float hx_centroid[2] = { c_x[0], c_x[1] };
+        float hx_width_height[2] = { wh_x[0], wh_x[1] };
 
         float centroid[2] = { bbox->x + static_cast<float>(bbox->width) / 2,
                               bbox->y + static_cast<float>(bbox->height) / 2 };
-        centroid_filter->update(centroid , hx_centroid);
+        filter.update(c_x, &centroid_P[slot * 16], centroid, hx_centroid);
 
         float width_height[2] = { static_cast<float>(bbox->width),
                                   static_cast<float>(bbox->height) };
-        width_height_filter->update(width_height, hx_width_height);
-
-        trace_score = bbox->value;
-        observations.push_back(*bbox);
-        while (observations.size() > max_observations) {
-            observations.erase(observations.begin());
+        filter.update(wh_x, &width_height_P[slot * 16], width_height, hx_width_height);
+
+        trace_score[slot] = bbox->value;
+        // bbox might point to last_prediction, copy before the EMAs read it
+        const ei_impulse_result_bounding_box_t obs = *bbox;
+        observations[slot * 2] = observations[slot * 2 + 1];
+        observations[slot * 2 + 1] = obs;
+        if (observation_count[slot] < max_observations[slot]) {
+            observation_count[slot]++;
+        }
+        else if (observation_count[slot] > max_observations[slot]) {
+            observation_count[slot] = max_observations[slot];
         }
 
-        xyxy_emas[0]->update(bbox->x);
-        xyxy_emas[1]->update(bbox->y);
-        xyxy_emas[2]->update(bbox->width);
-        xyxy_emas[3]->update(bbox->height);
-
+        emas[slot * 4 + 0].update(obs.x);
+        emas[slot * 4 + 1].update(obs.y);
+        emas[slot * 4 + 2].update(obs.width);
+        emas[slot * 4 + 3].update(obs.height);
     }
 
-    std::tuple<int, int, int, int> last_centroid_segment() const {
-        if (observations.size() < 2) {
+    std::tuple<int, int, int, int> last_centroid_segment(int slot) const {
+        if (observation_count[slot] < 2) {
             return {};
         }
-        auto obs_t_minus1 = observations[observations.size() - 2];
-        auto obs_t_0 = observations.back();
+        const ei_impulse_result_bounding_box_t &obs_t_minus1 = observations[slot * 2];
+        const ei_impulse_result_bounding_box_t &obs_t_0 = observations[slot * 2 + 1];
 
         return {obs_t_minus1.x + static_cast<float>(obs_t_minus1.width) / 2,
                 obs_t_minus1.y + static_cast<float>(obs_t_minus1.height) / 2,
@@ -186,87 +255,110 @@ public:
                 obs_t_0.y + static_cast<float>(obs_t_0.height) / 2};
     }
 
-    const ei_impulse_result_bounding_box_t* last_observation() const {
-        if (observations.empty()) {
+    const ei_impulse_result_bounding_box_t* last_observation(int slot) const {
+        if (observation_count[slot] == 0) {
             return nullptr;
         }
-        return &observations.back();
+        return &observations[slot * 2 + 1];
     }
 
-    ei_impulse_result_bounding_box_t smoothed_last_observation() const {
+    ei_impulse_result_bounding_box_t smoothed_last_observation(int slot) const {
         ei_impulse_result_bounding_box_t bbox = {"", 0, 0, 0, 0, 0.0};
-        if (observations.empty()) {
+        if (observation_count[slot] == 0) {
             return bbox;
         }
 
-        bbox.x = round(xyxy_emas[0]->smoothed_value());
-        bbox.y = round(xyxy_emas[1]->smoothed_value());
-        bbox.width = round(xyxy_emas[2]->smoothed_value());
-        bbox.height = round(xyxy_emas[3]->smoothed_value());
-        bbox.label = trace_label;
-        bbox.value = trace_score;
+        bbox.x = round(emas[slot * 4 + 0].smoothed_value());
+        bbox.y = round(emas[slot * 4 + 1].smoothed_value());
+        bbox.width = round(emas[slot * 4 + 2].smoothed_value());
+        bbox.height = round(emas[slot * 4 + 3].smoothed_value());
+        bbox.label = last_prediction[slot].label;
+        bbox.value = trace_score[slot];
         return bbox;
     }
 
-    void debug_output() const {
+    void debug_output(int slot) const {
+        (void)slot;
 #if EI_LOG_LEVEL == EI_LOG_LEVEL_DEBUG
         // output debug info, C-style
-        ei_printf("Trace %d:\n", id);
-        ei_printf("  Last ground truth update: %d\n", last_ground_truth_update_t);
-        ei_printf("  Last prediction: %d %d %d %d %f\n", last_prediction.x, last_prediction.y, last_prediction.width, last_prediction.height, last_prediction.value);
+        const ei_impulse_result_bounding_box_t &p = last_prediction[slot];
+        ei_printf("Trace %d:\n", id[slot]);
+        ei_printf("  Last ground truth update: %d\n", last_ground_truth_update_t[slot]);
+        ei_printf("  Last prediction: %d %d %d %d %f\n", p.x, p.y, p.width, p.height, p.value);
         ei_printf("  Observations:\n");
-        for (const auto& obs : observations) {
+        for (int ix = 2 - std::min<int>(observation_count[slot], 2); ix < 2; ix++) {
+            const ei_impulse_result_bounding_box_t &obs = observations[slot * 2 + ix];
             ei_printf("%d %d %d %d %f\n", obs.x, obs.y, obs.width, obs.height, obs.value);
         }
 #endif
     }
 
-    uint32_t id;
-    uint32_t last_ground_truth_update_t;
-    ei_impulse_result_bounding_box_t last_prediction;
+    size_t capacity;
+    uint32_t *id;
+    uint32_t *last_ground_truth_update_t;
+    ei_impulse_result_bounding_box_t *last_prediction;
 
 private:
-    std::vector<ei_impulse_result_bounding_box_t> observations;
-    TinyEKF* centroid_filter;
-    TinyEKF* width_height_filter;
-    uint32_t max_observations;
-    float fx_centroid[2];
-    float fx_width_height[2];
-    float hx_centroid[2];
-    float hx_width_height[2];
-    const char* trace_label;
-    float trace_score;
-    ExponentialMovingAverage *xyxy_emas[4];
+    TracePool(const TracePool&) = delete;
+    TracePool& operator=(const TracePool&) = delete;
+
+    TinyEKFModel filter;
+    // [previous, last] observation per slot
+    ei_impulse_result_bounding_box_t *observations;
+    uint16_t *observation_count;
+    uint32_t *max_observations;
+    float *trace_score;
+    float *centroid_x;
+    float *centroid_P;
+    float *width_height_x;
+    float *width_height_P;
+    ExponentialMovingAverage *emas;
+    int *free_slots;
+    size_t free_count;
+    uint8_t *buffer;
 };
 
 class Tracker {
 public:
-    Tracker (uint32_t keep_grace = 5, uint16_t max_observations = 5, float threshold = 0.5, bool use_iou = true)
+    Tracker (uint32_t keep_grace = 5, uint16_t max_observations = 5, float threshold = 0.5, bool use_iou = true,
+             size_t max_traces = EI_CLASSIFIER_OBJECT_TRACKING_MAX_TRACES)
             : keep_grace(keep_grace),
               max_observations(max_observations),
+              traces(max_traces),
               alignment(threshold, use_iou) {
         trace_seq_id = 0;
         t = 0;
+
+        open_traces.reserve(traces.capacity);
+        traces_tmp.reserve(traces.capacity);
+        trace_bboxes.reserve(traces.capacity);
+        last_obs_matches.reserve(traces.capacity);
+        last_obs_values.reserve(traces.capacity);
+        predicted_matches.reserve(traces.capacity);
+        predicted_values.reserve(traces.capacity);
+        object_tracking_output.reserve(traces.capacity);
     }
 
-    ~Tracker() {
-        for (auto trace : open_traces) {
-            delete trace;
-        }
-        for (auto trace : closed_traces) {
-            delete trace;
-        }
+    /**
+     * Whether the trace pool could be allocated
+     */
+    bool ok() const {
+        return traces.capacity > 0;
     }
 
-    std::vector<Trace*>open_traces;
-    std::vector<Trace*>closed_traces;
+    // slots in the trace pool, oldest trace first
+    std::vector<int> open_traces;
     std::vector<ei_object_tracking_trace_t> object_tracking_output;
 
     /**
-     * Process new detections.
-     * @param detections Bounding boxes, this vector might be reordered.
+     * Process new detections. The buffers used here are kept between calls, so once they've
+     * grown to the largest number of detections seen this doesn't allocate.
+     * @param bbs Bounding boxes (not modified, they're copied before sorting)
+     * @param bbs_num Number of bounding boxes
      */
-    void process_new_detections(std::vector<ei_impulse_result_bounding_box_t> detections) {
+    void process_new_detections(const ei_impulse_result_bounding_box_t *bbs, size_t bbs_num) {
+        detections.assign(bbs, bbs + bbs_num);
+
         // sort detections by x, y, width, height, label (same in Python code, see ei_tracking/tracking.py)
         // so it doesn't matter in what order we pass in the detections
         std::sort(detections.begin(), detections.end(), [](const ei_impulse_result_bounding_box_t& a, const ei_impulse_result_bounding_box_t& b) {
@@ -277,120 +369,122 @@ public:
             return std::strcmp(a.label, b.label) < 0;
         });
 
+        const size_t open_count = open_traces.size();
+        alignment.set_detections(detections.data(), detections.size());
+        last_obs_matches.resize(open_count);
+        last_obs_values.resize(open_count);
+        predicted_matches.resize(open_count);
+        predicted_values.resize(open_count);
+
         // firstly try an alignment with last observations...
-        std::vector<ei_impulse_result_bounding_box_t> last_obs_bboxes;
-        for (auto trace : open_traces) {
-            last_obs_bboxes.push_back(*trace->last_observation());
+        trace_bboxes.resize(open_count);
+        for (size_t i = 0; i < open_count; i++) {
+            const ei_impulse_result_bounding_box_t *last_obs = traces.last_observation(open_traces[i]);
+            trace_bboxes[i] = last_obs ? *last_obs : traces.last_prediction[open_traces[i]];
         }
 
-        std::vector<std::tuple<int, int, float>> last_obs_matches = alignment.align(last_obs_bboxes, detections);
-
-        float last_obs_cost = 0;
-        for (auto last_obs_match : last_obs_matches) {
-            EI_LOGD("last_obs_match %d %d %f\n", std::get<0>(last_obs_match), std::get<1>(last_obs_match), std::get<2>(last_obs_match));
-            last_obs_cost += std::get<2>(last_obs_match);
-        }
+        float last_obs_cost = alignment.align(trace_bboxes.data(), open_count,
+            last_obs_matches.data(), last_obs_values.data());
         EI_LOGD("last_obs_cost %f\n", last_obs_cost);
 
         // ... then with the kalman filter predictions
-        std::vector<ei_impulse_result_bounding_box_t> predicted_bboxes;
-        for (auto trace : open_traces) {
-            predicted_bboxes.push_back(trace->predict());
-            EI_LOGD("predicted %d %d %d %d %f\n", trace->last_prediction.x, trace->last_prediction.y, trace->last_prediction.width, trace->last_prediction.height, trace->last_prediction.value);
+        for (size_t i = 0; i < open_count; i++) {
+            trace_bboxes[i] = traces.predict(open_traces[i]);
         }
 
-        std::vector<std::tuple<int, int, float>> predicted_matches = alignment.align(predicted_bboxes, detections);
-        float predicted_cost = 0;
-        for (auto predicted_match : predicted_matches) {
-            EI_LOGD("predicted_match %d %d %f\n", std::get<0>(predicted_match), std::get<1>(predicted_match), std::get<2>(predicted_match));
-            predicted_cost += std::get<2>(predicted_match);
-        }
+        float predicted_cost = alignment.align(trace_bboxes.data(), open_count,
+            predicted_matches.data(), predicted_values.data());
         EI_LOGD("predicted_cost %f\n", predicted_cost);
 
         // and use whichever matching set is better
-        std::vector<std::tuple<int, int, float>> matches;
-
+        const int *matches;
         if (last_obs_cost < predicted_cost) {
             EI_LOGD("using last_obs_matches matches\n");
-            matches = last_obs_matches;
+            matches = last_obs_matches.data();
         }
         else {
             EI_LOGD("using predicted_matches matches\n");
-            matches = predicted_matches;
+            matches = predicted_matches.data();
         }
 
         // assume all detections are unassigned and will becomes new tracks
-        // until we see otherwise ( i.e. they match an existing track )∂        //
-        std::set<uint16_t>unassigned_detection_idxs;
-        for (size_t i = 0; i < detections.size(); i++) {
-            unassigned_detection_idxs.insert(i);
-        }
-
-        // keep track of open traces idxs that haven't been updated
-        std::set<uint16_t>open_traces_idxs_to_be_updated;
-        for (size_t i = 0; i < open_traces.size(); i++) {
-            open_traces_idxs_to_be_updated.insert(i);
-        }
+        // until we see otherwise ( i.e. they match an existing track )
+        detection_assigned.assign(detections.size(), 0);
 
         // update existing traces with any matches
-        for (size_t i = 0; i < matches.size(); i++) {
-            uint32_t trace_idx = std::get<0>(matches[i]);
-            uint32_t detection_idx = std::get<1>(matches[i]);
-            EI_LOGD("t_idx=%u d_idx=%u iou=%.6f\n", trace_idx, detection_idx, std::get<2>(matches[i]));
-
-            Trace *trace = open_traces[trace_idx];
-            open_traces_idxs_to_be_updated.erase(trace_idx);
-            trace->update(t, &detections[detection_idx]);
-            unassigned_detection_idxs.erase(detection_idx);
+        for (size_t trace_idx = 0; trace_idx < open_count; trace_idx++) {
+            int detection_idx = matches[trace_idx];
+            if (detection_idx < 0) {
+                continue;
+            }
+            EI_LOGD("t_idx=%u d_idx=%d\n", (unsigned)trace_idx, detection_idx);
+
+            traces.update(open_traces[trace_idx], t, &detections[detection_idx]);
+            detection_assigned[detection_idx] = 1;
         }
 
-        for (auto detection_idx : unassigned_detection_idxs ) {
-            EI_LOGD("unassigned detection %d %d %d %d %d %f => starting new trace\n", detection_idx, detections[detection_idx].x, detections[detection_idx].y, detections[detection_idx].width, detections[detection_idx].height, detections[detection_idx].value);
-            open_traces.push_back(new Trace(trace_seq_id, t, detections[detection_idx], max_observations));
+        for (size_t detection_idx = 0; detection_idx < detections.size(); detection_idx++) {
+            if (detection_assigned[detection_idx]) {
+                continue;
+            }
+            const ei_impulse_result_bounding_box_t &d = detections[detection_idx];
+            int slot = traces.open(trace_seq_id, t, d, max_observations);
+            if (slot < 0) {
+                EI_LOGD("unassigned detection %d, but already tracking %d traces => dropped\n",
+                    (int)detection_idx, (int)traces.capacity);
+                continue;
+            }
+            EI_LOGD("unassigned detection %d %d %d %d %d %f => starting new trace\n", (int)detection_idx, d.x, d.y, d.width, d.height, d.value);
+            open_traces.push_back(slot);
             trace_seq_id += 1;
         }
 
-        std::vector<Trace*>traces_tmp;
+        traces_tmp.clear();
 
-        for (auto trace : open_traces) {
-            EI_LOGD("grace checking trace %d at t=%d (trace.last_ground_truth_update_t=%d)\n", trace->id, t, trace->last_ground_truth_update_t);
-            uint32_t time_since_last_update = t - trace->last_ground_truth_update_t;
+        for (int slot : open_traces) {
+            EI_LOGD("grace checking trace %d at t=%d (trace.last_ground_truth_update_t=%d)\n", traces.id[slot], t, traces.last_ground_truth_update_t[slot]);
+            uint32_t time_since_last_update = t - traces.last_ground_truth_update_t[slot];
             if (time_since_last_update > keep_grace) {
                 // been too long since last update, close it
-                EI_LOGD("closing trace %d\n", trace->id);
-                closed_traces.push_back(trace);
+                EI_LOGD("closing trace %d\n", traces.id[slot]);
+                traces.close(slot);
             }
             else {
-                if (trace->last_ground_truth_update_t != t) {
+                if (traces.last_ground_truth_update_t[slot] != t) {
                     // wasn't match this step, so do rollout of filters
-                    EI_LOGD("self rollout of trace %d\n", trace->id);
-                    trace->update(t, nullptr);
+                    EI_LOGD("self rollout of trace %d\n", traces.id[slot]);
+                    traces.update(slot, t, nullptr);
                 }
-                EI_LOGD("trace %d still alive\n", trace->id);
-                traces_tmp.push_back(trace);
+                EI_LOGD("trace %d still alive\n", traces.id[slot]);
+                traces_tmp.push_back(slot);
             }
         }
 
-        open_traces = traces_tmp;
+        open_traces.swap(traces_tmp);
         object_tracking_output.clear();
 
-        for (auto trace : open_traces) {
+        for (int slot : open_traces) {
+            const ei_impulse_result_bounding_box_t &p = traces.last_prediction[slot];
             ei_object_tracking_trace_t trace_result = { 0 };
-            trace_result.id = trace->id;
-            trace_result.last_ground_truth_update_t = trace->last_ground_truth_update_t;
-            trace_result.label = trace->last_prediction.label;
-            trace_result.x = trace->last_prediction.x;
-            trace_result.y = trace->last_prediction.y;
-            trace_result.width = trace->last_prediction.width;
-            trace_result.height = trace->last_prediction.height;
-            trace_result.last_centroid_segment = trace->last_centroid_segment();
-            trace_result.value = trace->last_prediction.value;
+            trace_result.id = traces.id[slot];
+            trace_result.last_ground_truth_update_t = traces.last_ground_truth_update_t[slot];
+            trace_result.label = p.label;
+            trace_result.x = p.x;
+            trace_result.y = p.y;
+            trace_result.width = p.width;
+            trace_result.height = p.height;
+            trace_result.last_centroid_segment = traces.last_centroid_segment(slot);
+            trace_result.value = p.value;
 
             object_tracking_output.push_back(trace_result);
         }
         t += 1;
     }
 
+    void process_new_detections(const std::vector<ei_impulse_result_bounding_box_t>& new_detections) {
+        process_new_detections(new_detections.data(), new_detections.size());
+    }
+
     void set_threshold(float threshold) {
         alignment.threshold = threshold;
     }
@@ -404,8 +498,17 @@ public:
 private:
     uint32_t trace_seq_id;
     uint32_t t;
+    TracePool traces;
     JonkerVolgenantAlignment alignment;
-    std::vector<std::string> seen_labels;
+    // per frame buffers, kept to avoid reallocating
+    std::vector<ei_impulse_result_bounding_box_t> detections;
+    std::vector<ei_impulse_result_bounding_box_t> trace_bboxes;
+    std::vector<int> last_obs_matches;
+    std::vector<float> last_obs_values;
+    std::vector<int> predicted_matches;
+    std::vector<float> predicted_values;
+    std::vector<uint8_t> detection_assigned;
+    std::vector<int> traces_tmp;
 };
 
 EI_IMPULSE_ERROR init_object_tracking(ei_impulse_handle_t *handle, void** state, void *config)
@@ -421,6 +524,10 @@ EI_IMPULSE_ERROR init_object_tracking(ei_impulse_handle_t *handle, void** state,
     if (!object_tracker) {
         return EI_IMPULSE_OUT_OF_MEMORY;
     }
+    if (!object_tracker->ok()) {
+        delete object_tracker;
+        return EI_IMPULSE_OUT_OF_MEMORY;
+    }
 
     // Store the object counter state
     *state = (void*)object_tracker;
@@ -449,11 +556,7 @@ EI_IMPULSE_ERROR process_object_tracking(ei_impulse_handle_t *handle,
     Tracker *object_tracker = (Tracker *)state;
 
     if((void *)object_tracker != NULL) {
-        ei_impulse_result_bounding_box_t *bbs = result->bounding_boxes;
-        uint32_t bbs_num = result->bounding_boxes_count;
-        std::vector<ei_impulse_result_bounding_box_t> detections(bbs, bbs + bbs_num);
-
-        object_tracker->process_new_detections(detections);
+        object_tracker->process_new_detections(result->bounding_boxes, result->bounding_boxes_count);
 
         result->postprocessed_output.object_tracking_output.open_traces = object_tracker->object_tracking_output.data();
         result->postprocessed_output.object_tracking_output.open_traces_count = object_tracker->object_tracking_output.size();
@@ -36,6 +36,8 @@
 #define EI_POSTPROCESSING_H
 
 #include "edge-impulse-sdk/classifier/ei_model_types.h"
+#include "edge-impulse-sdk/dsp/ei_profiler.h"
+#include "edge-impulse-sdk/dsp/ei_memory_accounting.h"
 
 #if EI_CLASSIFIER_CALIBRATION_ENABLED
 #include "edge-impulse-sdk/classifier/postprocessing/ei_performance_calibration.h"
@@ -103,6 +105,8 @@ extern "C" EI_IMPULSE_ERROR deinit_postprocessing(ei_impulse_handle_t *handle) {
 
 extern "C" EI_IMPULSE_ERROR run_postprocessing(ei_impulse_handle_t *handle,
                                                ei_impulse_result_t *result) {
+    EI_PROFILE_SCOPE("postprocessing");
+    EI_MEMORY_STAGE(EI_MEMORY_STAGE_POSTPROCESSING);
     auto start_us = ei_read_timer_us();
 
     if (!handle) {
@@ -128,13 +132,15 @@ extern "C" EI_IMPULSE_ERROR run_postprocessing(ei_impulse_handle_t *handle,
         }
     }
 
-    // free raw results
+#if EI_CLASSIFIER_REUSE_RAW_OUTPUTS == 0
+    // free raw results (otherwise they're owned by the impulse state and reused on the next inference)
     for (size_t ix = 0; ix < impulse->output_tensors_size; ix++) {
         if (result->_raw_outputs[ix].matrix) {
-            delete result->_raw_outputs[ix].matrix;
-            result->_raw_outputs[ix].matrix = nullptr;
+            // matrix, matrix_i8 or matrix_u8, resets the pointer to nullptr
+            result->_raw_outputs[ix].free_matrix();
         }
     }
+#endif // EI_CLASSIFIER_REUSE_RAW_OUTPUTS == 0
 
     result->timing.postprocessing_us = ei_read_timer_us() - start_us;
 
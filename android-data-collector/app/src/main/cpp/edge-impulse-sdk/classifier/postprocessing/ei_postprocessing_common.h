@@ -42,7 +42,11 @@
 #include "edge-impulse-sdk/classifier/ei_classifier_types.h"
 #include "edge-impulse-sdk/classifier/ei_nms.h"
 #include "edge-impulse-sdk/dsp/ei_vector.h"
+#include "edge-impulse-sdk/dsp/config.hpp"
 #include <string>
+#include <string.h>
+#include <algorithm>
+#include <limits>
 
 #ifdef EI_HAS_PADDLEOCR_DETECTOR
 #include <utility>
@@ -50,6 +54,237 @@
 #include <limits>
 #endif // EI_HAS_PADDLEOCR_DETECTOR
 
+#if EIDSP_USE_NEON && defined(__aarch64__)
+#include <arm_neon.h>
+#define EI_POSTPROCESSING_NEON     1
+#elif EIDSP_USE_SSE2
+#include <emmintrin.h>
+#define EI_POSTPROCESSING_SSE2     1
+#endif
+
+/**
+ * Rejects detection scores on the raw output tensor, so decoders only dequantize and decode
+ * the rows that can pass `score >= threshold && score <= 1.0f`.
+ * For quantized tensors this is exact, for float tensors it's the same comparison.
+ */
+template<typename T>
+struct ei_score_filter_t {
+    T lo;
+    T hi;
+    bool any; // false if no value can pass
+};
+
+/**
+ * Range of quantized values in [qmin, qmax] whose dequantized score passes the threshold.
+ * Every value is dequantized the same way the decoders do, so no rounding at the edges;
+ * the dequantization is monotonic, so the values that pass are one range.
+ */
+__attribute__((unused)) static ei_score_filter_t<int> ei_score_filter_quantized(float threshold, float zero_point, float scale, int qmin, int qmax) {
+    ei_score_filter_t<int> filter = { qmax, qmin, false };
+    for (int q = qmin; q <= qmax; q++) {
+        float score = (static_cast<float>(q) - zero_point) * scale;
+        if (score >= threshold && score <= 1.0f) {
+            filter.lo = std::min(filter.lo, q);
+            filter.hi = std::max(filter.hi, q);
+            filter.any = true;
+        }
+    }
+    return filter;
+}
+
+__attribute__((unused)) static ei_score_filter_t<int8_t> ei_make_score_filter(const int8_t *data, float threshold, float zero_point, float scale) {
+    ei_score_filter_t<int> f = ei_score_filter_quantized(threshold, zero_point, scale, -128, 127);
+    return { (int8_t)f.lo, (int8_t)f.hi, f.any };
+}
+
+__attribute__((unused)) static ei_score_filter_t<uint8_t> ei_make_score_filter(const uint8_t *data, float threshold, float zero_point, float scale) {
+    ei_score_filter_t<int> f = ei_score_filter_quantized(threshold, zero_point, scale, 0, 255);
+    return { (uint8_t)f.lo, (uint8_t)f.hi, f.any };
+}
+
+__attribute__((unused)) static ei_score_filter_t<float> ei_make_score_filter(const float *data, float threshold, float zero_point, float scale) {
+    if (zero_point == 0.0f && scale == 1.0f) {
+        return { threshold, 1.0f, threshold <= 1.0f };
+    }
+    // not a plain float tensor, let everything through to the dequantized check
+    return { -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), true };
+}
+
+template<typename T>
+static inline bool ei_score_filter_pass(const ei_score_filter_t<T> &filter, T v) {
+    return v >= filter.lo && v <= filter.hi;
+}
+
+/**
+ * Index of the first of the n (contiguous) values that passes the filter, n if none does
+ */
+__attribute__((unused)) static size_t ei_score_filter_find(const ei_score_filter_t<float> &filter, const float *v, size_t n) {
+    size_t ix = 0;
+#if EI_POSTPROCESSING_NEON
+    const float32x4_t lo = vdupq_n_f32(filter.lo), hi = vdupq_n_f32(filter.hi);
+    for (; ix + 4 <= n; ix += 4) {
+        float32x4_t x = vld1q_f32(v + ix);
+        if (vmaxvq_u32(vandq_u32(vcgeq_f32(x, lo), vcleq_f32(x, hi))) != 0) {
+            break;
+        }
+    }
+#elif EI_POSTPROCESSING_SSE2
+    const __m128 lo = _mm_set1_ps(filter.lo), hi = _mm_set1_ps(filter.hi);
+    for (; ix + 4 <= n; ix += 4) {
+        __m128 x = _mm_loadu_ps(v + ix);
+        int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(x, lo), _mm_cmple_ps(x, hi)));
+        if (mask != 0) {
+            return ix + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; ix < n; ix++) {
+        if (ei_score_filter_pass(filter, v[ix])) {
+            return ix;
+        }
+    }
+    return n;
+}
+
+__attribute__((unused)) static size_t ei_score_filter_find(const ei_score_filter_t<uint8_t> &filter, const uint8_t *v, size_t n) {
+    size_t ix = 0;
+#if EI_POSTPROCESSING_NEON
+    const uint8x16_t lo = vdupq_n_u8(filter.lo), hi = vdupq_n_u8(filter.hi);
+    for (; ix + 16 <= n; ix += 16) {
+        uint8x16_t x = vld1q_u8(v + ix);
+        if (vmaxvq_u8(vandq_u8(vcgeq_u8(x, lo), vcleq_u8(x, hi))) != 0) {
+            break;
+        }
+    }
+#elif EI_POSTPROCESSING_SSE2
+    const __m128i lo = _mm_set1_epi8((char)filter.lo), hi = _mm_set1_epi8((char)filter.hi);
+    for (; ix + 16 <= n; ix += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(v + ix));
+        // x >= lo where max(x, lo) == x, x <= hi where min(x, hi) == x
+        __m128i in = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(x, lo), x), _mm_cmpeq_epi8(_mm_min_epu8(x, hi), x));
+        int mask = _mm_movemask_epi8(in);
+        if (mask != 0) {
+            return ix + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; ix < n; ix++) {
+        if (ei_score_filter_pass(filter, v[ix])) {
+            return ix;
+        }
+    }
+    return n;
+}
+
+__attribute__((unused)) static size_t ei_score_filter_find(const ei_score_filter_t<int8_t> &filter, const int8_t *v, size_t n) {
+    size_t ix = 0;
+#if EI_POSTPROCESSING_NEON
+    const int8x16_t lo = vdupq_n_s8(filter.lo), hi = vdupq_n_s8(filter.hi);
+    for (; ix + 16 <= n; ix += 16) {
+        int8x16_t x = vld1q_s8(v + ix);
+        if (vmaxvq_u8(vandq_u8(vcgeq_s8(x, lo), vcleq_s8(x, hi))) != 0) {
+            break;
+        }
+    }
+#elif EI_POSTPROCESSING_SSE2
+    // no signed byte min/max in SSE2, flip the sign bit and compare unsigned
+    const __m128i sign = _mm_set1_epi8((char)0x80);
+    const __m128i lo = _mm_xor_si128(_mm_set1_epi8(filter.lo), sign);
+    const __m128i hi = _mm_xor_si128(_mm_set1_epi8(filter.hi), sign);
+    for (; ix + 16 <= n; ix += 16) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(v + ix)), sign);
+        __m128i in = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(x, lo), x), _mm_cmpeq_epi8(_mm_min_epu8(x, hi), x));
+        int mask = _mm_movemask_epi8(in);
+        if (mask != 0) {
+            return ix + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; ix < n; ix++) {
+        if (ei_score_filter_pass(filter, v[ix])) {
+            return ix;
+        }
+    }
+    return n;
+}
+
+/**
+ * Index of the first maximum of the n values if that's above 0, otherwise 0
+ * (same as a `v[ix] > highest` scan that starts at highest = 0)
+ */
+__attribute__((unused)) static uint32_t ei_argmax_above_zero(const float *v, size_t n) {
+    float highest = 0.0f;
+    size_t ix = 0;
+#if EI_POSTPROCESSING_NEON
+    if (n >= 4) {
+        float32x4_t m = vdupq_n_f32(0.0f);
+        for (; ix + 4 <= n; ix += 4) {
+            m = vmaxq_f32(m, vld1q_f32(v + ix));
+        }
+        highest = vmaxvq_f32(m);
+    }
+#elif EI_POSTPROCESSING_SSE2
+    if (n >= 4) {
+        __m128 m = _mm_setzero_ps();
+        for (; ix + 4 <= n; ix += 4) {
+            m = _mm_max_ps(m, _mm_loadu_ps(v + ix));
+        }
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+        highest = _mm_cvtss_f32(m);
+    }
+#endif
+    for (; ix < n; ix++) {
+        if (v[ix] > highest) {
+            highest = v[ix];
+        }
+    }
+    if (!(highest > 0.0f)) {
+        return 0;
+    }
+    for (ix = 0; ix < n; ix++) {
+        if (v[ix] == highest) {
+            return (uint32_t)ix;
+        }
+    }
+    return 0;
+}
+
+__attribute__((unused)) static uint32_t ei_argmax_above_zero(const uint8_t *v, size_t n) {
+    uint8_t highest = 0;
+    size_t ix = 0;
+#if EI_POSTPROCESSING_NEON
+    if (n >= 16) {
+        uint8x16_t m = vdupq_n_u8(0);
+        for (; ix + 16 <= n; ix += 16) {
+            m = vmaxq_u8(m, vld1q_u8(v + ix));
+        }
+        highest = vmaxvq_u8(m);
+    }
+#elif EI_POSTPROCESSING_SSE2
+    if (n >= 16) {
+        __m128i m = _mm_setzero_si128();
+        for (; ix + 16 <= n; ix += 16) {
+            m = _mm_max_epu8(m, _mm_loadu_si128((const __m128i*)(v + ix)));
+        }
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 8));
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 4));
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 2));
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 1));
+        highest = (uint8_t)_mm_cvtsi128_si32(m);
+    }
+#endif
+    for (; ix < n; ix++) {
+        if (v[ix] > highest) {
+            highest = v[ix];
+        }
+    }
+    if (highest == 0) {
+        return 0;
+    }
+    return (uint32_t)((const uint8_t*)memchr(v, highest, n) - v);
+}
+
 int16_t get_block_number(ei_impulse_handle_t *handle, void *init_func)
 {
     for (size_t i = 0; i < handle->impulse->postprocessing_blocks_size; i++) {
@@ -652,34 +887,49 @@ __attribute__((unused)) static EI_IMPULSE_ERROR process_ssd_f32(ei_impulse_handl
 #endif
 }
 
-__attribute__((unused)) static EI_IMPULSE_ERROR process_yolov5_f32(ei_impulse_handle_t *handle,
-                                                                    uint32_t block_index,
-                                                                    uint32_t input_block_id,
-                                                                    ei_impulse_result_t *result,
-                                                                    void *config_ptr,
-                                                                    void *state) {
 #if EI_HAS_YOLOV5
-    const ei_impulse_t *impulse = handle->impulse;
-    const ei_fill_result_object_detection_f32_config_t *config = (ei_fill_result_object_detection_f32_config_t*)config_ptr;
-
-    ei::matrix_t* raw_output_mtx = NULL;
-    bool find_mtx_res = find_mtx_by_idx(result->_raw_outputs, &raw_output_mtx, input_block_id, impulse->output_tensors_size);
-    if (!find_mtx_res) {
-        return EI_IMPULSE_OUTPUT_TENSOR_NULL;
-    }
-
+/**
+ * Decode a (row_count, 5 + label_count) YOLOv5 output, [xc, yc, w, h, score, cls...] per row.
+ * Rows are rejected on the raw score before anything else is decoded, and candidates go straight
+ * into the NMS scratch, so background rows cost one compare.
+ */
+template<typename T>
+__attribute__((unused)) static EI_IMPULSE_ERROR fill_result_struct_yolov5_common(const ei_impulse_t *impulse,
+                                                                                  ei_impulse_result_t *result,
+                                                                                  int version,
+                                                                                  const T *data,
+                                                                                  float zero_point,
+                                                                                  float scale,
+                                                                                  size_t output_features_count,
+                                                                                  float threshold,
+                                                                                  size_t object_detection_count,
+                                                                                  const ei_object_detection_nms_config_t *nms_config) {
     static std::vector<ei_impulse_result_bounding_box_t> results;
     results.clear();
 
     size_t col_size = 5 + impulse->label_count;
-    size_t row_count = config->output_features_count / col_size;
+    size_t row_count = output_features_count / col_size;
 
-    for (size_t ix = 0; ix < row_count; ix++) {
+    const ei_score_filter_t<T> score_filter = ei_make_score_filter(data, threshold, zero_point, scale);
+    ei_nms_scratch_t *scratch = ei_nms_get_scratch();
+    size_t candidates = 0;
+
+    for (size_t ix = 0; ix < row_count && score_filter.any; ix++) {
         size_t base_ix = ix * col_size;
-        float xc = raw_output_mtx->buffer[base_ix + 0];
-        float yc = raw_output_mtx->buffer[base_ix + 1];
-        float w = raw_output_mtx->buffer[base_ix + 2];
-        float h = raw_output_mtx->buffer[base_ix + 3];
+        if (!ei_score_filter_pass(score_filter, data[base_ix + 4])) {
+            continue;
+        }
+
+        float score = (static_cast<float>(data[base_ix + 4]) - zero_point) * scale;
+        // NMS drops boxes without a score
+        if (score < threshold || score > 1.0f || score == 0.0f) {
+            continue;
+        }
+
+        float xc = (static_cast<float>(data[base_ix + 0]) - zero_point) * scale;
+        float yc = (static_cast<float>(data[base_ix + 1]) - zero_point) * scale;
+        float w = (static_cast<float>(data[base_ix + 2]) - zero_point) * scale;
+        float h = (static_cast<float>(data[base_ix + 3]) - zero_point) * scale;
         float x = xc - (w / 2.0f);
         float y = yc - (h / 2.0f);
         if (x < 0) {
@@ -699,46 +949,36 @@ __attribute__((unused)) static EI_IMPULSE_ERROR process_yolov5_f32(ei_impulse_ha
             continue;
         }
 
-        float score = raw_output_mtx->buffer[base_ix + 4];
+        // argmax over the raw values, for quantized outputs that's the same label
+        uint32_t label = ei_argmax_above_zero(data + base_ix + 5, impulse->label_count);
 
-        uint32_t label = 0;
-        float highest_value = 0.0f;
-        for (size_t lx = 0; lx < impulse->label_count; lx++) {
-            float l = raw_output_mtx->buffer[base_ix + 5 + lx];
-            if (l > highest_value) {
-                label = lx;
-                highest_value = l;
-            }
+        if (version != 5) {
+            x *= static_cast<float>(impulse->input_width);
+            y *= static_cast<float>(impulse->input_height);
+            w *= static_cast<float>(impulse->input_width);
+            h *= static_cast<float>(impulse->input_height);
         }
 
-        if (score >= config->threshold && score <= 1.0f) {
-            ei_impulse_result_bounding_box_t r;
-            r.label = impulse->categories[label];
-
-            if (config->version != 5) {
-                x *= static_cast<float>(impulse->input_width);
-                y *= static_cast<float>(impulse->input_height);
-                w *= static_cast<float>(impulse->input_width);
-                h *= static_cast<float>(impulse->input_height);
-            }
+        uint32_t bb_x = static_cast<uint32_t>(x);
+        uint32_t bb_y = static_cast<uint32_t>(y);
+        uint32_t bb_width = static_cast<uint32_t>(w);
+        uint32_t bb_height = static_cast<uint32_t>(h);
 
-            r.x = static_cast<uint32_t>(x);
-            r.y = static_cast<uint32_t>(y);
-            r.width = static_cast<uint32_t>(w);
-            r.height = static_cast<uint32_t>(h);
-            r.value = score;
-            results.push_back(r);
+        if (!ei_nms_add_box(scratch, &candidates, bb_y, bb_x, bb_y + bb_height, bb_x + bb_width, score, (int)label)) {
+            return EI_IMPULSE_OUT_OF_MEMORY;
         }
     }
 
-    EI_IMPULSE_ERROR nms_res = ei_run_nms(impulse, &config->nms_config, &results);
-    if (nms_res != EI_IMPULSE_OK) {
-        return nms_res;
+    if (candidates > 0) {
+        EI_IMPULSE_ERROR nms_res = ei_nms_select(impulse, scratch, candidates, true /*clip_boxes*/, nms_config, false /*class_aware*/, &results);
+        if (nms_res != EI_IMPULSE_OK) {
+            return nms_res;
+        }
     }
 
     // if we didn't detect min required objects, fill the rest with fixed value
     size_t added_boxes_count = results.size();
-    size_t min_object_detection_count = config->object_detection_count;
+    size_t min_object_detection_count = object_detection_count;
     if (added_boxes_count < min_object_detection_count) {
         results.resize(min_object_detection_count);
         for (size_t ix = added_boxes_count; ix < min_object_detection_count; ix++) {
@@ -750,6 +990,35 @@ __attribute__((unused)) static EI_IMPULSE_ERROR process_yolov5_f32(ei_impulse_ha
     result->bounding_boxes_count = added_boxes_count;
 
     return EI_IMPULSE_OK;
+}
+#endif // #if EI_HAS_YOLOV5
+
+__attribute__((unused)) static EI_IMPULSE_ERROR process_yolov5_f32(ei_impulse_handle_t *handle,
+                                                                    uint32_t block_index,
+                                                                    uint32_t input_block_id,
+                                                                    ei_impulse_result_t *result,
+                                                                    void *config_ptr,
+                                                                    void *state) {
+#if EI_HAS_YOLOV5
+    const ei_impulse_t *impulse = handle->impulse;
+    const ei_fill_result_object_detection_f32_config_t *config = (ei_fill_result_object_detection_f32_config_t*)config_ptr;
+
+    ei::matrix_t* raw_output_mtx = NULL;
+    bool find_mtx_res = find_mtx_by_idx(result->_raw_outputs, &raw_output_mtx, input_block_id, impulse->output_tensors_size);
+    if (!find_mtx_res) {
+        return EI_IMPULSE_OUTPUT_TENSOR_NULL;
+    }
+
+    return fill_result_struct_yolov5_common(impulse,
+                                            result,
+                                            config->version,
+                                            raw_output_mtx->buffer,
+                                            0.0f,
+                                            1.0f,
+                                            config->output_features_count,
+                                            config->threshold,
+                                            config->object_detection_count,
+                                            &config->nms_config);
 #else
     return EI_IMPULSE_LAST_LAYER_NOT_AVAILABLE;
 #endif
@@ -772,88 +1041,16 @@ __attribute__((unused)) static EI_IMPULSE_ERROR process_yolov5_i8(ei_impulse_han
         return EI_IMPULSE_OUTPUT_TENSOR_NULL;
     }
 
-    static std::vector<ei_impulse_result_bounding_box_t> results;
-    results.clear();
-
-    size_t col_size = 5 + impulse->label_count;
-    size_t row_count = config->output_features_count / col_size;
-
-    for (size_t ix = 0; ix < row_count; ix++) {
-        size_t base_ix = ix * col_size;
-        float xc = (raw_output_mtx->buffer[base_ix + 0] - config->zero_point) * config->scale;
-        float yc = (raw_output_mtx->buffer[base_ix + 1] - config->zero_point) * config->scale;
-        float w = (raw_output_mtx->buffer[base_ix + 2] - config->zero_point) * config->scale;
-        float h = (raw_output_mtx->buffer[base_ix + 3] - config->zero_point) * config->scale;
-        float x = xc - (w / 2.0f);
-        float y = yc - (h / 2.0f);
-        if (x < 0) {
-            x = 0;
-        }
-        if (y < 0) {
-            y = 0;
-        }
-        if (x + w > impulse->input_width) {
-            w = impulse->input_width - x;
-        }
-        if (y + h > impulse->input_height) {
-            h = impulse->input_height - y;
-        }
-
-        if (w < 0 || h < 0) {
-            continue;
-        }
-
-        float score = (raw_output_mtx->buffer[base_ix + 4] - config->zero_point) * config->scale;
-
-        uint32_t label = 0;
-        float highest_value = 0.0f;
-        for (size_t lx = 0; lx < impulse->label_count; lx++) {
-            float l = raw_output_mtx->buffer[base_ix + 5 + lx];
-            if (l > highest_value) {
-                label = lx;
-                highest_value = l;
-            }
-        }
-
-        if (score >= config->threshold && score <= 1.0f) {
-            ei_impulse_result_bounding_box_t r;
-            r.label = impulse->categories[label];
-
-            if (config->version != 5) {
-                x *= static_cast<float>(impulse->input_width);
-                y *= static_cast<float>(impulse->input_height);
-                w *= static_cast<float>(impulse->input_width);
-                h *= static_cast<float>(impulse->input_height);
-            }
-
-            r.x = static_cast<uint32_t>(x);
-            r.y = static_cast<uint32_t>(y);
-            r.width = static_cast<uint32_t>(w);
-            r.height = static_cast<uint32_t>(h);
-            r.value = score;
-            results.push_back(r);
-        }
-    }
-
-    EI_IMPULSE_ERROR nms_res = ei_run_nms(impulse, &config->nms_config, &results);
-    if (nms_res != EI_IMPULSE_OK) {
-        return nms_res;
-    }
-
-    // if we didn't detect min required objects, fill the rest with fixed value
-    size_t added_boxes_count = results.size();
-    size_t min_object_detection_count = config->object_detection_count;
-    if (added_boxes_count < min_object_detection_count) {
-        results.resize(min_object_detection_count);
-        for (size_t ix = added_boxes_count; ix < min_object_detection_count; ix++) {
-            results[ix].value = 0.0f;
-        }
-    }
-
-    result->bounding_boxes = results.data();
-    result->bounding_boxes_count = added_boxes_count;
-
-    return EI_IMPULSE_OK;
+    return fill_result_struct_yolov5_common(impulse,
+                                            result,
+                                            config->version,
+                                            raw_output_mtx->buffer,
+                                            config->zero_point,
+                                            config->scale,
+                                            config->output_features_count,
+                                            config->threshold,
+                                            config->object_detection_count,
+                                            &config->nms_config);
 #else
     return EI_IMPULSE_LAST_LAYER_NOT_AVAILABLE;
 #endif
@@ -2020,36 +2217,54 @@ __attribute__((unused)) static EI_IMPULSE_ERROR fill_result_struct_yolo_pro_comm
     size_t row_count = output_features_count / col_size;
 
     static std::vector<ei_impulse_result_bounding_box_t> results;
-    static std::vector<ei_impulse_result_bounding_box_t> class_results;
     results.clear();
 
+    const ei_score_filter_t<T> score_filter = ei_make_score_filter(data, threshold, zero_point, scale);
+    ei_nms_scratch_t *scratch = ei_nms_get_scratch();
+    size_t candidates = 0;
+
     // (xmin, ymin, xmax, ymax, cls...)
-    for (size_t cls_idx = 0; cls_idx < (size_t)impulse->label_count; cls_idx++)  {
+    // scan the class scores of a row on the raw values, the box is only decoded if one passes
+    for (size_t ix = 0; ix < row_count && score_filter.any; ix++) {
+        size_t base_ix = ix * col_size;
+        const T *cls_scores = data + base_ix + 4;
+        bool have_box = false;
+        float xmin = 0, ymin = 0, xmax = 0, ymax = 0;
 
-        std::vector<float> boxes;
-        std::vector<float> scores;
-        std::vector<int> classes;
-        class_results.clear();
+        for (size_t cls_idx = 0; ; cls_idx++) {
+            cls_idx += ei_score_filter_find(score_filter, cls_scores + cls_idx, impulse->label_count - cls_idx);
+            if (cls_idx >= impulse->label_count) {
+                break;
+            }
 
+            float score = (static_cast<float>(cls_scores[cls_idx]) - zero_point) * scale;
+            if (score < threshold || score > 1.0f) {
+                continue;
+            }
 
-        for (size_t ix = 0; ix < row_count; ix++) {
-            size_t base_ix = ix * col_size;
-            float xmin  = (static_cast<float>(data[base_ix + 0]) - zero_point) * scale;
-            float ymin  = (static_cast<float>(data[base_ix + 1]) - zero_point) * scale;
-            float xmax  = (static_cast<float>(data[base_ix + 2]) - zero_point) * scale;
-            float ymax  = (static_cast<float>(data[base_ix + 3]) - zero_point) * scale;
-            float score = (static_cast<float>(data[base_ix + 4 + cls_idx]) - zero_point) * scale;
-
-            if (xmin < 0) xmin = 0;
-            if (xmin > 1) xmin = 1;
-            if (ymin < 0) ymin = 0;
-            if (ymin > 1) ymin = 1;
-            if (ymax < 0) ymax = 0;
-            if (ymax > 1) ymax = 1;
-            if (xmax < 0) xmax = 0;
-            if (xmax > 1) xmax = 1;
-            if (xmax < xmin) xmax = xmin;
-            if (ymax < ymin) ymax = ymin;
+            if (!have_box) {
+                xmin  = (static_cast<float>(data[base_ix + 0]) - zero_point) * scale;
+                ymin  = (static_cast<float>(data[base_ix + 1]) - zero_point) * scale;
+                xmax  = (static_cast<float>(data[base_ix + 2]) - zero_point) * scale;
+                ymax  = (static_cast<float>(data[base_ix + 3]) - zero_point) * scale;
+
+                if (xmin < 0) xmin = 0;
+                if (xmin > 1) xmin = 1;
+                if (ymin < 0) ymin = 0;
+                if (ymin > 1) ymin = 1;
+                if (ymax < 0) ymax = 0;
+                if (ymax > 1) ymax = 1;
+                if (xmax < 0) xmax = 0;
+                if (xmax > 1) xmax = 1;
+                if (xmax < xmin) xmax = xmin;
+                if (ymax < ymin) ymax = ymin;
+
+                ymin *= static_cast<float>(impulse->input_height);
+                xmin *= static_cast<float>(impulse->input_width);
+                ymax *= static_cast<float>(impulse->input_height);
+                xmax *= static_cast<float>(impulse->input_width);
+                have_box = true;
+            }
 
 #if EI_LOG_LEVEL == EI_LOG_LEVEL_DEBUG
                 ei_printf("%s (", impulse->categories[(uint32_t)cls_idx]);
@@ -2067,39 +2282,18 @@ __attribute__((unused)) static EI_IMPULSE_ERROR fill_result_struct_yolo_pro_comm
                 ei_printf(" ]\n");
 #endif
 
-            if (score >= threshold && score <= 1.0f) {
-                ymin *= static_cast<float>(impulse->input_height);
-                xmin *= static_cast<float>(impulse->input_width);
-                ymax *= static_cast<float>(impulse->input_height);
-                xmax *= static_cast<float>(impulse->input_width);
-
-                boxes.push_back(ymin);
-                boxes.push_back(xmin);
-                boxes.push_back(ymax);
-                boxes.push_back(xmax);
-                scores.push_back(score);
-                classes.push_back((int)cls_idx);
+            if (!ei_nms_add_box(scratch, &candidates, ymin, xmin, ymax, xmax, score, (int)cls_idx)) {
+                return EI_IMPULSE_OUT_OF_MEMORY;
             }
         }
+    }
 
-        size_t nr_boxes = scores.size();
-
-        EI_IMPULSE_ERROR nms_res = ei_run_nms(impulse,
-                                            &class_results,
-                                            boxes.data(),
-                                            scores.data(),
-                                            classes.data(),
-                                            nr_boxes,
-                                            true /*clip_boxes*/,
-                                            &nms_config);
-
+    // boxes only suppress boxes of their own class, same as running NMS per class
+    if (candidates > 0) {
+        EI_IMPULSE_ERROR nms_res = ei_nms_select(impulse, scratch, candidates, true /*clip_boxes*/, &nms_config, true /*class_aware*/, &results);
         if (nms_res != EI_IMPULSE_OK) {
             return nms_res;
         }
-
-        for (auto bb: class_results) {
-            results.push_back(bb);
-        }
     }
 
     prepare_nms_results_common(object_detection_count, result, &results);
@@ -2188,18 +2382,29 @@ __attribute__((unused)) static EI_IMPULSE_ERROR fill_result_struct_yolov11_commo
     size_t col_size = output_features_count / row_count;
 
     static std::vector<ei_impulse_result_bounding_box_t> results;
-    static std::vector<ei_impulse_result_bounding_box_t> class_results;
     results.clear();
 
+    const ei_score_filter_t<T> score_filter = ei_make_score_filter(data, threshold, zero_point, scale);
+    ei_nms_scratch_t *scratch = ei_nms_get_scratch();
+    size_t candidates = 0;
+
     // output shape: (num_classes + 4, num_detections) e.g. (5, 189)
     //  [0] -> (xcenter, ycenter, width, height, cls...)
-    for (size_t cls_idx = 0; cls_idx < (size_t)impulse->label_count; cls_idx++)  {
-        std::vector<float> boxes;
-        std::vector<float> scores;
-        std::vector<int> classes;
-        class_results.clear();
+    // the scores of a class are contiguous, so scan those on the raw values and only decode
+    // the boxes of the detections that pass
+    for (size_t cls_idx = 0; cls_idx < (size_t)impulse->label_count && score_filter.any; cls_idx++)  {
+        const T *cls_scores = data + ((4 + cls_idx) * col_size);
+
+        for (size_t det_idx = 0; ; det_idx++) {
+            det_idx += ei_score_filter_find(score_filter, cls_scores + det_idx, col_size - det_idx);
+            if (det_idx >= col_size) {
+                break;
+            }
 
-        for (size_t det_idx = 0; det_idx < col_size; det_idx++) {
+            float score = (static_cast<float>(cls_scores[det_idx]) - zero_point) * scale;
+            if (score < threshold || score > 1.0f) {
+                continue;
+            }
 
             float xcenter = (static_cast<float>(data[0 * col_size + det_idx]) - zero_point) * scale;
             float ycenter = (static_cast<float>(data[1 * col_size + det_idx]) - zero_point) * scale;
@@ -2245,8 +2450,6 @@ __attribute__((unused)) static EI_IMPULSE_ERROR fill_result_struct_yolov11_commo
                 ymax = impulse->input_height;
             }
 
-            float score = (static_cast<float>(data[(4+cls_idx) * col_size + det_idx]) - zero_point) * scale;
-
 #if EI_LOG_LEVEL == EI_LOG_LEVEL_DEBUG
                 ei_printf("%s (", impulse->categories[(uint32_t)cls_idx]);
                 ei_printf_float(cls_idx);
@@ -2263,34 +2466,18 @@ __attribute__((unused)) static EI_IMPULSE_ERROR fill_result_struct_yolov11_commo
                 ei_printf(" ]\n");
 #endif
 
-            if (score >= threshold && score <= 1.0f) {
-                boxes.push_back(ymin);
-                boxes.push_back(xmin);
-                boxes.push_back(ymax);
-                boxes.push_back(xmax);
-                scores.push_back(score);
-                classes.push_back((int)cls_idx);
+            if (!ei_nms_add_box(scratch, &candidates, ymin, xmin, ymax, xmax, score, (int)cls_idx)) {
+                return EI_IMPULSE_OUT_OF_MEMORY;
             }
         }
+    }
 
-        size_t nr_boxes = scores.size();
-
-        EI_IMPULSE_ERROR nms_res = ei_run_nms(impulse,
-                                            &class_results,
-                                            boxes.data(),
-                                            scores.data(),
-                                            classes.data(),
-                                            nr_boxes,
-                                            true /*clip_boxes*/,
-                                            &nms_config);
-
+    // boxes only suppress boxes of their own class, same as running NMS per class
+    if (candidates > 0) {
+        EI_IMPULSE_ERROR nms_res = ei_nms_select(impulse, scratch, candidates, true /*clip_boxes*/, &nms_config, true /*class_aware*/, &results);
         if (nms_res != EI_IMPULSE_OK) {
             return nms_res;
         }
-
-        for (auto bb: class_results) {
-            results.push_back(bb);
-        }
     }
 
     prepare_nms_results_common(object_detection_count, result, &results);
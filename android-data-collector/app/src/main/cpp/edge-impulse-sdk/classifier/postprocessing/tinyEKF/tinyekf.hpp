@@ -28,30 +28,21 @@ void print_arr(T *arr, int m, int n, const char *name = "arr") {
 #endif
 }
 
-class TinyEKF {
+/**
+ * Transition, observation and noise models of the filter. These are the same for every filter
+ * with the same parameters, so they're kept apart from the state (x, P), which the caller owns;
+ * many filters can then share one model and keep their state in flat arrays.
+ */
+class TinyEKFModel {
 public:
-    TinyEKF(const float* x0, uint32_t EKF_N, uint32_t EKF_M,
-            float dt = 0.1,
-            float *u = nullptr,
+    TinyEKFModel(float dt = 0.1,
+            const float *u = nullptr,
             float process_noise_scale = 0.1,
             float observation_noise_scale=0.1)
 {
         // set private variables
-        this->EKF_N = EKF_N;
-        this->EKF_M = EKF_M;
         this->dt = dt;
 
-        x = new float[this->EKF_N];
-        memset(x, 0, sizeof(float) * this->EKF_N);
-        // x is the state
-        x[0] = x0[0];
-        x[1] = x0[1];
-        x[2] = x0[0];
-        x[3] = x0[1];
-
-        // print init x
-        print_arr(x, 1, this->EKF_N, "init x");
-
         // F is the state transition model
         // self.F = np.array(
         //     [[1, 0, self.dt, 0],
@@ -60,7 +51,6 @@ public:
         //      [0, 0, 0, 1]]
         // )
 
-        F = new float[16];
         memset(F, 0, sizeof(float) * 16);
         for (int i = 0; i < 4; ++i) {
             for (int j = 0; j < 4; ++j) {
@@ -73,7 +63,6 @@ public:
         print_arr(F, 4, 4, "init F");
 
         // H is the observation model
-        H = new float[8];
         memset(H, 0, sizeof(float) * 8);
 
         H[0] = H[5] = 1;
@@ -82,7 +71,6 @@ public:
         print_arr(H, 2, 4, "init H");
 
         // Q is the covariance of the process noise
-        Q = new float[16];
         memset(Q, 0, sizeof(float) * 16);
 
         // self.Q = (
@@ -111,7 +99,6 @@ public:
         print_arr(Q, 4, 4, "init Q");
 
         // R is the covariance of the observation noise
-        R = new float[4];
         memset(R, 0, sizeof(float) * 4);
 
         for (int i = 0; i < 2; ++i) {
@@ -130,60 +117,39 @@ public:
         //      [0, self.dt]]
         // )
 
-        B = new float[this->EKF_N * this->EKF_N * 2];
-        memset(B, 0, sizeof(float) * this->EKF_N * this->EKF_N * 2);
+        memset(B, 0, sizeof(B));
         B[0] = B[3] = (dt * dt) / 2;
         B[4] = B[7] = dt;
 
         if (u == nullptr) {
-            u = new float[2];
-            u[0] = u[1] = 0.1;
+            this->u[0] = this->u[1] = 0.1;
         }
-        this->u = u;
-
-        // P is the predict / update transition
-        P = new float[16];
-        memset(P, 0, sizeof(float) * 16);
-
-        for (int i = 0; i < 4; ++i) {
-            for (int j = 0; j < 4; ++j) {
-                P[i * 4 + j] = (i == j) ? 1 : 0;
-            }
+        else {
+            this->u[0] = u[0];
+            this->u[1] = u[1];
         }
-
-        // print P
-        print_arr(P, 4, 4, "init P");
     }
 
-    ~TinyEKF() {
-        delete[] x;
-        delete[] P;
-        delete[] Q;
-        delete[] F;
-        delete[] H;
-        delete[] R;
-        delete[] B;
-        delete[] u;
-    }
+    /**
+     * Initial state for observation x0
+     * @param x  state, 8 floats (4x2)
+     * @param P  covariance, 16 floats (4x4)
+     */
+    void init(const float *x0, float *x, float *P) const;
+    void predict(float *x, float *P) const;
+    bool update(float *x, float *P, const float *z, const float *hx) const;
 
-    void predict(const float *fx);
-    bool update(const float *z, const float *hx);
-    float *x;
 private:
-    uint32_t EKF_N;
-    uint32_t EKF_M;
+    float Q[16];
+    float F[16];
+    float H[8];
+    float R[4];
 
-    float *P;
-    float *Q;
-    float *F;
-    float *H;
-    float *R;
-
-    float *B;
-    float *u;
+    float B[8];
+    float u[2];
     float dt;
 
-    void update_step3(float *GH);
+    void update_step3(float *P, float *GH) const;
 
     /// @private
     static void _mulmat(
@@ -370,7 +336,31 @@ private:
     }
 };
 
-void TinyEKF::predict(const float *fx) {
+void TinyEKFModel::init(const float *x0, float *x, float *P) const {
+    memset(x, 0, sizeof(float) * 8);
+    // x is the state
+    x[0] = x0[0];
+    x[1] = x0[1];
+    x[2] = x0[0];
+    x[3] = x0[1];
+
+    // print init x
+    print_arr(x, 1, 8, "init x");
+
+    // P is the predict / update transition
+    memset(P, 0, sizeof(float) * 16);
+
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            P[i * 4 + j] = (i == j) ? 1 : 0;
+        }
+    }
+
+    // print P
+    print_arr(P, 4, 4, "init P");
+}
+
+void TinyEKFModel::predict(float *x, float *P) const {
 
     // self.x = self.F @ self.x + self.B @ self.u
 
@@ -381,25 +371,25 @@ void TinyEKF::predict(const float *fx) {
     print_arr(Bu, 4, 1, "Bu");
 
     // print x before
-    print_arr(this->x, 1, 4, "x before");
+    print_arr(x, 1, 4, "x before");
 
     float Fx[8];
-    _mulmat(this->F, this->x, Fx, 4, 4, 2);
+    _mulmat(this->F, x, Fx, 4, 4, 2);
 
     // print Fx
     print_arr(Fx, 4, 2, "Fx");
     // print x after
-    print_arr(this->x, 1, 4, "x after");
-
-    //_addmat(Fx, Bu, this->x, 4, 1);
-    this->x[0] = Fx[0] + Bu[0];
-    this->x[1] = Fx[1] + Bu[1];
-    this->x[2] = Fx[2] + Bu[0];
-    this->x[3] = Fx[3] + Bu[1];
-    this->x[4] = Fx[4] + Bu[2];
-    this->x[5] = Fx[5] + Bu[3];
-    this->x[6] = Fx[6] + Bu[2];
-    this->x[7] = Fx[7] + Bu[3];
+    print_arr(x, 1, 4, "x after");
+
+    //_addmat(Fx, Bu, x, 4, 1);
+    x[0] = Fx[0] + Bu[0];
+    x[1] = Fx[1] + Bu[1];
+    x[2] = Fx[2] + Bu[0];
+    x[3] = Fx[3] + Bu[1];
+    x[4] = Fx[4] + Bu[2];
+    x[5] = Fx[5] + Bu[3];
+    x[6] = Fx[6] + Bu[2];
+    x[7] = Fx[7] + Bu[3];
 
     // this is the formula for the next part
     // self.P_pre = np.dot(F, self.P_post).dot(F.T) + Q
@@ -425,7 +415,7 @@ void TinyEKF::predict(const float *fx) {
     print_arr(P, 4, 4, "P");
 }
 
-bool TinyEKF::update(const float *z, const float *hx) {
+bool TinyEKFModel::update(float *x, float *P, const float *z, const float *hx) const {
 
     float Ht[8];
     _transpose(H, Ht, 2, 4);
@@ -457,7 +447,7 @@ bool TinyEKF::update(const float *z, const float *hx) {
     print_arr(G, 4, 2, "G");
 
     // print x
-    print_arr(this->x, 1, 4, "x in update");
+    print_arr(x, 1, 4, "x in update");
 
     // we get hx as an argument to function
     float z_hx[4];
@@ -476,16 +466,16 @@ bool TinyEKF::update(const float *z, const float *hx) {
     // // print Gz_hx
     print_arr(Gz_hx, 4, 2, "Gz_hx");
 
-    _addvec(this->x, Gz_hx, this->x, 8);
+    _addvec(x, Gz_hx, x, 8);
 
     float GH[16];
     _mulmat(G, H, GH, 4, 2, 4);
-    update_step3(GH);
+    update_step3(P, GH);
     return true;
 }
 
 /// @private
-void TinyEKF::update_step3(float *GH)
+void TinyEKFModel::update_step3(float *P, float *GH) const
 {
     _negate(GH, 4, 4);
     _addeye(GH, 4);
@@ -493,4 +483,34 @@ void TinyEKF::update_step3(float *GH)
     float GHP[16];
     _mulmat(GH, P, GHP, 4, 4, 4);
     memcpy(P, GHP, 16 * sizeof(float));
-}
\ No newline at end of file
+}
+
+/**
+ * Filter with its own model and state
+ */
+class TinyEKF {
+public:
+    // the state is 4x2, EKF_N has to be 8 (EKF_M is unused)
+    TinyEKF(const float* x0, uint32_t EKF_N, uint32_t EKF_M,
+            float dt = 0.1,
+            float *u = nullptr,
+            float process_noise_scale = 0.1,
+            float observation_noise_scale=0.1)
+        : model(dt, u, process_noise_scale, observation_noise_scale)
+    {
+        model.init(x0, x, P);
+    }
+
+    void predict(const float *fx) {
+        model.predict(x, P);
+    }
+
+    bool update(const float *z, const float *hx) {
+        return model.update(x, P, z, hx);
+    }
+
+    float x[8];
+private:
+    TinyEKFModel model;
+    float P[16];
+};
@@ -77,6 +77,14 @@
     #endif
 #endif // EIDSP_USE_NEON
 
+#ifndef EIDSP_USE_SSE2
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define EIDSP_USE_SSE2      1
+    #else
+        #define EIDSP_USE_SSE2      0
+    #endif
+#endif // EIDSP_USE_SSE2
+
 #ifndef EIDSP_USE_ASSERTS
 #define EIDSP_USE_ASSERTS        0
 #endif // EIDSP_USE_ASSERTS
@@ -110,6 +118,48 @@
 #define EIDSP_SIGNAL_C_FN_POINTER    0
 #endif // EIDSP_SIGNAL_C_FN_POINTER
 
+// storage class for the little DSP state that can't be passed through a signal_t
+// (e.g. the preemphasis filter), thread local where available so impulse handles
+// can run on multiple threads at once
+#ifndef EIDSP_THREAD_LOCAL
+#if defined(__unix__) || defined(__APPLE__) || defined(_WIN32)
+#define EIDSP_THREAD_LOCAL           thread_local
+#else
+#define EIDSP_THREAD_LOCAL
+#endif
+#endif // EIDSP_THREAD_LOCAL
+
+// number of FFT plans (kissfft twiddles + scratch buffers) and mel filterbanks that are
+// kept around per thread, so the frame loops of the audio blocks don't rebuild them on
+// every frame / slice. 0 disables the caches (saves the RAM on small targets)
+#ifndef EIDSP_PLAN_CACHE_SIZE
+#if defined(__unix__) || defined(__APPLE__) || defined(_WIN32)
+#define EIDSP_PLAN_CACHE_SIZE        4
+#else
+#define EIDSP_PLAN_CACHE_SIZE        0
+#endif
+#endif // EIDSP_PLAN_CACHE_SIZE
+
+// compile in the stage timers (EI_PROFILE_SCOPE, see dsp/ei_profiler.h). They only time
+// anything after ei_profiler_start(), until then every scope costs a single load
+#ifndef EIDSP_PROFILING
+#if defined(__unix__) || defined(__APPLE__) || defined(_WIN32)
+#define EIDSP_PROFILING              1
+#else
+#define EIDSP_PROFILING              0
+#endif
+#endif // EIDSP_PROFILING
+
+// count the bytes allocated through ei_malloc / ei_calloc per stage (see dsp/ei_memory_accounting.h),
+// a few relaxed atomic adds per allocation
+#ifndef EIDSP_MEMORY_ACCOUNTING
+#if defined(__unix__) || defined(__APPLE__)
+#define EIDSP_MEMORY_ACCOUNTING      1
+#else
+#define EIDSP_MEMORY_ACCOUNTING      0
+#endif
+#endif // EIDSP_MEMORY_ACCOUNTING
+
 #ifndef EIDSP_USE_ESP_DSP
 #if defined(ESP32) || defined(CONFIG_IDF_TARGET_ESP32) || defined(CONFIG_IDF_TARGET_ESP32S3) || defined(CONFIG_IDF_TARGET_ESP32P4) || defined(CONFIG_IDF_TARGET_ESP32C3)
 #define EIDSP_USE_ESP_DSP 1
@@ -0,0 +1,444 @@
+/*
+ * Copyright (c) 2024 EdgeImpulse Inc.
+ *
+ * Generated by Edge Impulse and licensed under the applicable Edge Impulse
+ * Terms of Service. Community and Professional Terms of Service
+ * (https://edgeimpulse.com/legal/terms-of-service) or Enterprise Terms of
+ * Service (https://edgeimpulse.com/legal/enterprise-terms-of-service),
+ * according to your product plan subscription (the “License”).
+ *
+ * This software, documentation and other associated files (collectively referred
+ * to as the “Software”) is a single SDK variation generated by the Edge Impulse
+ * platform and requires an active paid Edge Impulse subscription to use this
+ * Software for any purpose.
+ *
+ * You may NOT use this Software unless you have an active Edge Impulse subscription
+ * that meets the eligibility requirements for the applicable License, subject to
+ * your full and continued compliance with the terms and conditions of the License,
+ * including without limitation any usage restrictions under the applicable License.
+ *
+ * If you do not have an active Edge Impulse product plan subscription, or if use
+ * of this Software exceeds the usage limitations of your Edge Impulse product plan
+ * subscription, you are not permitted to use this Software and must immediately
+ * delete and erase all copies of this Software within your control or possession.
+ * Edge Impulse reserves all rights and remedies available to enforce its rights.
+ *
+ * Unless required by applicable law or agreed to in writing, the Software is
+ * distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing
+ * permissions, disclaimers and limitations under the License.
+ */
+#ifndef __EI_DSP_WINDOW_STATE__H__
+#define __EI_DSP_WINDOW_STATE__H__
+
+#include <math.h>
+#include "edge-impulse-sdk/dsp/returntypes.hpp"
+#include "edge-impulse-sdk/dsp/numpy.hpp"
+#include "edge-impulse-sdk/dsp/config.hpp"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+
+/**
+ * Sliding window over the raw input of a (non-audio) DSP block, for run_classifier_continuous().
+ *
+ * Slices are pushed into a ring buffer (one row per axis) that always holds the last
+ * window_length frames. Running power sums make the mean / moments of every axis available in
+ * O(1), min / max are only rescanned when the current extreme leaves the window, and the power
+ * spectra of full FFT frames are cached, so a new slice costs O(slice) instead of O(window).
+ *
+ * Values are stored unscaled (as read from the signal), scale_axes is applied to the features.
+ */
+class ei_dsp_window_state_t {
+public:
+    ei_dsp_window_state_t(size_t axes, size_t window_length)
+        : axes(axes), window_length(window_length)
+    {
+        buffer = (float*)ei_calloc(axes * window_length, sizeof(float));
+        sums = (axis_sums_t*)ei_calloc(axes, sizeof(axis_sums_t));
+    }
+
+    ~ei_dsp_window_state_t() {
+        ei_free(buffer);
+        ei_free(sums);
+        ei_free(scratch);
+        ei_free(frame_spectra);
+        ei_free(frame_sums);
+        ei_free(frame_end);
+        ei_free(frame_buffer);
+        ei_free(means);
+        ei_free(page);
+    }
+
+    /**
+     * @return false if any of the buffers failed to allocate
+     */
+    bool is_valid() const {
+        return buffer != nullptr && sums != nullptr;
+    }
+
+    bool is_full() const {
+        return count == window_length;
+    }
+
+    size_t get_axes() const {
+        return axes;
+    }
+
+    size_t get_window_length() const {
+        return window_length;
+    }
+
+    /**
+     * Frames pushed since the window was created
+     */
+    uint64_t get_frames_pushed() const {
+        return frames_pushed;
+    }
+
+    /**
+     * Value ix (0 = oldest) of an axis in the window
+     */
+    float get(size_t axis, size_t ix) const {
+        size_t pos = head + ix;
+        if (pos >= window_length) {
+            pos -= window_length;
+        }
+        return buffer[(axis * window_length) + pos];
+    }
+
+    /**
+     * Append an (interleaved) slice of frames, dropping the oldest frames from the window
+     */
+    int push(ei::signal_t *signal) {
+        if (signal->total_length % axes != 0) {
+            EIDSP_ERR(ei::EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        // read in pages, so we don't need a buffer the size of the slice
+        if (page == nullptr) {
+            page = (float*)ei_calloc(page_frames * axes, sizeof(float));
+            if (page == nullptr) {
+                EIDSP_ERR(ei::EIDSP_OUT_OF_MEM);
+            }
+        }
+
+        const size_t frames = signal->total_length / axes;
+        for (size_t frame_ix = 0; frame_ix < frames; frame_ix += page_frames) {
+            size_t n = frames - frame_ix > page_frames ? page_frames : frames - frame_ix;
+            int ret = signal->get_data(frame_ix * axes, n * axes, page);
+            if (ret != 0) {
+                EIDSP_ERR(ret);
+            }
+            for (size_t ix = 0; ix < n; ix++) {
+                push_frame(page + (ix * axes));
+            }
+        }
+
+        return ei::EIDSP_OK;
+    }
+
+    double get_mean(size_t axis) const {
+        return sums[axis].shift + (sums[axis].s1 / count);
+    }
+
+    /**
+     * Mean and central moments (divided by n, like numpy::stdev / skew / kurtosis) of an axis
+     */
+    void get_moments(size_t axis, double *mean, double *m2, double *m3, double *m4) const {
+        const axis_sums_t &s = sums[axis];
+        const double n = (double)count;
+        const double mu = s.s1 / n;
+        const double e2 = s.s2 / n;
+        const double e3 = s.s3 / n;
+        const double e4 = s.s4 / n;
+        const double mu2 = mu * mu;
+
+        *mean = s.shift + mu;
+        *m2 = e2 - mu2;
+        *m3 = e3 - (3.0 * mu * e2) + (2.0 * mu2 * mu);
+        *m4 = e4 - (4.0 * mu * e3) + (6.0 * mu2 * e2) - (3.0 * mu2 * mu2);
+        // cancellation can leave a tiny negative variance for a constant signal
+        if (*m2 < 0.0) {
+            *m2 = 0.0;
+        }
+        if (*m4 < 0.0) {
+            *m4 = 0.0;
+        }
+    }
+
+    float get_min(size_t axis) {
+        if (sums[axis].rescan) {
+            rescan_min_max(axis);
+        }
+        return sums[axis].min;
+    }
+
+    float get_max(size_t axis) {
+        if (sums[axis].rescan) {
+            rescan_min_max(axis);
+        }
+        return sums[axis].max;
+    }
+
+    /**
+     * The window as an (interleaved) frames x axes buffer, e.g. to run a block over the full window
+     * @return nullptr if out of memory
+     */
+    float* get_interleaved() {
+        if (scratch == nullptr) {
+            scratch = (float*)ei_calloc(axes * window_length, sizeof(float));
+            if (scratch == nullptr) {
+                return nullptr;
+            }
+        }
+        for (size_t ix = 0; ix < count; ix++) {
+            for (size_t axis = 0; axis < axes; axis++) {
+                scratch[(ix * axes) + axis] = get(axis, ix);
+            }
+        }
+        return scratch;
+    }
+
+    /**
+     * Set up the cache of power spectra of full FFT frames (frames start every hop frames,
+     * counted from the start of the window). Frees the cache if the layout changed.
+     * @return false if out of memory
+     */
+    bool init_frame_cache(size_t fft_length, size_t hop) {
+        if (frame_spectra && this->fft_length == fft_length && this->hop == hop) {
+            return true;
+        }
+        ei_free(frame_spectra);
+        ei_free(frame_sums);
+        ei_free(frame_end);
+        ei_free(frame_buffer);
+
+        this->fft_length = fft_length;
+        this->hop = hop;
+        frame_slots = window_length >= fft_length ? ((window_length - fft_length) / hop) + 1 : 1;
+        const size_t bins = (fft_length / 2) + 1;
+        frame_spectra = (float*)ei_calloc(frame_slots * axes * bins, sizeof(float));
+        frame_sums = (double*)ei_calloc(frame_slots * axes, sizeof(double));
+        frame_end = (uint64_t*)ei_calloc(frame_slots, sizeof(uint64_t));
+        frame_buffer = (float*)ei_calloc(fft_length, sizeof(float));
+        if (!frame_spectra || !frame_sums || !frame_end || !frame_buffer) {
+            ei_free(frame_spectra);
+            ei_free(frame_sums);
+            ei_free(frame_end);
+            ei_free(frame_buffer);
+            frame_spectra = nullptr;
+            frame_sums = nullptr;
+            frame_end = nullptr;
+            frame_buffer = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Power spectrum (fft_length / 2 + 1 bins) of the full frame ending at window index end
+     * (exclusive), computed once and then served from the cache. The frame mean is removed
+     * before the FFT (only bin 0 depends on it), *frame_sum is the sum of the frame.
+     * Only valid when get_frames_pushed() and the window length are multiples of the hop.
+     */
+    const float* get_frame_spectrum(size_t axis, size_t end, double *frame_sum) {
+        const size_t bins = (fft_length / 2) + 1;
+        const uint64_t abs_end = (frames_pushed - count) + end;
+        const size_t slot = (size_t)((abs_end / hop) % frame_slots);
+
+        // marker + 1, so 0 means "empty"
+        if (frame_end[slot] != abs_end + 1) {
+            for (size_t a = 0; a < axes; a++) {
+                double sum = 0;
+                for (size_t ix = 0; ix < fft_length; ix++) {
+                    frame_buffer[ix] = get(a, end - fft_length + ix);
+                    sum += frame_buffer[ix];
+                }
+                const float frame_mean = (float)(sum / fft_length);
+                for (size_t ix = 0; ix < fft_length; ix++) {
+                    frame_buffer[ix] -= frame_mean;
+                }
+                float *spectrum = frame_spectra + (((slot * axes) + a) * bins);
+                ei::numpy::power_spectrum(frame_buffer, fft_length, spectrum, bins, fft_length);
+                frame_sums[(slot * axes) + a] = sum;
+            }
+            frame_end[slot] = abs_end + 1;
+        }
+
+        *frame_sum = frame_sums[(slot * axes) + axis];
+        return frame_spectra + (((slot * axes) + axis) * bins);
+    }
+
+    /**
+     * Scratch buffer of fft_length floats (valid after init_frame_cache())
+     */
+    float* get_frame_buffer() {
+        return frame_buffer;
+    }
+
+    /**
+     * Add the (scaled) mean of every axis of the current window to the moving average of the
+     * flatten block, which averages the means of the last num_windows calls
+     */
+    int push_window_means(float scale, size_t num_windows) {
+        if (means == nullptr) {
+            means = (float*)ei_calloc(axes * num_windows, sizeof(float));
+            if (means == nullptr) {
+                EIDSP_ERR(ei::EIDSP_OUT_OF_MEM);
+            }
+            means_windows = num_windows;
+        }
+
+        for (size_t axis = 0; axis < axes; axis++) {
+            means[(axis * means_windows) + means_head] = (float)get_mean(axis) * scale;
+        }
+        means_head = means_head + 1 == means_windows ? 0 : means_head + 1;
+        if (means_count < means_windows) {
+            means_count++;
+        }
+        return ei::EIDSP_OK;
+    }
+
+    float get_moving_average(size_t axis) const {
+        return ei::numpy::mean(means + (axis * means_windows), means_count);
+    }
+
+    void* operator new(size_t size) {
+        return ei_malloc(size);
+    }
+
+    void operator delete(void* ptr) {
+        ei_free(ptr);
+    }
+
+private:
+    typedef struct {
+        double shift; // sums are of (x - shift), to keep them small for signals with an offset
+        double s1, s2, s3, s4;
+        float min, max;
+        bool rescan;
+    } axis_sums_t;
+
+    size_t axes;
+    size_t window_length;
+    float *buffer = nullptr; // axes rows of window_length, oldest value at head
+    size_t head = 0;
+    size_t count = 0;
+    uint64_t frames_pushed = 0;
+    axis_sums_t *sums = nullptr;
+    float *scratch = nullptr;
+
+    // power spectra of full FFT frames, see get_frame_spectrum()
+    size_t fft_length = 0;
+    size_t hop = 0;
+    size_t frame_slots = 0;
+    float *frame_spectra = nullptr;
+    double *frame_sums = nullptr;
+    uint64_t *frame_end = nullptr;
+    float *frame_buffer = nullptr;
+
+    // flatten moving average
+    float *means = nullptr;
+    size_t means_windows = 0;
+    size_t means_head = 0;
+    size_t means_count = 0;
+
+    static const size_t page_frames = 32;
+    float *page = nullptr;
+
+    void push_frame(const float *frame) {
+        size_t pos = head + count;
+        if (pos >= window_length) {
+            pos -= window_length;
+        }
+
+        for (size_t axis = 0; axis < axes; axis++) {
+            axis_sums_t &s = sums[axis];
+            float *value = buffer + (axis * window_length) + pos;
+
+            if (count == 0 && frames_pushed == 0) {
+                s.shift = frame[axis];
+                s.min = s.max = frame[axis];
+            }
+
+            if (count == window_length) {
+                const double old = (double)*value - s.shift;
+                const double old2 = old * old;
+                s.s1 -= old;
+                s.s2 -= old2;
+                s.s3 -= old2 * old;
+                s.s4 -= old2 * old2;
+                if (*value <= s.min || *value >= s.max) {
+                    s.rescan = true;
+                }
+            }
+
+            *value = frame[axis];
+            const double v = (double)frame[axis] - s.shift;
+            const double v2 = v * v;
+            s.s1 += v;
+            s.s2 += v2;
+            s.s3 += v2 * v;
+            s.s4 += v2 * v2;
+            if (!s.rescan) {
+                if (frame[axis] < s.min) {
+                    s.min = frame[axis];
+                }
+                if (frame[axis] > s.max) {
+                    s.max = frame[axis];
+                }
+            }
+        }
+
+        if (count == window_length) {
+            head = head + 1 == window_length ? 0 : head + 1;
+        }
+        else {
+            count++;
+        }
+        frames_pushed++;
+
+        // running sums drift (add / subtract of every value), recompute them once per window
+        if (frames_pushed % window_length == 0) {
+            for (size_t axis = 0; axis < axes; axis++) {
+                recompute_sums(axis);
+            }
+        }
+    }
+
+    void recompute_sums(size_t axis) {
+        axis_sums_t &s = sums[axis];
+        double mean = 0;
+        for (size_t ix = 0; ix < count; ix++) {
+            mean += get(axis, ix);
+        }
+        mean /= count;
+
+        s.shift = mean;
+        s.s1 = s.s2 = s.s3 = s.s4 = 0;
+        for (size_t ix = 0; ix < count; ix++) {
+            const double v = (double)get(axis, ix) - s.shift;
+            const double v2 = v * v;
+            s.s1 += v;
+            s.s2 += v2;
+            s.s3 += v2 * v;
+            s.s4 += v2 * v2;
+        }
+    }
+
+    void rescan_min_max(size_t axis) {
+        axis_sums_t &s = sums[axis];
+        s.min = s.max = get(axis, 0);
+        for (size_t ix = 1; ix < count; ix++) {
+            const float v = get(axis, ix);
+            if (v < s.min) {
+                s.min = v;
+            }
+            if (v > s.max) {
+                s.max = v;
+            }
+        }
+        s.rescan = false;
+    }
+};
+
+#endif // __EI_DSP_WINDOW_STATE__H__
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2024 EdgeImpulse Inc.
+ *
+ * Generated by Edge Impulse and licensed under the applicable Edge Impulse
+ * Terms of Service. Community and Professional Terms of Service
+ * (https://edgeimpulse.com/legal/terms-of-service) or Enterprise Terms of
+ * Service (https://edgeimpulse.com/legal/enterprise-terms-of-service),
+ * according to your product plan subscription (the “License”).
+ *
+ * This software, documentation and other associated files (collectively referred
+ * to as the “Software”) is a single SDK variation generated by the Edge Impulse
+ * platform and requires an active paid Edge Impulse subscription to use this
+ * Software for any purpose.
+ *
+ * You may NOT use this Software unless you have an active Edge Impulse subscription
+ * that meets the eligibility requirements for the applicable License, subject to
+ * your full and continued compliance with the terms and conditions of the License,
+ * including without limitation any usage restrictions under the applicable License.
+ *
+ * If you do not have an active Edge Impulse product plan subscription, or if use
+ * of this Software exceeds the usage limitations of your Edge Impulse product plan
+ * subscription, you are not permitted to use this Software and must immediately
+ * delete and erase all copies of this Software within your control or possession.
+ * Edge Impulse reserves all rights and remedies available to enforce its rights.
+ *
+ * Unless required by applicable law or agreed to in writing, the Software is
+ * distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing
+ * permissions, disclaimers and limitations under the License.
+ */
+#ifndef __EI_MEMORY_ACCOUNTING__H__
+#define __EI_MEMORY_ACCOUNTING__H__
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "edge-impulse-sdk/dsp/config.hpp"
+
+/**
+ * Memory accounting for everything allocated through ei_malloc / ei_calloc / ei_free (by the
+ * posix and Android porting layers, platforms with their own ei_malloc don't report). Counters
+ * are relaxed atomics and are always on, allocations are attributed to the stage of the calling
+ * thread (EI_MEMORY_STAGE), so steady state allocations and growth can be followed per stage
+ * without a debug build. Block sizes come from the allocator (malloc_usable_size), so no
+ * header is added to the blocks.
+ */
+
+#if EIDSP_MEMORY_ACCOUNTING == 1
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+typedef enum {
+    EI_MEMORY_STAGE_OTHER = 0,          /**< Outside of the stages below, e.g. init / deinit */
+    EI_MEMORY_STAGE_DSP,                /**< DSP blocks */
+    EI_MEMORY_STAGE_INPUT,              /**< Features and filling the input tensors */
+    EI_MEMORY_STAGE_ARENA,              /**< Building interpreters and their tensor arenas */
+    EI_MEMORY_STAGE_INFERENCE,          /**< Running the model */
+    EI_MEMORY_STAGE_POSTPROCESSING,     /**< Postprocessing (NMS, tracking, thresholds, ...) */
+    EI_MEMORY_STAGE_RESULTS,            /**< Result struct: classification and raw outputs */
+    EI_MEMORY_STAGE_COUNT
+} ei_memory_stage_t;
+
+/**
+ * Allocations and frees made while a stage was active. Frees count for the stage that frees,
+ * so a stage that keeps growing (allocated_bytes - freed_bytes) holds on to memory.
+ */
+typedef struct {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t allocated_bytes;
+    uint64_t freed_bytes;
+} ei_memory_stage_stats_t;
+
+/**
+ * Snapshot of the counters, see ei_memory_get_stats()
+ */
+typedef struct {
+    size_t in_use;                                      // bytes allocated right now
+    size_t peak;                                        // max. in_use since the last reset
+    uint32_t inferences;                                // impulse runs since the last reset
+    ei_memory_stage_stats_t stages[EI_MEMORY_STAGE_COUNT];
+} ei_memory_stats_t;
+
+class EiMemoryAccounting {
+public:
+    static EiMemoryAccounting &get() {
+        static EiMemoryAccounting instance;
+        return instance;
+    }
+
+    static ei_memory_stage_t &current_stage() {
+        static EIDSP_THREAD_LOCAL ei_memory_stage_t stage = EI_MEMORY_STAGE_OTHER;
+        return stage;
+    }
+
+    static size_t block_size(void *ptr) {
+#if defined(__APPLE__)
+        return malloc_size(ptr);
+#else
+        return malloc_usable_size(ptr);
+#endif
+    }
+
+    void on_alloc(void *ptr) {
+        if (!ptr) {
+            return;
+        }
+        size_t bytes = block_size(ptr);
+        counters_t &counters = stages[current_stage()];
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        counters.allocated_bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+        size_t now = in_use.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t max = peak.load(std::memory_order_relaxed);
+        while (now > max && !peak.compare_exchange_weak(max, now, std::memory_order_relaxed)) {
+        }
+    }
+
+    // call before the block is freed
+    void on_free(void *ptr) {
+        if (!ptr) {
+            return;
+        }
+        size_t bytes = block_size(ptr);
+        counters_t &counters = stages[current_stage()];
+        counters.frees.fetch_add(1, std::memory_order_relaxed);
+        counters.freed_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        in_use.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    void on_inference() {
+        inferences.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void reset() {
+        for (counters_t &counters : stages) {
+            counters.allocations.store(0, std::memory_order_relaxed);
+            counters.frees.store(0, std::memory_order_relaxed);
+            counters.allocated_bytes.store(0, std::memory_order_relaxed);
+            counters.freed_bytes.store(0, std::memory_order_relaxed);
+        }
+        inferences.store(0, std::memory_order_relaxed);
+        peak.store(in_use.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    void get_stats(ei_memory_stats_t *stats) {
+        stats->in_use = in_use.load(std::memory_order_relaxed);
+        stats->peak = peak.load(std::memory_order_relaxed);
+        stats->inferences = inferences.load(std::memory_order_relaxed);
+        for (int ix = 0; ix < EI_MEMORY_STAGE_COUNT; ix++) {
+            stats->stages[ix].allocations = stages[ix].allocations.load(std::memory_order_relaxed);
+            stats->stages[ix].frees = stages[ix].frees.load(std::memory_order_relaxed);
+            stats->stages[ix].allocated_bytes = stages[ix].allocated_bytes.load(std::memory_order_relaxed);
+            stats->stages[ix].freed_bytes = stages[ix].freed_bytes.load(std::memory_order_relaxed);
+        }
+    }
+
+private:
+    // one cache line per stage, threads in different stages don't contend
+    struct alignas(64) counters_t {
+        std::atomic<uint64_t> allocations { 0 };
+        std::atomic<uint64_t> frees { 0 };
+        std::atomic<uint64_t> allocated_bytes { 0 };
+        std::atomic<uint64_t> freed_bytes { 0 };
+    };
+
+    counters_t stages[EI_MEMORY_STAGE_COUNT];
+    std::atomic<size_t> in_use { 0 };
+    std::atomic<size_t> peak { 0 };
+    std::atomic<uint32_t> inferences { 0 };
+};
+
+/**
+ * Attributes the allocations of the calling thread to `stage` for the enclosing scope
+ */
+class EiMemoryStageScope {
+public:
+    EiMemoryStageScope(ei_memory_stage_t stage) : previous(EiMemoryAccounting::current_stage()) {
+        EiMemoryAccounting::current_stage() = stage;
+    }
+
+    ~EiMemoryStageScope() {
+        end();
+    }
+
+    void end() {
+        if (previous != EI_MEMORY_STAGE_COUNT) {
+            EiMemoryAccounting::current_stage() = previous;
+            previous = EI_MEMORY_STAGE_COUNT;
+        }
+    }
+
+private:
+    ei_memory_stage_t previous;
+};
+
+#define EI_MEMORY_CONCAT_(a, b)         a##b
+#define EI_MEMORY_CONCAT(a, b)          EI_MEMORY_CONCAT_(a, b)
+#define EI_MEMORY_STAGE(stage)          EiMemoryStageScope EI_MEMORY_CONCAT(ei_memory_stage_, __LINE__)(stage)
+// attribute part of a scope, id has to be unique within the scope
+#define EI_MEMORY_STAGE_BEGIN(id, stage) EiMemoryStageScope ei_memory_stage_##id(stage)
+#define EI_MEMORY_STAGE_END(id)         ei_memory_stage_##id.end()
+#define EI_MEMORY_COUNT_INFERENCE()     EiMemoryAccounting::get().on_inference()
+
+// hooks for the porting layer (ei_malloc / ei_calloc / ei_free)
+#define ei_memory_accounting_alloc(ptr) EiMemoryAccounting::get().on_alloc(ptr)
+#define ei_memory_accounting_free(ptr)  EiMemoryAccounting::get().on_free(ptr)
+
+static const char * const ei_memory_stage_names[EI_MEMORY_STAGE_COUNT] = {
+    "other", "dsp", "input", "arena", "inference", "postprocessing", "results"
+};
+
+/**
+ * @brief Get the memory counters. Diff two snapshots (or use ei_memory_reset_stats()) to get
+ * the allocations of a period, e.g. of a number of inferences in steady state.
+ *
+ * @param[out] stats Counters since the last reset, `in_use` since start
+ */
+__attribute__((unused)) static void ei_memory_get_stats(ei_memory_stats_t *stats) {
+    EiMemoryAccounting::get().get_stats(stats);
+}
+
+/**
+ * @brief Clear the allocation counters and the inference count, the peak restarts at the
+ * memory that is in use now.
+ */
+__attribute__((unused)) static void ei_memory_reset_stats(void) {
+    EiMemoryAccounting::get().reset();
+}
+
+/**
+ * Print the counters per stage, per inference where there were inferences
+ */
+__attribute__((unused)) static void ei_memory_print_stats(const ei_memory_stats_t *stats) {
+    const double inferences = stats->inferences > 0 ? stats->inferences : 1;
+
+    ei_printf("Memory over %u inference(s): %lu bytes in use, peak %lu bytes\n", (unsigned)stats->inferences,
+        (unsigned long)stats->in_use, (unsigned long)stats->peak);
+    ei_printf("  %-16s %12s %12s %14s %14s\n", "stage", "allocs/inf", "frees/inf", "bytes/inf", "net bytes");
+    for (int ix = 0; ix < EI_MEMORY_STAGE_COUNT; ix++) {
+        const ei_memory_stage_stats_t &stage = stats->stages[ix];
+        if (stage.allocations == 0 && stage.frees == 0) {
+            continue;
+        }
+        ei_printf("  %-16s %12.2f %12.2f %14.1f %14lld\n", ei_memory_stage_names[ix],
+            (double)stage.allocations / inferences, (double)stage.frees / inferences,
+            (double)stage.allocated_bytes / inferences,
+            (long long)stage.allocated_bytes - (long long)stage.freed_bytes);
+    }
+}
+
+/**
+ * Serialize the counters, e.g. to hand them to the application layer:
+ * {"in_use":n,"peak":n,"inferences":n,"stages":[{"name":"dsp","allocations":n,"frees":n,
+ *  "allocated_bytes":n,"freed_bytes":n},...]}
+ */
+__attribute__((unused)) static void ei_memory_stats_to_json(const ei_memory_stats_t *stats, std::string *json) {
+    char buf[200];
+    snprintf(buf, sizeof(buf), "{\"in_use\":%lu,\"peak\":%lu,\"inferences\":%u,\"stages\":[",
+        (unsigned long)stats->in_use, (unsigned long)stats->peak, (unsigned)stats->inferences);
+    *json = buf;
+    for (int ix = 0; ix < EI_MEMORY_STAGE_COUNT; ix++) {
+        const ei_memory_stage_stats_t &stage = stats->stages[ix];
+        snprintf(buf, sizeof(buf),
+            "%s{\"name\":\"%s\",\"allocations\":%llu,\"frees\":%llu,\"allocated_bytes\":%llu,\"freed_bytes\":%llu}",
+            ix == 0 ? "" : ",", ei_memory_stage_names[ix], (unsigned long long)stage.allocations,
+            (unsigned long long)stage.frees, (unsigned long long)stage.allocated_bytes,
+            (unsigned long long)stage.freed_bytes);
+        *json += buf;
+    }
+    *json += "]}";
+}
+
+#else
+
+#define EI_MEMORY_STAGE(stage)
+#define EI_MEMORY_STAGE_BEGIN(id, stage)
+#define EI_MEMORY_STAGE_END(id)
+#define EI_MEMORY_COUNT_INFERENCE()
+#define ei_memory_accounting_alloc(ptr) (void)0
+#define ei_memory_accounting_free(ptr)  (void)0
+
+#endif // EIDSP_MEMORY_ACCOUNTING == 1
+
+#endif // __EI_MEMORY_ACCOUNTING__H__
@@ -32,6 +32,7 @@
 #define __EIPROFILER__H__
 
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "edge-impulse-sdk/dsp/config.hpp"
 
 class EiProfiler {
 public:
@@ -45,7 +46,7 @@ public:
     }
     void report(const char *message)
     {
-        ei_printf("%s took %llu\r\n", message, ei_read_timer_ms() - timestamp);
+        ei_printf("%s took %llu\r\n", message, (unsigned long long)(ei_read_timer_ms() - timestamp));
         timestamp = ei_read_timer_ms(); //read again to not count printf time
     }
 
@@ -53,4 +54,288 @@ private:
     uint64_t timestamp;
 };
 
+#if EIDSP_PROFILING == 1
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Timing of one stage (or one op of a model), aggregated over all times it ran
+ */
+typedef struct {
+    std::string name;
+    uint32_t count;     // number of times it ran
+    double total_us;
+    double min_us;
+    double max_us;
+} ei_profiler_entry_t;
+
+/**
+ * Profile of the inferences of one handle since ei_profiler_start(), see ei_profiler_get_report()
+ */
+typedef struct {
+    uint32_t inferences;                        // number of impulse runs of the handle
+    std::vector<ei_profiler_entry_t> stages;    // DSP (sub-)stages, inference, postprocessing; by name
+    std::vector<ei_profiler_entry_t> ops;       // model ops, in graph order (if the engine reports them)
+} ei_profiler_report_t;
+
+static inline void ei_profiler_entry_add(ei_profiler_entry_t *entry, double us) {
+    if (entry->count == 0 || us < entry->min_us) {
+        entry->min_us = us;
+    }
+    if (entry->count == 0 || us > entry->max_us) {
+        entry->max_us = us;
+    }
+    entry->count++;
+    entry->total_us += us;
+}
+
+/**
+ * Aggregates the stage timers (EI_PROFILE_SCOPE) per impulse handle. A thread times its stages
+ * for the handle of the innermost EI_PROFILE_HANDLE scope (process_impulse() and friends open
+ * one), so handles running at the same time on other threads don't end up in each other's
+ * profile. Timing is off for a handle until set_enabled(handle, true), stages are keyed by name
+ * so the names must be string literals.
+ */
+class EiStageProfiler {
+public:
+    /**
+     * Handle the calling thread runs stages for, and whether profiling is enabled for it
+     */
+    typedef struct {
+        const void *handle;
+        bool enabled;
+    } thread_state_t;
+
+    static EiStageProfiler &get() {
+        static EiStageProfiler instance;
+        return instance;
+    }
+
+    static thread_state_t &current() {
+        static thread_local thread_state_t state = { nullptr, false };
+        return state;
+    }
+
+    /**
+     * Whether the stages the calling thread runs now are timed
+     */
+    static bool enabled() {
+        return current().enabled;
+    }
+
+    bool enabled(const void *handle) {
+        if (enabled_handles.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = profiles.find(handle);
+        return it != profiles.end() && it->second.enabled;
+    }
+
+    void set_enabled(const void *handle, bool enabled) {
+        std::lock_guard<std::mutex> lock(mutex);
+        profile_t &profile = profiles[handle];
+        if (profile.enabled != enabled) {
+            enabled_handles.fetch_add(enabled ? 1 : -1, std::memory_order_relaxed);
+            profile.enabled = enabled;
+        }
+    }
+
+    void add(const char *name, double us) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ei_profiler_entry_t &entry = profiles[current().handle].stages[name];
+        if (entry.count == 0) {
+            entry.name = name;
+        }
+        ei_profiler_entry_add(&entry, us);
+    }
+
+    void reset(const void *handle) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = profiles.find(handle);
+        if (it != profiles.end()) {
+            it->second.stages.clear();
+        }
+    }
+
+    /**
+     * Drop the timings and the enabled state of a handle that's going away
+     */
+    void remove(const void *handle) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = profiles.find(handle);
+        if (it != profiles.end()) {
+            if (it->second.enabled) {
+                enabled_handles.fetch_sub(1, std::memory_order_relaxed);
+            }
+            profiles.erase(it);
+        }
+    }
+
+    void get_stages(const void *handle, std::vector<ei_profiler_entry_t> *out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        out->clear();
+        auto it = profiles.find(handle);
+        if (it == profiles.end()) {
+            return;
+        }
+        for (auto &stage : it->second.stages) {
+            out->push_back(stage.second);
+        }
+    }
+
+private:
+    struct name_less {
+        bool operator()(const char *a, const char *b) const {
+            return strcmp(a, b) < 0;
+        }
+    };
+
+    struct profile_t {
+        bool enabled = false;
+        std::map<const char*, ei_profiler_entry_t, name_less> stages;
+    };
+
+    // handles with profiling enabled, so threads skip the lock while nothing is profiled
+    std::atomic<int> enabled_handles { 0 };
+    std::mutex mutex;
+    std::map<const void*, profile_t> profiles;
+};
+
+/**
+ * Makes the calling thread time its stages for `handle` until the end of the scope
+ */
+class EiProfileHandleScope {
+public:
+    EiProfileHandleScope(const void *handle) : previous(EiStageProfiler::current()) {
+        EiStageProfiler::current() = { handle, EiStageProfiler::get().enabled(handle) };
+    }
+
+    ~EiProfileHandleScope() {
+        EiStageProfiler::current() = previous;
+    }
+
+private:
+    EiStageProfiler::thread_state_t previous;
+};
+
+/**
+ * Times the enclosing scope as stage `name` (if the profiler is enabled)
+ */
+class EiProfileScope {
+public:
+    EiProfileScope(const char *name) : name(EiStageProfiler::enabled() ? name : nullptr) {
+        if (this->name) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~EiProfileScope() {
+        end();
+    }
+
+    void end() {
+        if (name) {
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            EiStageProfiler::get().add(name, elapsed.count());
+            name = nullptr;
+        }
+    }
+
+private:
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define EI_PROFILE_CONCAT_(a, b)    a##b
+#define EI_PROFILE_CONCAT(a, b)     EI_PROFILE_CONCAT_(a, b)
+#define EI_PROFILE_SCOPE(name)      EiProfileScope EI_PROFILE_CONCAT(ei_profile_scope_, __LINE__)(name)
+// time part of a scope, id has to be unique within the scope
+#define EI_PROFILE_BEGIN(id, name)  EiProfileScope ei_profile_##id(name)
+#define EI_PROFILE_END(id)          ei_profile_##id.end()
+// time the stages of the rest of the scope for an impulse handle
+#define EI_PROFILE_HANDLE(handle)   EiProfileHandleScope EI_PROFILE_CONCAT(ei_profile_handle_, __LINE__)(handle)
+
+/**
+ * Print a report, ops sorted by their share of the time
+ */
+__attribute__((unused)) static void ei_profiler_print_report(const ei_profiler_report_t *report) {
+    const double inferences = report->inferences > 0 ? report->inferences : 1;
+
+    ei_printf("Profile of %u inference(s), times are per inference:\n", (unsigned)report->inferences);
+    ei_printf("  %-40s %10s %10s %10s %8s\n", "stage", "avg (ms)", "min (ms)", "max (ms)", "calls");
+    for (const ei_profiler_entry_t &stage : report->stages) {
+        ei_printf("  %-40s %10.3f %10.3f %10.3f %8u\n", stage.name.c_str(),
+            stage.total_us / inferences / 1000.0, stage.min_us / 1000.0, stage.max_us / 1000.0,
+            (unsigned)stage.count);
+    }
+
+    if (report->ops.empty()) {
+        return;
+    }
+
+    double ops_total_us = 0;
+    std::vector<const ei_profiler_entry_t*> ops;
+    for (const ei_profiler_entry_t &op : report->ops) {
+        ops.push_back(&op);
+        ops_total_us += op.total_us;
+    }
+    std::sort(ops.begin(), ops.end(), [](const ei_profiler_entry_t *a, const ei_profiler_entry_t *b) {
+        return a->total_us > b->total_us;
+    });
+
+    ei_printf("  %-40s %10s %10s %10s %8s\n", "op", "avg (ms)", "min (ms)", "max (ms)", "share");
+    for (const ei_profiler_entry_t *op : ops) {
+        ei_printf("  %-40s %10.3f %10.3f %10.3f %7.1f%%\n", op->name.c_str(),
+            op->total_us / inferences / 1000.0, op->min_us / 1000.0, op->max_us / 1000.0,
+            ops_total_us > 0 ? op->total_us * 100.0 / ops_total_us : 0.0);
+    }
+}
+
+static void ei_profiler_entries_to_json(const std::vector<ei_profiler_entry_t> &entries, std::string *json) {
+    char buf[160];
+    for (size_t ix = 0; ix < entries.size(); ix++) {
+        const ei_profiler_entry_t &entry = entries[ix];
+        *json += ix == 0 ? "{\"name\":\"" : ",{\"name\":\"";
+        for (char c : entry.name) {
+            if (c == '"' || c == '\\') {
+                *json += '\\';
+            }
+            *json += (c >= 0 && c < 0x20) ? ' ' : c;
+        }
+        snprintf(buf, sizeof(buf), "\",\"count\":%u,\"total_us\":%.3f,\"min_us\":%.3f,\"max_us\":%.3f}",
+            (unsigned)entry.count, entry.total_us, entry.min_us, entry.max_us);
+        *json += buf;
+    }
+}
+
+/**
+ * Serialize a report as JSON (e.g. to hand it to Java / Kotlin):
+ * {"inferences":n,"stages":[{"name","count","total_us","min_us","max_us"}, ...],"ops":[...]}
+ */
+__attribute__((unused)) static void ei_profiler_report_to_json(const ei_profiler_report_t *report, std::string *json) {
+    json->clear();
+    *json += "{\"inferences\":" + std::to_string(report->inferences) + ",\"stages\":[";
+    ei_profiler_entries_to_json(report->stages, json);
+    *json += "],\"ops\":[";
+    ei_profiler_entries_to_json(report->ops, json);
+    *json += "]}";
+}
+
+#else
+
+#define EI_PROFILE_SCOPE(name)
+#define EI_PROFILE_BEGIN(id, name)
+#define EI_PROFILE_END(id)
+#define EI_PROFILE_HANDLE(handle)
+
+#endif // EIDSP_PROFILING == 1
+
 #endif  //!__EIPROFILER__H__
@@ -32,5 +32,6 @@
 #define _EIDSP_IMAGE_H_
 
 #include "edge-impulse-sdk/dsp/image/processing.hpp"
+#include "edge-impulse-sdk/dsp/image/kernels.hpp"
 
 #endif
\ No newline at end of file
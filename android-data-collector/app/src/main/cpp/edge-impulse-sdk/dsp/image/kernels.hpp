@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2024 EdgeImpulse Inc.
+ *
+ * Generated by Edge Impulse and licensed under the applicable Edge Impulse
+ * Terms of Service. Community and Professional Terms of Service
+ * (https://edgeimpulse.com/legal/terms-of-service) or Enterprise Terms of
+ * Service (https://edgeimpulse.com/legal/enterprise-terms-of-service),
+ * according to your product plan subscription (the “License”).
+ *
+ * This software, documentation and other associated files (collectively referred
+ * to as the “Software”) is a single SDK variation generated by the Edge Impulse
+ * platform and requires an active paid Edge Impulse subscription to use this
+ * Software for any purpose.
+ *
+ * You may NOT use this Software unless you have an active Edge Impulse subscription
+ * that meets the eligibility requirements for the applicable License, subject to
+ * your full and continued compliance with the terms and conditions of the License,
+ * including without limitation any usage restrictions under the applicable License.
+ *
+ * If you do not have an active Edge Impulse product plan subscription, or if use
+ * of this Software exceeds the usage limitations of your Edge Impulse product plan
+ * subscription, you are not permitted to use this Software and must immediately
+ * delete and erase all copies of this Software within your control or possession.
+ * Edge Impulse reserves all rights and remedies available to enforce its rights.
+ *
+ * Unless required by applicable law or agreed to in writing, the Software is
+ * distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing
+ * permissions, disclaimers and limitations under the License.
+ */
+#ifndef _EIDSP_IMAGE_KERNELS_H_
+#define _EIDSP_IMAGE_KERNELS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "edge-impulse-sdk/dsp/config.hpp"
+
+// vdivq_f32 and the 64 byte table lookups are AArch64 only, 32-bit NEON uses the scalar loops
+#if EIDSP_USE_NEON && defined(__aarch64__)
+#include <arm_neon.h>
+#define EI_IMAGE_KERNELS_NEON       1
+#elif EIDSP_USE_SSE2
+#include <emmintrin.h>
+#define EI_IMAGE_KERNELS_SSE2       1
+#endif
+
+/**
+ * Pixel conversion kernels for the image DSP block.
+ *
+ * Image signals hold one 0xRRGGBB pixel per float. The `packed_*` kernels unpack a page
+ * of those, the `bytes_*` kernels take RGB888 / grayscale bytes straight from a camera
+ * buffer. All kernels give the same results as the per-pixel loops they replace:
+ *  - float outputs keep the true division by 255 (vdivq_f32 / _mm_div_ps are IEEE
+ *    exact, a multiply by 1/255 is not)
+ *  - int8 outputs go through a 256 entry lookup table per channel, built with the
+ *    scalar expression, so the scaling + rounding is exact whatever the quantization
+ *    parameters are
+ *  - the fixed-point grayscale path is integer math (or floats that only ever hold
+ *    integers below 2^24 on SSE2)
+ * Grayscale float output rounds every product and sum separately, the tail goes through
+ * the vector code as well so all pixels of an image are computed the same way.
+ */
+namespace ei { namespace image { namespace kernels {
+
+// ITU-R 601-2 luma transform
+// see: https://pillow.readthedocs.io/en/stable/reference/Image.html#PIL.Image.Image.convert
+static const float red_to_gray = 0.299f;
+static const float green_to_gray = 0.587f;
+static const float blue_to_gray = 0.114f;
+
+static const int32_t i_red_to_gray = (int32_t)(0.299f * 65536.0f);
+static const int32_t i_green_to_gray = (int32_t)(0.587f * 65536.0f);
+static const int32_t i_blue_to_gray = (int32_t)(0.114f * 65536.0f);
+
+/**
+ * Lookup tables for int8 quantization, one table of 256 entries per channel
+ * (grayscale input only uses the first one)
+ */
+typedef int8_t quantization_lut_t[3][256];
+
+#if EI_IMAGE_KERNELS_NEON
+
+// 256 entry byte lookup, out of range indices leave the previous result alone
+static inline uint8x16_t lut_lookup_neon(const uint8x16x4_t tbl[4], uint8x16_t idx) {
+    const uint8x16_t v64 = vdupq_n_u8(64);
+
+    uint8x16_t res = vqtbl4q_u8(tbl[0], idx);
+    idx = vsubq_u8(idx, v64);
+    res = vqtbx4q_u8(res, tbl[1], idx);
+    idx = vsubq_u8(idx, v64);
+    res = vqtbx4q_u8(res, tbl[2], idx);
+    idx = vsubq_u8(idx, v64);
+    return vqtbx4q_u8(res, tbl[3], idx);
+}
+
+static inline void load_lut_neon(const int8_t *lut, uint8x16x4_t tbl[4]) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(lut);
+    for (int ix = 0; ix < 4; ix++) {
+        tbl[ix].val[0] = vld1q_u8(p + (ix * 64) + 0);
+        tbl[ix].val[1] = vld1q_u8(p + (ix * 64) + 16);
+        tbl[ix].val[2] = vld1q_u8(p + (ix * 64) + 32);
+        tbl[ix].val[3] = vld1q_u8(p + (ix * 64) + 48);
+    }
+}
+
+// unpack 16 packed pixels into the r, g and b bytes
+static inline void unpack16_neon(const float *pixels, uint8x16_t *r, uint8x16_t *g, uint8x16_t *b) {
+    uint32x4_t p0 = vcvtq_u32_f32(vld1q_f32(pixels + 0));
+    uint32x4_t p1 = vcvtq_u32_f32(vld1q_f32(pixels + 4));
+    uint32x4_t p2 = vcvtq_u32_f32(vld1q_f32(pixels + 8));
+    uint32x4_t p3 = vcvtq_u32_f32(vld1q_f32(pixels + 12));
+
+    // the narrowing moves drop the upper bits, so no masks needed
+    *r = vcombine_u8(
+        vmovn_u16(vcombine_u16(vmovn_u32(vshrq_n_u32(p0, 16)), vmovn_u32(vshrq_n_u32(p1, 16)))),
+        vmovn_u16(vcombine_u16(vmovn_u32(vshrq_n_u32(p2, 16)), vmovn_u32(vshrq_n_u32(p3, 16)))));
+    *g = vcombine_u8(
+        vmovn_u16(vcombine_u16(vmovn_u32(vshrq_n_u32(p0, 8)), vmovn_u32(vshrq_n_u32(p1, 8)))),
+        vmovn_u16(vcombine_u16(vmovn_u32(vshrq_n_u32(p2, 8)), vmovn_u32(vshrq_n_u32(p3, 8)))));
+    *b = vcombine_u8(
+        vmovn_u16(vcombine_u16(vmovn_u32(p0), vmovn_u32(p1))),
+        vmovn_u16(vcombine_u16(vmovn_u32(p2), vmovn_u32(p3))));
+}
+
+static inline float32x4_t gray_f32_neon(float32x4_t pixels) {
+    const float32x4_t v255 = vdupq_n_f32(255.0f);
+    const uint32x4_t mask = vdupq_n_u32(0xff);
+
+    uint32x4_t p = vcvtq_u32_f32(pixels);
+    float32x4_t r = vdivq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(p, 16), mask)), v255);
+    float32x4_t g = vdivq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(p, 8), mask)), v255);
+    float32x4_t b = vdivq_f32(vcvtq_f32_u32(vandq_u32(p, mask)), v255);
+
+    float32x4_t v = vaddq_f32(vmulq_n_f32(r, red_to_gray), vmulq_n_f32(g, green_to_gray));
+    return vaddq_f32(v, vmulq_n_f32(b, blue_to_gray));
+}
+
+#elif EI_IMAGE_KERNELS_SSE2
+
+static inline __m128 gray_f32_sse2(__m128 pixels) {
+    const __m128 v255 = _mm_set1_ps(255.0f);
+    const __m128i mask = _mm_set1_epi32(0xff);
+
+    __m128i p = _mm_cvttps_epi32(pixels);
+    __m128 r = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), mask)), v255);
+    __m128 g = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), mask)), v255);
+    __m128 b = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(p, mask)), v255);
+
+    __m128 v = _mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(red_to_gray)), _mm_mul_ps(g, _mm_set1_ps(green_to_gray)));
+    return _mm_add_ps(v, _mm_mul_ps(b, _mm_set1_ps(blue_to_gray)));
+}
+
+#endif // EI_IMAGE_KERNELS_NEON
+
+/**
+ * Unpack packed pixels into interleaved RGB floats in 0..1
+ * @param pixels Packed 0xRRGGBB pixels
+ * @param pixel_count Number of pixels
+ * @param out Output buffer (3 * pixel_count)
+ */
+static inline void packed_to_rgb_f32(const float *pixels, size_t pixel_count, float *out) {
+    size_t ix = 0;
+
+#if EI_IMAGE_KERNELS_NEON
+    const float32x4_t v255 = vdupq_n_f32(255.0f);
+    const uint32x4_t mask = vdupq_n_u32(0xff);
+
+    for (; ix + 4 <= pixel_count; ix += 4) {
+        uint32x4_t p = vcvtq_u32_f32(vld1q_f32(pixels + ix));
+
+        float32x4x3_t rgb;
+        rgb.val[0] = vdivq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(p, 16), mask)), v255);
+        rgb.val[1] = vdivq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(p, 8), mask)), v255);
+        rgb.val[2] = vdivq_f32(vcvtq_f32_u32(vandq_u32(p, mask)), v255);
+        vst3q_f32(out + (ix * 3), rgb);
+    }
+#elif EI_IMAGE_KERNELS_SSE2
+    const __m128 v255 = _mm_set1_ps(255.0f);
+    const __m128i mask = _mm_set1_epi32(0xff);
+
+    for (; ix + 4 <= pixel_count; ix += 4) {
+        __m128i p = _mm_cvttps_epi32(_mm_loadu_ps(pixels + ix));
+
+        __m128 r = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), mask)), v255);
+        __m128 g = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), mask)), v255);
+        __m128 b = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(p, mask)), v255);
+
+        // interleave to r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+        __m128 rg_lo = _mm_unpacklo_ps(r, g);
+        __m128 rg_hi = _mm_unpackhi_ps(r, g);
+        __m128 t0 = _mm_shuffle_ps(b, r, _MM_SHUFFLE(1, 1, 0, 0));
+        __m128 t1 = _mm_shuffle_ps(g, b, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 t2 = _mm_shuffle_ps(b, rg_hi, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 t3 = _mm_shuffle_ps(rg_hi, b, _MM_SHUFFLE(3, 3, 3, 3));
+
+        float *o = out + (ix * 3);
+        _mm_storeu_ps(o + 0, _mm_shuffle_ps(rg_lo, t0, _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_storeu_ps(o + 4, _mm_shuffle_ps(t1, rg_hi, _MM_SHUFFLE(1, 0, 2, 0)));
+        _mm_storeu_ps(o + 8, _mm_shuffle_ps(t2, t3, _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+#endif
+
+    for (; ix < pixel_count; ix++) {
+        uint32_t pixel = static_cast<uint32_t>(pixels[ix]);
+
+        out[(ix * 3) + 0] = static_cast<float>(pixel >> 16 & 0xff) / 255.0f;
+        out[(ix * 3) + 1] = static_cast<float>(pixel >> 8 & 0xff) / 255.0f;
+        out[(ix * 3) + 2] = static_cast<float>(pixel & 0xff) / 255.0f;
+    }
+}
+
+/**
+ * Unpack packed pixels into grayscale floats in 0..1
+ * @param pixels Packed 0xRRGGBB pixels
+ * @param pixel_count Number of pixels
+ * @param out Output buffer (pixel_count)
+ */
+static inline void packed_to_gray_f32(const float *pixels, size_t pixel_count, float *out) {
+    size_t ix = 0;
+
+#if EI_IMAGE_KERNELS_NEON || EI_IMAGE_KERNELS_SSE2
+    for (; ix + 4 <= pixel_count; ix += 4) {
+#if EI_IMAGE_KERNELS_NEON
+        vst1q_f32(out + ix, gray_f32_neon(vld1q_f32(pixels + ix)));
+#else
+        _mm_storeu_ps(out + ix, gray_f32_sse2(_mm_loadu_ps(pixels + ix)));
+#endif
+    }
+
+    // tail goes through the same vector math (see above)
+    if (ix < pixel_count) {
+        float in_tail[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float out_tail[4];
+        for (size_t jx = ix; jx < pixel_count; jx++) {
+            in_tail[jx - ix] = pixels[jx];
+        }
+#if EI_IMAGE_KERNELS_NEON
+        vst1q_f32(out_tail, gray_f32_neon(vld1q_f32(in_tail)));
+#else
+        _mm_storeu_ps(out_tail, gray_f32_sse2(_mm_loadu_ps(in_tail)));
+#endif
+        for (size_t jx = ix; jx < pixel_count; jx++) {
+            out[jx] = out_tail[jx - ix];
+        }
+    }
+#else
+    for (; ix < pixel_count; ix++) {
+        uint32_t pixel = static_cast<uint32_t>(pixels[ix]);
+
+        float r = static_cast<float>(pixel >> 16 & 0xff) / 255.0f;
+        float g = static_cast<float>(pixel >> 8 & 0xff) / 255.0f;
+        float b = static_cast<float>(pixel & 0xff) / 255.0f;
+
+        out[ix] = (red_to_gray * r) + (green_to_gray * g) + (blue_to_gray * b);
+    }
+#endif
+}
+
+/**
+ * Unpack and quantize packed pixels into interleaved RGB int8 values
+ * @param pixels Packed 0xRRGGBB pixels
+ * @param pixel_count Number of pixels
+ * @param lut Quantized value for every r, g and b byte
+ * @param out Output buffer (3 * pixel_count)
+ */
+static inline void packed_to_rgb_i8(const float *pixels, size_t pixel_count, const quantization_lut_t lut, int8_t *out) {
+    size_t ix = 0;
+
+#if EI_IMAGE_KERNELS_NEON
+    uint8x16x4_t tbl_r[4], tbl_g[4], tbl_b[4];
+    load_lut_neon(lut[0], tbl_r);
+    load_lut_neon(lut[1], tbl_g);
+    load_lut_neon(lut[2], tbl_b);
+
+    for (; ix + 16 <= pixel_count; ix += 16) {
+        uint8x16_t r, g, b;
+        unpack16_neon(pixels + ix, &r, &g, &b);
+
+        uint8x16x3_t rgb;
+        rgb.val[0] = lut_lookup_neon(tbl_r, r);
+        rgb.val[1] = lut_lookup_neon(tbl_g, g);
+        rgb.val[2] = lut_lookup_neon(tbl_b, b);
+        vst3q_u8(reinterpret_cast<uint8_t *>(out + (ix * 3)), rgb);
+    }
+#endif
+
+    for (; ix < pixel_count; ix++) {
+        uint32_t pixel = static_cast<uint32_t>(pixels[ix]);
+
+        out[(ix * 3) + 0] = lut[0][pixel >> 16 & 0xff];
+        out[(ix * 3) + 1] = lut[1][pixel >> 8 & 0xff];
+        out[(ix * 3) + 2] = lut[2][pixel & 0xff];
+    }
+}
+
+/**
+ * Unpack packed pixels into grayscale int8 values, using the 16.16 fixed-point
+ * luma transform (only valid for scale 1/255)
+ * @param pixels Packed 0xRRGGBB pixels
+ * @param pixel_count Number of pixels
+ * @param zero_point Quantization zero point
+ * @param out Output buffer (pixel_count)
+ */
+static inline void packed_to_gray_i8_fixed(const float *pixels, size_t pixel_count, int32_t zero_point, int8_t *out) {
+    size_t ix = 0;
+
+#if EI_IMAGE_KERNELS_NEON
+    const uint32x4_t mask = vdupq_n_u32(0xff);
+    const int32x4_t vzp = vdupq_n_s32(zero_point);
+
+    for (; ix + 8 <= pixel_count; ix += 8) {
+        int16x4_t half[2];
+        for (int jx = 0; jx < 2; jx++) {
+            uint32x4_t p = vcvtq_u32_f32(vld1q_f32(pixels + ix + (jx * 4)));
+            int32x4_t r = vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(p, 16), mask));
+            int32x4_t g = vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(p, 8), mask));
+            int32x4_t b = vreinterpretq_s32_u32(vandq_u32(p, mask));
+
+            int32x4_t gray = vmulq_n_s32(r, i_red_to_gray);
+            gray = vmlaq_n_s32(gray, g, i_green_to_gray);
+            gray = vmlaq_n_s32(gray, b, i_blue_to_gray);
+            gray = vaddq_s32(vshrq_n_s32(gray, 16), vzp);
+            half[jx] = vqmovn_s32(gray);
+        }
+        // the saturating narrow clamps to -128..127
+        vst1_s8(out + ix, vqmovn_s16(vcombine_s16(half[0], half[1])));
+    }
+#elif EI_IMAGE_KERNELS_SSE2
+    // SSE2 has no 32-bit multiply; the products and sums are integers below 2^24 so
+    // float math is exact here
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128 vr = _mm_set1_ps(static_cast<float>(i_red_to_gray));
+    const __m128 vg = _mm_set1_ps(static_cast<float>(i_green_to_gray));
+    const __m128 vb = _mm_set1_ps(static_cast<float>(i_blue_to_gray));
+    const __m128i vzp = _mm_set1_epi32(zero_point);
+
+    for (; ix + 8 <= pixel_count; ix += 8) {
+        __m128i half[2];
+        for (int jx = 0; jx < 2; jx++) {
+            __m128i p = _mm_cvttps_epi32(_mm_loadu_ps(pixels + ix + (jx * 4)));
+            __m128 r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), mask));
+            __m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), mask));
+            __m128 b = _mm_cvtepi32_ps(_mm_and_si128(p, mask));
+
+            __m128 gray = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, vr), _mm_mul_ps(g, vg)), _mm_mul_ps(b, vb));
+            half[jx] = _mm_add_epi32(_mm_srai_epi32(_mm_cvttps_epi32(gray), 16), vzp);
+        }
+        // the saturating packs clamp to -128..127
+        __m128i packed = _mm_packs_epi32(half[0], half[1]);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + ix), _mm_packs_epi16(packed, packed));
+    }
+#endif
+
+    for (; ix < pixel_count; ix++) {
+        uint32_t pixel = static_cast<uint32_t>(pixels[ix]);
+        int32_t r = static_cast<int32_t>(pixel >> 16 & 0xff);
+        int32_t g = static_cast<int32_t>(pixel >> 8 & 0xff);
+        int32_t b = static_cast<int32_t>(pixel & 0xff);
+
+        int32_t gray = (i_red_to_gray * r) + (i_green_to_gray * g) + (i_blue_to_gray * b);
+        gray >>= 16; // scale down to int8_t
+        gray += zero_point;
+        if (gray < -128) gray = -128;
+        else if (gray > 127) gray = 127;
+        out[ix] = static_cast<int8_t>(gray);
+    }
+}
+
+/**
+ * Scale RGB888 or grayscale bytes into floats in 0..1
+ * @param bytes Input bytes (channels interleaved)
+ * @param byte_count Number of bytes (pixels * channels)
+ * @param out Output buffer (byte_count)
+ */
+static inline void bytes_to_f32(const uint8_t *bytes, size_t byte_count, float *out) {
+    size_t ix = 0;
+
+#if EI_IMAGE_KERNELS_NEON
+    const float32x4_t v255 = vdupq_n_f32(255.0f);
+
+    for (; ix + 16 <= byte_count; ix += 16) {
+        uint8x16_t v = vld1q_u8(bytes + ix);
+        uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+        uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+
+        vst1q_f32(out + ix + 0, vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), v255));
+        vst1q_f32(out + ix + 4, vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), v255));
+        vst1q_f32(out + ix + 8, vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), v255));
+        vst1q_f32(out + ix + 12, vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), v255));
+    }
+#elif EI_IMAGE_KERNELS_SSE2
+    const __m128 v255 = _mm_set1_ps(255.0f);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; ix + 16 <= byte_count; ix += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + ix));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+        _mm_storeu_ps(out + ix + 0, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), v255));
+        _mm_storeu_ps(out + ix + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), v255));
+        _mm_storeu_ps(out + ix + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), v255));
+        _mm_storeu_ps(out + ix + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), v255));
+    }
+#endif
+
+    for (; ix < byte_count; ix++) {
+        out[ix] = static_cast<float>(bytes[ix]) / 255.0f;
+    }
+}
+
+/**
+ * Quantize RGB888 or grayscale bytes into int8 values
+ * @param bytes Input bytes (channels interleaved)
+ * @param pixel_count Number of pixels
+ * @param channels 1 (grayscale) or 3 (RGB)
+ * @param lut Quantized value for every byte, per channel
+ * @param out Output buffer (pixel_count * channels)
+ */
+static inline void bytes_to_i8(const uint8_t *bytes, size_t pixel_count, int channels, const quantization_lut_t lut, int8_t *out) {
+    size_t ix = 0;
+
+    if (channels == 3) {
+#if EI_IMAGE_KERNELS_NEON
+        uint8x16x4_t tbl_r[4], tbl_g[4], tbl_b[4];
+        load_lut_neon(lut[0], tbl_r);
+        load_lut_neon(lut[1], tbl_g);
+        load_lut_neon(lut[2], tbl_b);
+
+        for (; ix + 16 <= pixel_count; ix += 16) {
+            uint8x16x3_t rgb = vld3q_u8(bytes + (ix * 3));
+            rgb.val[0] = lut_lookup_neon(tbl_r, rgb.val[0]);
+            rgb.val[1] = lut_lookup_neon(tbl_g, rgb.val[1]);
+            rgb.val[2] = lut_lookup_neon(tbl_b, rgb.val[2]);
+            vst3q_u8(reinterpret_cast<uint8_t *>(out + (ix * 3)), rgb);
+        }
+#endif
+        for (; ix < pixel_count; ix++) {
+            out[(ix * 3) + 0] = lut[0][bytes[(ix * 3) + 0]];
+            out[(ix * 3) + 1] = lut[1][bytes[(ix * 3) + 1]];
+            out[(ix * 3) + 2] = lut[2][bytes[(ix * 3) + 2]];
+        }
+    }
+    else {
+#if EI_IMAGE_KERNELS_NEON
+        uint8x16x4_t tbl[4];
+        load_lut_neon(lut[0], tbl);
+
+        for (; ix + 16 <= pixel_count; ix += 16) {
+            vst1q_u8(reinterpret_cast<uint8_t *>(out + ix), lut_lookup_neon(tbl, vld1q_u8(bytes + ix)));
+        }
+#endif
+        for (; ix < pixel_count; ix++) {
+            out[ix] = lut[0][bytes[ix]];
+        }
+    }
+}
+
+} } } // namespace ei::image::kernels
+
+#endif // _EIDSP_IMAGE_KERNELS_H_
@@ -42,10 +42,23 @@
 extern size_t ei_memory_in_use;
 extern size_t ei_memory_peak_use;
 
+// ei_memory_in_use / ei_memory_peak_use are updated atomically, DSP blocks may run on several threads
+__attribute__((unused)) static inline void ei_dsp_memory_add(size_t bytes) {
+    size_t in_use = __atomic_add_fetch(&ei_memory_in_use, bytes, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&ei_memory_peak_use, __ATOMIC_RELAXED);
+    while (in_use > peak &&
+           !__atomic_compare_exchange_n(&ei_memory_peak_use, &peak, in_use, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+__attribute__((unused)) static inline void ei_dsp_memory_sub(size_t bytes) {
+    __atomic_sub_fetch(&ei_memory_in_use, bytes, __ATOMIC_RELAXED);
+}
+
 #if EIDSP_PRINT_ALLOCATIONS == 1
 #define ei_dsp_printf           printf
 #else
-#define ei_dsp_printf           (void)
+#define ei_dsp_printf(...)      ((void)0)
 #endif
 
 typedef std::unique_ptr<void, std::function<void(void*)>> ei_unique_ptr_t;
@@ -76,10 +89,7 @@ namespace ei {
      * @param bytes Number of bytes allocated
      */
     #define ei_dsp_register_alloc_internal(fn, file, line, bytes, ptr) \
-        ei_memory_in_use += bytes; \
-        if (ei_memory_in_use > ei_memory_peak_use) { \
-            ei_memory_peak_use = ei_memory_in_use; \
-        } \
+        ei_dsp_memory_add(bytes); \
         ei_dsp_printf("alloc %lu bytes (in_use=%lu, peak=%lu) (%s@ %s:%d) %p\n", \
             (unsigned long)bytes, (unsigned long)ei_memory_in_use, (unsigned long)ei_memory_peak_use, fn, file, line, ptr);
 
@@ -91,10 +101,7 @@ namespace ei {
      * @param type_size Size of the data type
      */
     #define ei_dsp_register_matrix_alloc_internal(fn, file, line, rows, cols, type_size, ptr) \
-        ei_memory_in_use += (rows * cols * type_size); \
-        if (ei_memory_in_use > ei_memory_peak_use) { \
-            ei_memory_peak_use = ei_memory_in_use; \
-        } \
+        ei_dsp_memory_add(rows * cols * type_size); \
         ei_dsp_printf("alloc matrix %lu x %lu = %lu bytes (in_use=%lu, peak=%lu) (%s@ %s:%d) %p\n", \
             (unsigned long)rows, (unsigned long)cols, (unsigned long)(rows * cols * type_size), (unsigned long)ei_memory_in_use, \
                 (unsigned long)ei_memory_peak_use, fn, file, line, ptr);
@@ -104,7 +111,7 @@ namespace ei {
      * @param bytes Number of bytes free'd
      */
     #define ei_dsp_register_free_internal(fn, file, line, bytes, ptr) \
-        ei_memory_in_use -= bytes; \
+        ei_dsp_memory_sub(bytes); \
         ei_dsp_printf("free %lu bytes (in_use=%lu, peak=%lu) (%s@ %s:%d) %p\n", \
             (unsigned long)bytes, (unsigned long)ei_memory_in_use, (unsigned long)ei_memory_peak_use, fn, file, line, ptr);
 
@@ -116,7 +123,7 @@ namespace ei {
      * @param type_size Size of the data type
      */
     #define ei_dsp_register_matrix_free_internal(fn, file, line, rows, cols, type_size, ptr) \
-        ei_memory_in_use -= (rows * cols * type_size); \
+        ei_dsp_memory_sub(rows * cols * type_size); \
         ei_dsp_printf("free matrix %lu x %lu = %lu bytes (in_use=%lu, peak=%lu) (%s@ %s:%d) %p\n", \
             (unsigned long)rows, (unsigned long)cols, (unsigned long)(rows * cols * type_size), \
                 (unsigned long)ei_memory_in_use, (unsigned long)ei_memory_peak_use, fn, file, line, ptr);
@@ -208,7 +215,7 @@ __attribute__((unused)) static void ei_dsp_free_func(void *ptr, size_t size) {
 * @param size Desired size of the memory block, in BYTES.
 * @return ei_tracked_unique_ptr
 */
-static ei_unique_ptr_t make_tracked_unique_ptr(void* ptr_in, size_t size) {
+__attribute__((unused)) static ei_unique_ptr_t make_tracked_unique_ptr(void* ptr_in, size_t size) {
     auto ptr = reinterpret_cast<void**>(ptr_in);
     *ptr = ei_dsp_malloc(size);
     return ei_unique_ptr_t(*ptr, [size](void *ptr) {
@@ -523,6 +523,13 @@ public:
 
     static int dct_transform(float vector[], size_t len)
     {
+        // the MFCC frame loop runs this for every frame, so take the buffers and twiddles from
+        // the FFT plan of the calling thread if there is one
+        rfft_plan_t *plan = get_rfft_plan(len);
+        if (plan && get_dct_twiddles(plan)) {
+            return dct_transform(plan, vector);
+        }
+
         const size_t fft_data_out_size = (len / 2 + 1) * sizeof(ei::fft_complex_t);
         const size_t fft_data_in_size = len * sizeof(float);
 
@@ -1331,8 +1338,15 @@ public:
         }
 
         fft_complex_t *fft_output = NULL;
-        auto ptr = EI_MAKE_TRACKED_POINTER(fft_output, n_fft_out_features);
-        EI_ERR_AND_RETURN_ON_NULL(fft_output, EIDSP_OUT_OF_MEM);
+        ei_unique_ptr_t ptr(nullptr, ei_free);
+        rfft_plan_t *plan = get_rfft_plan(n_fft);
+        if (plan) {
+            fft_output = plan->output;
+        }
+        else {
+            ptr = EI_MAKE_TRACKED_POINTER(fft_output, n_fft_out_features);
+            EI_ERR_AND_RETURN_ON_NULL(fft_output, EIDSP_OUT_OF_MEM);
+        }
 
         int ret = rfft(src, src_size, fft_output, n_fft_out_features, n_fft);
         if (ret != EIDSP_OK) {
@@ -1368,6 +1382,11 @@ public:
             src_size = n_fft;
         }
 
+        rfft_plan_t *plan = get_rfft_plan(n_fft);
+        if (plan) {
+            return rfft(plan, src, src_size, output);
+        }
+
         // Unfortunately, arm fft (at least) modifies the input buffer AND does not work in place
         // So we have to copy the input to a new buffer
         EI_DSP_MATRIX(fft_input, 1, n_fft);
@@ -1498,6 +1517,20 @@ public:
     }
 
 #if EIDSP_SIGNAL_C_FN_POINTER == 0
+#ifndef __MBED__
+    /**
+     * get_data of the signals made by signal_from_buffer(). A named type rather than
+     * a lambda, so signal_buffer() can find the buffer again.
+     */
+    struct signal_buffer_reader_t {
+        const float *data;
+
+        int operator()(size_t offset, size_t length, float *out_ptr) const {
+            return numpy::signal_get_data(data, offset, length, out_ptr);
+        }
+    };
+#endif // __MBED__
+
     /**
      * Create a signal structure from a buffer.
      * This is useful for data that you keep in memory anyway. If you need to load from
@@ -1513,13 +1546,28 @@ public:
 #ifdef __MBED__
         signal->get_data = mbed::callback(&numpy::signal_get_data, data);
 #else
-        signal->get_data = [data](size_t offset, size_t length, float *out_ptr) {
-            return numpy::signal_get_data(data, offset, length, out_ptr);
-        };
+        signal->get_data = signal_buffer_reader_t { data };
 #endif
         return EIDSP_OK;
     }
 
+    /**
+     * The buffer behind a signal made by signal_from_buffer(), so it can be read without
+     * going through get_data. Needs RTTI (std::function::target).
+     * @param signal Signal
+     * @returns The buffer (total_length floats), or nullptr for any other signal
+     */
+    static const float* signal_buffer(const signal_t *signal)
+    {
+#if !defined(__MBED__) && (defined(__cpp_rtti) || defined(__GXX_RTTI))
+        const signal_buffer_reader_t *reader = signal->get_data.target<signal_buffer_reader_t>();
+        return reader != nullptr ? reader->data : nullptr;
+#else
+        (void)signal;
+        return nullptr;
+#endif
+    }
+
 #endif
 
 #if defined ( __GNUC__ )
@@ -1564,10 +1612,12 @@ public:
      */
     __attribute__((always_inline)) static inline float log(float a)
     {
-        int32_t g = (int32_t) * ((int32_t *)&a);
+        int32_t g;
+        memcpy(&g, &a, sizeof(g));
         int32_t e = (g - 0x3f2aaaab) & 0xff800000;
         g = g - e;
-        float m = (float) * ((float *)&g);
+        float m;
+        memcpy(&m, &g, sizeof(m));
         float i = (float)e * 1.19209290e-7f; // 0x1.0p-23
         /* m in [2/3, 4/3] */
         float f = m - 1.0f;
@@ -2305,7 +2355,185 @@ public:
         }
     }
 
+    /**
+     * FFT plan for a real FFT of n_fft points: the kissfft config (twiddles) and the
+     * input / output buffers, see get_rfft_plan(). DCT-II of n_fft points goes through the
+     * same FFT, its input buffer and twiddles are created on first use (get_dct_twiddles()).
+     */
+    typedef struct {
+        size_t n_fft;
+        kiss_fftr_cfg cfg;
+        float *input;
+        fft_complex_t *output;
+        float *dct_input;
+        float *dct_cos;
+        float *dct_sin;
+    } rfft_plan_t;
+
+    /**
+     * Cached FFT plan of the calling thread for n_fft points, created on first use.
+     * The least recently created plan is dropped when there are more than
+     * EIDSP_PLAN_CACHE_SIZE FFT lengths in use.
+     * @returns nullptr if the cache is disabled or out of memory (callers then allocate per call)
+     */
+    static rfft_plan_t* get_rfft_plan(size_t n_fft) {
+#if EIDSP_PLAN_CACHE_SIZE > 0
+        rfft_plan_cache_t &cache = rfft_plan_cache();
+        for (size_t ix = 0; ix < EIDSP_PLAN_CACHE_SIZE; ix++) {
+            if (cache.plans[ix].n_fft == n_fft) {
+                return &cache.plans[ix];
+            }
+        }
+
+        rfft_plan_t *plan = &cache.plans[cache.next];
+        free_rfft_plan(plan);
+        plan->input = (float*)ei_calloc(n_fft, sizeof(float));
+        plan->output = (fft_complex_t*)ei_calloc((n_fft / 2) + 1, sizeof(fft_complex_t));
+        if (!plan->input || !plan->output) {
+            free_rfft_plan(plan);
+            return nullptr;
+        }
+        plan->n_fft = n_fft;
+        cache.next = (cache.next + 1) % EIDSP_PLAN_CACHE_SIZE;
+        return plan;
+#else
+        return nullptr;
+#endif
+    }
+
+    /**
+     * Free the FFT plans of the calling thread (they're also freed when the thread exits)
+     */
+    static void free_rfft_plans() {
+#if EIDSP_PLAN_CACHE_SIZE > 0
+        rfft_plan_cache().clear();
+#endif
+    }
+
 private:
+    static void free_rfft_plan(rfft_plan_t *plan) {
+        if (plan->cfg) {
+            kiss_fftr_free(plan->cfg);
+        }
+        ei_free(plan->input);
+        ei_free(plan->output);
+        ei_free(plan->dct_input);
+        ei_free(plan->dct_cos);
+        ei_free(plan->dct_sin);
+        memset(plan, 0, sizeof(rfft_plan_t));
+    }
+
+    /**
+     * Create the DCT input buffer and twiddles of a plan (same expressions as the per call
+     * path of dct_transform(), so the output is the same)
+     * @returns false if out of memory
+     */
+    static bool get_dct_twiddles(rfft_plan_t *plan) {
+        if (plan->dct_input) {
+            return true;
+        }
+        const size_t len = plan->n_fft;
+        plan->dct_input = (float*)ei_calloc(len, sizeof(float));
+        plan->dct_cos = (float*)ei_calloc(len, sizeof(float));
+        plan->dct_sin = (float*)ei_calloc(len, sizeof(float));
+        if (!plan->dct_input || !plan->dct_cos || !plan->dct_sin) {
+            ei_free(plan->dct_input);
+            ei_free(plan->dct_cos);
+            ei_free(plan->dct_sin);
+            plan->dct_input = plan->dct_cos = plan->dct_sin = nullptr;
+            return false;
+        }
+        for (size_t i = 0; i < len; i++) {
+            float temp = i * M_PI / (len * 2);
+            plan->dct_cos[i] = cos(temp);
+            plan->dct_sin[i] = sin(temp);
+        }
+        return true;
+    }
+
+    /**
+     * dct_transform() through a cached plan, so no allocations
+     */
+    static int dct_transform(rfft_plan_t *plan, float vector[]) {
+        const size_t len = plan->n_fft;
+        float *fft_data_in = plan->dct_input;
+        fft_complex_t *fft_data_out = plan->output;
+
+        size_t halfLen = len / 2;
+        for (size_t i = 0; i < halfLen; i++) {
+            fft_data_in[i] = vector[i * 2];
+            fft_data_in[len - 1 - i] = vector[i * 2 + 1];
+        }
+        if (len % 2 == 1) {
+            fft_data_in[halfLen] = vector[len - 1];
+        }
+
+        int r = rfft(plan, fft_data_in, len, fft_data_out);
+        if (r != 0) {
+            return r;
+        }
+
+        size_t i = 0;
+        for (; i < len / 2 + 1; i++) {
+            vector[i] = fft_data_out[i].r * plan->dct_cos[i] + fft_data_out[i].i * plan->dct_sin[i];
+        }
+        for (; i < len; i++) {
+            int conj_idx = len-i;
+            vector[i] = fft_data_out[conj_idx].r * plan->dct_cos[i] - fft_data_out[conj_idx].i * plan->dct_sin[i];
+        }
+        return EIDSP_OK;
+    }
+
+#if EIDSP_PLAN_CACHE_SIZE > 0
+    class rfft_plan_cache_t {
+    public:
+        rfft_plan_t plans[EIDSP_PLAN_CACHE_SIZE] = { };
+        size_t next = 0;
+
+        ~rfft_plan_cache_t() {
+            clear();
+        }
+
+        void clear() {
+            for (size_t ix = 0; ix < EIDSP_PLAN_CACHE_SIZE; ix++) {
+                free_rfft_plan(&plans[ix]);
+            }
+            next = 0;
+        }
+    };
+
+    static rfft_plan_cache_t& rfft_plan_cache() {
+        static EIDSP_THREAD_LOCAL rfft_plan_cache_t cache;
+        return cache;
+    }
+#endif // EIDSP_PLAN_CACHE_SIZE > 0
+
+    /**
+     * rfft through a cached plan, so no allocations (kissfft config is created on first use)
+     */
+    static int rfft(rfft_plan_t *plan, const float *src, size_t src_size, fft_complex_t *output) {
+        memcpy(plan->input, src, src_size * sizeof(float));
+        memset(plan->input + src_size, 0, (plan->n_fft - src_size) * sizeof(float));
+
+        auto res = ei::fft::hw_r2c_fft(plan->input, output, plan->n_fft);
+        if (!handle_fft_hw_failure(res, plan->n_fft)) {
+            return EIDSP_OK;
+        }
+
+    #if EIDSP_INCLUDE_KISSFFT || !defined(EIDSP_INCLUDE_KISSFFT)
+        if (!plan->cfg) {
+            plan->cfg = kiss_fftr_alloc(plan->n_fft, 0, NULL, NULL);
+            if (!plan->cfg) {
+                EIDSP_ERR(EIDSP_OUT_OF_MEM);
+            }
+        }
+        kiss_fftr(plan->cfg, plan->input, (kiss_fft_cpx*)output);
+        return EIDSP_OK;
+    #else
+        return EIDSP_NOT_SUPPORTED;
+    #endif
+    }
+
     /**
      * Helper function to handle FFT hardware acceleration failures and logging
      * @param res Result code from hardware FFT attempt
@@ -708,6 +708,19 @@ typedef struct ei_signal_t {
 #endif // __cplusplus
 
 #ifdef __cplusplus
+/**
+ * Which matrix of the ei_feature_t union is set
+ */
+typedef enum {
+    EI_FEATURE_MATRIX_F32 = 0,
+    EI_FEATURE_MATRIX_I8 = 1,
+    EI_FEATURE_MATRIX_U8 = 2,
+} ei_feature_matrix_type_t;
+
+static inline uint8_t ei_feature_matrix_type(const ei::matrix_t *) { return EI_FEATURE_MATRIX_F32; }
+static inline uint8_t ei_feature_matrix_type(const ei::matrix_i8_t *) { return EI_FEATURE_MATRIX_I8; }
+static inline uint8_t ei_feature_matrix_type(const ei::matrix_u8_t *) { return EI_FEATURE_MATRIX_U8; }
+
 typedef struct ei_feature_t {
     union {
         ei::matrix_t* matrix;
@@ -715,6 +728,28 @@ typedef struct ei_feature_t {
         ei::matrix_u8_t* matrix_u8;
     };
     uint32_t blockId;
+    // ei_feature_matrix_type_t of the matrix above, EI_FEATURE_MATRIX_F32 when zero-initialized
+    uint8_t matrix_type;
+
+    /**
+     * Delete the matrix through its own type (the union shares one pointer, so deleting
+     * an int8 / uint8 matrix as `matrix` would release it as a float matrix)
+     */
+    void free_matrix() {
+        switch (matrix_type) {
+            case EI_FEATURE_MATRIX_I8:
+                delete matrix_i8;
+                break;
+            case EI_FEATURE_MATRIX_U8:
+                delete matrix_u8;
+                break;
+            default:
+                delete matrix;
+                break;
+        }
+        matrix = nullptr;
+        matrix_type = EI_FEATURE_MATRIX_F32;
+    }
 
     void* operator new(size_t size) {
         return ei_malloc(size);
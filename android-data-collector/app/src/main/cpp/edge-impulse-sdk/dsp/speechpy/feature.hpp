@@ -39,6 +39,7 @@
 #include "../memory.hpp"
 #include "../returntypes.hpp"
 #include "../ei_vector.h"
+#include "../ei_profiler.h"
 
 namespace ei {
 namespace speechpy {
@@ -193,6 +194,44 @@ public:
         return static_cast<int>(floor((fft_size + 1) * hertz / sampling_freq));
     }
 
+    /**
+     * Mel filterbank for one block configuration, see get_mel_plan(). mfe() uses the sparse
+     * form (the bins every filter covers and their weights), mfe_v3() the (transposed)
+     * filterbank matrix.
+     */
+    typedef struct {
+        // key
+        bool in_use;
+        bool dense;
+        uint32_t sampling_frequency;
+        uint16_t num_filters;
+        uint16_t fft_length;
+        uint32_t low_frequency;
+        uint32_t high_frequency;
+        uint16_t max_bin;
+
+        // sparse filterbank: filter i has weight 1 at bins[i + 1] plus the weights
+        // weights[weights_start[i]..weights_start[i + 1]) at weight_bins[...]
+        uint16_t *bins;
+        uint32_t *weights_start;
+        uint16_t *weight_bins;
+        float *weights;
+
+#if EIDSP_QUANTIZE_FILTERBANK
+        quantized_matrix_t *filterbank;
+#else
+        matrix_t *filterbank;
+#endif
+    } mel_plan_t;
+
+    /**
+     * Free the mel filterbanks cached by the calling thread
+     */
+    static void free_mel_plans() {
+        mel_plan_cache_t &cache = mel_plan_cache();
+        cache.clear();
+    }
+
     /**
      * Compute Mel-filterbank energy features from an audio signal.
      * @param out_features Use `calculate_mfe_buffer_size` to allocate the right matrix.
@@ -236,6 +275,7 @@ public:
         stack_frames_info_t stack_frame_info = { 0 };
         stack_frame_info.signal = signal;
 
+        EI_PROFILE_BEGIN(stack_frames, "dsp/framing");
         ret = processing::stack_frames(
             &stack_frame_info,
             sampling_frequency,
@@ -244,6 +284,7 @@ public:
             false,
             version
         );
+        EI_PROFILE_END(stack_frames);
         if (ret != 0) {
             EIDSP_ERR(ret);
         }
@@ -267,47 +308,16 @@ public:
         }
 
         const size_t power_spectrum_frame_size = (fft_length / 2 + 1);
-        // Computing the Mel filterbank
-        // converting the upper and lower frequencies to Mels.
-        // num_filter + 2 is because for num_filter filterbanks we need
-        // num_filter+2 point.
-        float *mels;
-        const int MELS_SIZE = num_filters + 2;
-        const size_t mem_size = MELS_SIZE * sizeof(float);
-        mels = (float*)ei_dsp_calloc(MELS_SIZE, sizeof(float));
-        EI_ERR_AND_RETURN_ON_NULL(mels, EIDSP_OUT_OF_MEM);
-        ei_unique_ptr_t __ptr__(mels,[mem_size](void* ptr){ei::ei_dsp_free_func(ptr, mem_size);});
-        uint16_t* bins = reinterpret_cast<uint16_t*>(mels); // alias the mels array so we can reuse the space
-
-        numpy::linspace(
-            functions::frequency_to_mel(static_cast<float>(low_frequency)),
-            functions::frequency_to_mel(static_cast<float>(high_frequency)),
-            num_filters + 2,
-            mels);
-
         uint16_t max_bin = version >= 4 ? fft_length : power_spectrum_frame_size; // preserve a bug in v<4
-        // go to -1 size b/c special handling, see after
-        for (uint16_t ix = 0; ix < MELS_SIZE-1; ix++) {
-            mels[ix] = functions::mel_to_frequency(mels[ix]);
-            if (mels[ix] < low_frequency) {
-                mels[ix] = low_frequency;
-            }
-            if (mels[ix] > high_frequency) {
-                mels[ix] = high_frequency;
-            }
-            bins[ix] = get_fft_bin_from_hertz(max_bin, mels[ix], sampling_frequency);
-        }
 
-        // here is a really annoying bug in Speechpy which calculates the frequency index wrong for the last bucket
-        // the last 'hertz' value is not 8,000 (with sampling rate 16,000) but 7,999.999999
-        // thus calculating the bucket to 64, not 65.
-        // we're adjusting this here a tiny bit to ensure we have the same result
-        mels[MELS_SIZE-1] = functions::mel_to_frequency(mels[MELS_SIZE-1]);
-        if (mels[MELS_SIZE-1] > high_frequency) {
-            mels[MELS_SIZE-1] = high_frequency;
+        mel_plan_release_t release_plans;
+        mel_plan_t *plan = get_mel_plan(false, sampling_frequency, num_filters, fft_length,
+            low_frequency, high_frequency, max_bin);
+        if (!plan) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
-        mels[MELS_SIZE-1] -= 0.001;
-        bins[MELS_SIZE-1] = get_fft_bin_from_hertz(max_bin, mels[MELS_SIZE-1], sampling_frequency);
+        const uint16_t *bins = plan->bins;
+        assert(bins[num_filters + 1] < power_spectrum_frame_size);
 
         EI_DSP_MATRIX(power_spectrum_frame, 1, power_spectrum_frame_size);
         if (!power_spectrum_frame.buffer) {
@@ -326,15 +336,18 @@ public:
                     (stack_frame_info.signal->total_length - (signal_offset + signal_length));
             }
 
+            EI_PROFILE_BEGIN(get_frame, "dsp/framing");
             ret = stack_frame_info.signal->get_data(
                 signal_offset,
                 signal_length,
                 signal_frame.buffer
             );
+            EI_PROFILE_END(get_frame);
             if (ret != 0) {
                 EIDSP_ERR(ret);
             }
 
+            EI_PROFILE_BEGIN(fft, "dsp/fft");
             ret = numpy::power_spectrum(
                 signal_frame.buffer,
                 stack_frame_info.frame_length,
@@ -342,6 +355,7 @@ public:
                 power_spectrum_frame_size,
                 fft_length
             );
+            EI_PROFILE_END(fft);
 
             if (ret != 0) {
                 EIDSP_ERR(ret);
@@ -356,34 +370,17 @@ public:
                 out_energies->buffer[ix] = energy;
             }
 
+            EI_PROFILE_BEGIN(filterbank, "dsp/filterbank");
             auto row_ptr = out_features->get_row_ptr(ix);
             for (size_t i = 0; i < num_filters; i++) {
-                size_t left = bins[i];
-                size_t middle = bins[i+1];
-                size_t right = bins[i+2];
-
-                assert(right < power_spectrum_frame_size);
-                // now we have weights and locations to move from fft to mel sgram
-                // both left and right become zero weights, so skip them
-
-                // middle always has weight of 1.0
-                // since we skip left and right, if left = middle we need to handle that
-                row_ptr[i] = power_spectrum_frame.buffer[middle];
-
-                for (size_t bin = left+1; bin < right; bin++) {
-                    if (bin < middle) {
-                        row_ptr[i] +=
-                            ((static_cast<float>(bin) - left) / (middle - left)) * // weight *
-                            power_spectrum_frame.buffer[bin];
-                    }
-                    // intentionally skip middle, handled above
-                    if (bin > middle) {
-                        row_ptr[i] +=
-                            ((right - static_cast<float>(bin)) / (right - middle)) * // weight *
-                            power_spectrum_frame.buffer[bin];
-                    }
+                // middle always has weight of 1.0, the other weights are in the plan
+                row_ptr[i] = power_spectrum_frame.buffer[bins[i + 1]];
+
+                for (uint32_t w = plan->weights_start[i]; w < plan->weights_start[i + 1]; w++) {
+                    row_ptr[i] += plan->weights[w] * power_spectrum_frame.buffer[plan->weight_bins[w]];
                 }
             }
+            EI_PROFILE_END(filterbank);
 
             if (ret != 0) {
                 EIDSP_ERR(ret);
@@ -436,6 +433,7 @@ public:
         stack_frames_info_t stack_frame_info = { 0 };
         stack_frame_info.signal = signal;
 
+        EI_PROFILE_BEGIN(stack_frames, "dsp/framing");
         ret = processing::stack_frames(
             &stack_frame_info,
             sampling_frequency,
@@ -444,6 +442,7 @@ public:
             false,
             version
         );
+        EI_PROFILE_END(stack_frames);
         if (ret != 0) {
             EIDSP_ERR(ret);
         }
@@ -468,33 +467,27 @@ public:
 
         uint16_t coefficients = fft_length / 2 + 1;
 
-        // calculate the filterbanks first... preferably I would want to do the matrix multiplications
-        // whenever they happen, but OK...
-#if EIDSP_QUANTIZE_FILTERBANK
-        EI_DSP_QUANTIZED_MATRIX(filterbanks, num_filters, coefficients, &numpy::dequantize_zero_one);
-#else
-        EI_DSP_MATRIX(filterbanks, num_filters, coefficients);
-#endif
-        if (!filterbanks.buffer) {
+        // the filterbank is calculated once per configuration and kept in the plan
+        mel_plan_release_t release_plans;
+        mel_plan_t *plan = get_mel_plan(true, sampling_frequency, num_filters, fft_length,
+            low_frequency, high_frequency, coefficients);
+        if (!plan) {
             EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
 
-        ret = feature::filterbanks(
-            &filterbanks, num_filters, coefficients, sampling_frequency, low_frequency, high_frequency, true);
-        if (ret != 0) {
-            EIDSP_ERR(ret);
+        const size_t power_spectrum_frame_size = (fft_length / 2 + 1);
+        EI_DSP_MATRIX(power_spectrum_frame, 1, power_spectrum_frame_size);
+        if (!power_spectrum_frame.buffer) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
-        for (size_t ix = 0; ix < stack_frame_info.frame_ixs.size(); ix++) {
-            size_t power_spectrum_frame_size = (fft_length / 2 + 1);
 
-            EI_DSP_MATRIX(power_spectrum_frame, 1, power_spectrum_frame_size);
-            if (!power_spectrum_frame.buffer) {
-                EIDSP_ERR(EIDSP_OUT_OF_MEM);
-            }
-
-            // get signal data from the audio file
-            EI_DSP_MATRIX(signal_frame, 1, stack_frame_info.frame_length);
+        // get signal data from the audio file
+        EI_DSP_MATRIX(signal_frame, 1, stack_frame_info.frame_length);
+        if (!signal_frame.buffer) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
 
+        for (size_t ix = 0; ix < stack_frame_info.frame_ixs.size(); ix++) {
             // don't read outside of the audio buffer... we'll automatically zero pad then
             size_t signal_offset = stack_frame_info.frame_ixs.at(ix);
             size_t signal_length = stack_frame_info.frame_length;
@@ -502,16 +495,24 @@ public:
                 signal_length = signal_length -
                     (stack_frame_info.signal->total_length - (signal_offset + signal_length));
             }
+            if (signal_length < (size_t)stack_frame_info.frame_length) {
+                // the frame buffer is reused, so pad explicitly
+                memset(signal_frame.buffer + signal_length, 0,
+                    (stack_frame_info.frame_length - signal_length) * sizeof(float));
+            }
 
+            EI_PROFILE_BEGIN(get_frame, "dsp/framing");
             ret = stack_frame_info.signal->get_data(
                 signal_offset,
                 signal_length,
                 signal_frame.buffer
             );
+            EI_PROFILE_END(get_frame);
             if (ret != 0) {
                 EIDSP_ERR(ret);
             }
 
+            EI_PROFILE_BEGIN(fft, "dsp/fft");
             ret = numpy::power_spectrum(
                 signal_frame.buffer,
                 stack_frame_info.frame_length,
@@ -519,6 +520,7 @@ public:
                 power_spectrum_frame_size,
                 fft_length
             );
+            EI_PROFILE_END(fft);
 
             if (ret != 0) {
                 EIDSP_ERR(ret);
@@ -534,13 +536,15 @@ public:
             }
 
             // calculate the out_features directly here
+            EI_PROFILE_BEGIN(filterbank, "dsp/filterbank");
             ret = numpy::dot_by_row(
                 ix,
                 power_spectrum_frame.buffer,
                 power_spectrum_frame_size,
-                &filterbanks,
+                plan->filterbank,
                 out_features
             );
+            EI_PROFILE_END(filterbank);
 
             if (ret != 0) {
                 EIDSP_ERR(ret);
@@ -576,6 +580,7 @@ public:
         stack_frames_info_t stack_frame_info = { 0 };
         stack_frame_info.signal = signal;
 
+        EI_PROFILE_BEGIN(stack_frames, "dsp/framing");
         ret = processing::stack_frames(
             &stack_frame_info,
             sampling_frequency,
@@ -584,6 +589,7 @@ public:
             false,
             version
         );
+        EI_PROFILE_END(stack_frames);
         if (ret != 0) {
             EIDSP_ERR(ret);
         }
@@ -614,11 +620,13 @@ public:
                     (stack_frame_info.signal->total_length - (signal_offset + signal_length));
             }
 
+            EI_PROFILE_BEGIN(get_frame, "dsp/framing");
             ret = stack_frame_info.signal->get_data(
                 signal_offset,
                 signal_length,
                 signal_frame.buffer
             );
+            EI_PROFILE_END(get_frame);
             if (ret != 0) {
                 EIDSP_ERR(ret);
             }
@@ -642,6 +650,7 @@ public:
                 }
             }
 
+            EI_PROFILE_BEGIN(fft, "dsp/fft");
             ret = numpy::power_spectrum(
                 signal_frame.buffer,
                 stack_frame_info.frame_length,
@@ -649,6 +658,7 @@ public:
                 coefficients,
                 fft_length
             );
+            EI_PROFILE_END(fft);
 
             if (ret != 0) {
                 EIDSP_ERR(ret);
@@ -763,7 +773,9 @@ public:
         }
 
         // now do DST type 2
+        EI_PROFILE_BEGIN(dct, "dsp/dct");
         ret = numpy::dct2(&features_matrix, DCT_NORMALIZATION_ORTHO);
+        EI_PROFILE_END(dct);
         if (ret != EIDSP_OK) {
             EIDSP_ERR(ret);
         }
@@ -813,6 +825,189 @@ public:
         size_matrix.cols = (uint32_t)cols;
         return size_matrix;
     }
+private:
+    // frees the plans again when returning from mfe() / mfe_v3() if EIDSP_PLAN_CACHE_SIZE is 0
+    struct mel_plan_release_t {
+        ~mel_plan_release_t() {
+            if (EIDSP_PLAN_CACHE_SIZE == 0) {
+                free_mel_plans();
+            }
+        }
+    };
+
+    static const size_t mel_plan_cache_size = EIDSP_PLAN_CACHE_SIZE > 0 ? EIDSP_PLAN_CACHE_SIZE : 1;
+
+    class mel_plan_cache_t {
+    public:
+        mel_plan_t plans[mel_plan_cache_size] = { };
+        size_t next = 0;
+
+        ~mel_plan_cache_t() {
+            clear();
+        }
+
+        void clear() {
+            for (size_t ix = 0; ix < mel_plan_cache_size; ix++) {
+                free_mel_plan(&plans[ix]);
+            }
+            next = 0;
+        }
+    };
+
+    static mel_plan_cache_t& mel_plan_cache() {
+        static EIDSP_THREAD_LOCAL mel_plan_cache_t cache;
+        return cache;
+    }
+
+    static void free_mel_plan(mel_plan_t *plan) {
+        ei_free(plan->bins);
+        ei_free(plan->weights_start);
+        ei_free(plan->weight_bins);
+        ei_free(plan->weights);
+        delete plan->filterbank;
+        memset(plan, 0, sizeof(mel_plan_t));
+    }
+
+    /**
+     * Mel filterbank for this configuration from the cache of the calling thread, calculated on
+     * first use. For mfe() (dense = false) max_bin is the bin count used to map frequencies
+     * to bins, for mfe_v3() (dense = true) it's the number of FFT coefficients.
+     * @returns nullptr if out of memory
+     */
+    static mel_plan_t* get_mel_plan(bool dense, uint32_t sampling_frequency, uint16_t num_filters,
+        uint16_t fft_length, uint32_t low_frequency, uint32_t high_frequency, uint16_t max_bin)
+    {
+        mel_plan_cache_t &cache = mel_plan_cache();
+        for (size_t ix = 0; ix < mel_plan_cache_size; ix++) {
+            mel_plan_t *plan = &cache.plans[ix];
+            if (plan->in_use && plan->dense == dense && plan->sampling_frequency == sampling_frequency &&
+                plan->num_filters == num_filters && plan->fft_length == fft_length &&
+                plan->low_frequency == low_frequency && plan->high_frequency == high_frequency &&
+                plan->max_bin == max_bin) {
+                return plan;
+            }
+        }
+
+        mel_plan_t *plan = &cache.plans[cache.next];
+        free_mel_plan(plan);
+        int ret = dense ?
+            build_dense_mel_plan(plan, sampling_frequency, num_filters, low_frequency, high_frequency, max_bin) :
+            build_sparse_mel_plan(plan, sampling_frequency, num_filters, low_frequency, high_frequency, max_bin);
+        if (ret != EIDSP_OK) {
+            free_mel_plan(plan);
+            return nullptr;
+        }
+
+        plan->in_use = true;
+        plan->dense = dense;
+        plan->sampling_frequency = sampling_frequency;
+        plan->num_filters = num_filters;
+        plan->fft_length = fft_length;
+        plan->low_frequency = low_frequency;
+        plan->high_frequency = high_frequency;
+        plan->max_bin = max_bin;
+        cache.next = (cache.next + 1) % mel_plan_cache_size;
+        return plan;
+    }
+
+    static int build_dense_mel_plan(mel_plan_t *plan, uint32_t sampling_frequency, uint16_t num_filters,
+        uint32_t low_frequency, uint32_t high_frequency, uint16_t coefficients)
+    {
+#if EIDSP_QUANTIZE_FILTERBANK
+        plan->filterbank = new quantized_matrix_t(num_filters, coefficients, &numpy::dequantize_zero_one);
+#else
+        plan->filterbank = new matrix_t(num_filters, coefficients);
+#endif
+        if (!plan->filterbank || !plan->filterbank->buffer) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        return feature::filterbanks(
+            plan->filterbank, num_filters, coefficients, sampling_frequency, low_frequency, high_frequency, true);
+    }
+
+    static int build_sparse_mel_plan(mel_plan_t *plan, uint32_t sampling_frequency, uint16_t num_filters,
+        uint32_t low_frequency, uint32_t high_frequency, uint16_t max_bin)
+    {
+        // Computing the Mel filterbank
+        // converting the upper and lower frequencies to Mels.
+        // num_filter + 2 is because for num_filter filterbanks we need
+        // num_filter+2 point.
+        const int MELS_SIZE = num_filters + 2;
+        ei_vector<float> mels(MELS_SIZE);
+        plan->bins = (uint16_t*)ei_calloc(MELS_SIZE, sizeof(uint16_t));
+        plan->weights_start = (uint32_t*)ei_calloc(num_filters + 1, sizeof(uint32_t));
+        if (!plan->bins || !plan->weights_start) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+        uint16_t *bins = plan->bins;
+
+        numpy::linspace(
+            functions::frequency_to_mel(static_cast<float>(low_frequency)),
+            functions::frequency_to_mel(static_cast<float>(high_frequency)),
+            num_filters + 2,
+            mels.data());
+
+        // go to -1 size b/c special handling, see after
+        for (uint16_t ix = 0; ix < MELS_SIZE-1; ix++) {
+            mels[ix] = functions::mel_to_frequency(mels[ix]);
+            if (mels[ix] < low_frequency) {
+                mels[ix] = low_frequency;
+            }
+            if (mels[ix] > high_frequency) {
+                mels[ix] = high_frequency;
+            }
+            bins[ix] = get_fft_bin_from_hertz(max_bin, mels[ix], sampling_frequency);
+        }
+
+        // here is a really annoying bug in Speechpy which calculates the frequency index wrong for the last bucket
+        // the last 'hertz' value is not 8,000 (with sampling rate 16,000) but 7,999.999999
+        // thus calculating the bucket to 64, not 65.
+        // we're adjusting this here a tiny bit to ensure we have the same result
+        mels[MELS_SIZE-1] = functions::mel_to_frequency(mels[MELS_SIZE-1]);
+        if (mels[MELS_SIZE-1] > high_frequency) {
+            mels[MELS_SIZE-1] = high_frequency;
+        }
+        mels[MELS_SIZE-1] -= 0.001;
+        bins[MELS_SIZE-1] = get_fft_bin_from_hertz(max_bin, mels[MELS_SIZE-1], sampling_frequency);
+
+        // both left and right become zero weights, and middle always has weight 1.0,
+        // so store the bins in between (in order, so the sums come out the same)
+        size_t weight_count = 0;
+        for (size_t i = 0; i < num_filters; i++) {
+            if (bins[i + 2] > bins[i] + 1) {
+                weight_count += bins[i + 2] - bins[i] - 1;
+            }
+        }
+        plan->weight_bins = (uint16_t*)ei_calloc(weight_count > 0 ? weight_count : 1, sizeof(uint16_t));
+        plan->weights = (float*)ei_calloc(weight_count > 0 ? weight_count : 1, sizeof(float));
+        if (!plan->weight_bins || !plan->weights) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        uint32_t w = 0;
+        for (size_t i = 0; i < num_filters; i++) {
+            size_t left = bins[i];
+            size_t middle = bins[i+1];
+            size_t right = bins[i+2];
+
+            plan->weights_start[i] = w;
+            for (size_t bin = left+1; bin < right; bin++) {
+                if (bin < middle) {
+                    plan->weight_bins[w] = bin;
+                    plan->weights[w++] = (static_cast<float>(bin) - left) / (middle - left);
+                }
+                // intentionally skip middle
+                if (bin > middle) {
+                    plan->weight_bins[w] = bin;
+                    plan->weights[w++] = (right - static_cast<float>(bin)) / (right - middle);
+                }
+            }
+        }
+        plan->weights_start[num_filters] = w;
+
+        return EIDSP_OK;
+    }
 };
 
 } // namespace speechpy
@@ -32,6 +32,7 @@
 #define _EIDSP_SPEECHPY_PROCESSING_H_
 
 #include "../numpy.hpp"
+#include "../ei_profiler.h"
 
 namespace ei {
 namespace speechpy {
@@ -400,6 +401,8 @@ namespace processing {
     static int cmvnw(matrix_t *features_matrix, uint16_t win_size = 301, bool variance_normalization = false,
         bool scale = false)
     {
+        EI_PROFILE_SCOPE("dsp/normalization");
+
         if (win_size == 0) {
             return EIDSP_OK;
         }
@@ -492,6 +495,8 @@ namespace processing {
      * @param features_matrix input feature matrix, will be modified in place
      */
     static int mfe_normalization(matrix_t *features_matrix, int noise_floor_db) {
+        EI_PROFILE_SCOPE("dsp/normalization");
+
         const float noise = static_cast<float>(noise_floor_db * -1);
         const float noise_scale = 1.0f / (static_cast<float>(noise_floor_db * -1) + 12.0f);
 
@@ -530,6 +535,8 @@ namespace processing {
      * @param features_matrix input feature matrix, will be modified in place
      */
     static int spectrogram_normalization(matrix_t *features_matrix, int noise_floor_db, bool clip_at_one) {
+        EI_PROFILE_SCOPE("dsp/normalization");
+
         const float noise = static_cast<float>(noise_floor_db * -1);
         const float noise_scale = 1.0f / (static_cast<float>(noise_floor_db * -1) + 12.0f);
 
@@ -35,6 +35,7 @@
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
 #if EI_PORTING_ANDROID== 1
 
+#include "edge-impulse-sdk/dsp/ei_memory_accounting.h"
 #include <inttypes.h>
 #include <math.h>
 #include <stdio.h>
@@ -99,14 +100,19 @@ __attribute__((weak)) char ei_getchar(void)
 }
 
 __attribute__((weak)) void *ei_malloc(size_t size) {
-    return malloc(size);
+    void *ptr = malloc(size);
+    ei_memory_accounting_alloc(ptr);
+    return ptr;
 }
 
 __attribute__((weak)) void *ei_calloc(size_t nitems, size_t size) {
-    return calloc(nitems, size);
+    void *ptr = calloc(nitems, size);
+    ei_memory_accounting_alloc(ptr);
+    return ptr;
 }
 
 __attribute__((weak)) void ei_free(void *ptr) {
+    ei_memory_accounting_free(ptr);
     free(ptr);
 }
 
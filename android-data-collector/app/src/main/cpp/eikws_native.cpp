@@ -1,18 +1,18 @@
 /* Edge Impulse "hey_android" KWS JNI bridge for the Android Data Collector.
  *
  * Exposes a small continuous-classifier API to Kotlin:
- *   init()             – calls run_classifier_init()
- *   sliceSize()        – samples per slice (PCM 16k mono)
- *   labelCount()       – number of output labels
- *   label(i)           – label name at index i
- *   runSlice(float[])  – feed one slice, returns float[label_count] scores
- *   deinit()           – tear down
+ *   createSession()             – new impulse handle + buffers, run_classifier_init() on it
+ *                                 (1 interpreter thread, pinned to the performance cores)
+ *   sliceSize()                 – samples per slice (PCM 16k mono)
+ *   labelCount()                – number of output labels
+ *   label(i)                    – label name at index i
+ *   runSlice(session, float[])  – feed one slice, returns float[label_count] scores
+ *   destroySession(session)     – tear down
  */
 
 #include <jni.h>
 #include <string>
 #include <vector>
-#include <mutex>
 #include <android/log.h>
 
 #include "edge-impulse-sdk/classifier/ei_run_classifier.h"
@@ -22,31 +22,50 @@
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
 namespace {
-    std::mutex g_lock;
-    bool g_inited = false;
+    /**
+     * Owns everything needed to run the continuous classifier: the impulse handle (with its
+     * preallocated features / outputs), the slice buffer, the scores and the result struct.
+     * Nothing is allocated per slice.
+     */
+    struct KwsSession {
+        ei_impulse_handle_t handle;
+        ei_impulse_result_t result;
+        std::vector<float> slice;
+        std::vector<float> scores;
+
+        KwsSession()
+            : handle(ei_default_impulse.impulse)
+            , slice(EI_CLASSIFIER_SLICE_SIZE)
+            , scores(EI_CLASSIFIER_LABEL_COUNT) {
+            // The KWS model is a few small convolutions: a single interpreter thread avoids waking
+            // up (and migrating) worker threads on every slice, pinned to the performance cores.
+            ei_tflite_runtime_options_t options = EI_TFLITE_RUNTIME_OPTIONS_DEFAULT;
+            options.num_threads = 1;
+            options.cpu_affinity_mask = ei_tflite_get_performance_cores_mask();
+            run_classifier_init(&handle, &options);
+        }
+
+        ~KwsSession() {
+            run_classifier_deinit(&handle);
+        }
+    };
 }
 
 extern "C" {
 
-JNIEXPORT jint JNICALL
-Java_com_edgeimpulse_datalogger_voice_KwsNative_initNative(JNIEnv*, jobject) {
-    std::lock_guard<std::mutex> lk(g_lock);
-    if (g_inited) return 0;
-    run_classifier_init();
-    g_inited = true;
-    LOGI("run_classifier_init() done; slice=%d freq=%d labels=%d",
+JNIEXPORT jlong JNICALL
+Java_com_edgeimpulse_datalogger_voice_KwsNative_createSession(JNIEnv*, jobject) {
+    auto *session = new KwsSession();
+    LOGI("session created; slice=%d freq=%d labels=%d",
          (int)EI_CLASSIFIER_SLICE_SIZE,
          (int)EI_CLASSIFIER_FREQUENCY,
          (int)EI_CLASSIFIER_LABEL_COUNT);
-    return 0;
+    return reinterpret_cast<jlong>(session);
 }
 
 JNIEXPORT void JNICALL
-Java_com_edgeimpulse_datalogger_voice_KwsNative_deinitNative(JNIEnv*, jobject) {
-    std::lock_guard<std::mutex> lk(g_lock);
-    if (!g_inited) return;
-    run_classifier_deinit();
-    g_inited = false;
+Java_com_edgeimpulse_datalogger_voice_KwsNative_destroySession(JNIEnv*, jobject, jlong session) {
+    delete reinterpret_cast<KwsSession*>(session);
 }
 
 JNIEXPORT jint JNICALL
@@ -78,11 +97,12 @@ Java_com_edgeimpulse_datalogger_voice_KwsNative_label(JNIEnv* env, jobject, jint
  */
 JNIEXPORT jfloatArray JNICALL
 Java_com_edgeimpulse_datalogger_voice_KwsNative_runSlice(JNIEnv* env, jobject,
+                                                          jlong session_ptr,
                                                           jfloatArray data) {
-    std::lock_guard<std::mutex> lk(g_lock);
-    if (!g_inited) {
-        run_classifier_init();
-        g_inited = true;
+    auto *session = reinterpret_cast<KwsSession*>(session_ptr);
+    if (!session) {
+        LOGE("runSlice: no session");
+        return nullptr;
     }
 
     jsize length = env->GetArrayLength(data);
@@ -92,20 +112,17 @@ Java_com_edgeimpulse_datalogger_voice_KwsNative_runSlice(JNIEnv* env, jobject,
         return nullptr;
     }
 
-    jfloat* inputPtr = env->GetFloatArrayElements(data, nullptr);
-    static std::vector<float> g_slice(EI_CLASSIFIER_SLICE_SIZE);
-    std::copy(inputPtr, inputPtr + length, g_slice.begin());
-    env->ReleaseFloatArrayElements(data, inputPtr, JNI_ABORT);
+    env->GetFloatArrayRegion(data, 0, length, session->slice.data());
 
     signal_t signal;
-    int err = numpy::signal_from_buffer(g_slice.data(), g_slice.size(), &signal);
+    int err = numpy::signal_from_buffer(session->slice.data(), session->slice.size(), &signal);
     if (err != 0) {
         LOGE("signal_from_buffer failed: %d", err);
         return nullptr;
     }
 
-    ei_impulse_result_t result = { 0 };
-    EI_IMPULSE_ERROR res = run_classifier_continuous(&signal, &result,
+    ei_impulse_result_t &result = session->result;
+    EI_IMPULSE_ERROR res = run_classifier_continuous(&session->handle, &signal, &result,
                                                      /*debug*/ false,
                                                      /*enable_maf*/ true);
     if (res != EI_IMPULSE_OK) {
@@ -113,12 +130,11 @@ Java_com_edgeimpulse_datalogger_voice_KwsNative_runSlice(JNIEnv* env, jobject,
         return nullptr;
     }
 
-    jfloatArray out = env->NewFloatArray(EI_CLASSIFIER_LABEL_COUNT);
-    std::vector<float> scores(EI_CLASSIFIER_LABEL_COUNT);
     for (uint32_t i = 0; i < EI_CLASSIFIER_LABEL_COUNT; i++) {
-        scores[i] = result.classification[i].value;
+        session->scores[i] = result.classification[i].value;
     }
-    env->SetFloatArrayRegion(out, 0, EI_CLASSIFIER_LABEL_COUNT, scores.data());
+    jfloatArray out = env->NewFloatArray(EI_CLASSIFIER_LABEL_COUNT);
+    env->SetFloatArrayRegion(out, 0, EI_CLASSIFIER_LABEL_COUNT, session->scores.data());
     return out;
 }
 
@@ -36,13 +36,19 @@ class KwsEngine(
     private var labels: List<String> = emptyList()
     private var lastFireMs: Long = 0L
 
+    // Native session, guarded by sessionLock so stop() can't free it under a running slice
+    private val sessionLock = Any()
+    private var session: Long = 0L
+
     fun start(): Boolean {
         if (_running.value) return true
         if (!KwsNative.isAvailable()) {
             Log.e(TAG, "Native lib unavailable")
             return false
         }
-        KwsNative.initNative()
+        synchronized(sessionLock) {
+            if (session == 0L) session = KwsNative.createSession()
+        }
         val sliceSize = KwsNative.sliceSize()
         val freq = KwsNative.frequency()
         labels = (0 until KwsNative.labelCount()).map { KwsNative.label(it) }
@@ -59,11 +65,18 @@ class KwsEngine(
         capture?.stop()
         capture = null
         _running.value = false
-        KwsNative.deinitNative()
+        synchronized(sessionLock) {
+            if (session != 0L) {
+                KwsNative.destroySession(session)
+                session = 0L
+            }
+        }
     }
 
     private fun onSlice(slice: FloatArray) {
-        val scores = KwsNative.runSlice(slice) ?: return
+        val scores = synchronized(sessionLock) {
+            if (session == 0L) null else KwsNative.runSlice(session, slice)
+        } ?: return
         var bestIdx = 0
         var bestVal = scores[0]
         for (i in 1 until scores.size) {
@@ -9,7 +9,8 @@ package com.edgeimpulse.datalogger.voice
  *
  * The native library is built from [app/src/main/cpp/CMakeLists.txt]. The model
  * expects PCM (16 kHz, mono, float, range +/-32768) fed one slice at a time
- * via [runSlice]; results are post-MAF probabilities indexed by [label].
+ * via [runSlice] on a session from [createSession]; results are post-MAF
+ * probabilities indexed by [label].
  */
 object KwsNative {
 
@@ -27,11 +28,12 @@ object KwsNative {
 
     fun isAvailable(): Boolean = loaded
 
-    external fun initNative(): Int
-    external fun deinitNative()
+    /** Creates a native session (impulse handle + buffers), returns an opaque handle. */
+    external fun createSession(): Long
+    external fun destroySession(session: Long)
     external fun sliceSize(): Int
     external fun frequency(): Int
     external fun labelCount(): Int
     external fun label(idx: Int): String
-    external fun runSlice(slice: FloatArray): FloatArray?
+    external fun runSlice(session: Long, slice: FloatArray): FloatArray?
 }
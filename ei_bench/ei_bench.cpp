@@ -0,0 +1,1776 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Host benchmark for the impulse in EI_BENCH_MODEL_DIR (see CMakeLists.txt).
+ *
+ * Runs run_classifier(), run_classifier_continuous() and, for camera models, the camera path
+ * (YUV_420_888 frame -> crop / resize -> run_classifier()) over synthetic or recorded input, and
+ * reports latency percentiles, throughput, memory per stage and allocations per inference.
+ * The stress mode runs several handles on their own threads and checks their results against
+ * a single-threaded run (build with -DEI_BENCH_SANITIZER=thread to look for data races), the
+ * batch mode compares the throughput of run_classifier_batch() over batch sizes, the nms mode
+ * checks and times ei_nms_run() against a plain sort + IoU NMS, the image-kernels mode checks
+ * and times the image DSP kernels against the per-pixel code they replaced, and the spectral mode
+ * checks the sliding window spectral analysis against the full-window one.
+ * Run with --help for the options.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "model-parameters/model_metadata.h"
+
+// ei_nms.h is only compiled for object detection models. The nms mode runs it on synthetic
+// candidates whatever the model is, so compile it here (under the YOLOv11 switch, which is put
+// back right after, so the rest of the SDK is built as exported).
+#if !(EI_HAS_YOLOV5 || EI_HAS_YOLOX || EI_HAS_TAO_DECODE_DETECTIONS || EI_HAS_TAO_YOLOV3 || EI_HAS_TAO_YOLOV4 || EI_HAS_YOLOV2 || EI_HAS_YOLO_PRO || EI_HAS_YOLOV11 || EI_HAS_QC_FACE_DET_LITE)
+#undef EI_HAS_YOLOV11
+#define EI_HAS_YOLOV11 1
+#include "edge-impulse-sdk/classifier/ei_nms.h"
+#undef EI_HAS_YOLOV11
+#define EI_HAS_YOLOV11 0
+#endif
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "edge-impulse-sdk/dsp/image/processing.hpp"
+#include "edge-impulse-sdk/dsp/image/kernels.hpp"
+#include "edge-impulse-sdk/dsp/ei_memory_accounting.h"
+#include "yuv_to_rgb.h"
+
+/**
+ * Allocation counting. On Linux malloc / calloc / realloc are wrapped at link time
+ * (-Wl,--wrap, see CMakeLists.txt), so allocations from the SDK and the C runtime are counted;
+ * operator new is replaced below for the allocations of the C++ runtime.
+ */
+static std::atomic<uint64_t> bench_allocations(0);
+
+#if EI_BENCH_WRAP_MALLOC == 1
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    bench_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    bench_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    bench_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+}
+#define bench_malloc __real_malloc
+#else
+#define bench_malloc malloc
+#endif
+
+void *operator new(size_t size)
+{
+    bench_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = bench_malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    bench_allocations.fetch_add(1, std::memory_order_relaxed);
+    return bench_malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept { free(ptr); }
+
+typedef struct {
+    const char *mode;           // all, classifier, continuous, image, stress, batch, nms, image-kernels or spectral
+    int runs;
+    int warmup;
+    const char *input;          // recorded raw features, nullptr for synthetic input
+    const char *frame_input;    // recorded YUV 4:2:0 frame (I420) for the image mode
+    int frame_width;
+    int frame_height;
+    int threads;                // full TFLite only, 0 = default
+    int handles;                // stress mode, one handle per thread
+    int batch;                  // batch mode, largest batch size
+    bool profile;
+    bool json;
+} bench_options_t;
+
+/**
+ * Latencies of all measured runs of one mode, in microseconds
+ */
+struct bench_samples_t {
+    std::vector<double> total;
+    std::vector<double> image;
+    std::vector<double> dsp;
+    std::vector<double> classification;
+    std::vector<double> postprocessing;
+
+    void reserve(size_t n) {
+        total.reserve(n);
+        image.reserve(n);
+        dsp.reserve(n);
+        classification.reserve(n);
+        postprocessing.reserve(n);
+    }
+
+    void add(double total_us, double image_us, const ei_impulse_result_t &result) {
+        total.push_back(total_us);
+        image.push_back(image_us);
+        dsp.push_back((double)result.timing.dsp_us);
+        classification.push_back((double)result.timing.classification_us);
+        postprocessing.push_back((double)result.timing.postprocessing_us);
+    }
+};
+
+typedef struct {
+    double mean;
+    double min;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+} bench_stats_t;
+
+struct bench_result_t {
+    std::string mode;
+    size_t runs;
+    double wall_us;
+    bench_samples_t samples;
+    double allocations_per_inference;
+    size_t dsp_peak_memory;
+    long max_rss_kb;
+#if EIDSP_MEMORY_ACCOUNTING == 1
+    ei_memory_stats_t memory;
+#endif
+#if EIDSP_PROFILING == 1
+    bool has_profile;
+    ei_profiler_report_t profile;
+#endif
+};
+
+/**
+ * Nearest-rank percentiles
+ */
+static bench_stats_t bench_get_stats(std::vector<double> values)
+{
+    bench_stats_t stats = { 0, 0, 0, 0, 0, 0 };
+    if (values.empty()) {
+        return stats;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    auto percentile = [&values](double p) {
+        size_t rank = (size_t)std::ceil(p / 100.0 * (double)values.size());
+        return values[rank == 0 ? 0 : rank - 1];
+    };
+
+    double sum = 0;
+    for (double v : values) {
+        sum += v;
+    }
+
+    stats.mean = sum / (double)values.size();
+    stats.min = values.front();
+    stats.p50 = percentile(50);
+    stats.p95 = percentile(95);
+    stats.p99 = percentile(99);
+    stats.max = values.back();
+    return stats;
+}
+
+static double bench_now_us(void)
+{
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static long bench_max_rss_kb(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/**
+ * Reads a recorded input: numbers separated by commas and / or whitespace, as copied from the
+ * 'Raw features' on the Live classification page (pixels as 0xRRGGBB hex are fine).
+ */
+static bool bench_read_features(const char *path, std::vector<float> *out)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        ei_printf("ERR: Failed to open %s\n", path);
+        return false;
+    }
+
+    std::string text;
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, read);
+    }
+    fclose(file);
+
+    out->clear();
+    const char *p = text.c_str();
+    while (*p) {
+        if (*p == ',' || isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+        char *end;
+        double value = strtod(p, &end);
+        if (end == p) {
+            ei_printf("ERR: Unexpected character '%c' in %s\n", *p, path);
+            return false;
+        }
+        out->push_back((float)value);
+        p = end;
+    }
+    return true;
+}
+
+/**
+ * Synthetic input when no recording is given: a few tones plus noise for time series, a
+ * gradient with noise for images (as 0xRRGGBB pixels). Deterministic, so runs are comparable.
+ */
+static void bench_synthetic_features(size_t count, std::vector<float> *out)
+{
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+    out->resize(count);
+    for (size_t ix = 0; ix < count; ix++) {
+#if EI_CLASSIFIER_SENSOR == EI_CLASSIFIER_SENSOR_CAMERA
+        uint32_t r = (uint32_t)(ix * 255 / count);
+        uint32_t g = (uint32_t)(128.0f + 100.0f * noise(rng));
+        uint32_t b = 255 - r;
+        (*out)[ix] = (float)((r << 16) | (g << 8) | b);
+#else
+        float t = (float)ix / (float)EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+        (*out)[ix] = 1000.0f * sinf(t * 0.05f) + 300.0f * sinf(t * 0.31f) + 100.0f * noise(rng);
+#endif
+    }
+}
+
+__attribute__((unused)) static void bench_synthetic_frame(int width, int height, std::vector<uint8_t> *out)
+{
+    std::mt19937 rng(42);
+    size_t luma = (size_t)width * height;
+    size_t chroma = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+
+    out->resize(luma + 2 * chroma);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            (*out)[(size_t)y * width + x] = (uint8_t)((x + y + (rng() & 15)) & 0xff);
+        }
+    }
+    for (size_t ix = 0; ix < 2 * chroma; ix++) {
+        (*out)[luma + ix] = (uint8_t)(96 + (rng() & 63));
+    }
+}
+
+typedef struct {
+    const float *features;
+    size_t offset;
+    size_t size;
+} bench_window_t;
+
+static int bench_window_get_data(bench_window_t *window, size_t offset, size_t length, float *out_ptr)
+{
+    // recorded input is read as a ring, so any recording length works for continuous mode
+    for (size_t ix = 0; ix < length; ix++) {
+        out_ptr[ix] = window->features[(window->offset + offset + ix) % window->size];
+    }
+    return 0;
+}
+
+/**
+ * Handle for one mode, released (interpreters, continuous state) when the mode is done
+ */
+struct bench_session_t {
+    ei_impulse_handle_t handle;
+    ei_impulse_result_t result;
+
+    bench_session_t(const bench_options_t *options) : handle(ei_default_impulse.impulse) {
+#if EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL
+        ei_tflite_runtime_options_t runtime_options = EI_TFLITE_RUNTIME_OPTIONS_DEFAULT;
+        runtime_options.num_threads = options->threads;
+        run_classifier_init(&handle, &runtime_options);
+#else
+        (void)options;
+        run_classifier_init(&handle);
+#endif
+        memset(&result, 0, sizeof(result));
+    }
+
+    ~bench_session_t() {
+        run_classifier_deinit(&handle);
+    }
+};
+
+/**
+ * Times options->runs calls of run_one(session, iteration, &image_us), after options->warmup
+ * calls that aren't counted (interpreter creation, plan caches, first touch of the arenas).
+ */
+template<typename F>
+static bool bench_run(const char *mode, const bench_options_t *options, F run_one, bench_result_t *out)
+{
+    bench_session_t session(options);
+
+    out->mode = mode;
+    out->runs = 0;
+    out->samples.reserve(options->runs);
+
+#if EIDSP_PROFILING == 1
+    out->has_profile = options->profile;
+    if (options->profile) {
+        ei_profiler_start(&session.handle);
+    }
+#endif
+
+    for (int ix = 0; ix < options->warmup; ix++) {
+        double image_us = 0;
+        EI_IMPULSE_ERROR res = run_one(&session, ix, &image_us);
+        if (res != EI_IMPULSE_OK) {
+            ei_printf("ERR: %s failed (%d)\n", mode, (int)res);
+            return false;
+        }
+    }
+
+#if EIDSP_PROFILING == 1
+    if (options->profile) {
+        ei_profiler_reset(&session.handle);
+    }
+#endif
+
+    ei_memory_peak_use = ei_memory_in_use;
+    size_t memory_baseline = ei_memory_in_use;
+#if EIDSP_MEMORY_ACCOUNTING == 1
+    ei_memory_reset_stats();
+#endif
+    uint64_t allocations = bench_allocations.load(std::memory_order_relaxed);
+    double start_us = bench_now_us();
+
+    for (int ix = 0; ix < options->runs; ix++) {
+        double image_us = 0;
+        double run_start_us = bench_now_us();
+        EI_IMPULSE_ERROR res = run_one(&session, options->warmup + ix, &image_us);
+        double run_us = bench_now_us() - run_start_us;
+        if (res != EI_IMPULSE_OK) {
+            ei_printf("ERR: %s failed (%d)\n", mode, (int)res);
+            return false;
+        }
+        out->samples.add(run_us, image_us, session.result);
+        out->runs++;
+    }
+
+    out->wall_us = bench_now_us() - start_us;
+    out->allocations_per_inference =
+        (double)(bench_allocations.load(std::memory_order_relaxed) - allocations) / (double)options->runs;
+    out->dsp_peak_memory = ei_memory_peak_use - memory_baseline;
+    out->max_rss_kb = bench_max_rss_kb();
+#if EIDSP_MEMORY_ACCOUNTING == 1
+    ei_memory_get_stats(&out->memory);
+#endif
+
+#if EIDSP_PROFILING == 1
+    if (options->profile) {
+        ei_profiler_get_report(&session.handle, &out->profile);
+        ei_profiler_stop(&session.handle);
+    }
+#endif
+
+    return true;
+}
+
+static bool bench_classifier(const bench_options_t *options, const std::vector<float> &features, bench_result_t *out)
+{
+    if (features.size() < EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
+        ei_printf("ERR: classifier needs at least %d features, input has %d\n",
+            (int)EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, (int)features.size());
+        return false;
+    }
+
+    // a longer recording is split in consecutive windows
+    size_t windows = features.size() / EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE;
+
+    auto run_one = [&](bench_session_t *session, int iteration, double *) {
+        signal_t signal;
+        const float *window = features.data() + (iteration % windows) * EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE;
+        numpy::signal_from_buffer(window, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+        return run_classifier(&session->handle, &signal, &session->result, false);
+    };
+
+    return bench_run("classifier", options, run_one, out);
+}
+
+static bool bench_continuous(const bench_options_t *options, const std::vector<float> &features, bench_result_t *out)
+{
+    const size_t slice_size = EI_CLASSIFIER_SLICE_SIZE * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+
+    auto run_one = [&](bench_session_t *session, int iteration, double *) {
+        bench_window_t window = { features.data(), ((size_t)iteration * slice_size) % features.size(), features.size() };
+        signal_t signal;
+        signal.total_length = slice_size;
+        signal.get_data = [&window](size_t offset, size_t length, float *out_ptr) {
+            return bench_window_get_data(&window, offset, length, out_ptr);
+        };
+        return run_classifier_continuous(&session->handle, &signal, &session->result, false);
+    };
+
+    return bench_run("continuous", options, run_one, out);
+}
+
+#if EI_CLASSIFIER_SENSOR == EI_CLASSIFIER_SENSOR_CAMERA
+static bool bench_image(const bench_options_t *options, const std::vector<uint8_t> &frame, bench_result_t *out)
+{
+    const int width = options->frame_width;
+    const int height = options->frame_height;
+    const size_t luma = (size_t)width * height;
+    const size_t chroma = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+
+    std::vector<uint8_t> rgb(EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT * 3);
+    const uint8_t *rgb_frame = rgb.data();
+
+    auto run_one = [&](bench_session_t *session, int, double *image_us) {
+        // same as passYuvToCpp in the camera example: one pass from the planes to the model input
+        double start_us = bench_now_us();
+        int res = yuv420_to_rgb888_crop_and_interpolate(
+            frame.data(),
+            frame.data() + luma,
+            frame.data() + luma + chroma,
+            width,
+            height,
+            width,
+            (width + 1) / 2,
+            1,
+            0,
+            rgb.data(),
+            EI_CLASSIFIER_INPUT_WIDTH,
+            EI_CLASSIFIER_INPUT_HEIGHT);
+        *image_us = bench_now_us() - start_us;
+        if (res != EIDSP_OK) {
+            return EI_IMPULSE_DSP_ERROR;
+        }
+
+        signal_t signal;
+        signal.total_length = EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT;
+        signal.get_data = [rgb_frame](size_t offset, size_t length, float *out_ptr) {
+            const uint8_t *pixel = rgb_frame + offset * 3;
+            for (size_t ix = 0; ix < length; ix++, pixel += 3) {
+                out_ptr[ix] = (float)((pixel[0] << 16) + (pixel[1] << 8) + pixel[2]);
+            }
+            return 0;
+        };
+        return run_classifier(&session->handle, &signal, &session->result, false);
+    };
+
+    return bench_run("image", options, run_one, out);
+}
+#endif // EI_CLASSIFIER_SENSOR == EI_CLASSIFIER_SENSOR_CAMERA
+
+/**
+ * Scores of a result, to compare the results of the stress threads with a single-threaded run
+ */
+static void bench_append_scores(const ei_impulse_result_t &result, std::vector<float> *out)
+{
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        out->push_back(result.classification[ix].value);
+    }
+    out->push_back(result.anomaly);
+    out->push_back((float)result.bounding_boxes_count);
+    for (uint32_t ix = 0; ix < result.bounding_boxes_count; ix++) {
+        const ei_impulse_result_bounding_box_t &bb = result.bounding_boxes[ix];
+        out->push_back(bb.value);
+        out->push_back((float)bb.x);
+        out->push_back((float)bb.y);
+        out->push_back((float)bb.width);
+        out->push_back((float)bb.height);
+    }
+}
+
+typedef struct {
+    EI_IMPULSE_ERROR res;
+    size_t inferences;
+    double wall_us;
+    std::vector<float> scores;
+    // with --profile, inferences in the profile of the handle, -1 if not profiled
+    int profiled_inferences;
+} bench_stress_run_t;
+
+/**
+ * The sequence every stress thread runs on its own handle: run_classifier() on the next window,
+ * then (time series models) run_classifier_continuous() on the next slice, options->runs times.
+ * If profile is set the handle is profiled, see bench_stress_run_t::profiled_inferences.
+ */
+static void bench_stress_sequence(const bench_options_t *options, const std::vector<float> &features,
+    bool profile, bench_stress_run_t *out)
+{
+    const size_t windows = features.size() / EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE;
+    bench_session_t session(options);
+
+    out->res = EI_IMPULSE_OK;
+    out->inferences = 0;
+    out->profiled_inferences = -1;
+#if EIDSP_PROFILING == 1
+    if (profile) {
+        ei_profiler_start(&session.handle);
+    }
+#else
+    (void)profile;
+#endif
+    double start_us = bench_now_us();
+
+    for (int ix = 0; ix < options->runs && out->res == EI_IMPULSE_OK; ix++) {
+        signal_t signal;
+        const float *window = features.data() + (ix % windows) * EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE;
+        numpy::signal_from_buffer(window, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
+        out->res = run_classifier(&session.handle, &signal, &session.result, false);
+        if (out->res != EI_IMPULSE_OK) {
+            break;
+        }
+        bench_append_scores(session.result, &out->scores);
+        out->inferences++;
+
+#if EI_CLASSIFIER_SENSOR != EI_CLASSIFIER_SENSOR_CAMERA
+        const size_t slice_size = EI_CLASSIFIER_SLICE_SIZE * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+        bench_window_t slice = { features.data(), ((size_t)ix * slice_size) % features.size(), features.size() };
+        signal.total_length = slice_size;
+        signal.get_data = [&slice](size_t offset, size_t length, float *out_ptr) {
+            return bench_window_get_data(&slice, offset, length, out_ptr);
+        };
+        out->res = run_classifier_continuous(&session.handle, &signal, &session.result, false);
+        if (out->res != EI_IMPULSE_OK) {
+            break;
+        }
+        bench_append_scores(session.result, &out->scores);
+        out->inferences++;
+#endif
+    }
+
+    out->wall_us = bench_now_us() - start_us;
+
+#if EIDSP_PROFILING == 1
+    if (profile) {
+        ei_profiler_report_t report;
+        ei_profiler_get_report(&session.handle, &report);
+        ei_profiler_stop(&session.handle);
+        out->profiled_inferences = (int)report.inferences;
+    }
+#endif
+}
+
+/**
+ * options->handles handles, each on its own thread, run the same sequence at the same time.
+ * Every thread has to get exactly the scores of a single-threaded run of the sequence; with
+ * per-handle state nothing is shared between them (ThreadSanitizer checks the rest).
+ * With --profile only the first handle is profiled, and its profile has to count exactly its
+ * own inferences, not those of the handles running next to it.
+ */
+static bool bench_stress(const bench_options_t *options, const std::vector<float> &features)
+{
+    if (features.size() < EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
+        ei_printf("ERR: stress needs at least %d features, input has %d\n",
+            (int)EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, (int)features.size());
+        return false;
+    }
+
+    bench_stress_run_t reference;
+    bench_stress_sequence(options, features, false, &reference);
+    if (reference.res != EI_IMPULSE_OK) {
+        ei_printf("ERR: stress reference run failed (%d)\n", (int)reference.res);
+        return false;
+    }
+
+    std::vector<bench_stress_run_t> runs(options->handles);
+    std::vector<std::thread> threads;
+    double start_us = bench_now_us();
+    for (int ix = 0; ix < options->handles; ix++) {
+        threads.emplace_back(bench_stress_sequence, options, std::cref(features), options->profile && ix == 0, &runs[ix]);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    double wall_us = bench_now_us() - start_us;
+
+    bool ok = true;
+    size_t inferences = 0;
+    for (int ix = 0; ix < options->handles; ix++) {
+        const bench_stress_run_t &run = runs[ix];
+        inferences += run.inferences;
+        if (run.res != EI_IMPULSE_OK) {
+            ei_printf("ERR: stress handle %d failed (%d)\n", ix, (int)run.res);
+            ok = false;
+            continue;
+        }
+        size_t mismatches = 0;
+        for (size_t jx = 0; jx < run.scores.size(); jx++) {
+            if (jx >= reference.scores.size() || run.scores[jx] != reference.scores[jx]) {
+                mismatches++;
+            }
+        }
+        mismatches += reference.scores.size() - std::min(reference.scores.size(), run.scores.size());
+        if (mismatches > 0) {
+            ei_printf("ERR: stress handle %d: %d of %d scores differ from the single-threaded run\n",
+                ix, (int)mismatches, (int)reference.scores.size());
+            ok = false;
+        }
+        if (run.profiled_inferences >= 0 && run.profiled_inferences != (int)run.inferences) {
+            ei_printf("ERR: stress handle %d: profile counts %d inferences, the handle ran %d\n",
+                ix, run.profiled_inferences, (int)run.inferences);
+            ok = false;
+        }
+    }
+
+    if (options->json) {
+        printf("{\"mode\":\"stress\",\"handles\":%d,\"inferences\":%d,\"inferences_per_second\":%.3f,\"ok\":%s}\n",
+            options->handles, (int)inferences, (double)inferences * 1000000.0 / wall_us, ok ? "true" : "false");
+    }
+    else {
+        ei_printf("stress: %d handles on %d threads, %d inferences, %.1f inferences/s (single handle: %.1f inferences/s)\n",
+            options->handles, options->handles, (int)inferences, (double)inferences * 1000000.0 / wall_us,
+            (double)reference.inferences * 1000000.0 / reference.wall_us);
+        ei_printf("  results %s the single-threaded run\n\n", ok ? "match" : "DO NOT match");
+    }
+    return ok;
+}
+
+/**
+ * run_classifier_batch() throughput for batch sizes 1, 2, 4, ... up to options->batch. Every
+ * size gets its own handle, options->warmup batches (the input tensor is resized on the first
+ * one) and then options->runs measured batches over consecutive windows of the input.
+ */
+static bool bench_batch(const bench_options_t *options, const std::vector<float> &features)
+{
+    if (features.size() < EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
+        ei_printf("ERR: batch needs at least %d features, input has %d\n",
+            (int)EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, (int)features.size());
+        return false;
+    }
+    const size_t windows = features.size() / EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE;
+
+    std::vector<int> batch_sizes;
+    for (int n = 1; n < options->batch; n *= 2) {
+        batch_sizes.push_back(n);
+    }
+    batch_sizes.push_back(options->batch);
+
+    if (!options->json) {
+#if EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL
+        ei_printf("batch: the model input is resized to the batch and run with one Invoke() "
+            "(models that can't be resized fall back to one inference per sample)\n");
+#else
+        ei_printf("batch: TensorFlow Lite Micro has no batched Invoke(), run_classifier_batch() "
+            "falls back to one inference per sample, so only the call overhead is compared\n");
+#endif
+        ei_printf("  %-6s %14s %12s %12s %10s\n", "batch", "inferences/s", "ms/batch", "ms/sample", "speedup");
+    }
+
+    std::string json;
+    double single_per_second = 0;
+    for (int n : batch_sizes) {
+        bench_session_t session(options);
+        std::vector<signal_t> signals(n);
+        std::vector<ei_impulse_result_t> results(n);
+        memset(results.data(), 0, sizeof(ei_impulse_result_t) * n);
+
+        auto run_batch = [&](int iteration) {
+            for (int ix = 0; ix < n; ix++) {
+                size_t window = ((size_t)iteration * n + ix) % windows;
+                numpy::signal_from_buffer(features.data() + window * EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE,
+                    EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signals[ix]);
+            }
+            return run_classifier_batch(&session.handle, signals.data(), n, results.data(), false);
+        };
+
+        for (int ix = 0; ix < options->warmup; ix++) {
+            EI_IMPULSE_ERROR res = run_batch(ix);
+            if (res != EI_IMPULSE_OK) {
+                ei_printf("ERR: run_classifier_batch (batch of %d) failed (%d)\n", n, (int)res);
+                return false;
+            }
+        }
+
+        double start_us = bench_now_us();
+        for (int ix = 0; ix < options->runs; ix++) {
+            EI_IMPULSE_ERROR res = run_batch(options->warmup + ix);
+            if (res != EI_IMPULSE_OK) {
+                ei_printf("ERR: run_classifier_batch (batch of %d) failed (%d)\n", n, (int)res);
+                return false;
+            }
+        }
+        double wall_us = bench_now_us() - start_us;
+
+        double per_second = (double)options->runs * n * 1000000.0 / wall_us;
+        if (n == 1) {
+            single_per_second = per_second;
+        }
+        double speedup = single_per_second > 0 ? per_second / single_per_second : 0;
+
+        if (options->json) {
+            char buffer[256];
+            snprintf(buffer, sizeof(buffer),
+                "%s{\"batch\":%d,\"inferences_per_second\":%.3f,\"ms_per_batch\":%.3f,\"speedup\":%.3f}",
+                json.empty() ? "" : ",", n, per_second, wall_us / 1000.0 / options->runs, speedup);
+            json.append(buffer);
+        }
+        else {
+            ei_printf("  %-6d %14.1f %12.3f %12.3f %9.2fx\n", n, per_second, wall_us / 1000.0 / options->runs,
+                wall_us / 1000.0 / options->runs / n, speedup);
+        }
+    }
+
+    if (options->json) {
+        printf("{\"mode\":\"batch\",\"engine\":\"%s\",\"batches\":[%s]}\n",
+            EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL ? "tflite-full" : "tflite-micro",
+            json.c_str());
+    }
+    else {
+        ei_printf("\n");
+    }
+    return true;
+}
+
+/**
+ * Synthetic YOLOv8 / YOLO11 output for the nms mode: one candidate per anchor of the 640x640
+ * 80x80 + 40x40 + 20x20 grids (8400), with the box and best class of each anchor. Anchors on
+ * one of the objects get a box around it with a high score, the others a small box with a low
+ * score, so the IoU and score thresholds both matter.
+ */
+static void bench_nms_candidates(std::mt19937 *rng, int objects, int classes,
+    std::vector<float> *boxes, std::vector<float> *scores, std::vector<int> *labels)
+{
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+
+    std::vector<float> obj;
+    for (int ix = 0; ix < objects; ix++) {
+        float w = 20.0f + u(*rng) * 200.0f;
+        float h = 20.0f + u(*rng) * 200.0f;
+        obj.insert(obj.end(), { u(*rng) * 640.0f, u(*rng) * 640.0f, w, h, (float)((*rng)() % classes) });
+    }
+
+    boxes->clear();
+    scores->clear();
+    labels->clear();
+    for (int stride : { 8, 16, 32 }) {
+        for (int gy = 0; gy < 640 / stride; gy++) {
+            for (int gx = 0; gx < 640 / stride; gx++) {
+                float cx = ((float)gx + 0.5f) * stride;
+                float cy = ((float)gy + 0.5f) * stride;
+                float w, h, score;
+                int label;
+                const float *o = nullptr;
+                for (int ix = 0; ix < objects && !o; ix++) {
+                    const float *candidate = &obj[ix * 5];
+                    if (fabsf(candidate[0] - cx) < candidate[2] / 2 && fabsf(candidate[1] - cy) < candidate[3] / 2) {
+                        o = candidate;
+                    }
+                }
+                if (o && u(*rng) < 0.5f) {
+                    cx = o[0] + (u(*rng) - 0.5f) * 16.0f;
+                    cy = o[1] + (u(*rng) - 0.5f) * 16.0f;
+                    w = o[2] * (0.8f + 0.4f * u(*rng));
+                    h = o[3] * (0.8f + 0.4f * u(*rng));
+                    score = 0.3f + 0.7f * u(*rng);
+                    label = (int)o[4];
+                }
+                else {
+                    w = stride * (1.0f + 4.0f * u(*rng));
+                    h = stride * (1.0f + 4.0f * u(*rng));
+                    score = 0.3f * u(*rng) * u(*rng);
+                    label = (int)((*rng)() % classes);
+                }
+                boxes->insert(boxes->end(), { cy - h / 2, cx - w / 2, cy + h / 2, cx + w / 2 });
+                scores->push_back(score);
+                labels->push_back(label);
+            }
+        }
+    }
+}
+
+/**
+ * NMS as before the SoA engine: sort the candidates over the threshold by score (ties in index
+ * order), then keep a candidate if its ComputeIntersectionOverUnion() with every kept box (of
+ * its class, when class aware) is below the IoU threshold.
+ */
+static void bench_nms_reference(const std::vector<float> &boxes, const std::vector<float> &scores,
+    const std::vector<int> &labels, float score_threshold, float iou_threshold, bool class_aware,
+    std::vector<int> *order, std::vector<int> *selected)
+{
+    order->clear();
+    for (size_t ix = 0; ix < scores.size(); ix++) {
+        if (scores[ix] > score_threshold) {
+            order->push_back((int)ix);
+        }
+    }
+    std::sort(order->begin(), order->end(), [&scores](const int a, const int b) {
+        return scores[a] > scores[b] || (scores[a] == scores[b] && a < b);
+    });
+
+    selected->clear();
+    for (int c : *order) {
+        bool suppressed = false;
+        for (int s : *selected) {
+            if ((!class_aware || labels[s] == labels[c]) &&
+                    ComputeIntersectionOverUnion(boxes.data(), c, s) >= iou_threshold) {
+                suppressed = true;
+                break;
+            }
+        }
+        if (!suppressed) {
+            selected->push_back(c);
+        }
+    }
+}
+
+/**
+ * ei_nms_run() against bench_nms_reference() on 8400 seeded YOLOv8 / YOLO11 style candidates,
+ * class agnostic and class aware, at a typical and at a low score threshold. Both have to keep
+ * the same boxes in the same order.
+ */
+static bool bench_nms(const bench_options_t *options)
+{
+    const int classes = 80;
+    std::mt19937 rng(42);
+    std::vector<float> boxes, scores;
+    std::vector<int> labels;
+    bench_nms_candidates(&rng, 30, classes, &boxes, &scores, &labels);
+    const size_t count = scores.size();
+
+    ei_nms_scratch_t *scratch = ei_nms_get_scratch();
+    if (!ei_nms_reserve(scratch, count)) {
+        ei_printf("ERR: Out of memory, can't allocate the NMS scratch\n");
+        return false;
+    }
+
+    if (!options->json) {
+        ei_printf("nms: %d candidates, %d classes, IoU threshold 0.45, %d runs after %d warm-up runs\n",
+            (int)count, classes, options->runs, options->warmup);
+        ei_printf("  %-9s %-12s %10s %14s %14s %9s %6s\n", "threshold", "classes", "candidates",
+            "reference (us)", "ei_nms_run (us)", "speedup", "kept");
+    }
+
+    bool ok = true;
+    std::string json;
+    std::vector<int> order, reference;
+    order.reserve(count);
+    reference.reserve(count);
+
+    for (float score_threshold : { 0.25f, 0.01f }) {
+        for (bool class_aware : { false, true }) {
+            ei_nms_options_t nms_options = { 0.45f, score_threshold, (int)count, 0, class_aware };
+            int selected = 0;
+
+            auto run_nms = [&]() {
+                for (size_t ix = 0; ix < count; ix++) {
+                    ei_nms_set_box(scratch, ix, boxes[ix * 4 + 0], boxes[ix * 4 + 1], boxes[ix * 4 + 2],
+                        boxes[ix * 4 + 3], scores[ix], labels[ix]);
+                }
+                selected = ei_nms_run(scratch, count, &nms_options);
+            };
+            auto run_reference = [&]() {
+                bench_nms_reference(boxes, scores, labels, score_threshold, 0.45f, class_aware,
+                    &order, &reference);
+            };
+
+            for (int ix = 0; ix < options->warmup; ix++) {
+                run_reference();
+                run_nms();
+            }
+
+            double start_us = bench_now_us();
+            for (int ix = 0; ix < options->runs; ix++) {
+                run_reference();
+            }
+            double reference_us = (bench_now_us() - start_us) / options->runs;
+
+            start_us = bench_now_us();
+            for (int ix = 0; ix < options->runs; ix++) {
+                run_nms();
+            }
+            double nms_us = (bench_now_us() - start_us) / options->runs;
+
+            bool same = (size_t)selected == reference.size() &&
+                std::equal(reference.begin(), reference.end(), scratch->selected);
+            if (!same) {
+                ei_printf("ERR: nms (threshold %.2f, %s) keeps %d boxes, the reference keeps %d\n",
+                    score_threshold, class_aware ? "class aware" : "agnostic", selected, (int)reference.size());
+                ok = false;
+            }
+
+            if (options->json) {
+                char buffer[256];
+                snprintf(buffer, sizeof(buffer),
+                    "%s{\"score_threshold\":%.2f,\"class_aware\":%s,\"candidates\":%d,\"reference_us\":%.3f,"
+                    "\"nms_us\":%.3f,\"kept\":%d,\"same\":%s}",
+                    json.empty() ? "" : ",", score_threshold, class_aware ? "true" : "false", (int)order.size(),
+                    reference_us, nms_us, selected, same ? "true" : "false");
+                json.append(buffer);
+            }
+            else {
+                ei_printf("  %-9.2f %-12s %10d %14.1f %14.1f %8.2fx %6d%s\n", score_threshold,
+                    class_aware ? "class aware" : "agnostic", (int)order.size(), reference_us, nms_us,
+                    reference_us / nms_us, selected, same ? "" : " MISMATCH");
+            }
+        }
+    }
+
+    if (options->json) {
+        printf("{\"mode\":\"nms\",\"candidates\":%d,\"runs\":[%s]}\n", (int)count, json.c_str());
+    }
+    else {
+        ei_printf("  selections %s the reference\n\n", ok ? "match" : "DO NOT match");
+    }
+    return ok;
+}
+
+/**
+ * The per-pixel image DSP code from before the SIMD kernels (extract_image_features and
+ * extract_image_features_quantized), as the reference for the image-kernels mode
+ */
+static void bench_image_reference_f32(const float *pixels, size_t pixel_count, int channels, float *out)
+{
+    for (size_t ix = 0; ix < pixel_count; ix++) {
+        uint32_t pixel = static_cast<uint32_t>(pixels[ix]);
+
+        float r = static_cast<float>(pixel >> 16 & 0xff) / 255.0f;
+        float g = static_cast<float>(pixel >> 8 & 0xff) / 255.0f;
+        float b = static_cast<float>(pixel & 0xff) / 255.0f;
+
+        if (channels == 3) {
+            *out++ = r;
+            *out++ = g;
+            *out++ = b;
+        }
+        else {
+            *out++ = (0.299f * r) + (0.587f * g) + (0.114f * b);
+        }
+    }
+}
+
+static void bench_image_reference_i8(const float *pixels, size_t pixel_count, int channels,
+    float scale, float zero_point, int image_scaling, int8_t *out)
+{
+    static const float torch_mean[] = { 0.485, 0.456, 0.406 };
+    static const float torch_std[] = { 0.229, 0.224, 0.225 };
+    const int32_t red_to_gray = (int32_t)(0.299f * 65536.0f);
+    const int32_t green_to_gray = (int32_t)(0.587f * 65536.0f);
+    const int32_t blue_to_gray = (int32_t)(0.114f * 65536.0f);
+    const bool fast_path = scale == 0.003921568859368563f && zero_point == -128 &&
+        image_scaling == EI_CLASSIFIER_IMAGE_SCALING_NONE;
+
+    for (size_t ix = 0; ix < pixel_count; ix++) {
+        uint32_t pixel = static_cast<uint32_t>(pixels[ix]);
+
+        if (fast_path) {
+            int32_t r = static_cast<int32_t>(pixel >> 16 & 0xff);
+            int32_t g = static_cast<int32_t>(pixel >> 8 & 0xff);
+            int32_t b = static_cast<int32_t>(pixel & 0xff);
+            if (channels == 3) {
+                *out++ = static_cast<int8_t>(r + zero_point);
+                *out++ = static_cast<int8_t>(g + zero_point);
+                *out++ = static_cast<int8_t>(b + zero_point);
+            }
+            else {
+                int32_t gray = (red_to_gray * r) + (green_to_gray * g) + (blue_to_gray * b);
+                gray >>= 16;
+                gray += zero_point;
+                if (gray < -128) gray = -128;
+                else if (gray > 127) gray = 127;
+                *out++ = static_cast<int8_t>(gray);
+            }
+            continue;
+        }
+
+        float r = static_cast<float>(pixel >> 16 & 0xff);
+        float g = static_cast<float>(pixel >> 8 & 0xff);
+        float b = static_cast<float>(pixel & 0xff);
+
+        if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_NONE) {
+            r /= 255.0f;
+            g /= 255.0f;
+            b /= 255.0f;
+        }
+        else if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_TORCH) {
+            r /= 255.0f;
+            g /= 255.0f;
+            b /= 255.0f;
+
+            r = (r - torch_mean[0]) / torch_std[0];
+            g = (g - torch_mean[1]) / torch_std[1];
+            b = (b - torch_mean[2]) / torch_std[2];
+        }
+        else if (image_scaling == EI_CLASSIFIER_IMAGE_SCALING_MIN128_127) {
+            r -= 128.0f;
+            g -= 128.0f;
+            b -= 128.0f;
+        }
+
+        if (channels == 3) {
+            *out++ = static_cast<int8_t>(round(r / scale) + zero_point);
+            *out++ = static_cast<int8_t>(round(g / scale) + zero_point);
+            *out++ = static_cast<int8_t>(round(b / scale) + zero_point);
+        }
+        else {
+            float v = (0.299f * r) + (0.587f * g) + (0.114f * b);
+            *out++ = static_cast<int8_t>(round(v / scale) + zero_point);
+        }
+    }
+}
+
+/**
+ * The image DSP kernels (dsp/image/kernels.hpp) against bench_image_reference_f32() /
+ * bench_image_reference_i8() at 96x96, 160x160 and 320x320: outputs have to be identical byte
+ * for byte. Float outputs go through extract_image_features(). int8 outputs go through
+ * extract_image_features_quantized() when the model is quantized, otherwise (the function isn't
+ * compiled then) through the kernels it uses, with tables built from the reference.
+ * RGB888 / grayscale byte buffers (camera frames) go through bytes_to_f32() / bytes_to_i8().
+ */
+static bool bench_image_kernels(const bench_options_t *options)
+{
+    typedef struct {
+        const char *name;
+        float scale;
+        float zero_point;
+        int image_scaling;
+    } quantization_t;
+    const quantization_t quantizations[] = {
+        { "i8", 0.003921568859368563f, -128, EI_CLASSIFIER_IMAGE_SCALING_NONE },
+        { "i8 0..1", 0.0045f, -100, EI_CLASSIFIER_IMAGE_SCALING_NONE },
+        { "i8 torch", 0.0187f, -14, EI_CLASSIFIER_IMAGE_SCALING_TORCH },
+        { "i8 min128", 1.0f, 0, EI_CLASSIFIER_IMAGE_SCALING_MIN128_127 },
+    };
+
+    if (!options->json) {
+        ei_printf("image-kernels: %d runs after %d warm-up runs, %s\n", options->runs, options->warmup,
+#if EI_IMAGE_KERNELS_NEON
+            "NEON"
+#elif EI_IMAGE_KERNELS_SSE2
+            "SSE2"
+#else
+            "no SIMD (scalar fallback)"
+#endif
+            );
+        ei_printf("  %-9s %-24s %14s %12s %9s %s\n", "size", "path", "reference (us)", "kernel (us)", "speedup", "");
+    }
+
+    bool ok = true;
+    std::string json;
+    std::mt19937 rng(42);
+
+    for (int size : { 96, 160, 320 }) {
+        const size_t pixel_count = (size_t)size * size;
+
+        std::vector<float> pixels(pixel_count);
+        std::vector<uint8_t> rgb888(pixel_count * 3);
+        for (size_t ix = 0; ix < pixel_count; ix++) {
+            uint32_t pixel = rng() & 0xffffff;
+            pixels[ix] = (float)pixel;
+            rgb888[ix * 3 + 0] = (uint8_t)(pixel >> 16);
+            rgb888[ix * 3 + 1] = (uint8_t)(pixel >> 8);
+            rgb888[ix * 3 + 2] = (uint8_t)pixel;
+        }
+        signal_t signal;
+        numpy::signal_from_buffer(pixels.data(), pixel_count, &signal);
+
+        std::vector<float> expected_f32(pixel_count * 3), actual_f32(pixel_count * 3);
+        std::vector<int8_t> expected_i8(pixel_count * 3), actual_i8(pixel_count * 3);
+
+        // times run() and reference(), then compares the outputs byte for byte
+        auto check = [&](const char *path, size_t bytes, const void *expected, const void *actual,
+                std::function<void()> reference, std::function<int()> run) {
+            for (int ix = 0; ix < options->warmup; ix++) {
+                reference();
+                run();
+            }
+            double start_us = bench_now_us();
+            for (int ix = 0; ix < options->runs; ix++) {
+                reference();
+            }
+            double reference_us = (bench_now_us() - start_us) / options->runs;
+            int res = EIDSP_OK;
+            start_us = bench_now_us();
+            for (int ix = 0; ix < options->runs && res == EIDSP_OK; ix++) {
+                res = run();
+            }
+            double kernel_us = (bench_now_us() - start_us) / options->runs;
+
+            bool same = res == EIDSP_OK && memcmp(expected, actual, bytes) == 0;
+            ok = ok && same;
+
+            char size_name[16];
+            snprintf(size_name, sizeof(size_name), "%dx%d", size, size);
+            if (options->json) {
+                char buffer[256];
+                snprintf(buffer, sizeof(buffer),
+                    "%s{\"size\":\"%s\",\"path\":\"%s\",\"reference_us\":%.3f,\"kernel_us\":%.3f,\"same\":%s}",
+                    json.empty() ? "" : ",", size_name, path, reference_us, kernel_us, same ? "true" : "false");
+                json.append(buffer);
+            }
+            else {
+                ei_printf("  %-9s %-24s %14.1f %12.1f %8.2fx %s\n", size_name, path, reference_us, kernel_us,
+                    reference_us / kernel_us, same ? "" : "MISMATCH");
+            }
+        };
+
+        for (int channels : { 3, 1 }) {
+            ei_dsp_config_image_t config = { 0, 1, 1, nullptr, 0, channels == 3 ? "RGB" : "Grayscale" };
+            const size_t values = pixel_count * channels;
+
+            matrix_t output(1, values, actual_f32.data());
+            check(channels == 3 ? "rgb f32" : "gray f32", values * sizeof(float), expected_f32.data(), actual_f32.data(),
+                [&]() { bench_image_reference_f32(pixels.data(), pixel_count, channels, expected_f32.data()); },
+                [&]() { return extract_image_features(&signal, &output, &config, 0); });
+
+            for (const quantization_t &q : quantizations) {
+                std::string path = std::string(channels == 3 ? "rgb " : "gray ") + q.name;
+                auto reference = [&]() {
+                    bench_image_reference_i8(pixels.data(), pixel_count, channels, q.scale, q.zero_point,
+                        q.image_scaling, expected_i8.data());
+                };
+#if (EI_CLASSIFIER_QUANTIZATION_ENABLED == 1) && (EI_CLASSIFIER_INFERENCING_ENGINE != EI_CLASSIFIER_DRPAI)
+                matrix_i8_t output_i8(1, values, actual_i8.data());
+                check(path.c_str(), values, expected_i8.data(), actual_i8.data(), reference, [&]() {
+                    return extract_image_features_quantized(&signal, &output_i8, &config, q.scale, q.zero_point, 0,
+                        q.image_scaling);
+                });
+#else
+                const bool fast_path = q.image_scaling == EI_CLASSIFIER_IMAGE_SCALING_NONE &&
+                    q.scale == 0.003921568859368563f && q.zero_point == -128;
+                if (channels == 1 && !fast_path) {
+                    // per-pixel code in extract_image_features_quantized(), not a kernel
+                    continue;
+                }
+                ei::image::kernels::quantization_lut_t lut;
+                for (int ch = 0; ch < 3; ch++) {
+                    for (int v = 0; v < 256; v++) {
+                        float pixel = (float)(v << (8 * (2 - ch)));
+                        int8_t quantized[3];
+                        bench_image_reference_i8(&pixel, 1, 3, q.scale, q.zero_point, q.image_scaling, quantized);
+                        lut[ch][v] = quantized[ch];
+                    }
+                }
+                check(path.c_str(), values, expected_i8.data(), actual_i8.data(), reference, [&]() {
+                    if (channels == 3) {
+                        ei::image::kernels::packed_to_rgb_i8(pixels.data(), pixel_count, lut, actual_i8.data());
+                    }
+                    else {
+                        ei::image::kernels::packed_to_gray_i8_fixed(pixels.data(), pixel_count,
+                            (int32_t)q.zero_point, actual_i8.data());
+                    }
+                    return (int)EIDSP_OK;
+                });
+#endif
+            }
+        }
+
+        // camera frames: RGB888 bytes, and the red bytes as a grayscale frame
+        std::vector<uint8_t> gray(pixel_count);
+        for (size_t ix = 0; ix < pixel_count; ix++) {
+            gray[ix] = rgb888[ix * 3];
+        }
+        for (int channels : { 3, 1 }) {
+            const uint8_t *bytes = channels == 3 ? rgb888.data() : gray.data();
+            const size_t values = pixel_count * channels;
+
+            check(channels == 3 ? "rgb888 bytes f32" : "gray bytes f32", values * sizeof(float),
+                expected_f32.data(), actual_f32.data(),
+                [&]() {
+                    for (size_t ix = 0; ix < values; ix++) {
+                        expected_f32[ix] = static_cast<float>(bytes[ix]) / 255.0f;
+                    }
+                },
+                [&]() {
+                    ei::image::kernels::bytes_to_f32(bytes, values, actual_f32.data());
+                    return (int)EIDSP_OK;
+                });
+
+            for (const quantization_t &q : quantizations) {
+                if (channels == 1 && q.image_scaling != EI_CLASSIFIER_IMAGE_SCALING_NONE) {
+                    continue;
+                }
+                ei::image::kernels::quantization_lut_t lut;
+                for (int ch = 0; ch < 3; ch++) {
+                    for (int v = 0; v < 256; v++) {
+                        float pixel = (float)(v << (8 * (2 - ch)));
+                        int8_t quantized[3];
+                        bench_image_reference_i8(&pixel, 1, 3, q.scale, q.zero_point, q.image_scaling, quantized);
+                        lut[ch][v] = quantized[ch];
+                    }
+                }
+                std::string path = std::string(channels == 3 ? "rgb888 bytes " : "gray bytes ") + q.name;
+                check(path.c_str(), values, expected_i8.data(), actual_i8.data(),
+                    [&]() {
+                        for (size_t ix = 0; ix < values; ix++) {
+                            float pixel = (float)((uint32_t)bytes[ix] << (8 * (2 - (ix % channels))));
+                            int8_t quantized[3];
+                            bench_image_reference_i8(&pixel, 1, 3, q.scale, q.zero_point, q.image_scaling, quantized);
+                            expected_i8[ix] = quantized[ix % channels];
+                        }
+                    },
+                    [&]() {
+                        ei::image::kernels::bytes_to_i8(bytes, pixel_count, channels, lut, actual_i8.data());
+                        return (int)EIDSP_OK;
+                    });
+            }
+        }
+    }
+
+    if (options->json) {
+        printf("{\"mode\":\"image-kernels\",\"runs\":[%s]}\n", json.c_str());
+    }
+    else {
+        ei_printf("  outputs %s the per-pixel code\n\n", ok ? "match" : "DO NOT match");
+    }
+    return ok;
+}
+
+/**
+ * extract_spectral_analysis_per_slice_features() (continuous mode) against
+ * extract_spectral_analysis_features() on the same window, for a few window / slice / FFT
+ * configurations: FFT frames reused between windows, a zero padded tail frame (window length
+ * not a multiple of the FFT length), and the configurations that recalculate the whole window
+ * (hop not dividing the window, filters). A 3-axis random walk is streamed a slice at a time
+ * and every full window has to give the same features within float tolerance.
+ */
+static bool bench_spectral(const bench_options_t *options)
+{
+    typedef struct {
+        const char *name;
+        uint16_t implementation_version;
+        size_t window_length;
+        size_t slice_length;
+        int fft_length;
+        bool do_fft_overlap;
+        const char *filter_type;
+        float filter_cutoff;
+        int filter_order;
+        float scale_axes;
+        bool do_log;
+    } spectral_case_t;
+    const spectral_case_t cases[] = {
+        { "reused frames", 2, 256, 32, 64, true, "none", 0, 0, 1.0f, false },
+        { "tail frame", 2, 200, 40, 16, true, "none", 0, 0, 1.0f, false },
+        { "tail frame, log, scale", 2, 120, 24, 16, true, "none", 0, 0, 2.5f, true },
+        { "tail frame, high cut", 2, 304, 16, 32, true, "high", 10.0f, 0, 1.0f, true },
+        { "no overlap", 2, 192, 64, 64, false, "none", 0, 0, 1.0f, false },
+        { "window not hop aligned", 2, 200, 25, 64, false, "none", 0, 0, 1.0f, false },
+        { "slice not hop aligned", 2, 256, 20, 64, true, "none", 0, 0, 1.0f, false },
+        { "low pass filter", 2, 250, 50, 32, true, "low", 20.0f, 2, 1.0f, true },
+        { "v4 reused frames", 4, 256, 32, 64, true, "none", 0, 0, 1.0f, false },
+        { "v4 tail frame", 4, 200, 40, 16, true, "none", 0, 0, 1.0f, true },
+    };
+    const size_t axes = 3;
+    const float frequency = 100.0f;
+
+    if (!options->json) {
+        ei_printf("spectral: %d slices per configuration after the window has filled, %d axes at %.0f Hz\n",
+            options->runs, (int)axes, frequency);
+        ei_printf("  %-24s %7s %6s %5s %15s %16s %9s %s\n", "configuration", "window", "slice", "fft",
+            "window (us)", "per slice (us)", "max diff", "");
+    }
+
+    bool ok = true;
+    std::string json;
+    std::mt19937 rng(42);
+    std::normal_distribution<float> step(0.0f, 1.0f);
+
+    for (const spectral_case_t &c : cases) {
+        ei_dsp_config_spectral_analysis_t config = { 0, c.implementation_version, (int)axes, c.scale_axes, 1,
+            c.filter_type, c.filter_cutoff, c.filter_order, "FFT", c.fft_length, 3, 0.1f, "[0.1, 0.5, 1.0, 2.0, 5.0]",
+            c.do_log, c.do_fft_overlap, 1, "db4", false };
+
+        size_t start_bin = 1;
+        size_t stop_bin = (c.fft_length / 2) + 1;
+        if (strcmp(c.filter_type, "none") != 0) {
+            spectral::feature::get_start_stop_bin(frequency, c.fft_length, c.filter_cutoff, &start_bin, &stop_bin,
+                strcmp(c.filter_type, "high") == 0);
+        }
+        const size_t feature_count = axes * (3 + (c.implementation_version == 4 ? 2 : 0) + stop_bin - start_bin);
+
+        const size_t slices = (c.window_length / c.slice_length) + options->runs;
+        std::vector<float> data(slices * c.slice_length * axes);
+        float position[axes] = { 0 };
+        for (size_t ix = 0; ix < data.size(); ix++) {
+            position[ix % axes] += step(rng);
+            data[ix] = position[ix % axes];
+        }
+
+        ei_dsp_window_state_t window_state(axes, c.window_length);
+        std::vector<float> expected(feature_count), actual(feature_count);
+        double window_us = 0, slice_us = 0, max_diff = 0;
+        int compared = 0;
+        bool same = window_state.is_valid();
+        bool supported = true;
+
+        for (size_t slice = 0; slice < slices && same && supported; slice++) {
+            signal_t slice_signal;
+            numpy::signal_from_buffer(data.data() + (slice * c.slice_length * axes), c.slice_length * axes,
+                &slice_signal);
+            matrix_t actual_matrix(1, feature_count, actual.data());
+            matrix_size_t size;
+
+            double start_us = bench_now_us();
+            int res = extract_spectral_analysis_per_slice_features(&slice_signal, &actual_matrix, &config, frequency,
+                &size, &window_state);
+            slice_us += bench_now_us() - start_us;
+            if (res != EIDSP_OK) {
+                ei_printf("ERR: extract_spectral_analysis_per_slice_features failed (%d)\n", res);
+                same = false;
+                break;
+            }
+            if (!window_state.is_full()) {
+                continue;
+            }
+
+            // the window ends with this slice
+            size_t window_end = (slice + 1) * c.slice_length;
+            signal_t window_signal;
+            numpy::signal_from_buffer(data.data() + ((window_end - c.window_length) * axes), c.window_length * axes,
+                &window_signal);
+            matrix_t expected_matrix(1, feature_count, expected.data());
+
+            start_us = bench_now_us();
+            res = extract_spectral_analysis_features(&window_signal, &expected_matrix, &config, frequency);
+            window_us += bench_now_us() - start_us;
+            if (res == EIDSP_NOT_SUPPORTED) {
+                // this implementation version isn't compiled in for this model (EI_DSP_PARAMS_GENERATED)
+                supported = false;
+                break;
+            }
+            if (res != EIDSP_OK || size.rows * size.cols != feature_count) {
+                ei_printf("ERR: extract_spectral_analysis_features failed (%d)\n", res);
+                same = false;
+                break;
+            }
+
+            for (size_t ix = 0; ix < feature_count; ix++) {
+                double diff = fabs((double)actual[ix] - expected[ix]);
+                max_diff = std::max(max_diff, diff / std::max(1.0, fabs((double)expected[ix])));
+                if (!(diff <= 1e-3 * std::max(1.0, fabs((double)expected[ix])))) {
+                    same = false;
+                }
+            }
+            compared++;
+        }
+        ok = ok && same;
+
+        if (options->json) {
+            char buffer[320];
+            snprintf(buffer, sizeof(buffer),
+                "%s{\"configuration\":\"%s\",\"window\":%zu,\"slice\":%zu,\"fft_length\":%d,\"supported\":%s,"
+                "\"window_us\":%.3f,\"slice_us\":%.3f,\"max_diff\":%g,\"same\":%s}",
+                json.empty() ? "" : ",", c.name, c.window_length, c.slice_length, c.fft_length,
+                supported ? "true" : "false", compared ? window_us / compared : 0, slices ? slice_us / slices : 0,
+                max_diff, same ? "true" : "false");
+            json.append(buffer);
+        }
+        else if (!supported) {
+            ei_printf("  %-24s %7zu %6zu %5d   not compiled in for this model\n", c.name, c.window_length,
+                c.slice_length, c.fft_length);
+        }
+        else {
+            ei_printf("  %-24s %7zu %6zu %5d %15.1f %16.1f %9.1e %s\n", c.name, c.window_length, c.slice_length,
+                c.fft_length, compared ? window_us / compared : 0, slice_us / slices, max_diff,
+                same ? "" : "MISMATCH");
+        }
+    }
+
+    if (options->json) {
+        printf("{\"mode\":\"spectral\",\"runs\":[%s]}\n", json.c_str());
+    }
+    else {
+        ei_printf("  sliding window features %s the full-window features\n\n", ok ? "match" : "DO NOT match");
+    }
+    return ok;
+}
+
+static void bench_print_stats(const char *name, const std::vector<double> &values)
+{
+    bench_stats_t s = bench_get_stats(values);
+    ei_printf("  %-16s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", name,
+        s.mean / 1000.0, s.min / 1000.0, s.p50 / 1000.0, s.p95 / 1000.0, s.p99 / 1000.0, s.max / 1000.0);
+}
+
+static void bench_print_result(const bench_result_t *result)
+{
+    ei_printf("%s: %d inferences, %.1f inferences/s\n", result->mode.c_str(), (int)result->runs,
+        (double)result->runs * 1000000.0 / result->wall_us);
+    ei_printf("  %-16s %10s %10s %10s %10s %10s %10s\n", "(ms)", "mean", "min", "p50", "p95", "p99", "max");
+    bench_print_stats("total", result->samples.total);
+    if (result->mode == "image") {
+        bench_print_stats("image", result->samples.image);
+    }
+    bench_print_stats("dsp", result->samples.dsp);
+    bench_print_stats("classification", result->samples.classification);
+    bench_print_stats("postprocessing", result->samples.postprocessing);
+    ei_printf("  allocations per inference: %.2f, DSP peak memory: %d bytes, max RSS: %ld KB\n",
+        result->allocations_per_inference, (int)result->dsp_peak_memory, result->max_rss_kb);
+
+#if EIDSP_MEMORY_ACCOUNTING == 1
+    ei_memory_print_stats(&result->memory);
+#endif
+
+#if EIDSP_PROFILING == 1
+    if (result->has_profile) {
+        ei_profiler_print_report(&result->profile);
+    }
+#endif
+    ei_printf("\n");
+}
+
+static void bench_stats_to_json(const char *name, const std::vector<double> &values, std::string *out)
+{
+    bench_stats_t s = bench_get_stats(values);
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer),
+        "\"%s\":{\"mean\":%.3f,\"min\":%.3f,\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+        name, s.mean, s.min, s.p50, s.p95, s.p99, s.max);
+    out->append(buffer);
+}
+
+static void bench_results_to_json(const std::vector<bench_result_t> &results, std::string *out)
+{
+    char buffer[512];
+
+    snprintf(buffer, sizeof(buffer), "{\"project\":\"%s\",\"deploy_version\":%d,\"engine\":\"%s\",\"modes\":[",
+        EI_CLASSIFIER_PROJECT_NAME, (int)EI_CLASSIFIER_PROJECT_DEPLOY_VERSION,
+        EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL ? "tflite-full" : "tflite-micro");
+    out->append(buffer);
+
+    for (size_t ix = 0; ix < results.size(); ix++) {
+        const bench_result_t &r = results[ix];
+        snprintf(buffer, sizeof(buffer),
+            "%s{\"mode\":\"%s\",\"runs\":%d,\"inferences_per_second\":%.3f,"
+            "\"allocations_per_inference\":%.3f,\"dsp_peak_memory\":%d,\"max_rss_kb\":%ld,\"latency_us\":{",
+            ix > 0 ? "," : "", r.mode.c_str(), (int)r.runs, (double)r.runs * 1000000.0 / r.wall_us,
+            r.allocations_per_inference, (int)r.dsp_peak_memory, r.max_rss_kb);
+        out->append(buffer);
+
+        bench_stats_to_json("total", r.samples.total, out);
+        out->append(",");
+        bench_stats_to_json("image", r.samples.image, out);
+        out->append(",");
+        bench_stats_to_json("dsp", r.samples.dsp, out);
+        out->append(",");
+        bench_stats_to_json("classification", r.samples.classification, out);
+        out->append(",");
+        bench_stats_to_json("postprocessing", r.samples.postprocessing, out);
+        out->append("}");
+
+#if EIDSP_MEMORY_ACCOUNTING == 1
+        std::string memory;
+        ei_memory_stats_to_json(&r.memory, &memory);
+        out->append(",\"memory\":");
+        out->append(memory);
+#endif
+
+#if EIDSP_PROFILING == 1
+        if (r.has_profile) {
+            std::string profile;
+            ei_profiler_report_to_json(&r.profile, &profile);
+            out->append(",\"profile\":");
+            out->append(profile);
+        }
+#endif
+        out->append("}");
+    }
+    out->append("]}");
+}
+
+static void bench_usage(const char *name)
+{
+    ei_printf("Usage: %s [options]\n\n", name);
+    ei_printf("  --mode MODE           all (default), classifier, continuous, image, stress, batch, nms,\n");
+    ei_printf("                        image-kernels or spectral\n");
+    ei_printf("  --runs N              measured inferences per mode (default 100)\n");
+    ei_printf("  --warmup N            inferences before measuring (default 5)\n");
+    ei_printf("  --input FILE          recorded raw features (comma separated), default synthetic\n");
+    ei_printf("  --frame WxH           camera frame size for the image mode (default 640x480)\n");
+    ei_printf("  --frame-input FILE    recorded YUV 4:2:0 (I420) camera frame for the image mode\n");
+    ei_printf("  --threads N           interpreter threads (full TensorFlow Lite only)\n");
+    ei_printf("  --handles N           handles (threads) for the stress mode (default 4)\n");
+    ei_printf("  --batch N             largest batch size for the batch mode (default 32)\n");
+    ei_printf("  --profile             time the DSP stages and the model ops as well\n");
+    ei_printf("  --json                print the results as JSON\n");
+}
+
+static bool bench_parse_options(int argc, char **argv, bench_options_t *options)
+{
+    *options = { "all", 100, 5, nullptr, nullptr, 640, 480, 0, 4, 32, false, false };
+
+    for (int ix = 1; ix < argc; ix++) {
+        const char *arg = argv[ix];
+        const char *value = ix + 1 < argc ? argv[ix + 1] : nullptr;
+
+        if (strcmp(arg, "--profile") == 0) {
+            options->profile = true;
+            continue;
+        }
+        if (strcmp(arg, "--json") == 0) {
+            options->json = true;
+            continue;
+        }
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0 || !value) {
+            return false;
+        }
+
+        ix++;
+        if (strcmp(arg, "--mode") == 0) {
+            options->mode = value;
+        }
+        else if (strcmp(arg, "--runs") == 0) {
+            options->runs = atoi(value);
+        }
+        else if (strcmp(arg, "--warmup") == 0) {
+            options->warmup = atoi(value);
+        }
+        else if (strcmp(arg, "--input") == 0) {
+            options->input = value;
+        }
+        else if (strcmp(arg, "--frame-input") == 0) {
+            options->frame_input = value;
+        }
+        else if (strcmp(arg, "--frame") == 0) {
+            if (sscanf(value, "%dx%d", &options->frame_width, &options->frame_height) != 2) {
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--threads") == 0) {
+            options->threads = atoi(value);
+        }
+        else if (strcmp(arg, "--handles") == 0) {
+            options->handles = atoi(value);
+        }
+        else if (strcmp(arg, "--batch") == 0) {
+            options->batch = atoi(value);
+        }
+        else {
+            return false;
+        }
+    }
+
+    return options->runs > 0 && options->warmup >= 0 && options->handles > 0 && options->batch > 0 &&
+        options->frame_width > 0 && options->frame_height > 0;
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t options;
+    if (!bench_parse_options(argc, argv, &options)) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+
+#if EIDSP_PROFILING != 1
+    if (options.profile) {
+        ei_printf("WARN: built with EIDSP_PROFILING=0, ignoring --profile\n");
+        options.profile = false;
+    }
+#endif
+
+    bool all = strcmp(options.mode, "all") == 0;
+    bool run_classifier_mode = all || strcmp(options.mode, "classifier") == 0;
+    bool run_continuous_mode = all || strcmp(options.mode, "continuous") == 0;
+    bool run_image_mode = all || strcmp(options.mode, "image") == 0;
+    bool run_stress_mode = strcmp(options.mode, "stress") == 0;
+    bool run_batch_mode = strcmp(options.mode, "batch") == 0;
+    bool run_nms_mode = strcmp(options.mode, "nms") == 0;
+    bool run_image_kernels_mode = strcmp(options.mode, "image-kernels") == 0;
+    bool run_spectral_mode = strcmp(options.mode, "spectral") == 0;
+    if (!run_classifier_mode && !run_continuous_mode && !run_image_mode && !run_stress_mode && !run_batch_mode &&
+            !run_nms_mode && !run_image_kernels_mode && !run_spectral_mode) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<float> features;
+    if (options.input) {
+        if (!bench_read_features(options.input, &features) || features.empty()) {
+            return 1;
+        }
+    }
+    else {
+        // a few windows, so continuous mode doesn't see the same slices over and over
+        bench_synthetic_features(EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE * 4, &features);
+    }
+
+    if (!options.json) {
+        ei_printf("%s (deploy v%d), %s, %d runs after %d warm-up runs\n\n", EI_CLASSIFIER_PROJECT_NAME,
+            (int)EI_CLASSIFIER_PROJECT_DEPLOY_VERSION,
+            EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE_FULL ? "TensorFlow Lite" : "TensorFlow Lite Micro",
+            options.runs, options.warmup);
+    }
+
+    if (run_stress_mode) {
+        return bench_stress(&options, features) ? 0 : 1;
+    }
+    if (run_batch_mode) {
+        return bench_batch(&options, features) ? 0 : 1;
+    }
+    if (run_nms_mode) {
+        return bench_nms(&options) ? 0 : 1;
+    }
+    if (run_image_kernels_mode) {
+        return bench_image_kernels(&options) ? 0 : 1;
+    }
+    if (run_spectral_mode) {
+        return bench_spectral(&options) ? 0 : 1;
+    }
+
+    std::vector<bench_result_t> results;
+    bool ok = true;
+
+    if (run_classifier_mode) {
+        bench_result_t result;
+        if (bench_classifier(&options, features, &result)) {
+            results.push_back(std::move(result));
+        }
+        else {
+            ok = false;
+        }
+    }
+
+    if (run_continuous_mode) {
+#if EI_CLASSIFIER_SENSOR != EI_CLASSIFIER_SENSOR_CAMERA
+        bench_result_t result;
+        if (bench_continuous(&options, features, &result)) {
+            results.push_back(std::move(result));
+        }
+        else {
+            ok = false;
+        }
+#else
+        if (!all) {
+            ei_printf("ERR: continuous mode needs a time series model\n");
+            ok = false;
+        }
+#endif
+    }
+
+    if (run_image_mode) {
+#if EI_CLASSIFIER_SENSOR == EI_CLASSIFIER_SENSOR_CAMERA
+        std::vector<uint8_t> frame;
+        size_t frame_size = (size_t)options.frame_width * options.frame_height +
+            2 * (size_t)((options.frame_width + 1) / 2) * ((options.frame_height + 1) / 2);
+        if (options.frame_input) {
+            FILE *file = fopen(options.frame_input, "rb");
+            frame.resize(frame_size);
+            if (!file || fread(frame.data(), 1, frame_size, file) != frame_size) {
+                ei_printf("ERR: %s is not a %dx%d I420 frame\n", options.frame_input,
+                    options.frame_width, options.frame_height);
+                ok = false;
+            }
+            if (file) {
+                fclose(file);
+            }
+        }
+        else {
+            bench_synthetic_frame(options.frame_width, options.frame_height, &frame);
+        }
+
+        bench_result_t result;
+        if (ok && bench_image(&options, frame, &result)) {
+            results.push_back(std::move(result));
+        }
+        else {
+            ok = false;
+        }
+#else
+        if (!all) {
+            ei_printf("ERR: image mode needs a camera model\n");
+            ok = false;
+        }
+#endif
+    }
+
+    if (options.json) {
+        std::string json;
+        bench_results_to_json(results, &json);
+        printf("%s\n", json.c_str());
+    }
+    else {
+        for (const bench_result_t &result : results) {
+            bench_print_result(&result);
+        }
+    }
+
+    return ok ? 0 : 1;
+}
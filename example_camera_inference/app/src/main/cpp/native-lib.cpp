@@ -35,17 +35,73 @@
 #include <jni.h>
 #include <android/log.h>
 #include <string>
+#include <string.h>
 #include <stdio.h>
 #include "vector"
 #include "edge-impulse-sdk/classifier/ei_run_classifier.h"
 #include "edge-impulse-sdk/dsp/image/image.hpp"
+#include "yuv_to_rgb.h"
 
-jbyte* byteData = nullptr;
 #define CAMERA_INPUT_WIDTH 480
 #define CAMERA_INPUT_HEIGHT 640
 #define PIXEL_NUM 3
 
-static int ei_camera_get_data(size_t offset, size_t length, float *out_ptr)
+/**
+ * Results are returned through a direct FloatBuffer that Kotlin allocates once
+ * (InferenceResult in MainActivity.kt) and hands to every call, so nothing is boxed or
+ * allocated on the result path. Layout (in floats), must match InferenceResult:
+ *
+ *   [0, RESULT_HEADER_SIZE)   header, see RESULT_IX_*
+ *   [RESULT_HEADER_SIZE, +EI_CLASSIFIER_LABEL_COUNT)   classification scores
+ *   then up to RESULT_MAX_BOXES boxes of RESULT_BOX_SIZE floats each:
+ *   label index (-1 for visual anomaly cells), value, x, y, width, height.
+ *   Object detection boxes come first, followed by the visual anomaly grid cells.
+ */
+#ifndef RESULT_MAX_BOXES
+#define RESULT_MAX_BOXES 100
+#endif
+
+#define RESULT_IX_FLAGS             0
+#define RESULT_IX_BOX_COUNT         1
+#define RESULT_IX_VISUAL_AD_COUNT   2
+#define RESULT_IX_ANOMALY           3
+#define RESULT_IX_VISUAL_AD_MAX     4
+#define RESULT_IX_VISUAL_AD_MEAN    5
+#define RESULT_IX_TIMING_DSP_US     6
+#define RESULT_IX_TIMING_CLASSIFICATION_US 7
+#define RESULT_IX_TIMING_ANOMALY_US 8
+#define RESULT_HEADER_SIZE          9
+#define RESULT_BOX_SIZE             6
+#define RESULT_BUFFER_SIZE          (RESULT_HEADER_SIZE + EI_CLASSIFIER_LABEL_COUNT + RESULT_MAX_BOXES * RESULT_BOX_SIZE)
+
+#define RESULT_FLAG_CLASSIFICATION  1
+#define RESULT_FLAG_OBJECT_DETECTION 2
+#define RESULT_FLAG_VISUAL_AD       4
+#define RESULT_FLAG_ANOMALY         8
+
+// Label strings, resolved once in JNI_OnLoad
+static jobjectArray labels_ref = nullptr;
+
+/**
+ * Inference session, created once from Kotlin (createSession) and passed back as a jlong.
+ * Owns the impulse handle (and with that the preallocated features / outputs), the result
+ * struct and the model sized RGB888 input frame, so no allocations happen per frame.
+ */
+struct ei_session_t {
+    ei_impulse_handle_t handle;
+    ei_impulse_result_t result;
+    uint8_t input_frame[EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT * PIXEL_NUM];
+
+    ei_session_t() : handle(ei_default_impulse.impulse) {
+        run_classifier_init(&handle);
+    }
+
+    ~ei_session_t() {
+        run_classifier_deinit(&handle);
+    }
+};
+
+static int ei_camera_get_data(const uint8_t *frame, size_t offset, size_t length, float *out_ptr)
 {
     // we already have a RGB888 buffer, so recalculate offset into pixel index
     size_t pixel_ix = offset * 3;
@@ -54,9 +110,9 @@ static int ei_camera_get_data(size_t offset, size_t length, float *out_ptr)
 
     while (pixels_left != 0) {
 
-        uint8_t r = static_cast<uint8_t>(byteData[pixel_ix]);
-        uint8_t g = static_cast<uint8_t>(byteData[pixel_ix + 1]);
-        uint8_t b = static_cast<uint8_t>(byteData[pixel_ix + 2]);
+        uint8_t r = frame[pixel_ix];
+        uint8_t g = frame[pixel_ix + 1];
+        uint8_t b = frame[pixel_ix + 2];
 
         out_ptr[out_ptr_ix] = (r << 16) + (g << 8) + b;
 
@@ -70,209 +126,268 @@ static int ei_camera_get_data(size_t offset, size_t length, float *out_ptr)
     return 0;
 }
 
-extern "C" JNIEXPORT jobject JNICALL
+static void write_inference_result(const ei_impulse_result_t &result, float *out);
+
+static jboolean classify_frame(ei_session_t *session, float *out)
+{
+    const uint8_t *frame = session->input_frame;
+
+    signal_t signal;
+    signal.total_length = EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT;
+    signal.get_data = [frame](size_t offset, size_t length, float *out_ptr) {
+        return ei_camera_get_data(frame, offset, length, out_ptr);
+    };
+
+    EI_IMPULSE_ERROR res = run_classifier(&session->handle, &signal, &session->result, false);
+
+    if (res != EI_IMPULSE_OK) {
+        __android_log_print(ANDROID_LOG_ERROR, "MAIN", "run_classifier failed (%d)\n", res);
+        return JNI_FALSE;
+    }
+
+    write_inference_result(session->result, out);
+    return JNI_TRUE;
+}
+
+/**
+ * Returns the address of the caller's result buffer, or nullptr if it's not a direct
+ * buffer of at least RESULT_BUFFER_SIZE floats.
+ */
+static float *get_result_buffer(JNIEnv* env, jobject result_buffer)
+{
+    auto *out = static_cast<float*>(env->GetDirectBufferAddress(result_buffer));
+    if (!out || env->GetDirectBufferCapacity(result_buffer) < RESULT_BUFFER_SIZE) {
+        __android_log_print(ANDROID_LOG_ERROR, "MAIN", "Result buffer must be a direct FloatBuffer of at least %d floats\n",
+                            RESULT_BUFFER_SIZE);
+        return nullptr;
+    }
+    return out;
+}
+
+extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void*)
+{
+    JNIEnv* env;
+    if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+
+    jclass stringClass = env->FindClass("java/lang/String");
+    if (!stringClass) {
+        return JNI_ERR;
+    }
+
+    jobjectArray labels = env->NewObjectArray(EI_CLASSIFIER_LABEL_COUNT, stringClass, nullptr);
+    for (size_t i = 0; i < EI_CLASSIFIER_LABEL_COUNT; i++) {
+        jstring label = env->NewStringUTF(ei_classifier_inferencing_categories[i]);
+        env->SetObjectArrayElement(labels, i, label);
+        env->DeleteLocalRef(label);
+    }
+    labels_ref = static_cast<jobjectArray>(env->NewGlobalRef(labels));
+    env->DeleteLocalRef(labels);
+    env->DeleteLocalRef(stringClass);
+
+    return JNI_VERSION_1_6;
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_example_test_1camera_MainActivity_getLabels(
+        JNIEnv*,
+        jobject) {
+    return labels_ref;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_test_1camera_MainActivity_getResultBufferSize(
+        JNIEnv*,
+        jobject) {
+    return RESULT_BUFFER_SIZE;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_test_1camera_MainActivity_createSession(
+        JNIEnv*,
+        jobject) {
+    return reinterpret_cast<jlong>(new ei_session_t());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_test_1camera_MainActivity_destroySession(
+        JNIEnv*,
+        jobject,
+        jlong session) {
+    delete reinterpret_cast<ei_session_t*>(session);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
 Java_com_example_test_1camera_MainActivity_passToCpp(
         JNIEnv* env,
         jobject,
-        jbyteArray image_data) {
+        jlong session_ptr,
+        jbyteArray image_data,
+        jobject result_buffer) {
+
+    auto *session = reinterpret_cast<ei_session_t*>(session_ptr);
+    float *out = get_result_buffer(env, result_buffer);
+    if (!session || !out) {
+        return JNI_FALSE;
+    }
 
-    // Get byte array data from JNI
-    byteData = env->GetByteArrayElements(image_data, nullptr);
     jsize byteArrayLength = env->GetArrayLength(image_data);
 
     if (byteArrayLength != CAMERA_INPUT_WIDTH * CAMERA_INPUT_HEIGHT * PIXEL_NUM) {
         __android_log_print(ANDROID_LOG_INFO, "MAIN", "The size of your 'features' array is not correct. Expected %d items, but had %d\n",
                             CAMERA_INPUT_WIDTH * CAMERA_INPUT_HEIGHT * PIXEL_NUM, byteArrayLength);
-        return nullptr;
+        return JNI_FALSE;
     }
 
+    // Get byte array data from JNI
+    jbyte* byteData = env->GetByteArrayElements(image_data, nullptr);
+
     ei::image::processing::crop_and_interpolate_rgb888(
             (uint8_t*)byteData,
             CAMERA_INPUT_WIDTH,
             CAMERA_INPUT_HEIGHT,
-            (uint8_t*)byteData,
+            session->input_frame,
             EI_CLASSIFIER_INPUT_WIDTH,
             EI_CLASSIFIER_INPUT_HEIGHT);
 
-    ei_impulse_result_t result;
+    // the caller's array is left untouched
+    env->ReleaseByteArrayElements(image_data, byteData, JNI_ABORT);
 
-    signal_t signal;
-    signal.total_length = EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT;
-    signal.get_data = &ei_camera_get_data;
+    return classify_frame(session, out);
+}
 
-    EI_IMPULSE_ERROR res = run_classifier(&signal, &result, false);
+/**
+ * Zero-copy path: takes the YUV_420_888 planes of a CameraX ImageProxy as direct ByteBuffers,
+ * converts, rotates, crops and resizes them in a single pass straight into the model sized
+ * input buffer. No Bitmap / byte[] is created on the Java side.
+ */
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_example_test_1camera_MainActivity_passYuvToCpp(
+        JNIEnv* env,
+        jobject,
+        jlong session_ptr,
+        jobject y_buffer,
+        jobject u_buffer,
+        jobject v_buffer,
+        jint width,
+        jint height,
+        jint y_row_stride,
+        jint uv_row_stride,
+        jint uv_pixel_stride,
+        jint rotation_degrees,
+        jobject result_buffer) {
+
+    auto *session = reinterpret_cast<ei_session_t*>(session_ptr);
+    float *out = get_result_buffer(env, result_buffer);
+    if (!session || !out) {
+        return JNI_FALSE;
+    }
 
-    // Find Java classes
-    jclass resultClass = env->FindClass("com/example/test_camera/InferenceResult");
-    jclass timingClass = env->FindClass("com/example/test_camera/Timing");
-    jclass hashMapClass = env->FindClass("java/util/HashMap");
-    jclass listClass = env->FindClass("java/util/ArrayList");
-    jclass boundingBoxClass = env->FindClass("com/example/test_camera/BoundingBox");
+    auto *y_plane = static_cast<const uint8_t*>(env->GetDirectBufferAddress(y_buffer));
+    auto *u_plane = static_cast<const uint8_t*>(env->GetDirectBufferAddress(u_buffer));
+    auto *v_plane = static_cast<const uint8_t*>(env->GetDirectBufferAddress(v_buffer));
 
-    if (!resultClass || !timingClass || !hashMapClass || !listClass || !boundingBoxClass) {
-        return nullptr; // Error finding classes
+    if (!y_plane || !u_plane || !v_plane) {
+        __android_log_print(ANDROID_LOG_ERROR, "MAIN", "Image planes are not direct buffers\n");
+        return JNI_FALSE;
     }
 
-    // Get method IDs
-    jmethodID resultConstructor = env->GetMethodID(resultClass, "<init>",
-                                                   "(Ljava/util/Map;Ljava/util/List;Ljava/util/List;Ljava/util/Map;Lcom/example/test_camera/Timing;)V");
+    int res = yuv420_to_rgb888_crop_and_interpolate(
+            y_plane,
+            u_plane,
+            v_plane,
+            width,
+            height,
+            y_row_stride,
+            uv_row_stride,
+            uv_pixel_stride,
+            rotation_degrees,
+            session->input_frame,
+            EI_CLASSIFIER_INPUT_WIDTH,
+            EI_CLASSIFIER_INPUT_HEIGHT);
+
+    if (res != EIDSP_OK) {
+        __android_log_print(ANDROID_LOG_ERROR, "MAIN", "Failed to convert camera frame (%d)\n", res);
+        return JNI_FALSE;
+    }
 
-    jmethodID boundingBoxConstructor = env->GetMethodID(boundingBoxClass, "<init>",
-                                                        "(Ljava/lang/String;FIIII)V");
+    return classify_frame(session, out);
+}
 
-    jmethodID timingConstructor = env->GetMethodID(timingClass, "<init>",
-                                                   "(IIIIJJJ)V");
+static void write_box(float *out, uint32_t ix, float label_ix, const ei_impulse_result_bounding_box_t &bb)
+{
+    // boxes are scaled to the preview size
+    float x_ratio = 1080 / (float)EI_CLASSIFIER_INPUT_WIDTH;
+    float y_ratio = 2400 / (float)EI_CLASSIFIER_INPUT_HEIGHT;
+
+    float *box = out + RESULT_HEADER_SIZE + EI_CLASSIFIER_LABEL_COUNT + ix * RESULT_BOX_SIZE;
+    box[0] = label_ix;
+    box[1] = bb.value;
+    box[2] = (float)bb.x * x_ratio;
+    box[3] = (float)bb.y * y_ratio;
+    box[4] = (float)bb.width * x_ratio;
+    box[5] = (float)bb.height * y_ratio;
+}
 
-    jmethodID hashMapInit = env->GetMethodID(hashMapClass, "<init>", "()V");
-    jmethodID hashMapPut = env->GetMethodID(hashMapClass, "put",
-                                            "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;");
-    jmethodID listAdd = env->GetMethodID(listClass, "add", "(Ljava/lang/Object;)Z");
+__attribute__((unused)) static float get_label_index(const char *label)
+{
+    for (size_t i = 0; i < EI_CLASSIFIER_LABEL_COUNT; i++) {
+        // postprocessing points at the category strings, so this is usually a pointer match
+        if (label == ei_classifier_inferencing_categories[i] ||
+            strcmp(label, ei_classifier_inferencing_categories[i]) == 0) {
+            return (float)i;
+        }
+    }
+    return -1.0f;
+}
 
-    jclass floatClass = env->FindClass("java/lang/Float");
-    if (!floatClass) return nullptr;
+static void write_inference_result(const ei_impulse_result_t &result, float *out)
+{
+    uint32_t flags = 0;
+    uint32_t box_count = 0;
+    uint32_t visual_ad_count = 0;
 
-    // Get Float constructor method ID
-    jmethodID floatConstructor = env->GetMethodID(floatClass, "<init>", "(F)V");
-    if (!floatConstructor) return nullptr; // Error finding constructor
+    out[RESULT_IX_ANOMALY] = 0.0f;
+    out[RESULT_IX_VISUAL_AD_MAX] = 0.0f;
+    out[RESULT_IX_VISUAL_AD_MEAN] = 0.0f;
 
 #if EI_CLASSIFIER_LABEL_COUNT > 0
-    // Construct classification map
-    jobject classificationMap = env->NewObject(hashMapClass, hashMapInit);
+    flags |= RESULT_FLAG_CLASSIFICATION;
     for (size_t i = 0; i < EI_CLASSIFIER_LABEL_COUNT; i++) {
-        jstring key = env->NewStringUTF(result.classification[i].label);
-        jobject value = env->NewObject(floatClass, floatConstructor, result.classification[i].value);
-
-        env->CallObjectMethod(classificationMap, hashMapPut, key, value);
-
-        // Cleanup local references
-        env->DeleteLocalRef(key);
-        env->DeleteLocalRef(value);
+        out[RESULT_HEADER_SIZE + i] = result.classification[i].value;
     }
 #endif
 
 #if EI_CLASSIFIER_OBJECT_DETECTION == 1
-    // Create ArrayList for object detections
-    jobject boundingBoxList = env->NewObject(listClass, env->GetMethodID(listClass, "<init>", "()V"));
-    for (uint32_t i = 0; i < result.bounding_boxes_count; i++) {
-        ei_impulse_result_bounding_box_t bb = result.bounding_boxes[i];
+    flags |= RESULT_FLAG_OBJECT_DETECTION;
+    for (uint32_t i = 0; i < result.bounding_boxes_count && box_count < RESULT_MAX_BOXES; i++) {
+        const ei_impulse_result_bounding_box_t &bb = result.bounding_boxes[i];
         if (bb.value == 0) continue;
-        float x_ratio = 1080 / (float)EI_CLASSIFIER_INPUT_WIDTH;
-        float y_ratio = 2400 / (float)EI_CLASSIFIER_INPUT_HEIGHT;
-        //__android_log_print(ANDROID_LOG_INFO, "MAIN", "x_ratio: %f, y_ratio: %f", x_ratio, y_ratio);
-
-        float x = (float)bb.x * x_ratio;
-        float y = (float)bb.y * y_ratio;
-        float width = (float)bb.width * x_ratio;
-        float height = (float)bb.height * y_ratio;
-
-        //__android_log_print(ANDROID_LOG_INFO, "MAIN", "x: %f, y: %f, width: %f, height: %f", x, y, width, height);
-
-        jstring label = env->NewStringUTF(bb.label);
-        jobject boundingBoxObj = env->NewObject(boundingBoxClass,
-                                                boundingBoxConstructor,
-                                                label,
-                                                (jfloat)bb.value,
-                                                (jint)x,
-                                                (jint)y,
-                                                (jint)width,
-                                                (jint)height);
-        env->CallBooleanMethod(boundingBoxList, listAdd, boundingBoxObj);
-
-        env->DeleteLocalRef(label);
-        env->DeleteLocalRef(boundingBoxObj);
+        write_box(out, box_count++, get_label_index(bb.label), bb);
     }
 #endif
 
-    // Create HashMap for anomaly values
-    jobject anomalyResultMap = env->NewObject(hashMapClass, hashMapInit);
-
 #if EI_CLASSIFIER_HAS_ANOMALY != 3
-    jobject anomalyString = env->NewStringUTF("anomaly");
-    jobject anomalyValue = env->NewObject(floatClass, floatConstructor, (jfloat)result.anomaly);
-
-    env->CallObjectMethod(anomalyResultMap, hashMapPut, anomalyString, anomalyValue);
-    env->DeleteLocalRef(anomalyString);
-    env->DeleteLocalRef(anomalyValue);
+    out[RESULT_IX_ANOMALY] = result.anomaly;
 #endif
-
-#if EI_CLASSIFIER_HAS_VISUAL_ANOMALY
-    // Create ArrayList for visual anomaly grid cells
-    jobject boundingBoxListAnomaly = env->NewObject(listClass, env->GetMethodID(listClass, "<init>", "()V"));
-    for (uint32_t i = 0; i < result.visual_ad_count; i++) {
-        ei_impulse_result_bounding_box_t bb = result.visual_ad_grid_cells[i];
-
-        float x_ratio = 1080 / (float)EI_CLASSIFIER_INPUT_WIDTH;
-        float y_ratio = 2400 / (float)EI_CLASSIFIER_INPUT_HEIGHT;
-        //__android_log_print(ANDROID_LOG_INFO, "MAIN", "x_ratio: %f, y_ratio: %f", x_ratio, y_ratio);
-
-        float x = (float)bb.x * x_ratio;
-        float y = (float)bb.y * y_ratio;
-        float width = (float)bb.width * x_ratio;
-        float height = (float)bb.height * y_ratio;
-
-        jstring label = env->NewStringUTF("anomaly");
-        jobject boundingBoxObj = env->NewObject(boundingBoxClass,
-                                                boundingBoxConstructor,
-                                                label,
-                                                (jfloat)bb.value,
-                                                (jint)x,
-                                                (jint)y,
-                                                (jint)width,
-                                                (jint)height);
-        env->CallBooleanMethod(boundingBoxListAnomaly, listAdd, boundingBoxObj);
-
-        env->DeleteLocalRef(label);
-        env->DeleteLocalRef(boundingBoxObj);
-    }
-
-    jobject maxString = env->NewStringUTF("max");
-    jobject maxValue = env->NewObject(floatClass, floatConstructor, (jfloat)result.visual_ad_result.max_value);
-
-    jobject meanString = env->NewStringUTF("mean");
-    jobject meanValue = env->NewObject(floatClass, floatConstructor, (jfloat)result.visual_ad_result.mean_value);
-
-    env->CallObjectMethod(anomalyResultMap, hashMapPut, maxString, maxValue);
-    env->CallObjectMethod(anomalyResultMap, hashMapPut, meanString, meanValue);
-    env->DeleteLocalRef(meanString);
-    env->DeleteLocalRef(maxString);
-    env->DeleteLocalRef(meanValue);
-    env->DeleteLocalRef(maxValue);
+#if EI_CLASSIFIER_HAS_ANOMALY
+    flags |= RESULT_FLAG_ANOMALY;
 #endif
 
-    // Construct Timing object
-    jobject timingObject = env->NewObject(timingClass, timingConstructor,
-                                          result.timing.sampling,
-                                          result.timing.dsp,
-                                          result.timing.classification,
-                                          result.timing.anomaly,
-                                          result.timing.dsp_us,
-                                          result.timing.classification_us,
-                                          result.timing.anomaly_us);
-
-    // Construct InferenceResult object
-    jobject inferenceResult = env->NewObject(resultClass,
-                                             resultConstructor,
-#if EI_CLASSIFIER_LABEL_COUNT > 0
-                                             classificationMap,
-#else
-            nullptr,
-#endif
-#if EI_CLASSIFIER_OBJECT_DETECTION == 1
-            boundingBoxList,
-#else
-                                             nullptr,
-#endif
 #if EI_CLASSIFIER_HAS_VISUAL_ANOMALY
-            boundingBoxListAnomaly,
-#else
-                                             nullptr,
-#endif
-#if EI_CLASSIFIER_HAS_ANOMALY
-            anomalyResultMap,
-#else
-                                             nullptr,
+    flags |= RESULT_FLAG_VISUAL_AD;
+    for (uint32_t i = 0; i < result.visual_ad_count && box_count + visual_ad_count < RESULT_MAX_BOXES; i++) {
+        write_box(out, box_count + visual_ad_count++, -1.0f, result.visual_ad_grid_cells[i]);
+    }
+    out[RESULT_IX_VISUAL_AD_MAX] = result.visual_ad_result.max_value;
+    out[RESULT_IX_VISUAL_AD_MEAN] = result.visual_ad_result.mean_value;
 #endif
-                                             timingObject);
 
-    return inferenceResult;
-}
\ No newline at end of file
+    out[RESULT_IX_FLAGS] = (float)flags;
+    out[RESULT_IX_BOX_COUNT] = (float)box_count;
+    out[RESULT_IX_VISUAL_AD_COUNT] = (float)visual_ad_count;
+    out[RESULT_IX_TIMING_DSP_US] = (float)result.timing.dsp_us;
+    out[RESULT_IX_TIMING_CLASSIFICATION_US] = (float)result.timing.classification_us;
+    out[RESULT_IX_TIMING_ANOMALY_US] = (float)result.timing.anomaly_us;
+}
@@ -0,0 +1,161 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "yuv_to_rgb.h"
+#include "edge-impulse-sdk/dsp/image/processing.hpp"
+#include "edge-impulse-sdk/dsp/returntypes.hpp"
+#include "edge-impulse-sdk/porting/ei_logging.h"
+
+#define YUV_CLAMP(t) (((t) > 255) ? 255 : (((t) < 0) ? 0 : (t)))
+
+int yuv420_to_rgb888_crop_and_interpolate(
+    const uint8_t *yPlane,
+    const uint8_t *uPlane,
+    const uint8_t *vPlane,
+    int srcWidth,
+    int srcHeight,
+    int yRowStride,
+    int uvRowStride,
+    int uvPixelStride,
+    int rotationDegrees,
+    uint8_t *dstImage,
+    int dstWidth,
+    int dstHeight)
+{
+    // Same fixed point scheme as ei::image::processing::resize_image
+    constexpr int FRAC_BITS = 14;
+    constexpr int FRAC_VAL = (1 << FRAC_BITS);
+    constexpr int FRAC_MASK = (FRAC_VAL - 1);
+
+    if (!yPlane || !uPlane || !vPlane || !dstImage) {
+        return ei::EIDSP_PARAMETER_INVALID;
+    }
+    if (srcWidth < 2 || srcHeight < 2 || dstWidth < 1 || dstHeight < 1) {
+        return ei::EIDSP_PARAMETER_INVALID;
+    }
+
+    // Map a coordinate in the rotated (upright) image back to the sensor image:
+    // sx = sx0 + rx * sxx + ry * sxy
+    // sy = sy0 + rx * syx + ry * syy
+    int rotWidth, rotHeight;
+    int sx0, sxx, sxy, sy0, syx, syy;
+    switch (rotationDegrees) {
+        case 0:
+            rotWidth = srcWidth; rotHeight = srcHeight;
+            sx0 = 0; sxx = 1; sxy = 0;
+            sy0 = 0; syx = 0; syy = 1;
+            break;
+        case 90:
+            rotWidth = srcHeight; rotHeight = srcWidth;
+            sx0 = 0; sxx = 0; sxy = 1;
+            sy0 = srcHeight - 1; syx = -1; syy = 0;
+            break;
+        case 180:
+            rotWidth = srcWidth; rotHeight = srcHeight;
+            sx0 = srcWidth - 1; sxx = -1; sxy = 0;
+            sy0 = srcHeight - 1; syx = 0; syy = -1;
+            break;
+        case 270:
+            rotWidth = srcHeight; rotHeight = srcWidth;
+            sx0 = srcWidth - 1; sxx = 0; sxy = -1;
+            sy0 = 0; syx = 1; syy = 0;
+            break;
+        default:
+            EI_LOGE("Unsupported rotation: %d\n", rotationDegrees);
+            return ei::EIDSP_PARAMETER_INVALID;
+    }
+
+    // Center crop (in rotated space) that matches the aspect ratio of the destination
+    int cropWidth, cropHeight;
+    ei::image::processing::calculate_crop_dims(rotWidth, rotHeight, dstWidth, dstHeight, cropWidth, cropHeight);
+    const int cropX = (rotWidth - cropWidth) / 2;
+    const int cropY = (rotHeight - cropHeight) / 2;
+    const int cropXEnd = cropX + cropWidth - 1;
+    const int cropYEnd = cropY + cropHeight - 1;
+
+    const uint32_t src_x_frac = (cropWidth * FRAC_VAL) / dstWidth;
+    const uint32_t src_y_frac = (cropHeight * FRAC_VAL) / dstHeight;
+
+    uint8_t *d = dstImage;
+    uint32_t src_y_accum = 0;
+
+    for (int y = 0; y < dstHeight; y++) {
+        const int ry0 = cropY + (int)(src_y_accum >> FRAC_BITS);
+        const int ry1 = ry0 < cropYEnd ? ry0 + 1 : ry0;
+        const uint32_t y_frac = src_y_accum & FRAC_MASK;
+        const uint32_t ny_frac = FRAC_VAL - y_frac;
+        src_y_accum += src_y_frac;
+
+        uint32_t src_x_accum = 0;
+        for (int x = 0; x < dstWidth; x++) {
+            const int rx0 = cropX + (int)(src_x_accum >> FRAC_BITS);
+            const int rx1 = rx0 < cropXEnd ? rx0 + 1 : rx0;
+            const uint32_t x_frac = src_x_accum & FRAC_MASK;
+            const uint32_t nx_frac = FRAC_VAL - x_frac;
+            src_x_accum += src_x_frac;
+
+            // the four neighbours, in sensor coordinates
+            const int sx00 = sx0 + rx0 * sxx + ry0 * sxy, sy00 = sy0 + rx0 * syx + ry0 * syy;
+            const int sx10 = sx0 + rx1 * sxx + ry0 * sxy, sy10 = sy0 + rx1 * syx + ry0 * syy;
+            const int sx01 = sx0 + rx0 * sxx + ry1 * sxy, sy01 = sy0 + rx0 * syx + ry1 * syy;
+            const int sx11 = sx0 + rx1 * sxx + ry1 * sxy, sy11 = sy0 + rx1 * syx + ry1 * syy;
+
+            uint32_t p00 = yPlane[sy00 * yRowStride + sx00];
+            uint32_t p10 = yPlane[sy10 * yRowStride + sx10];
+            uint32_t p01 = yPlane[sy01 * yRowStride + sx01];
+            uint32_t p11 = yPlane[sy11 * yRowStride + sx11];
+            p00 = ((p00 * nx_frac) + (p10 * x_frac) + FRAC_VAL / 2) >> FRAC_BITS; // top line
+            p01 = ((p01 * nx_frac) + (p11 * x_frac) + FRAC_VAL / 2) >> FRAC_BITS; // bottom line
+            p00 = ((p00 * ny_frac) + (p01 * y_frac) + FRAC_VAL / 2) >> FRAC_BITS; // top + bottom
+
+            // chroma is subsampled 2x2, take the sample covering the top-left neighbour
+            const int uv_ix = (sy00 >> 1) * uvRowStride + (sx00 >> 1) * uvPixelStride;
+            const int u = (int)uPlane[uv_ix] - 128;
+            const int v = (int)vPlane[uv_ix] - 128;
+
+            // full range BT.601, 8 fractional bits
+            const int c = (int)p00 << 8;
+            const int r = (c + 359 * v + 128) >> 8;
+            const int g = (c - 88 * u - 183 * v + 128) >> 8;
+            const int b = (c + 454 * u + 128) >> 8;
+
+            *d++ = (uint8_t)YUV_CLAMP(r);
+            *d++ = (uint8_t)YUV_CLAMP(g);
+            *d++ = (uint8_t)YUV_CLAMP(b);
+        } // for x
+    } // for y
+
+    return ei::EIDSP_OK;
+}
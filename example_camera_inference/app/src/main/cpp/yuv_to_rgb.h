@@ -0,0 +1,79 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef YUV_TO_RGB_H
+#define YUV_TO_RGB_H
+
+#include <stdint.h>
+
+/**
+ * @brief Convert a planar / semi-planar YUV 4:2:0 image (e.g. Android YUV_420_888)
+ * to RGB888, rotating, center cropping and resizing it in a single pass.
+ * The crop keeps the aspect ratio of the destination (same as
+ * ei::image::processing::crop_and_interpolate_rgb888), luma is bilinearly interpolated,
+ * chroma is sampled at 2x2 resolution. Uses full range BT.601 (JFIF) coefficients.
+ *
+ * Lives in the example rather than in edge-impulse-sdk, so a stock Studio export can be
+ * dropped into this folder.
+ *
+ * @param yPlane Luma plane
+ * @param uPlane Cb plane
+ * @param vPlane Cr plane
+ * @param srcWidth Input width in pixels (before rotation)
+ * @param srcHeight Input height in pixels (before rotation)
+ * @param yRowStride Row stride of the luma plane in bytes
+ * @param uvRowStride Row stride of the chroma planes in bytes
+ * @param uvPixelStride Pixel stride of the chroma planes in bytes (1 = planar, 2 = semi-planar)
+ * @param rotationDegrees Clockwise rotation to apply, one of 0, 90, 180, 270
+ * @param dstImage Output RGB888 buffer, at least dstWidth * dstHeight * 3 bytes
+ * @param dstWidth Desired new width in pixels
+ * @param dstHeight Desired new height in pixels
+ * @return EIDSP_OK, or EIDSP_PARAMETER_INVALID
+ */
+int yuv420_to_rgb888_crop_and_interpolate(
+    const uint8_t *yPlane,
+    const uint8_t *uPlane,
+    const uint8_t *vPlane,
+    int srcWidth,
+    int srcHeight,
+    int yRowStride,
+    int uvRowStride,
+    int uvPixelStride,
+    int rotationDegrees,
+    uint8_t *dstImage,
+    int dstWidth,
+    int dstHeight);
+
+#endif // YUV_TO_RGB_H
@@ -1,9 +1,6 @@
 package com.example.test_camera
 
 import android.annotation.SuppressLint
-import android.graphics.Bitmap
-import android.graphics.BitmapFactory
-import android.graphics.Matrix
 import android.os.Bundle
 import android.util.Log
 import android.Manifest
@@ -13,12 +10,13 @@ import androidx.camera.core.*
 import androidx.camera.lifecycle.ProcessCameraProvider
 import androidx.camera.view.PreviewView
 import androidx.core.content.ContextCompat
-import androidx.lifecycle.lifecycleScope
 import com.example.test_camera.databinding.ActivityMainBinding
-import kotlinx.coroutines.Dispatchers
-import kotlinx.coroutines.launch
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.FloatBuffer
 import java.util.concurrent.ExecutorService
 import java.util.concurrent.Executors
+import java.util.concurrent.atomic.AtomicBoolean
 import android.content.Context
 import android.content.pm.PackageManager
 import android.graphics.Canvas
@@ -29,32 +27,59 @@ import android.util.AttributeSet
 import android.view.View
 import androidx.core.app.ActivityCompat
 
-data class InferenceResult(
-    val classification: Map<String, Float>?,   // Classification labels and values
-    val objectDetections: List<BoundingBox>?,  // Object detection results
-    val visualAnomalyGridCells: List<BoundingBox>?, // Visual anomaly grid
-    val anomalyResult: Map<String, Float>?, // Anomaly values
-    val timing: Timing  // Timing information
-)
-
-data class BoundingBox(
-    val label: String,
-    val confidence: Float,
-    val x: Int,
-    val y: Int,
-    val width: Int,
-    val height: Int
-)
-
-data class Timing(
-    val sampling: Int,
-    val dsp: Int,
-    val classification: Int,
-    val anomaly: Int,
-    val dsp_us: Long,
-    val classification_us: Long,
-    val anomaly_us: Long
-)
+/**
+ * View over the direct buffer the native code writes each result into, allocated once and
+ * reused for every frame so nothing is boxed or allocated on the result path.
+ * The layout must match RESULT_* in native-lib.cpp.
+ */
+class InferenceResult(val labels: Array<String>, capacity: Int) {
+    val buffer: FloatBuffer = ByteBuffer.allocateDirect(capacity * 4)
+        .order(ByteOrder.nativeOrder())
+        .asFloatBuffer()
+
+    private val flags get() = buffer.get(IX_FLAGS).toInt()
+
+    val hasClassification get() = flags and FLAG_CLASSIFICATION != 0
+    val hasObjectDetection get() = flags and FLAG_OBJECT_DETECTION != 0
+    val hasVisualAnomaly get() = flags and FLAG_VISUAL_AD != 0
+    val hasAnomaly get() = flags and FLAG_ANOMALY != 0
+
+    val anomaly get() = buffer.get(IX_ANOMALY)
+    val visualAnomalyMax get() = buffer.get(IX_VISUAL_AD_MAX)
+    val visualAnomalyMean get() = buffer.get(IX_VISUAL_AD_MEAN)
+
+    val dspUs get() = buffer.get(IX_TIMING_DSP_US).toLong()
+    val classificationUs get() = buffer.get(IX_TIMING_CLASSIFICATION_US).toLong()
+    val anomalyUs get() = buffer.get(IX_TIMING_ANOMALY_US).toLong()
+
+    fun score(labelIndex: Int) = buffer.get(HEADER_SIZE + labelIndex)
+
+    // Object detection boxes, followed by the visual anomaly grid cells
+    val boxCount get() = buffer.get(IX_BOX_COUNT).toInt()
+    val visualAnomalyCount get() = buffer.get(IX_VISUAL_AD_COUNT).toInt()
+
+    /** Offset of box [index] in [buffer]: label index (-1 for anomaly cells), value, x, y, width, height */
+    fun boxOffset(index: Int) = HEADER_SIZE + labels.size + index * BOX_SIZE
+
+    companion object {
+        const val IX_FLAGS = 0
+        const val IX_BOX_COUNT = 1
+        const val IX_VISUAL_AD_COUNT = 2
+        const val IX_ANOMALY = 3
+        const val IX_VISUAL_AD_MAX = 4
+        const val IX_VISUAL_AD_MEAN = 5
+        const val IX_TIMING_DSP_US = 6
+        const val IX_TIMING_CLASSIFICATION_US = 7
+        const val IX_TIMING_ANOMALY_US = 8
+        const val HEADER_SIZE = 9
+        const val BOX_SIZE = 6
+
+        const val FLAG_CLASSIFICATION = 1
+        const val FLAG_OBJECT_DETECTION = 2
+        const val FLAG_VISUAL_AD = 4
+        const val FLAG_ANOMALY = 8
+    }
+}
 
 private const val CAMERA_PERMISSION_REQUEST_CODE = 1001
 
@@ -78,26 +103,48 @@ class BoundingBoxOverlay(context: Context, attrs: AttributeSet? = null) : View(c
         alpha = 60 // Adjust transparency
     }
 
-    var boundingBoxes: List<BoundingBox> = emptyList()
-        set(value) {
-            field = value
-            invalidate() // Redraw when new bounding boxes are set
+    private var labels: Array<String> = emptyArray()
+    private var boxes = FloatArray(0)
+    private var boxCount = 0
+
+    /**
+     * Copies the boxes (object detections + visual anomaly cells) out of [result], so the
+     * native side can write the next frame while this view is drawing
+     */
+    fun setBoxes(result: InferenceResult) {
+        labels = result.labels
+        boxCount = result.boxCount + result.visualAnomalyCount
+        val size = boxCount * InferenceResult.BOX_SIZE
+        if (boxes.size < size) {
+            boxes = FloatArray(size)
         }
+        result.buffer.position(result.boxOffset(0))
+        result.buffer.get(boxes, 0, size)
+        result.buffer.rewind()
+        invalidate() // Redraw when new bounding boxes are set
+    }
+
+    private val rect = Rect()
 
     @SuppressLint("DefaultLocale")
     override fun onDraw(canvas: Canvas) {
         super.onDraw(canvas)
         canvas.drawColor(Color.TRANSPARENT) // Ensure transparency
 
-        boundingBoxes.forEach { box ->
-            val rect = Rect(box.x, box.y, box.x + box.width, box.y + box.height)
+        for (i in 0 until boxCount) {
+            val o = i * InferenceResult.BOX_SIZE
+            val labelIndex = boxes[o].toInt()
+            val confidence = boxes[o + 1]
+            val x = boxes[o + 2].toInt()
+            val y = boxes[o + 3].toInt()
+            rect.set(x, y, x + boxes[o + 4].toInt(), y + boxes[o + 5].toInt())
 
-            if (box.label == "anomaly") {
-                // Fill the box with transparent red
+            if (labelIndex < 0) {
+                // Visual anomaly cell, fill the box with transparent red
                 canvas.drawRect(rect, anomalyPaint)
 
                 // Display anomaly score in the center
-                val scoreText = String.format("%.2f", box.confidence)
+                val scoreText = String.format("%.2f", confidence)
                 val textX = rect.centerX().toFloat()
                 val textY = rect.centerY().toFloat()
 
@@ -105,8 +152,9 @@ class BoundingBoxOverlay(context: Context, attrs: AttributeSet? = null) : View(c
                 canvas.drawText(scoreText, textX, textY, textPaint)
             } else {
                 // Standard object detection box
+                textPaint.textAlign = Paint.Align.LEFT
                 canvas.drawRect(rect, paint)
-                canvas.drawText("${box.label} (${(box.confidence * 100).toInt()}%)", box.x.toFloat(), (box.y - 10).toFloat(), textPaint)
+                canvas.drawText("${labels[labelIndex]} (${(confidence * 100).toInt()}%)", x.toFloat(), (y - 10).toFloat(), textPaint)
             }
         }
     }
@@ -121,12 +169,27 @@ class MainActivity : ComponentActivity() {
 
     private val cameraExecutor: ExecutorService = Executors.newSingleThreadExecutor()
 
+    // Native inference session (handle + preallocated buffers), reused for every frame
+    @Volatile
+    private var session: Long = 0L
+
+    // Two result buffers: native writes into backResult on the analyzer thread while the
+    // UI reads frontResult. They are swapped only once the UI is done with the front one.
+    private lateinit var frontResult: InferenceResult
+    private lateinit var backResult: InferenceResult
+    private val resultPending = AtomicBoolean(false)
+
     override fun onCreate(savedInstanceState: Bundle?) {
         super.onCreate(savedInstanceState)
 
         binding = ActivityMainBinding.inflate(layoutInflater)
         setContentView(binding.root)
 
+        session = createSession()
+        val labels = getLabels()
+        frontResult = InferenceResult(labels, getResultBufferSize())
+        backResult = InferenceResult(labels, getResultBufferSize())
+
         resultTextView = findViewById(R.id.resultTextView) // Result TextView
         previewView = findViewById(R.id.previewView) // Camera preview view
         boundingBoxOverlay = findViewById(R.id.boundingBoxOverlay) // overlay for bbxes / visual ad
@@ -147,6 +210,16 @@ class MainActivity : ComponentActivity() {
 
     }
 
+    override fun onDestroy() {
+        super.onDestroy()
+        // the analyzer runs on cameraExecutor, so free the session on that thread
+        // once any in-flight frame is done
+        val sessionToDestroy = session
+        session = 0L
+        cameraExecutor.execute { destroySession(sessionToDestroy) }
+        cameraExecutor.shutdown()
+    }
+
     private fun startCamera() {
         val cameraProviderFuture = ProcessCameraProvider.getInstance(this)
         cameraProviderFuture.addListener({
@@ -154,7 +227,10 @@ class MainActivity : ComponentActivity() {
             val cameraSelector = CameraSelector.DEFAULT_BACK_CAMERA
             val preview = Preview.Builder().build()
             preview.setSurfaceProvider(previewView.surfaceProvider)
-            val imageAnalysis = ImageAnalysis.Builder().build()
+            val imageAnalysis = ImageAnalysis.Builder()
+                .setBackpressureStrategy(ImageAnalysis.STRATEGY_KEEP_ONLY_LATEST)
+                .setOutputImageFormat(ImageAnalysis.OUTPUT_IMAGE_FORMAT_YUV_420_888)
+                .build()
 
             imageAnalysis.setAnalyzer(cameraExecutor) { imageProxy ->
                 processImage(imageProxy)
@@ -185,71 +261,71 @@ class MainActivity : ComponentActivity() {
 
     // Process the captured image
     private fun processImage(imageProxy: ImageProxy) {
-        // Convert ImageProxy to Bitmap
-        val bitmap = imageProxy.toBitmap()
-
-        // Resize the Bitmap to Edge Impulse model size
-        // val resizedBitmap = Bitmap.createScaledBitmap(bitmap, 64, 64, true)
-        // resizing is done in C++ code
-
-        // Convert the resized bitmap to ByteArray
-        val byteArray = getByteArrayFromBitmap(bitmap)
-
-        // Close the imageProxy after processing
-        imageProxy.close()
-
-        // Pass to C++ for Edge Impulse inference
-        lifecycleScope.launch(Dispatchers.IO) {
-            val result = passToCpp(byteArray)
-            runOnUiThread {
-                displayResults(result)
-            }
+        // The YUV_420_888 planes are handed to C++ as direct buffers; conversion, rotation,
+        // crop and resize happen natively in one pass. The planes are only valid until
+        // the ImageProxy is closed, so inference runs here on the analyzer thread.
+        if (session == 0L) {
+            imageProxy.close()
+            return
+        }
+        val planes = imageProxy.planes
+        val ok = try {
+            passYuvToCpp(
+                session,
+                planes[0].buffer,
+                planes[1].buffer,
+                planes[2].buffer,
+                imageProxy.width,
+                imageProxy.height,
+                planes[0].rowStride,
+                planes[1].rowStride,
+                planes[1].pixelStride,
+                imageProxy.imageInfo.rotationDegrees,
+                backResult.buffer
+            )
+        } finally {
+            imageProxy.close()
         }
-    }
-
-    // Convert ImageProxy to Bitmap
-    private fun ImageProxy.toBitmap(): Bitmap {
-        val planes = this.planes
-        val buffer = planes[0].buffer
-        val bytes = ByteArray(buffer.remaining())
-        buffer.get(bytes)
-        return BitmapFactory.decodeByteArray(bytes, 0, bytes.size)
-    }
-
-    // Convert Bitmap to ByteArray (RGB888 format)
-    private fun getByteArrayFromBitmap(bitmap: Bitmap): ByteArray {
-
-        // Rotate the bitmap by 90 degrees
-        val matrix = Matrix()
-        matrix.postRotate(90f)
-
-        val rotatedBitmap = Bitmap.createBitmap(bitmap, 0, 0, bitmap.width, bitmap.height, matrix, true)
-
-        val width = rotatedBitmap.width
-        val height = rotatedBitmap.height
-
-        val pixels = IntArray(width * height) // Holds ARGB pixels
-        val rgbByteArray = ByteArray(width * height * 3) // Holds RGB888 data
-
-        rotatedBitmap.getPixels(pixels, 0, width, 0, 0, width, height)
-
-        // Convert ARGB to RGB888
-        for (i in pixels.indices) {
-            val pixel = pixels[i]
-            val r = (pixel shr 16) and 0xFF
-            val g = (pixel shr 8) and 0xFF
-            val b = pixel and 0xFF
 
-            rgbByteArray[i * 3] = r.toByte()
-            rgbByteArray[i * 3 + 1] = g.toByte()
-            rgbByteArray[i * 3 + 2] = b.toByte()
+        // if the UI hasn't drawn the previous result yet, drop this one
+        if (!resultPending.compareAndSet(false, true)) {
+            return
         }
+        val result = backResult
+        backResult = frontResult
+        frontResult = result
 
-        return rgbByteArray
+        runOnUiThread {
+            displayResults(if (ok) result else null)
+            resultPending.set(false)
+        }
     }
 
-    // Call the C++ function to process the image and return results
-    private external fun passToCpp(imageData: ByteArray): InferenceResult?
+    // Create / free the native inference session
+    private external fun createSession(): Long
+    private external fun destroySession(session: Long)
+
+    // Labels and the size (in floats) of the result buffer, see InferenceResult
+    private external fun getLabels(): Array<String>
+    private external fun getResultBufferSize(): Int
+
+    // Call the C++ function to process the image, results are written to resultBuffer
+    private external fun passToCpp(session: Long, imageData: ByteArray, resultBuffer: FloatBuffer): Boolean
+
+    // Zero-copy variant, takes the YUV_420_888 planes of an ImageProxy
+    private external fun passYuvToCpp(
+        session: Long,
+        yBuffer: ByteBuffer,
+        uBuffer: ByteBuffer,
+        vBuffer: ByteBuffer,
+        width: Int,
+        height: Int,
+        yRowStride: Int,
+        uvRowStride: Int,
+        uvPixelStride: Int,
+        rotationDegrees: Int,
+        resultBuffer: FloatBuffer
+    ): Boolean
 
     // Display results in UI
     @SuppressLint("SetTextI18n")
@@ -262,40 +338,28 @@ class MainActivity : ComponentActivity() {
         } else
         {
             val combinedText = StringBuilder()
-            if (result.classification != null) {
+            if (result.hasClassification) {
                 // Display classification results
-                val classificationText = result.classification.entries.joinToString("\n") {
-                    "${it.key}: ${it.value}"
+                combinedText.append("Classification:\n")
+                result.labels.forEachIndexed { ix, label ->
+                    combinedText.append(label).append(": ").append(result.score(ix)).append('\n')
                 }
-                combinedText.append("Classification:\n$classificationText\n\n")
+                combinedText.append('\n')
             }
-            if (result.objectDetections != null) {
-                // Display object detection results
-//                val objectDetectionText = result.objectDetections.joinToString("\n") {
-//                    "${it.label}: ${it.confidence}, ${it.x}, ${it.y}, ${it.width}, ${it.height}"
-//                }
+            if (result.hasObjectDetection) {
                 // Update bounding boxes on the overlay
                 boundingBoxOverlay.visibility = View.VISIBLE
-                boundingBoxOverlay.boundingBoxes = result.objectDetections
-                //combinedText.append("Object detection:\n$objectDetectionText\n\n")
+                boundingBoxOverlay.setBoxes(result)
             }
-            if (result.visualAnomalyGridCells != null) {
+            if (result.hasVisualAnomaly) {
                 // Display visual anomaly grid cells
-//                val visualAnomalyGridText = result.visualAnomalyGridCells.joinToString("\n") {
-//                    "${it.label}: ${it.confidence}, ${it.x}, ${it.y}, ${it.width}, ${it.height}"
-//                }
-                val visualAnomalyMax = result.anomalyResult?.getValue("max")
-                val visualAnomalyMean = result.anomalyResult?.getValue("mean")
                 boundingBoxOverlay.visibility = View.VISIBLE
-                boundingBoxOverlay.boundingBoxes = result.visualAnomalyGridCells
+                boundingBoxOverlay.setBoxes(result)
                 resultTextView.visibility = View.VISIBLE
-                combinedText.append("Visual anomaly values:\nMean: ${visualAnomalyMean}\nMax: ${visualAnomalyMax}")
-                //combinedText.append("Visual anomalies:\n$visualAnomalyGridText\n\nVisual anomaly values:\nMean: ${visualAnomalyMean}\nMax: ${visualAnomalyMax}\n\n")
-            }
-            if (result.anomalyResult?.get("anomaly") != null) {
+                combinedText.append("Visual anomaly values:\nMean: ${result.visualAnomalyMean}\nMax: ${result.visualAnomalyMax}")
+            } else if (result.hasAnomaly) {
                 // Display anomaly detection score
-                val anomalyScore = result.anomalyResult.get("anomaly")
-                combinedText.append("Anomaly score:\n${anomalyScore}")
+                combinedText.append("Anomaly score:\n${result.anomaly}")
             }
             // print the result
             val textToDisplay = combinedText.toString()
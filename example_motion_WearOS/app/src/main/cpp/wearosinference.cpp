@@ -37,53 +37,184 @@
 #include <vector>
 #include "edge-impulse-sdk/classifier/ei_run_classifier.h"
 
+// A stock Studio export only runs MFCC, MFE and spectrogram blocks continuously. The SDK in
+// android-data-collector also slides raw, flatten and spectral analysis blocks; with any other
+// SDK the app classifies full windows with runInference instead.
+#if defined(EI_CLASSIFIER_CONTINUOUS_WINDOW_BLOCKS) && (EI_CLASSIFIER_CONTINUOUS_WINDOW_BLOCKS == 1)
+#define WEAROS_CONTINUOUS_INFERENCE 1
+#else
+#define WEAROS_CONTINUOUS_INFERENCE 0
+#endif
+
 extern "C"
 JNIEXPORT jint JNICALL
 Java_com_edgeimpulse_edgeimpulsewearos_presentation_MainActivity_getFeatureCount(JNIEnv* env, jobject /* this */) {
     return EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE;
 }
 
+/**
+ * Number of floats to pass to runInferenceContinuous: one slice
+ * (EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW slices make up a window) of all axes.
+ */
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_edgeimpulse_edgeimpulsewearos_presentation_MainActivity_getSliceSize(JNIEnv* env, jobject /* this */) {
+    return EI_CLASSIFIER_SLICE_SIZE * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME;
+}
+
+/**
+ * Inference session, created once from Kotlin (createSession) and passed back as a jlong.
+ * Owns the impulse handle (and with that the preallocated features / outputs), the result
+ * struct and the raw feature buffer, so inference at the sensor rate doesn't allocate.
+ */
+struct ei_session_t {
+    ei_impulse_handle_t handle;
+    ei_impulse_result_t result;
+    std::vector<float> raw_features;
+    std::vector<float> slice_features;
+    // false once run_classifier_continuous failed, e.g. on a block the SDK can't slide
+    bool continuous;
+    // slices pushed so far, up to EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW
+    size_t slices_written;
+
+    ei_session_t()
+        : handle(ei_default_impulse.impulse)
+        , raw_features(EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE)
+        , slice_features(EI_CLASSIFIER_SLICE_SIZE * EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME)
+        , continuous(WEAROS_CONTINUOUS_INFERENCE == 1)
+        , slices_written(0) {
+        run_classifier_init(&handle);
+    }
+
+    ~ei_session_t() {
+        run_classifier_deinit(&handle);
+    }
+};
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_edgeimpulse_edgeimpulsewearos_presentation_MainActivity_createSession(JNIEnv* env, jobject /* this */) {
+    return reinterpret_cast<jlong>(new ei_session_t());
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_edgeimpulse_edgeimpulsewearos_presentation_MainActivity_destroySession(JNIEnv* env, jobject /* this */, jlong session) {
+    delete reinterpret_cast<ei_session_t*>(session);
+}
+
+/**
+ * Whether to push slices to runInferenceContinuous. If not, collect full windows
+ * (getFeatureCount floats) for runInference.
+ */
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_edgeimpulse_edgeimpulsewearos_presentation_MainActivity_isContinuous(JNIEnv* env, jobject /* this */, jlong session_ptr) {
+    auto *session = reinterpret_cast<ei_session_t*>(session_ptr);
+    return session && session->continuous ? JNI_TRUE : JNI_FALSE;
+}
+
+static jstring classification_to_jstring(JNIEnv* env, const ei_impulse_result_t &result) {
+    std::string output = "Classification Results:\n";
+    for (uint32_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        output += result.classification[ix].label;
+        output += ": ";
+        output += std::to_string(result.classification[ix].value);
+        output += "\n";
+    }
+    return env->NewStringUTF(output.c_str());
+}
+
 extern "C"
 JNIEXPORT jstring JNICALL
 Java_com_edgeimpulse_edgeimpulsewearos_presentation_MainActivity_runInference(
         JNIEnv* env,
         jobject /* this */,
+        jlong session_ptr,
         jfloatArray data // Accelerometer or sensor data
 ) {
-    // 1) Convert jfloatArray -> std::vector<float>
-    jsize length = env->GetArrayLength(data);
-    jfloat* inputPtr = env->GetFloatArrayElements(data, nullptr);
-    std::vector<float> rawFeatures(inputPtr, inputPtr + length);
-    env->ReleaseFloatArrayElements(data, inputPtr, 0);
+    auto *session = reinterpret_cast<ei_session_t*>(session_ptr);
+    if (!session) {
+        return env->NewStringUTF("No inference session");
+    }
 
-    // 2) Check buffer length matches your EI model's input size
-    if (rawFeatures.size() != EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
+    // 1) Check buffer length matches your EI model's input size
+    jsize length = env->GetArrayLength(data);
+    if (length != EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
         std::string errorMsg = "Expected " + std::to_string(EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE)
-                               + " floats, but got " + std::to_string(rawFeatures.size());
+                               + " floats, but got " + std::to_string(length);
         return env->NewStringUTF(errorMsg.c_str());
     }
 
+    // 2) Copy jfloatArray -> the session's feature buffer
+    env->GetFloatArrayRegion(data, 0, length, session->raw_features.data());
+
     // 3) Prepare the input signal
-    ei_impulse_result_t result;
+    ei_impulse_result_t &result = session->result;
     signal_t signal;
-    numpy::signal_from_buffer(rawFeatures.data(), rawFeatures.size(), &signal);
+    numpy::signal_from_buffer(session->raw_features.data(), session->raw_features.size(), &signal);
 
     // 4) Run the classifier
-    EI_IMPULSE_ERROR res = run_classifier(&signal, &result, false);
+    EI_IMPULSE_ERROR res = run_classifier(&session->handle, &signal, &result, false);
     if (res != EI_IMPULSE_OK) {
         std::string errorMsg = "run_classifier returned error code " + std::to_string(res);
         return env->NewStringUTF(errorMsg.c_str());
     }
 
-    // 5) Build a string with classification results
-    std::string output = "Classification Results:\n";
-    for (uint32_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
-        output += result.classification[ix].label;
-        output += ": ";
-        output += std::to_string(result.classification[ix].value);
-        output += "\n";
+    // 5) Return a string with classification results
+    return classification_to_jstring(env, result);
+}
+
+/**
+ * Continuous inference: push one slice (getSliceSize floats) of new sensor data. The SDK keeps
+ * the window and only processes the new slice, so the model runs every slice instead of every
+ * window without repeating the DSP over the whole window.
+ * Returns nullptr until the first window is full. Only while isContinuous is true.
+ */
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_com_edgeimpulse_edgeimpulsewearos_presentation_MainActivity_runInferenceContinuous(
+        JNIEnv* env,
+        jobject /* this */,
+        jlong session_ptr,
+        jfloatArray data
+) {
+    auto *session = reinterpret_cast<ei_session_t*>(session_ptr);
+    if (!session) {
+        return env->NewStringUTF("No inference session");
     }
 
-    // Return as jstring
-    return env->NewStringUTF(output.c_str());
+    if (!session->continuous) {
+        return env->NewStringUTF("Continuous inference is not supported for this impulse, use runInference");
+    }
+
+    jsize length = env->GetArrayLength(data);
+    if ((size_t)length != session->slice_features.size()) {
+        std::string errorMsg = "Expected " + std::to_string(session->slice_features.size())
+                               + " floats, but got " + std::to_string(length);
+        return env->NewStringUTF(errorMsg.c_str());
+    }
+    env->GetFloatArrayRegion(data, 0, length, session->slice_features.data());
+
+    ei_impulse_result_t &result = session->result;
+    signal_t signal;
+    numpy::signal_from_buffer(session->slice_features.data(), session->slice_features.size(), &signal);
+
+    EI_IMPULSE_ERROR res = run_classifier_continuous(&session->handle, &signal, &result, false);
+    if (res != EI_IMPULSE_OK) {
+        // e.g. a DSP block this SDK can't run continuously, isContinuous now returns false
+        session->continuous = false;
+        std::string errorMsg = "run_classifier_continuous returned error code " + std::to_string(res);
+        return env->NewStringUTF(errorMsg.c_str());
+    }
+
+    // the first slices only fill up the window
+    if (session->slices_written < EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW) {
+        session->slices_written++;
+        if (session->slices_written < EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW) {
+            return nullptr;
+        }
+    }
+
+    return classification_to_jstring(env, result);
 }
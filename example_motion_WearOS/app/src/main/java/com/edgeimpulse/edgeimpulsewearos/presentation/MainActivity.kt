@@ -18,11 +18,6 @@ import androidx.core.splashscreen.SplashScreen.Companion.installSplashScreen
 import androidx.wear.compose.material.*
 import com.edgeimpulse.edgeimpulsewearos.presentation.theme.EdgeImpulseWearOSTheme
 
-/**
- * If your model needs e.g. 120 float values (40 sets of x,y,z), set this to 120.
- */
-private const val EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE = 375
-
 class MainActivity : ComponentActivity(), SensorEventListener {
 
     companion object {
@@ -32,8 +27,26 @@ class MainActivity : ComponentActivity(), SensorEventListener {
         }
     }
 
+    // JNI functions to create / free the native inference session (handle + preallocated buffers)
+    external fun createSession(): Long
+    external fun destroySession(session: Long)
+
     // JNI function that runs inference using the Edge Impulse SDK, returning a String
-    external fun runInference(data: FloatArray): String?
+    external fun runInference(session: Long, data: FloatArray): String?
+
+    // Continuous inference: pushes one slice of new samples, returns null until the first window is full
+    external fun runInferenceContinuous(session: Long, data: FloatArray): String?
+
+    // Floats (samples x axes) per slice, a window is EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW slices
+    external fun getSliceSize(): Int
+
+    // Floats (samples x axes) per window, what runInference takes
+    external fun getFeatureCount(): Int
+
+    // False if the SDK can't run this impulse continuously, then classify full windows with runInference
+    external fun isContinuous(session: Long): Boolean
+
+    private var session: Long = 0L
 
     private lateinit var sensorManager: SensorManager
     private var accelerometer: Sensor? = null
@@ -44,9 +57,11 @@ class MainActivity : ComponentActivity(), SensorEventListener {
     // Uncomment to add Heart Rate sensor support
     //private var heartRateSensor: Sensor? = null
 
-    // Collect sensor data in this ring buffer
-    private val ringBuffer = FloatArray(EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE)
-    private var ringBufferIndex = 0
+    // Collect sensor data in this buffer: one slice in continuous mode (the SDK keeps the rest of
+    // the window), otherwise a full window
+    private var continuous = false
+    private var sampleBuffer = FloatArray(0)
+    private var sampleBufferIndex = 0
 
     // State to store the most recent inference result
     private val _inferenceResult = mutableStateOf("Collecting data...")
@@ -56,6 +71,11 @@ class MainActivity : ComponentActivity(), SensorEventListener {
         installSplashScreen()
         super.onCreate(savedInstanceState)
 
+        // Create the inference session once, it's reused for every window
+        session = createSession()
+        continuous = isContinuous(session)
+        sampleBuffer = FloatArray(if (continuous) getSliceSize() else getFeatureCount())
+
         // Initialize the sensor manager and accelerometer
         sensorManager = getSystemService(SENSOR_SERVICE) as SensorManager
         accelerometer = sensorManager.getDefaultSensor(Sensor.TYPE_ACCELEROMETER)
@@ -125,38 +145,59 @@ class MainActivity : ComponentActivity(), SensorEventListener {
         sensorManager.unregisterListener(this)
     }
 
+    override fun onDestroy() {
+        super.onDestroy()
+        destroySession(session)
+        session = 0L
+    }
+
     override fun onSensorChanged(event: SensorEvent) {
         when (event.sensor.type) {
             Sensor.TYPE_ACCELEROMETER -> {
-                ringBuffer[ringBufferIndex++] = event.values[0] // X
-                ringBuffer[ringBufferIndex++] = event.values[1] // Y
-                ringBuffer[ringBufferIndex++] = event.values[2] // Z
+                sampleBuffer[sampleBufferIndex++] = event.values[0] // X
+                sampleBuffer[sampleBufferIndex++] = event.values[1] // Y
+                sampleBuffer[sampleBufferIndex++] = event.values[2] // Z
             }
 
             // Uncomment to add Gyroscope readings
             /*
             Sensor.TYPE_GYROSCOPE -> {
-                ringBuffer[ringBufferIndex++] = event.values[0] // X rotation
-                ringBuffer[ringBufferIndex++] = event.values[1] // Y rotation
-                ringBuffer[ringBufferIndex++] = event.values[2] // Z rotation
+                sampleBuffer[sampleBufferIndex++] = event.values[0] // X rotation
+                sampleBuffer[sampleBufferIndex++] = event.values[1] // Y rotation
+                sampleBuffer[sampleBufferIndex++] = event.values[2] // Z rotation
             }
             */
 
             // Uncomment to add Heart Rate readings
             /*
             Sensor.TYPE_HEART_RATE -> {
-                ringBuffer[ringBufferIndex++] = event.values[0] // Heart rate BPM
+                sampleBuffer[sampleBufferIndex++] = event.values[0] // Heart rate BPM
             }
             */
         }
 
-        // If buffer is full, run inference
-        if (ringBufferIndex >= EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
-            ringBufferIndex = 0
-            val result = runInference(ringBuffer)
+        if (sampleBufferIndex < sampleBuffer.size) {
+            return
+        }
+        sampleBufferIndex = 0
+
+        if (continuous) {
+            // A new slice, run inference over the last window
+            val result = runInferenceContinuous(session, sampleBuffer)
+            if (!isContinuous(session)) {
+                // The SDK can't run this impulse continuously, collect full windows from now on
+                Log.w("EdgeImpulse", "Continuous inference unavailable: $result")
+                continuous = false
+                sampleBuffer = FloatArray(getFeatureCount())
+                return
+            }
+            _inferenceResult.value = result ?: return
+        } else {
+            // A full window
+            val result = runInference(session, sampleBuffer)
             _inferenceResult.value = result ?: "Inference returned null"
-            Log.d("EdgeImpulse", "Inference result: ${_inferenceResult.value}")
         }
+        Log.d("EdgeImpulse", "Inference result: ${_inferenceResult.value}")
     }
 
     override fun onAccuracyChanged(sensor: Sensor?, accuracy: Int) {
@@ -35,6 +35,7 @@
 #include <jni.h>
 #include <android/log.h>
 #include <string>
+#include <string.h>
 #include <stdio.h>
 #include "vector"
 #include "edge-impulse-sdk/classifier/ei_run_classifier.h"
@@ -43,180 +44,280 @@ std::vector<float> raw_features = {
     // Copy raw features here (e.g. from the 'Model testing' page)
 };
 
-extern "C" JNIEXPORT jobject JNICALL
-Java_com_example_test_1cpp_MainActivity_runInference(
-        JNIEnv* env,
-        jobject) {
-
-    if (raw_features.size() != EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
-        ei_printf("The size of your 'features' array is not correct. Expected %d items, but had %d\n", EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, raw_features.size());
-        return nullptr;
-    }
+/**
+ * Results are returned through a direct FloatBuffer that Kotlin allocates once
+ * (InferenceResult in MainActivity.kt) and hands to runInference, so nothing is boxed or
+ * allocated on the result path. Layout (in floats), must match InferenceResult:
+ *
+ *   [0, RESULT_HEADER_SIZE)   header, see RESULT_IX_*
+ *   [RESULT_HEADER_SIZE, +EI_CLASSIFIER_LABEL_COUNT)   classification scores
+ *   then up to RESULT_MAX_BOXES boxes of RESULT_BOX_SIZE floats each:
+ *   label index (-1 for visual anomaly cells), value, x, y, width, height.
+ *   Object detection boxes come first, followed by the visual anomaly grid cells.
+ */
+#ifndef RESULT_MAX_BOXES
+#define RESULT_MAX_BOXES 100
+#endif
 
+#define RESULT_IX_FLAGS             0
+#define RESULT_IX_BOX_COUNT         1
+#define RESULT_IX_VISUAL_AD_COUNT   2
+#define RESULT_IX_ANOMALY           3
+#define RESULT_IX_VISUAL_AD_MAX     4
+#define RESULT_IX_VISUAL_AD_MEAN    5
+#define RESULT_IX_TIMING_DSP_US     6
+#define RESULT_IX_TIMING_CLASSIFICATION_US 7
+#define RESULT_IX_TIMING_ANOMALY_US 8
+#define RESULT_HEADER_SIZE          9
+#define RESULT_BOX_SIZE             6
+#define RESULT_BUFFER_SIZE          (RESULT_HEADER_SIZE + EI_CLASSIFIER_LABEL_COUNT + RESULT_MAX_BOXES * RESULT_BOX_SIZE)
+
+#define RESULT_FLAG_CLASSIFICATION  1
+#define RESULT_FLAG_OBJECT_DETECTION 2
+#define RESULT_FLAG_VISUAL_AD       4
+#define RESULT_FLAG_ANOMALY         8
+
+// Label strings, resolved once in JNI_OnLoad
+static jobjectArray labels_ref = nullptr;
+
+/**
+ * Inference session, created once from Kotlin (createSession) and passed back as a jlong.
+ * Owns the impulse handle (and with that the preallocated features / outputs) and the
+ * result struct, so repeated calls to runInference don't allocate.
+ */
+struct ei_session_t {
+    ei_impulse_handle_t handle;
     ei_impulse_result_t result;
 
-    signal_t signal;
-    numpy::signal_from_buffer(&raw_features[0], raw_features.size(), &signal);
+    ei_session_t() : handle(ei_default_impulse.impulse) {
+        run_classifier_init(&handle);
+    }
 
-    EI_IMPULSE_ERROR res = run_classifier(&signal, &result, false);
+    ~ei_session_t() {
+        run_classifier_deinit(&handle);
+    }
+};
 
-    if (res != EI_IMPULSE_OK) {
-        ei_printf("Inference error code %d\n", (int)res);
-    return nullptr;
+static void write_box(float *out, uint32_t ix, float label_ix, const ei_impulse_result_bounding_box_t &bb)
+{
+    float *box = out + RESULT_HEADER_SIZE + EI_CLASSIFIER_LABEL_COUNT + ix * RESULT_BOX_SIZE;
+    box[0] = label_ix;
+    box[1] = bb.value;
+    box[2] = (float)bb.x;
+    box[3] = (float)bb.y;
+    box[4] = (float)bb.width;
+    box[5] = (float)bb.height;
+}
+
+__attribute__((unused)) static float get_label_index(const char *label)
+{
+    for (size_t i = 0; i < EI_CLASSIFIER_LABEL_COUNT; i++) {
+        // postprocessing points at the category strings, so this is usually a pointer match
+        if (label == ei_classifier_inferencing_categories[i] ||
+            strcmp(label, ei_classifier_inferencing_categories[i]) == 0) {
+            return (float)i;
+        }
     }
+    return -1.0f;
+}
 
-    // Find Java classes
-    jclass resultClass = env->FindClass("com/example/test_cpp/InferenceResult");
-    jclass timingClass = env->FindClass("com/example/test_cpp/Timing");
-    jclass hashMapClass = env->FindClass("java/util/HashMap");
-    jclass listClass = env->FindClass("java/util/ArrayList");
-    jclass boundingBoxClass = env->FindClass("com/example/test_cpp/BoundingBox");
+static void write_inference_result(const ei_impulse_result_t &result, float *out)
+{
+    uint32_t flags = 0;
+    uint32_t box_count = 0;
+    uint32_t visual_ad_count = 0;
 
-    if (!resultClass || !timingClass || !hashMapClass || !listClass || !boundingBoxClass) {
-        return nullptr; // Error finding classes
-    }
+    out[RESULT_IX_ANOMALY] = 0.0f;
+    out[RESULT_IX_VISUAL_AD_MAX] = 0.0f;
+    out[RESULT_IX_VISUAL_AD_MEAN] = 0.0f;
 
-    // Get method IDs
-    jmethodID resultConstructor = env->GetMethodID(resultClass, "<init>",
-                                                   "(Ljava/util/Map;Ljava/util/List;Ljava/util/List;Ljava/util/Map;Lcom/example/test_cpp/Timing;)V");
+#if EI_CLASSIFIER_LABEL_COUNT > 0
+    flags |= RESULT_FLAG_CLASSIFICATION;
+    for (size_t i = 0; i < EI_CLASSIFIER_LABEL_COUNT; i++) {
+        out[RESULT_HEADER_SIZE + i] = result.classification[i].value;
+    }
+#endif
 
-    jmethodID boundingBoxConstructor = env->GetMethodID(boundingBoxClass, "<init>",
-                                                 "(Ljava/lang/String;FIIII)V");
+#if EI_CLASSIFIER_OBJECT_DETECTION == 1
+    flags |= RESULT_FLAG_OBJECT_DETECTION;
+    for (uint32_t i = 0; i < result.bounding_boxes_count && box_count < RESULT_MAX_BOXES; i++) {
+        const ei_impulse_result_bounding_box_t &bb = result.bounding_boxes[i];
+        if (bb.value == 0) continue;
+        write_box(out, box_count++, get_label_index(bb.label), bb);
+    }
+#endif
 
-    jmethodID timingConstructor = env->GetMethodID(timingClass, "<init>",
-                                                   "(IIIIJJJ)V");
+#if EI_CLASSIFIER_HAS_ANOMALY != 3
+    out[RESULT_IX_ANOMALY] = result.anomaly;
+#endif
+#if EI_CLASSIFIER_HAS_ANOMALY
+    flags |= RESULT_FLAG_ANOMALY;
+#endif
 
-    jmethodID hashMapInit = env->GetMethodID(hashMapClass, "<init>", "()V");
-    jmethodID hashMapPut = env->GetMethodID(hashMapClass, "put",
-                                            "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;");
-    jmethodID listAdd = env->GetMethodID(listClass, "add", "(Ljava/lang/Object;)Z");
+#if EI_CLASSIFIER_HAS_VISUAL_ANOMALY
+    flags |= RESULT_FLAG_VISUAL_AD;
+    for (uint32_t i = 0; i < result.visual_ad_count && box_count + visual_ad_count < RESULT_MAX_BOXES; i++) {
+        write_box(out, box_count + visual_ad_count++, -1.0f, result.visual_ad_grid_cells[i]);
+    }
+    out[RESULT_IX_VISUAL_AD_MAX] = result.visual_ad_result.max_value;
+    out[RESULT_IX_VISUAL_AD_MEAN] = result.visual_ad_result.mean_value;
+#endif
 
-    jclass floatClass = env->FindClass("java/lang/Float");
-    if (!floatClass) return nullptr;
+    out[RESULT_IX_FLAGS] = (float)flags;
+    out[RESULT_IX_BOX_COUNT] = (float)box_count;
+    out[RESULT_IX_VISUAL_AD_COUNT] = (float)visual_ad_count;
+    out[RESULT_IX_TIMING_DSP_US] = (float)result.timing.dsp_us;
+    out[RESULT_IX_TIMING_CLASSIFICATION_US] = (float)result.timing.classification_us;
+    out[RESULT_IX_TIMING_ANOMALY_US] = (float)result.timing.anomaly_us;
+}
+
+/**
+ * Returns the address of the caller's result buffer, or nullptr if it's not a direct
+ * buffer of at least RESULT_BUFFER_SIZE floats.
+ */
+static float *get_result_buffer(JNIEnv* env, jobject result_buffer)
+{
+    auto *out = static_cast<float*>(env->GetDirectBufferAddress(result_buffer));
+    if (!out || env->GetDirectBufferCapacity(result_buffer) < RESULT_BUFFER_SIZE) {
+        __android_log_print(ANDROID_LOG_ERROR, "MAIN", "Result buffer must be a direct FloatBuffer of at least %d floats\n",
+                            RESULT_BUFFER_SIZE);
+        return nullptr;
+    }
+    return out;
+}
+
+extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void*)
+{
+    JNIEnv* env;
+    if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
 
-    // Get Float constructor method ID
-    jmethodID floatConstructor = env->GetMethodID(floatClass, "<init>", "(F)V");
-    if (!floatConstructor) return nullptr; // Error finding constructor
+    jclass stringClass = env->FindClass("java/lang/String");
+    if (!stringClass) {
+        return JNI_ERR;
+    }
 
-#if EI_CLASSIFIER_LABEL_COUNT > 0
-    // Construct classification map
-    jobject classificationMap = env->NewObject(hashMapClass, hashMapInit);
+    jobjectArray labels = env->NewObjectArray(EI_CLASSIFIER_LABEL_COUNT, stringClass, nullptr);
     for (size_t i = 0; i < EI_CLASSIFIER_LABEL_COUNT; i++) {
-        jstring key = env->NewStringUTF(result.classification[i].label);
-        jobject value = env->NewObject(floatClass, floatConstructor, result.classification[i].value);
+        jstring label = env->NewStringUTF(ei_classifier_inferencing_categories[i]);
+        env->SetObjectArrayElement(labels, i, label);
+        env->DeleteLocalRef(label);
+    }
+    labels_ref = static_cast<jobjectArray>(env->NewGlobalRef(labels));
+    env->DeleteLocalRef(labels);
+    env->DeleteLocalRef(stringClass);
 
-        env->CallObjectMethod(classificationMap, hashMapPut, key, value);
+    return JNI_VERSION_1_6;
+}
 
-        // Cleanup local references
-        env->DeleteLocalRef(key);
-        env->DeleteLocalRef(value);
-    }
-#endif
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_example_test_1cpp_MainActivity_getLabels(
+        JNIEnv*,
+        jobject) {
+    return labels_ref;
+}
 
-#if EI_CLASSIFIER_OBJECT_DETECTION == 1
-    // Create ArrayList for object detections
-    jobject boundingBoxList = env->NewObject(listClass, env->GetMethodID(listClass, "<init>", "()V"));
-    for (uint32_t i = 0; i < result.bounding_boxes_count; i++) {
-        ei_impulse_result_bounding_box_t bb = result.bounding_boxes[i];
-        if (bb.value == 0) continue;
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_test_1cpp_MainActivity_getResultBufferSize(
+        JNIEnv*,
+        jobject) {
+    return RESULT_BUFFER_SIZE;
+}
 
-        jstring label = env->NewStringUTF(bb.label);
-        jobject boundingBoxObj = env->NewObject(boundingBoxClass,
-                                                boundingBoxConstructor,
-                                                label,
-                                                (jfloat)bb.value,
-                                                (jint)bb.x,
-                                                (jint)bb.y,
-                                                (jint)bb.width,
-                                                (jint)bb.height);
-        env->CallBooleanMethod(boundingBoxList, listAdd, boundingBoxObj);
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_example_test_1cpp_MainActivity_createSession(
+        JNIEnv*,
+        jobject) {
+    return reinterpret_cast<jlong>(new ei_session_t());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_test_1cpp_MainActivity_destroySession(
+        JNIEnv*,
+        jobject,
+        jlong session) {
+    delete reinterpret_cast<ei_session_t*>(session);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_example_test_1cpp_MainActivity_runInference(
+        JNIEnv* env,
+        jobject,
+        jlong session_ptr,
+        jobject result_buffer) {
+
+    auto *session = reinterpret_cast<ei_session_t*>(session_ptr);
+    float *out = get_result_buffer(env, result_buffer);
+    if (!session || !out) {
+        return JNI_FALSE;
+    }
 
-        env->DeleteLocalRef(label);
-        env->DeleteLocalRef(boundingBoxObj);
+    if (raw_features.size() != EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
+        ei_printf("The size of your 'features' array is not correct. Expected %d items, but had %d\n", EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, raw_features.size());
+        return JNI_FALSE;
     }
-#endif
 
-    // Create HashMap for anomaly values
-    jobject anomalyResultMap = env->NewObject(hashMapClass, hashMapInit);
+    signal_t signal;
+    numpy::signal_from_buffer(&raw_features[0], raw_features.size(), &signal);
 
-#if EI_CLASSIFIER_HAS_ANOMALY != 3
-    jobject anomalyString = env->NewStringUTF("anomaly");
-    jobject anomalyValue = env->NewObject(floatClass, floatConstructor, (jfloat)result.anomaly);
+    EI_IMPULSE_ERROR res = run_classifier(&session->handle, &signal, &session->result, false);
 
-    env->CallObjectMethod(anomalyResultMap, hashMapPut, anomalyString, anomnalyValue);
-    env->DeleteLocalRef(anomalyString);
-    env->DeleteLocalRef(anomalyValue);
-#endif
+    if (res != EI_IMPULSE_OK) {
+        ei_printf("Inference error code %d\n", (int)res);
+        return JNI_FALSE;
+    }
 
-#if EI_CLASSIFIER_HAS_VISUAL_ANOMALY
-    // Create ArrayList for visual anomaly grid cells
-    jobject boundingBoxListAnomaly = env->NewObject(listClass, env->GetMethodID(listClass, "<init>", "()V"));
-    for (uint32_t i = 0; i < result.visual_ad_count; i++) {
-        ei_impulse_result_bounding_box_t bb = result.visual_ad_grid_cells[i];
-
-        jstring label = env->NewStringUTF("anomaly");
-        jobject boundingBoxObj = env->NewObject(boundingBoxClass,
-                                                boundingBoxConstructor,
-                                                label,
-                                                (jfloat)bb.value,
-                                                (jint)bb.x,
-                                                (jint)bb.y,
-                                                (jint)bb.width,
-                                                (jint)bb.height);
-        env->CallBooleanMethod(boundingBoxListAnomaly, listAdd, boundingBoxObj);
+    write_inference_result(session->result, out);
+    return JNI_TRUE;
+}
 
-        env->DeleteLocalRef(label);
-        env->DeleteLocalRef(boundingBoxObj);
+/**
+ * Profile runs inferences on the static features; returns the per-stage and per-op timings
+ * as JSON (see ei_profiler_report_to_json), or an empty string if profiling isn't compiled in.
+ * The report is also printed to the log.
+ */
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_example_test_1cpp_MainActivity_profileInference(
+        JNIEnv* env,
+        jobject,
+        jlong session_ptr,
+        jint runs) {
+
+    std::string json;
+
+#if EIDSP_PROFILING == 1
+    auto *session = reinterpret_cast<ei_session_t*>(session_ptr);
+    if (!session || runs <= 0 || raw_features.size() != EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE) {
+        return env->NewStringUTF("");
     }
 
-    jobject maxString = env->NewStringUTF("max");
-    jobject maxValue = env->NewObject(floatClass, floatConstructor, (jfloat)result.visual_ad_result.max_value);
+    signal_t signal;
+    numpy::signal_from_buffer(&raw_features[0], raw_features.size(), &signal);
 
-    jobject meanString = env->NewStringUTF("mean");
-    jobject meanValue = env->NewObject(floatClass, floatConstructor, (jfloat)result.visual_ad_result.mean_value);
+    // the first inference (re)builds the interpreter with the op profiler, don't count it
+    ei_profiler_start(&session->handle);
+    run_classifier(&session->handle, &signal, &session->result, false);
+    ei_profiler_reset(&session->handle);
+
+    for (jint i = 0; i < runs; i++) {
+        EI_IMPULSE_ERROR res = run_classifier(&session->handle, &signal, &session->result, false);
+        if (res != EI_IMPULSE_OK) {
+            ei_printf("Inference error code %d\n", (int)res);
+            break;
+        }
+    }
 
-    env->CallObjectMethod(anomalyResultMap, hashMapPut, maxString, maxValue);
-    env->CallObjectMethod(anomalyResultMap, hashMapPut, meanString, meanValue);
-    env->DeleteLocalRef(meanString);
-    env->DeleteLocalRef(maxString);
-    env->DeleteLocalRef(meanValue);
-    env->DeleteLocalRef(maxValue);
-#endif
+    ei_profiler_report_t report;
+    ei_profiler_get_report(&session->handle, &report);
+    ei_profiler_stop(&session->handle);
 
-    // Construct Timing object
-    jobject timingObject = env->NewObject(timingClass, timingConstructor,
-                                          result.timing.sampling,
-                                          result.timing.dsp,
-                                          result.timing.classification,
-                                          result.timing.anomaly,
-                                          result.timing.dsp_us,
-                                          result.timing.classification_us,
-                                          result.timing.anomaly_us);
-
-    // Construct InferenceResult object
-    jobject inferenceResult = env->NewObject(resultClass,
-                                             resultConstructor,
-#if EI_CLASSIFIER_LABEL_COUNT > 0
-            classificationMap,
-#else
-                                             nullptr,
-#endif
-#if EI_CLASSIFIER_OBJECT_DETECTION == 1
-            boundingBoxList,
-#else
-                                             nullptr,
-#endif
-#if EI_CLASSIFIER_HAS_VISUAL_ANOMALY
-                                             boundingBoxListAnomaly,
-#else
-            nullptr,
-#endif
-#if EI_CLASSIFIER_HAS_ANOMALY
-                                             anomalyResultMap,
+    ei_profiler_print_report(&report);
+    ei_profiler_report_to_json(&report, &json);
 #else
-            nullptr,
+    (void)session_ptr;
+    (void)runs;
 #endif
-                                             timingObject);
 
-    return inferenceResult;
-}
\ No newline at end of file
+    return env->NewStringUTF(json.c_str());
+}
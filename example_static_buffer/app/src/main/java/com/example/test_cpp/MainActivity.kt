@@ -4,38 +4,72 @@ import android.annotation.SuppressLint
 import androidx.appcompat.app.AppCompatActivity
 import android.os.Bundle
 import com.example.test_cpp.databinding.ActivityMainBinding
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.FloatBuffer
+import org.json.JSONObject
 
-data class InferenceResult(
-    val classification: Map<String, Float>?,   // Classification labels and values
-    val objectDetections: List<BoundingBox>?,  // Object detection results
-    val visualAnomalyGridCells: List<BoundingBox>?, // Visual anomaly grid
-    val anomalyResult: Map<String, Float>?, // Anomaly values
-    val timing: Timing  // Timing information
-)
-
-data class BoundingBox(
-    val label: String,
-    val confidence: Float,
-    val x: Int,
-    val y: Int,
-    val width: Int,
-    val height: Int
-)
-
-data class Timing(
-    val sampling: Int,
-    val dsp: Int,
-    val classification: Int,
-    val anomaly: Int,
-    val dsp_us: Long,
-    val classification_us: Long,
-    val anomaly_us: Long
-)
+/**
+ * View over the direct buffer the native code writes each result into, allocated once and
+ * reused for every call so nothing is boxed or allocated on the result path.
+ * The layout must match RESULT_* in native-lib.cpp.
+ */
+class InferenceResult(val labels: Array<String>, capacity: Int) {
+    val buffer: FloatBuffer = ByteBuffer.allocateDirect(capacity * 4)
+        .order(ByteOrder.nativeOrder())
+        .asFloatBuffer()
+
+    private val flags get() = buffer.get(IX_FLAGS).toInt()
+
+    val hasClassification get() = flags and FLAG_CLASSIFICATION != 0
+    val hasObjectDetection get() = flags and FLAG_OBJECT_DETECTION != 0
+    val hasVisualAnomaly get() = flags and FLAG_VISUAL_AD != 0
+    val hasAnomaly get() = flags and FLAG_ANOMALY != 0
+
+    val anomaly get() = buffer.get(IX_ANOMALY)
+    val visualAnomalyMax get() = buffer.get(IX_VISUAL_AD_MAX)
+    val visualAnomalyMean get() = buffer.get(IX_VISUAL_AD_MEAN)
+
+    val dspUs get() = buffer.get(IX_TIMING_DSP_US).toLong()
+    val classificationUs get() = buffer.get(IX_TIMING_CLASSIFICATION_US).toLong()
+    val anomalyUs get() = buffer.get(IX_TIMING_ANOMALY_US).toLong()
+
+    fun score(labelIndex: Int) = buffer.get(HEADER_SIZE + labelIndex)
+
+    // Object detection boxes, followed by the visual anomaly grid cells
+    val boxCount get() = buffer.get(IX_BOX_COUNT).toInt()
+    val visualAnomalyCount get() = buffer.get(IX_VISUAL_AD_COUNT).toInt()
+
+    /** Offset of box [index] in [buffer]: label index (-1 for anomaly cells), value, x, y, width, height */
+    fun boxOffset(index: Int) = HEADER_SIZE + labels.size + index * BOX_SIZE
+
+    companion object {
+        const val IX_FLAGS = 0
+        const val IX_BOX_COUNT = 1
+        const val IX_VISUAL_AD_COUNT = 2
+        const val IX_ANOMALY = 3
+        const val IX_VISUAL_AD_MAX = 4
+        const val IX_VISUAL_AD_MEAN = 5
+        const val IX_TIMING_DSP_US = 6
+        const val IX_TIMING_CLASSIFICATION_US = 7
+        const val IX_TIMING_ANOMALY_US = 8
+        const val HEADER_SIZE = 9
+        const val BOX_SIZE = 6
+
+        const val FLAG_CLASSIFICATION = 1
+        const val FLAG_OBJECT_DETECTION = 2
+        const val FLAG_VISUAL_AD = 4
+        const val FLAG_ANOMALY = 8
+    }
+}
 
 class MainActivity : AppCompatActivity() {
 
     private lateinit var binding: ActivityMainBinding
 
+    // Native inference session (handle + preallocated buffers)
+    private var session: Long = 0L
+
     @SuppressLint("SetTextI18n")
     override fun onCreate(savedInstanceState: Bundle?) {
         super.onCreate(savedInstanceState)
@@ -43,52 +77,112 @@ class MainActivity : AppCompatActivity() {
         binding = ActivityMainBinding.inflate(layoutInflater)
         setContentView(binding.root)
 
-        val result = runInference()
-        if (result == null) {
+        session = createSession()
+
+        val result = InferenceResult(getLabels(), getResultBufferSize())
+        if (!runInference(session, result.buffer)) {
             binding.sampleText.text = "Error running inference"
         } else
         {
             val combinedText = StringBuilder()
-            if (result.classification != null) {
+            if (result.hasClassification) {
                 // Display classification results
-                val classificationText = result.classification.entries.joinToString("\n") {
-                    "${it.key}: ${it.value}"
+                combinedText.append("Classification:\n")
+                result.labels.forEachIndexed { ix, label ->
+                    combinedText.append(label).append(": ").append(result.score(ix)).append('\n')
                 }
-                combinedText.append("Classification:\n$classificationText\n\n")
+                combinedText.append('\n')
             }
-            if (result.objectDetections != null) {
+            if (result.hasObjectDetection) {
                 // Display object detection results
-                val objectDetectionText = result.objectDetections.joinToString("\n") {
-                    "${it.label}: ${it.confidence}, ${it.x}, ${it.y}, ${it.width}, ${it.height}"
-                }
-                combinedText.append("Object detection:\n$objectDetectionText\n\n")
+                combinedText.append("Object detection:\n")
+                appendBoxes(combinedText, result, 0, result.boxCount)
+                combinedText.append('\n')
             }
-            if (result.visualAnomalyGridCells != null) {
+            if (result.hasVisualAnomaly) {
                 // Display visual anomaly grid cells
-                val visualAnomalyGridText = result.visualAnomalyGridCells.joinToString("\n") {
-                    "${it.label}: ${it.confidence}, ${it.x}, ${it.y}, ${it.width}, ${it.height}"
-                }
-                val visualAnomalyMax = result.anomalyResult?.getValue("max")
-                val visualAnomalyMean = result.anomalyResult?.getValue("mean")
-                combinedText.append("Visual anomalies:\n$visualAnomalyGridText\n\nVisual anomaly values:\nMean: ${visualAnomalyMean}\nMax: ${visualAnomalyMax}\n\n")
-            }
-            if (result.anomalyResult?.get("anomaly") != null) {
+                combinedText.append("Visual anomalies:\n")
+                appendBoxes(combinedText, result, result.boxCount, result.visualAnomalyCount)
+                combinedText.append("\nVisual anomaly values:\nMean: ${result.visualAnomalyMean}\nMax: ${result.visualAnomalyMax}\n\n")
+            } else if (result.hasAnomaly) {
                 // Display anomaly detection score
-                val anomalyScore = result.anomalyResult.get("anomaly")
-                combinedText.append("Anomaly score:\n${anomalyScore}")
+                combinedText.append("Anomaly score:\n${result.anomaly}")
+            }
+            if (PROFILE_RUNS > 0) {
+                appendProfile(combinedText, profileInference(session, PROFILE_RUNS))
             }
 
             binding.sampleText.text = combinedText.toString()
         }
     }
 
+    private fun appendBoxes(text: StringBuilder, result: InferenceResult, first: Int, count: Int) {
+        for (i in first until first + count) {
+            val o = result.boxOffset(i)
+            val labelIndex = result.buffer.get(o).toInt()
+            val label = if (labelIndex < 0) "anomaly" else result.labels[labelIndex]
+            text.append("$label: ${result.buffer.get(o + 1)}, ${result.buffer.get(o + 2).toInt()}, " +
+                    "${result.buffer.get(o + 3).toInt()}, ${result.buffer.get(o + 4).toInt()}, ${result.buffer.get(o + 5).toInt()}\n")
+        }
+    }
+
+    /**
+     * Appends the slowest stages and ops of a profile (JSON, see profileInference), times are
+     * averages per inference in ms
+     */
+    private fun appendProfile(text: StringBuilder, json: String) {
+        if (json.isEmpty()) return
+        val profile = JSONObject(json)
+        val inferences = maxOf(profile.getInt("inferences"), 1)
+        for (section in listOf("stages", "ops")) {
+            val entries = profile.getJSONArray(section)
+            val sorted = (0 until entries.length()).map { entries.getJSONObject(it) }
+                .sortedByDescending { it.getDouble("total_us") }
+            if (sorted.isEmpty()) continue
+            text.append("\nProfile $section (ms per inference):\n")
+            for (entry in sorted.take(PROFILE_MAX_ENTRIES)) {
+                text.append("${entry.getString("name")}: " +
+                        String.format("%.3f", entry.getDouble("total_us") / inferences / 1000.0) + "\n")
+            }
+        }
+    }
+
+    override fun onDestroy() {
+        super.onDestroy()
+        destroySession(session)
+        session = 0L
+    }
+
+    /**
+     * Create / free the native inference session, it is reused for every runInference call
+     */
+    external fun createSession(): Long
+    external fun destroySession(session: Long)
+
     /**
      * A native method that is implemented by the 'test_cpp' native library,
-     * which is packaged with this application.
+     * which is packaged with this application. Results are written to resultBuffer.
      */
-    external fun runInference(): InferenceResult?
+    external fun runInference(session: Long, resultBuffer: FloatBuffer): Boolean
+
+    /**
+     * Labels and the size (in floats) of the result buffer, see InferenceResult
+     */
+    external fun getLabels(): Array<String>
+    external fun getResultBufferSize(): Int
+
+    /**
+     * Runs the impulse [runs] times with the profiler on, returns the timings per stage and per
+     * op as JSON (also printed to logcat), or an empty string if profiling isn't compiled in
+     */
+    external fun profileInference(session: Long, runs: Int): String
 
     companion object {
+        // Number of inferences to profile after the first result, 0 to disable
+        const val PROFILE_RUNS = 0
+        const val PROFILE_MAX_ENTRIES = 10
+
+
         // Used to load the 'test_cpp' library on application startup.
         init {
             System.loadLibrary("test_cpp")
@@ -131,6 +131,21 @@ Java_com_qualcomm_qti_speech_1to_1image_SpeechToImageNativeJNI_initializeDetoken
     return (*env).NewStringUTF(run_whisper(jstring_to_stdstring(env, audio_path)).c_str());
   }
 
+  JNIEXPORT void JNICALL
+  Java_com_qualcomm_qti_speech_1to_1image_SpeechToImageNativeJNI_beginWhisperStream(JNIEnv *env, jobject thiz,
+                                                                                    jstring audio_path) {
+    begin_whisper_stream(jstring_to_stdstring(env, audio_path));
+  }
+
+  JNIEXPORT void JNICALL
+  Java_com_qualcomm_qti_speech_1to_1image_SpeechToImageNativeJNI_pushWhisperAudio(JNIEnv *env, jobject thiz,
+                                                                                  jbyteArray pcm, jint length) {
+    // 16-bit little endian mono PCM, as read from AudioRecord
+    jbyte* bytes = env->GetByteArrayElements(pcm, nullptr);
+    push_whisper_audio(reinterpret_cast<const int16_t*>(bytes), static_cast<size_t>(length) / sizeof(int16_t));
+    env->ReleaseByteArrayElements(pcm, bytes, JNI_ABORT);
+  }
+
   JNIEXPORT void JNICALL
   Java_com_qualcomm_qti_speech_1to_1image_SpeechToImageNativeJNI_stopStableDiffusion(JNIEnv *env, jobject thiz) {
     stop_stable_diffusion = true;
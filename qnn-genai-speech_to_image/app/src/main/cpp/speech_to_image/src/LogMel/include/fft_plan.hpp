@@ -0,0 +1,53 @@
+//============================================================================
+// Copyright (c) 2026 Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause-Clear
+//============================================================================
+
+#ifndef FFT_PLAN_
+#define FFT_PLAN_
+
+#include <vector>
+
+namespace mel_spectrogram {
+
+struct fft_complex {
+    float r;
+    float i;
+};
+
+// Precomputed mixed-radix (4, 2, 3, 5, generic) real FFT for any even size, e.g. the
+// 400 point Whisper frame. The plan is read-only after construction so one plan can be
+// shared by all worker threads, each thread brings its own scratch buffer.
+class fft_plan {
+public:
+    explicit fft_plan(int n_fft);
+
+    int size() const { return m_n_fft; }
+
+    // number of complex bins rfft() writes (n_fft / 2 + 1)
+    int n_bins() const { return m_n_fft / 2 + 1; }
+
+    // scratch size (in complex values) rfft() needs
+    int scratch_size() const { return m_n_fft / 2; }
+
+    // forward FFT of n_fft real samples into n_bins() complex bins
+    void rfft(const float* in, fft_complex* out, fft_complex* scratch) const;
+
+private:
+    void work(fft_complex* out, const fft_complex* in, int fstride, const int* factors) const;
+    void bfly2(fft_complex* out, int fstride, int m) const;
+    void bfly3(fft_complex* out, int fstride, int m) const;
+    void bfly4(fft_complex* out, int fstride, int m) const;
+    void bfly5(fft_complex* out, int fstride, int m) const;
+    void bfly_generic(fft_complex* out, int fstride, int m, int p) const;
+
+    int m_n_fft;
+    int m_n_cfft;                           // complex FFT size (n_fft / 2)
+    std::vector<int> m_factors;             // (radix, remaining length) pairs
+    std::vector<fft_complex> m_twiddles;    // exp(-2*pi*i*k / n_cfft)
+    std::vector<fft_complex> m_super_twiddles;
+};
+
+}
+
+#endif //FFT_PLAN_
@@ -1,6 +1,8 @@
 #ifndef LOG_MEL_SPECTROGRAM_
 #define LOG_MEL_SPECTROGRAM_
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -12,7 +14,8 @@ class mel_calc_cpu;
 class LogMelSpectrogram {
 
 public:
-    LogMelSpectrogram(std::string mel_filter_binfile);
+    // n_threads = 0 sizes the worker pool to the big cores
+    LogMelSpectrogram(std::string mel_filter_binfile, int n_threads = 0);
     ~LogMelSpectrogram();
 
     std::vector<float> compute(const std::vector<float>& audio_data);
@@ -23,6 +26,19 @@ public:
 
     std::vector<float> load_audio_chunk(const std::vector<float>& audio_samples);
 
+    // Streaming: push microphone audio while recording, every frame is computed as soon
+    // as its window is complete. stream_finish() only has to do the last frames and
+    // returns the same spectrogram as load_audio_chunk() over all pushed samples.
+    void stream_begin();
+
+    void stream_push(const float* samples, size_t n_samples);
+
+    void stream_push_pcm16(const int16_t* samples, size_t n_samples);
+
+    bool streaming();
+
+    std::vector<float> stream_finish();
+
 private:
     std::shared_ptr<mel_calc_cpu> mel_calculator_sptr;
     int n_threads;
@@ -30,4 +46,4 @@ private:
 
 }
 
-#endif //LOG_MEL_SPECTROGRAM_
\ No newline at end of file
+#endif //LOG_MEL_SPECTROGRAM_
@@ -4,6 +4,15 @@
 //============================================================================
 
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
 #include <vector>
 
-std::vector<float> log_mel(std::string audio_path, std::string cache_dir);
\ No newline at end of file
+std::vector<float> log_mel(std::string audio_path, std::string cache_dir);
+
+// Compute the spectrogram of audio_path while it is being recorded: push the 16-bit
+// PCM as it comes from the microphone, log_mel(audio_path, ...) then only finishes
+// the last frames instead of reading the file back.
+void log_mel_stream_begin(std::string audio_path, std::string cache_dir);
+void log_mel_stream_push(const int16_t* samples, size_t n_samples);
@@ -0,0 +1,56 @@
+//============================================================================
+// Copyright (c) 2026 Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause-Clear
+//============================================================================
+
+#ifndef THREAD_POOL_
+#define THREAD_POOL_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mel_spectrogram {
+
+// Number of "big" cores: every core that is not in the slowest cluster (by
+// cpuinfo_max_freq), or all cores when the frequencies are unknown or identical.
+int big_core_count();
+
+// Persistent workers that are started once and woken up for every job, instead of
+// spawning std::threads per call. On Linux the workers are pinned to the big cores.
+class thread_pool {
+public:
+    // n_threads includes the calling thread, 0 = big_core_count()
+    explicit thread_pool(int n_threads = 0);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    int size() const { return m_n_threads; }
+
+    // Run fn(ith, n_threads) on every thread, the caller runs ith = 0.
+    // Returns when all threads are done. Not reentrant.
+    void run(const std::function<void(int, int)>& fn);
+
+private:
+    void worker_loop(int ith);
+
+    int m_n_threads;
+    std::vector<int> m_affinity;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_start_cv;
+    std::condition_variable m_done_cv;
+    const std::function<void(int, int)>* m_job = nullptr;
+    uint64_t m_generation = 0;
+    int m_pending = 0;
+    bool m_stop = false;
+};
+
+}
+
+#endif //THREAD_POOL_
@@ -0,0 +1,214 @@
+//============================================================================
+// Copyright (c) 2026 Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause-Clear
+//============================================================================
+
+#include "fft_plan.hpp"
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <cassert>
+
+namespace mel_spectrogram {
+
+static inline fft_complex c_mul(fft_complex a, fft_complex b) {
+    return { a.r * b.r - a.i * b.i, a.r * b.i + a.i * b.r };
+}
+
+static inline fft_complex c_add(fft_complex a, fft_complex b) {
+    return { a.r + b.r, a.i + b.i };
+}
+
+static inline fft_complex c_sub(fft_complex a, fft_complex b) {
+    return { a.r - b.r, a.i - b.i };
+}
+
+fft_plan::fft_plan(int n_fft) : m_n_fft(n_fft), m_n_cfft(n_fft / 2) {
+    assert(n_fft >= 2 && n_fft % 2 == 0);
+
+    m_twiddles.resize(m_n_cfft);
+    for (int k = 0; k < m_n_cfft; k++) {
+        double phase = -2.0 * M_PI * k / m_n_cfft;
+        m_twiddles[k] = { static_cast<float>(cos(phase)), static_cast<float>(sin(phase)) };
+    }
+
+    m_super_twiddles.resize(m_n_cfft / 2);
+    for (int k = 0; k < m_n_cfft / 2; k++) {
+        double phase = -M_PI * (static_cast<double>(k + 1) / m_n_cfft + 0.5);
+        m_super_twiddles[k] = { static_cast<float>(cos(phase)), static_cast<float>(sin(phase)) };
+    }
+
+    // radix 4 first, then 2, then the odd factors (400 -> 200 = 4 * 2 * 5 * 5)
+    int n = m_n_cfft;
+    int p = 4;
+    double floor_sqrt = floor(sqrt(static_cast<double>(n)));
+    do {
+        while (n % p) {
+            switch (p) {
+                case 4: p = 2; break;
+                case 2: p = 3; break;
+                default: p += 2; break;
+            }
+            if (p > floor_sqrt) {
+                p = n;
+            }
+        }
+        n /= p;
+        m_factors.push_back(p);
+        m_factors.push_back(n);
+    } while (n > 1);
+}
+
+void fft_plan::rfft(const float* in, fft_complex* out, fft_complex* scratch) const {
+    // pack the real samples as n_cfft complex values, FFT, then split the spectrum
+    work(scratch, reinterpret_cast<const fft_complex*>(in), 1, m_factors.data());
+
+    fft_complex tdc = scratch[0];
+    out[0] = { tdc.r + tdc.i, 0.0f };
+    out[m_n_cfft] = { tdc.r - tdc.i, 0.0f };
+
+    for (int k = 1; k <= m_n_cfft / 2; k++) {
+        fft_complex fpk = scratch[k];
+        fft_complex fpnk = { scratch[m_n_cfft - k].r, -scratch[m_n_cfft - k].i };
+
+        fft_complex f1k = c_add(fpk, fpnk);
+        fft_complex f2k = c_sub(fpk, fpnk);
+        fft_complex tw = c_mul(f2k, m_super_twiddles[k - 1]);
+
+        out[k] = { 0.5f * (f1k.r + tw.r), 0.5f * (f1k.i + tw.i) };
+        out[m_n_cfft - k] = { 0.5f * (f1k.r - tw.r), 0.5f * (tw.i - f1k.i) };
+    }
+}
+
+void fft_plan::work(fft_complex* out, const fft_complex* in, int fstride, const int* factors) const {
+    const int p = *factors++;
+    const int m = *factors++;
+    fft_complex* out_begin = out;
+    const fft_complex* out_end = out + p * m;
+
+    if (m == 1) {
+        do {
+            *out = *in;
+            in += fstride;
+        } while (++out != out_end);
+    } else {
+        do {
+            work(out, in, fstride * p, factors);
+            in += fstride;
+        } while ((out += m) != out_end);
+    }
+
+    switch (p) {
+        case 2: bfly2(out_begin, fstride, m); break;
+        case 3: bfly3(out_begin, fstride, m); break;
+        case 4: bfly4(out_begin, fstride, m); break;
+        case 5: bfly5(out_begin, fstride, m); break;
+        default: bfly_generic(out_begin, fstride, m, p); break;
+    }
+}
+
+void fft_plan::bfly2(fft_complex* out, int fstride, int m) const {
+    for (int k = 0; k < m; k++) {
+        fft_complex t = c_mul(out[m + k], m_twiddles[k * fstride]);
+        out[m + k] = c_sub(out[k], t);
+        out[k] = c_add(out[k], t);
+    }
+}
+
+void fft_plan::bfly3(fft_complex* out, int fstride, int m) const {
+    const float epi3 = m_twiddles[fstride * m].i;
+
+    for (int k = 0; k < m; k++) {
+        fft_complex s1 = c_mul(out[m + k], m_twiddles[k * fstride]);
+        fft_complex s2 = c_mul(out[2 * m + k], m_twiddles[2 * k * fstride]);
+        fft_complex s3 = c_add(s1, s2);
+        fft_complex s0 = c_sub(s1, s2);
+
+        fft_complex f0 = out[k];
+        fft_complex f1 = { f0.r - 0.5f * s3.r, f0.i - 0.5f * s3.i };
+        s0 = { s0.r * epi3, s0.i * epi3 };
+
+        out[k] = c_add(f0, s3);
+        out[2 * m + k] = { f1.r + s0.i, f1.i - s0.r };
+        out[m + k] = { f1.r - s0.i, f1.i + s0.r };
+    }
+}
+
+void fft_plan::bfly4(fft_complex* out, int fstride, int m) const {
+    for (int k = 0; k < m; k++) {
+        fft_complex s0 = c_mul(out[m + k], m_twiddles[k * fstride]);
+        fft_complex s1 = c_mul(out[2 * m + k], m_twiddles[2 * k * fstride]);
+        fft_complex s2 = c_mul(out[3 * m + k], m_twiddles[3 * k * fstride]);
+
+        fft_complex s5 = c_sub(out[k], s1);
+        fft_complex f0 = c_add(out[k], s1);
+        fft_complex s3 = c_add(s0, s2);
+        fft_complex s4 = c_sub(s0, s2);
+
+        out[2 * m + k] = c_sub(f0, s3);
+        out[k] = c_add(f0, s3);
+        out[m + k] = { s5.r + s4.i, s5.i - s4.r };
+        out[3 * m + k] = { s5.r - s4.i, s5.i + s4.r };
+    }
+}
+
+void fft_plan::bfly5(fft_complex* out, int fstride, int m) const {
+    const fft_complex ya = m_twiddles[fstride * m];
+    const fft_complex yb = m_twiddles[fstride * 2 * m];
+
+    fft_complex* f0 = out;
+    fft_complex* f1 = out + m;
+    fft_complex* f2 = out + 2 * m;
+    fft_complex* f3 = out + 3 * m;
+    fft_complex* f4 = out + 4 * m;
+
+    for (int u = 0; u < m; u++) {
+        fft_complex s0 = f0[u];
+        fft_complex s1 = c_mul(f1[u], m_twiddles[u * fstride]);
+        fft_complex s2 = c_mul(f2[u], m_twiddles[2 * u * fstride]);
+        fft_complex s3 = c_mul(f3[u], m_twiddles[3 * u * fstride]);
+        fft_complex s4 = c_mul(f4[u], m_twiddles[4 * u * fstride]);
+
+        fft_complex s7 = c_add(s1, s4);
+        fft_complex s10 = c_sub(s1, s4);
+        fft_complex s8 = c_add(s2, s3);
+        fft_complex s9 = c_sub(s2, s3);
+
+        f0[u] = { s0.r + s7.r + s8.r, s0.i + s7.i + s8.i };
+
+        fft_complex s5 = { s0.r + s7.r * ya.r + s8.r * yb.r, s0.i + s7.i * ya.r + s8.i * yb.r };
+        fft_complex s6 = { s10.i * ya.i + s9.i * yb.i, -(s10.r * ya.i + s9.r * yb.i) };
+        f1[u] = c_sub(s5, s6);
+        f4[u] = c_add(s5, s6);
+
+        fft_complex s11 = { s0.r + s7.r * yb.r + s8.r * ya.r, s0.i + s7.i * yb.r + s8.i * ya.r };
+        fft_complex s12 = { -s10.i * yb.i + s9.i * ya.i, s10.r * yb.i - s9.r * ya.i };
+        f2[u] = c_add(s11, s12);
+        f3[u] = c_sub(s11, s12);
+    }
+}
+
+void fft_plan::bfly_generic(fft_complex* out, int fstride, int m, int p) const {
+    std::vector<fft_complex> scratch(p);
+
+    for (int u = 0; u < m; u++) {
+        for (int q1 = 0; q1 < p; q1++) {
+            scratch[q1] = out[u + q1 * m];
+        }
+
+        for (int q1 = 0; q1 < p; q1++) {
+            int k = u + q1 * m;
+            int twidx = 0;
+            fft_complex acc = scratch[0];
+            for (int q = 1; q < p; q++) {
+                twidx += fstride * k;
+                if (twidx >= m_n_cfft) {
+                    twidx -= m_n_cfft;
+                }
+                acc = c_add(acc, c_mul(scratch[q], m_twiddles[twidx]));
+            }
+            out[k] = acc;
+        }
+    }
+}
+
+}
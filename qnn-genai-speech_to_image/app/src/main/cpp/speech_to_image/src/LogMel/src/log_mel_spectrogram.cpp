@@ -5,41 +5,35 @@
 #include <cmath>
 #include <vector>
 #include <thread>
+#include <mutex>
 #include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <fstream>
 #include "wavreader.h"
+#include "fft_plan.hpp"
+#include "thread_pool.hpp"
 
 // Constants
 #define WHISPER_N_FFT 400
 #define WHISPER_HOP_LENGTH 160
 #define WHISPER_SAMPLE_RATE 16000
-#define SIN_COS_N_COUNT WHISPER_N_FFT
 #define WHISPER_CHUNK_LENGTH 30
 #define N_SAMPLES WHISPER_CHUNK_LENGTH * WHISPER_SAMPLE_RATE
+// reflection pad in front of the audio (the center=True STFT padding)
+#define WHISPER_STAGE_2_PAD (WHISPER_N_FFT / 2)
 
 
 namespace mel_spectrogram {
 
 struct whisper_global_cache {
-    float sin_vals[SIN_COS_N_COUNT];
-    float cos_vals[SIN_COS_N_COUNT];
     float hann_window[WHISPER_N_FFT];
+    fft_plan plan;
 
-    whisper_global_cache() {
-        fill_sin_cos_table();
+    whisper_global_cache() : plan(WHISPER_N_FFT) {
         fill_hann_window(sizeof(hann_window)/sizeof(hann_window[0]), true, hann_window);
     }
 
-    void fill_sin_cos_table() {
-        for (int i = 0; i < SIN_COS_N_COUNT; i++) {
-            double theta = (2 * M_PI * i) / SIN_COS_N_COUNT;
-            sin_vals[i] = sinf(theta);
-            cos_vals[i] = cosf(theta);
-        }
-    }
-
     void fill_hann_window(int length, bool periodic, float* output) {
         int offset = periodic ? 0 : -1;
         for (int i = 0; i < length; i++) {
@@ -59,124 +53,68 @@ struct whisper_filters {
     int n_fft;
     int n_mel;
     std::vector<float> data;
+    // first and one past the last non-zero bin of every filter
+    std::vector<int> bin_start;
+    std::vector<int> bin_end;
 };
 
 struct whisper_global_cache global_cache;
 
-std::vector<float> pad_or_trim(const std::vector<float>& array, size_t length = N_SAMPLES) {
-    std::vector<float> result;
-
-    if (array.size() > length) {
-        // Trim the array
-        result.assign(array.begin(), array.begin() + length);
-    } else if (array.size() < length) {
-        // Pad the array
-        result = array;
-        result.resize(length, 0.0f);
-    } else {
-        // No need to pad or trim
-        result = array;
-    }
+// per thread buffers for one frame
+struct frame_buffers {
+    std::vector<float> fft_in;
+    std::vector<fft_complex> fft_out;
+    std::vector<fft_complex> scratch;
+    std::vector<float> power;
+
+    frame_buffers() :
+        fft_in(WHISPER_N_FFT, 0.0f),
+        fft_out(global_cache.plan.n_bins()),
+        scratch(global_cache.plan.scratch_size()),
+        power(global_cache.plan.n_bins()) {}
+};
 
-    return result;
+// sample p of the padded signal: reflection pad, the audio, then zeros
+static inline float padded_sample(const float* samples, int64_t n_available, int64_t p) {
+    int64_t k = p < WHISPER_STAGE_2_PAD ? WHISPER_STAGE_2_PAD - 1 - p : p - WHISPER_STAGE_2_PAD;
+    return k < n_available ? samples[k] : 0.0f;
 }
 
-void fft(const float* in, int N, float* out) {
-    if (N == 1) {
-        out[0] = in[0];
-        out[1] = 0;
-        return;
-    }
+// log10 mel energies of frame i, written to column i of mel.data
+void log_mel_spectrogram_frame(int i, const float* samples, int64_t n_available, const whisper_filters& filters, frame_buffers& buf, whisper_mel_data& mel) {
+    const int64_t offset = static_cast<int64_t>(i) * WHISPER_HOP_LENGTH;
+    const float* hann = global_cache.hann_window;
+    int n_fft = filters.n_fft;
 
-    const int half_N = N / 2;
-    if (N - half_N * 2 == 1) {
-        // Use naive DFT if N is not a power of 2
-        for (int k = 0; k < N; k++) {
-            float re = 0;
-            float im = 0;
-            for (int n = 0; n < N; n++) {
-                double theta = -2.0 * M_PI * k * n / N;
-                re += in[n] * cos(theta);
-                im += in[n] * sin(theta);
-            }
-            out[2 * k] = re;
-            out[2 * k + 1] = im;
+    assert(n_fft == global_cache.plan.n_bins());
+
+    // window lies in the zero padding: the spectrum is exactly zero
+    if (offset - WHISPER_STAGE_2_PAD >= n_available) {
+        const float silence = static_cast<float>(log10(1e-10));
+        for (int j = 0; j < mel.n_mel; j++) {
+            mel.data[j * mel.n_len + i] = silence;
         }
         return;
     }
 
-    std::vector<float> even;
-    std::vector<float> odd;
-	even.resize(N);
-	odd.resize(N);
-    for (int i = 0; i < half_N; ++i) {
-        even[i] = in[2 * i];
-        odd[i] = in[2 * i + 1];
-    }
-
-    std::vector<float> even_fft;
-    std::vector<float> odd_fft;
-	even_fft.resize(2 * N);
-	odd_fft.resize(2 * N);
-    fft(even.data(), half_N, even_fft.data());
-    fft(odd.data(), half_N, odd_fft.data());
-
-    for (int k = 0; k < half_N; ++k) {
-        double theta = -2.0 * M_PI * k / N;
-        float re = cos(theta);
-        float im = sin(theta);
-        float re_odd = odd_fft[2 * k];
-        float im_odd = odd_fft[2 * k + 1];
-
-        out[2 * k] = even_fft[2 * k] + re * re_odd - im * im_odd;
-        out[2 * k + 1] = even_fft[2 * k + 1] + re * im_odd + im * re_odd;
-        out[2 * (k + half_N)] = even_fft[2 * k] - re * re_odd + im * im_odd;
-        out[2 * (k + half_N) + 1] = even_fft[2 * k + 1] - re * im_odd - im * re_odd;
+    for (int j = 0; j < WHISPER_N_FFT; j++) {
+        buf.fft_in[j] = hann[j] * padded_sample(samples, n_available, offset + j);
     }
-}
-
-void log_mel_spectrogram_worker_thread(int ith, const float* hann, const std::vector<float>& samples, int n_samples, int n_threads, const whisper_filters& filters, whisper_mel_data& mel) {
-    const auto frame_size = WHISPER_N_FFT;
-    const auto frame_step = WHISPER_HOP_LENGTH;
-    std::vector<float> fft_in(frame_size, 0.0f);
-    std::vector<float> fft_out(frame_size * 2, 0.0f);
-    int n_fft = filters.n_fft;
-    int i = ith;
-
-    assert(n_fft == 1 + (frame_size / 2));
 
-    for (; i < std::min(n_samples / frame_step + 1, mel.n_len); i += n_threads) {
-        const int offset = i * frame_step;
+    global_cache.plan.rfft(buf.fft_in.data(), buf.fft_out.data(), buf.scratch.data());
 
-        for (int j = 0; j < std::min(frame_size, n_samples - offset); j++) {
-            fft_in[j] = hann[j] * samples[offset + j];
-        }
-
-        if (n_samples - offset < frame_size) {
-            std::fill(fft_in.begin() + (n_samples - offset), fft_in.end(), 0.0f);
-        }
-
-        fft(fft_in.data(), frame_size, fft_out.data());
-
-        for (int j = 0; j < n_fft; j++) {
-            fft_out[j] = (fft_out[2 * j] * fft_out[2 * j] + fft_out[2 * j + 1] * fft_out[2 * j + 1]);
-        }
-
-        for (int j = 0; j < mel.n_mel; j++) {
-            double sum = 0.0;
-            for (int k = 0; k < n_fft; k++) {
-                sum += fft_out[k] * filters.data[j * n_fft + k];
-            }
-            sum = log10(std::max(sum, 1e-10));
-            mel.data[j * mel.n_len + i] = static_cast<float>(sum);
-        }
+    for (int j = 0; j < n_fft; j++) {
+        buf.power[j] = (buf.fft_out[j].r * buf.fft_out[j].r + buf.fft_out[j].i * buf.fft_out[j].i);
     }
 
-    double sum = log10(1e-10);
-    for (; i < mel.n_len; i += n_threads) {
-        for (int j = 0; j < mel.n_mel; j++) {
-            mel.data[j * mel.n_len + i] = static_cast<float>(sum);
+    for (int j = 0; j < mel.n_mel; j++) {
+        const float* filter = filters.data.data() + j * n_fft;
+        double sum = 0.0;
+        for (int k = filters.bin_start[j]; k < filters.bin_end[j]; k++) {
+            sum += buf.power[k] * filter[k];
         }
+        sum = log10(std::max(sum, 1e-10));
+        mel.data[j * mel.n_len + i] = static_cast<float>(sum);
     }
 }
 
@@ -230,46 +168,108 @@ void log_mel_spectrogram_worker_thread(int ith, const float* hann, const std::ve
 
 class mel_calc_cpu {
 public:
-    mel_calc_cpu(std::string mel_filter_binfile) {
+    mel_calc_cpu(std::string mel_filter_binfile, int n_threads) : m_pool(n_threads) {
         //m_filters = load_mel_filters("mel_80.bin");
         //std::cout << "Filter: " << m_filters.data[1*201 + 2] << " \n";
         m_filters = load_mel_filters(mel_filter_binfile.c_str());
-    }
 
-    whisper_mel_data calculate(const std::vector<float>& samples, int n_threads) {
-        const float* hann = global_cache.hann_window;
+        // the filters are triangles over a few bins, only visit those
+        m_filters.bin_start.resize(m_filters.n_mel);
+        m_filters.bin_end.resize(m_filters.n_mel);
+        for (int j = 0; j < m_filters.n_mel; j++) {
+            const float* filter = m_filters.data.data() + j * m_filters.n_fft;
+            int start = 0;
+            int end = m_filters.n_fft;
+            while (start < end && filter[start] == 0.0f) {
+                start++;
+            }
+            while (end > start && filter[end - 1] == 0.0f) {
+                end--;
+            }
+            m_filters.bin_start[j] = start;
+            m_filters.bin_end[j] = end;
+        }
 
-        int64_t stage_1_pad = WHISPER_SAMPLE_RATE * 30;
-        int64_t stage_2_pad = WHISPER_N_FFT / 2;
+        m_buffers.resize(m_pool.size());
+    }
 
-        const int n_samples = static_cast<int>(samples.size());
+    int n_threads() const {
+        return m_pool.size();
+    }
 
-        std::vector<float> samples_padded;
-        samples_padded.resize(n_samples + stage_1_pad + stage_2_pad * 2);
-        std::copy(samples.begin(), samples.end(), samples_padded.begin() + stage_2_pad);
+    // n_available samples of audio, zero padded (or trimmed) to n_samples
+    whisper_mel_data calculate(const float* samples, int64_t n_available, int64_t n_samples) {
+        whisper_mel_data mel = new_mel(n_samples);
+        compute_frames(0, samples, std::min(n_available, n_samples), mel);
+        finalize(mel);
+        return mel;
+    }
 
-        std::fill(samples_padded.begin() + n_samples + stage_2_pad, samples_padded.begin() + n_samples + stage_1_pad + 2 * stage_2_pad, 0);
-        std::reverse_copy(samples.begin(), samples.begin() + stage_2_pad, samples_padded.begin());
+    void stream_begin() {
+        std::lock_guard<std::mutex> lock(m_stream_mutex);
+        m_stream_samples.clear();
+        m_stream_samples.reserve(N_SAMPLES);
+        m_stream_mel = new_mel(N_SAMPLES);
+        m_stream_frames = 0;
+        m_streaming = true;
+    }
 
-        whisper_mel_data mel;
-        mel.n_mel = m_filters.n_mel;
-        mel.n_len_org = (samples_padded.size() - WHISPER_N_FFT) / WHISPER_HOP_LENGTH;
-        mel.n_len = 2 + (n_samples + stage_2_pad - WHISPER_N_FFT) / WHISPER_HOP_LENGTH;
+    // computes every frame whose window is complete on the calling thread
+    void stream_push(const float* samples, size_t n_samples) {
+        std::lock_guard<std::mutex> lock(m_stream_mutex);
+        if (!m_streaming) {
+            return;
+        }
 
-        mel.data.resize(mel.n_len * mel.n_mel);
-        //mel.data = mel_data.data();
+        size_t n = std::min(n_samples, static_cast<size_t>(N_SAMPLES) - m_stream_samples.size());
+        m_stream_samples.insert(m_stream_samples.end(), samples, samples + n);
 
-        std::vector<std::thread> workers(n_threads - 1);
-        for (int iw = 0; iw < n_threads - 1; ++iw) {
-            workers[iw] = std::thread(log_mel_spectrogram_worker_thread, iw + 1, hann, std::cref(samples_padded), n_samples + stage_2_pad, n_threads, std::cref(m_filters), std::ref(mel));
+        const int64_t n_available = static_cast<int64_t>(m_stream_samples.size());
+        while (m_stream_frames < m_stream_mel.n_len &&
+               static_cast<int64_t>(m_stream_frames) * WHISPER_HOP_LENGTH + WHISPER_N_FFT - WHISPER_STAGE_2_PAD <= n_available) {
+            log_mel_spectrogram_frame(m_stream_frames, m_stream_samples.data(), n_available, m_filters, m_stream_buffers, m_stream_mel);
+            m_stream_frames++;
         }
+    }
 
-        log_mel_spectrogram_worker_thread(0, hann, samples_padded, n_samples + stage_2_pad, n_threads, m_filters, mel);
+    whisper_mel_data stream_finish() {
+        std::lock_guard<std::mutex> lock(m_stream_mutex);
+        m_streaming = false;
 
-        for (int iw = 0; iw < n_threads - 1; ++iw) {
-            workers[iw].join();
-        }
+        compute_frames(m_stream_frames, m_stream_samples.data(), static_cast<int64_t>(m_stream_samples.size()), m_stream_mel);
+        finalize(m_stream_mel);
 
+        whisper_mel_data mel = std::move(m_stream_mel);
+        m_stream_samples.clear();
+        m_stream_samples.shrink_to_fit();
+        return mel;
+    }
+
+    bool streaming() {
+        std::lock_guard<std::mutex> lock(m_stream_mutex);
+        return m_streaming;
+    }
+
+private:
+    whisper_mel_data new_mel(int64_t n_samples) {
+        whisper_mel_data mel;
+        mel.n_mel = m_filters.n_mel;
+        mel.n_len_org = (n_samples + WHISPER_SAMPLE_RATE * 30 + WHISPER_STAGE_2_PAD * 2 - WHISPER_N_FFT) / WHISPER_HOP_LENGTH;
+        mel.n_len = 2 + (n_samples + WHISPER_STAGE_2_PAD - WHISPER_N_FFT) / WHISPER_HOP_LENGTH;
+        mel.data.resize(mel.n_len * mel.n_mel);
+        return mel;
+    }
+
+    // frames first_frame..n_len on the pool
+    void compute_frames(int first_frame, const float* samples, int64_t n_available, whisper_mel_data& mel) {
+        m_pool.run([&](int ith, int nth) {
+            for (int i = first_frame + ith; i < mel.n_len; i += nth) {
+                log_mel_spectrogram_frame(i, samples, n_available, m_filters, m_buffers[ith], mel);
+            }
+        });
+    }
+
+    static void finalize(whisper_mel_data& mel) {
         double mmax = -1e20;
         for (int i = 0; i < mel.n_mel * mel.n_len; i++) {
             if (mel.data[i] > mmax) {
@@ -284,40 +284,32 @@ public:
             }
             mel.data[i] = (mel.data[i] + 4.0f) / 4.0f;
         }
-
-        return mel;
     }
 
-private:
     whisper_filters m_filters;
+    thread_pool m_pool;
+    std::vector<frame_buffers> m_buffers;
+
+    std::mutex m_stream_mutex;
+    bool m_streaming = false;
+    std::vector<float> m_stream_samples;
+    whisper_mel_data m_stream_mel;
+    int m_stream_frames = 0;
+    frame_buffers m_stream_buffers;
 };
 
-LogMelSpectrogram::LogMelSpectrogram(std::string mel_filter_binfile) : n_threads(2)
-{
-    mel_calculator_sptr.reset(new mel_calc_cpu(mel_filter_binfile));
+// 16-bit PCM to -1..1, the same scaling for files and streamed audio
+static inline float pcm16_to_float(int16_t a) {
+    return static_cast<float>(a) / 32767.f;
 }
 
-LogMelSpectrogram::~LogMelSpectrogram()
+static bool read_wav_audio(const std::string& filename, std::vector<float>& audio)
 {
-
-}
-
-std::vector<float>
-LogMelSpectrogram::compute(const std::vector<float>& audio_data)
-{
-    whisper_mel_data mel = mel_calculator_sptr->calculate(audio_data, n_threads);
-    return mel.data;
-}
-
-std::vector<float>
-LogMelSpectrogram::load_wav_audio_and_compute(const std::string& filename)
-{
-    std::vector<float> mel_spectrogram;
     void* h_x = wav_read_open(filename.c_str());
     if (h_x == NULL) 
     {
         std::cerr << "Error opening file: " << filename << std::endl;
-        return mel_spectrogram;
+        return false;
     }
 
     int format, channels, sr, bits_per_sample;
@@ -326,79 +318,109 @@ LogMelSpectrogram::load_wav_audio_and_compute(const std::string& filename)
     if (!res)
     {
         std::cerr << "get ref header error: " << res << std::endl;
-        return mel_spectrogram;
+        wav_read_close(h_x);
+        return false;
     }
 
     int samples = data_length * 8 / bits_per_sample;
     std::vector<int16_t> tmp(samples);
     res = wav_read_data(h_x, reinterpret_cast<unsigned char*>(tmp.data()), data_length);
+    wav_read_close(h_x);
     if (res < 0)
     {
         std::cerr << "read wav file error: " << res << std::endl;
-        return mel_spectrogram;
+        return false;
     }
-    std::vector<float> x(samples);
-    std::transform(tmp.begin(), tmp.end(), x.begin(),
-        [](int16_t a) {
-        return static_cast<float>(a) / 32767.f;
-    });
+    audio.resize(samples);
+    std::transform(tmp.begin(), tmp.end(), audio.begin(), pcm16_to_float);
+    return true;
+}
 
-    std::vector<float> paded_x = pad_or_trim(x, N_SAMPLES);
-    mel_spectrogram = this->compute(paded_x);
+LogMelSpectrogram::LogMelSpectrogram(std::string mel_filter_binfile, int n_threads)
+{
+    mel_calculator_sptr.reset(new mel_calc_cpu(mel_filter_binfile, n_threads));
+    this->n_threads = mel_calculator_sptr->n_threads();
+}
+
+LogMelSpectrogram::~LogMelSpectrogram()
+{
 
-    return mel_spectrogram;
 }
 
-std::vector<float> 
-LogMelSpectrogram::load_wav_audio(const std::string& filename)
+std::vector<float>
+LogMelSpectrogram::compute(const std::vector<float>& audio_data)
 {
-    std::vector<float> audio_chunks;
-    void* h_x = wav_read_open(filename.c_str());
-    if (h_x == NULL) 
-    {
-        std::cerr << "Error opening file: " << filename << std::endl;
-        return audio_chunks;
-    }
+    whisper_mel_data mel = mel_calculator_sptr->calculate(audio_data.data(), audio_data.size(), audio_data.size());
+    return mel.data;
+}
 
-    int format, channels, sr, bits_per_sample;
-    unsigned int data_length;
-    int res = wav_get_header(h_x, &format, &channels, &sr, &bits_per_sample, &data_length);
-    if (!res)
+std::vector<float>
+LogMelSpectrogram::load_wav_audio_and_compute(const std::string& filename)
+{
+    std::vector<float> x;
+    if (!read_wav_audio(filename, x))
     {
-        std::cerr << "get ref header error: " << res << std::endl;
-        return audio_chunks;
+        return std::vector<float>();
     }
 
-    int samples = data_length * 8 / bits_per_sample;
-    std::vector<int16_t> tmp(samples);
-    res = wav_read_data(h_x, reinterpret_cast<unsigned char*>(tmp.data()), data_length);
-    if (res < 0)
-    {
-        std::cerr << "read wav file error: " << res << std::endl;
-        return audio_chunks;
-    }
-    audio_chunks.resize(samples);
-    std::transform(tmp.begin(), tmp.end(), audio_chunks.begin(),
-        [](int16_t a) {
-        return static_cast<float>(a) / 32767.f;
-    });
+    // pad or trim to 30 seconds without copying the audio
+    whisper_mel_data mel = mel_calculator_sptr->calculate(x.data(), x.size(), N_SAMPLES);
+    return mel.data;
+}
+
+std::vector<float> 
+LogMelSpectrogram::load_wav_audio(const std::string& filename)
+{
+    std::vector<float> audio_chunks;
+    read_wav_audio(filename, audio_chunks);
     return audio_chunks;
 }
 
 std::vector<float>
 LogMelSpectrogram::load_audio_chunk(const std::vector<float>& audio_samples)
 {
-    std::vector<float> mel_spectrogram;
     std::cout << "AudioSize: " << audio_samples.size() << std::endl;
-    for (int i=0; i<10; i++)
-    {
-        std::cout << audio_samples[i] << std::endl;
+
+    whisper_mel_data mel = mel_calculator_sptr->calculate(audio_samples.data(), audio_samples.size(), N_SAMPLES);
+    return mel.data;
+}
+
+void
+LogMelSpectrogram::stream_begin()
+{
+    mel_calculator_sptr->stream_begin();
+}
+
+void
+LogMelSpectrogram::stream_push(const float* samples, size_t n_samples)
+{
+    mel_calculator_sptr->stream_push(samples, n_samples);
+}
+
+void
+LogMelSpectrogram::stream_push_pcm16(const int16_t* samples, size_t n_samples)
+{
+    float converted[1024];
+    while (n_samples > 0) {
+        size_t n = std::min(n_samples, sizeof(converted) / sizeof(converted[0]));
+        std::transform(samples, samples + n, converted, pcm16_to_float);
+        mel_calculator_sptr->stream_push(converted, n);
+        samples += n;
+        n_samples -= n;
     }
+}
 
-    std::vector<float> paded_x = pad_or_trim(audio_samples, N_SAMPLES);
-    mel_spectrogram = this->compute(paded_x);
+bool
+LogMelSpectrogram::streaming()
+{
+    return mel_calculator_sptr->streaming();
+}
 
-    return mel_spectrogram;
+std::vector<float>
+LogMelSpectrogram::stream_finish()
+{
+    whisper_mel_data mel = mel_calculator_sptr->stream_finish();
+    return mel.data;
 }
 
 }
\ No newline at end of file
@@ -4,12 +4,47 @@
 //============================================================================
 
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include "log_mel_spectrogram.hpp"
 #include "preprocess.hpp"
 
+// the filters and the worker pool are set up once and reused for every recording
+static std::mutex lms_mutex;
+static std::unique_ptr<mel_spectrogram::LogMelSpectrogram> lms;
+static std::string lms_cache_dir;
+static std::string lms_stream_path;
+
+static mel_spectrogram::LogMelSpectrogram& get_log_mel(const std::string& cache_dir){
+    if (!lms || lms_cache_dir != cache_dir) {
+        lms.reset(new mel_spectrogram::LogMelSpectrogram(cache_dir + "/mel_80.bin"));
+        lms_cache_dir = cache_dir;
+    }
+    return *lms;
+}
+
 std::vector<float> log_mel(std::string audio_path, std::string cache_dir){
-    mel_spectrogram::LogMelSpectrogram lms = mel_spectrogram::LogMelSpectrogram(cache_dir + "/mel_80.bin");
+    std::lock_guard<std::mutex> lock(lms_mutex);
+    mel_spectrogram::LogMelSpectrogram& spectrogram = get_log_mel(cache_dir);
+
+    // most of the frames were already computed while this file was being recorded
+    if (spectrogram.streaming() && audio_path == lms_stream_path) {
+        return spectrogram.stream_finish();
+    }
+
+    return spectrogram.load_wav_audio_and_compute(audio_path);
+}
+
+void log_mel_stream_begin(std::string audio_path, std::string cache_dir){
+    std::lock_guard<std::mutex> lock(lms_mutex);
+    get_log_mel(cache_dir).stream_begin();
+    lms_stream_path = audio_path;
+}
 
-    return lms.load_wav_audio_and_compute(audio_path);
+void log_mel_stream_push(const int16_t* samples, size_t n_samples){
+    std::lock_guard<std::mutex> lock(lms_mutex);
+    if (lms) {
+        lms->stream_push_pcm16(samples, n_samples);
+    }
 }
@@ -0,0 +1,125 @@
+//============================================================================
+// Copyright (c) 2026 Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause-Clear
+//============================================================================
+
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <fstream>
+#include <string>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace mel_spectrogram {
+
+static std::vector<int> big_cores() {
+    std::vector<int> cores;
+    std::vector<long> max_freqs;
+
+    int n_cpus = static_cast<int>(std::thread::hardware_concurrency());
+    for (int cpu = 0; cpu < n_cpus; cpu++) {
+        std::ifstream f("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/cpuinfo_max_freq");
+        long freq = 0;
+        if (!(f >> freq)) {
+            freq = 0;
+        }
+        max_freqs.push_back(freq);
+    }
+
+    if (max_freqs.empty()) {
+        return cores;
+    }
+
+    long slowest = *std::min_element(max_freqs.begin(), max_freqs.end());
+    long fastest = *std::max_element(max_freqs.begin(), max_freqs.end());
+    for (int cpu = 0; cpu < n_cpus; cpu++) {
+        if (slowest == fastest || max_freqs[cpu] > slowest) {
+            cores.push_back(cpu);
+        }
+    }
+    return cores;
+}
+
+int big_core_count() {
+    static const int count = std::max(1, static_cast<int>(big_cores().size()));
+    return count;
+}
+
+thread_pool::thread_pool(int n_threads) : m_n_threads(n_threads > 0 ? n_threads : big_core_count()) {
+    m_affinity = big_cores();
+    for (int ith = 1; ith < m_n_threads; ith++) {
+        m_workers.emplace_back(&thread_pool::worker_loop, this, ith);
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_start_cv.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void thread_pool::run(const std::function<void(int, int)>& fn) {
+    if (m_workers.empty()) {
+        fn(0, 1);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &fn;
+        m_pending = static_cast<int>(m_workers.size());
+        m_generation++;
+    }
+    m_start_cv.notify_all();
+
+    fn(0, m_n_threads);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [this] { return m_pending == 0; });
+    m_job = nullptr;
+}
+
+void thread_pool::worker_loop(int ith) {
+    uint64_t seen = 0;
+
+#ifdef __linux__
+    if (!m_affinity.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : m_affinity) {
+            CPU_SET(cpu, &set);
+        }
+        // best effort, the scheduler still works if this is not allowed
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+
+    while (true) {
+        const std::function<void(int, int)>* job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start_cv.wait(lock, [&] { return m_stop || m_generation != seen; });
+            if (m_stop) {
+                return;
+            }
+            seen = m_generation;
+            job = m_job;
+        }
+
+        (*job)(ith, m_n_threads);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending--;
+        }
+        m_done_cv.notify_one();
+    }
+}
+
+}
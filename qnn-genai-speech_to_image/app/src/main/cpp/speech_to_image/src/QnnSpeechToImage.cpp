@@ -10,12 +10,15 @@
 #include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <limits>
 #include <string>
 #include <vector>
 
 #include "DataUtil.hpp"
+#include "KvCache.hpp"
+#include "ModelBlob.hpp"
 #include "Logger.hpp"
 #include "PAL/Directory.hpp"
 #include "PAL/FileOp.hpp"
@@ -42,7 +45,6 @@ speech_to_image::QnnSpeechToImage::QnnSpeechToImage(QnnFunctionPointers qnnFunct
       m_backendLibraryHandle(backendLibraryHandle),
       m_isBackendInitialized(false),
       m_isContextCreated(false){
-        datautil::initialize_scheduler();
   return;
 }
 
@@ -94,6 +96,14 @@ speech_to_image::StatusCode speech_to_image::QnnSpeechToImage::initialize() {
   } else {
     QNN_WARN("Logging not available in the backend.");
   }
+
+  // The timestep embeddings of the whole schedule are read here once, not on every denoising step
+  if (datautil::StatusCode::SUCCESS != m_timestepEmbeddings.load(assets_path,
+                                                                 datautil::g_numInferenceSteps,
+                                                                 datautil::g_timestepEmbeddingDim)) {
+    QNN_ERROR("Could not load the timestep embeddings from %s", assets_path.c_str());
+    return StatusCode::FAILURE;
+  }
   return StatusCode::SUCCESS;
 }
 
@@ -162,52 +172,74 @@ speech_to_image::StatusCode speech_to_image::QnnSpeechToImage::createFromBinary(
     return StatusCode::FAILURE;
   }
 
-  uint64_t bufferSize[]{0, 0, 0, 0, 0};
-  std::shared_ptr<uint8_t> buffer[]{nullptr, nullptr, nullptr, nullptr, nullptr};
+  if (nullptr == m_qnnFunctionPointers.qnnInterface.contextCreateFromBinary) {
+    QNN_ERROR("contextCreateFromBinaryFnHandle is nullptr.");
+    return StatusCode::FAILURE;
+  }
+
+  // One model at a time: map the context binary, read its graph info, create its context and
+  // unmap it before the next binary is loaded, so only one binary is resident at any point.
+  // The binary info is owned by the system context handle (not by the binary), so the handles
+  // are kept until the graph info of all models has been copied.
   const QnnSystemContext_BinaryInfo_t* binaryInfo[]{nullptr, nullptr, nullptr, nullptr, nullptr};
   Qnn_ContextBinarySize_t binaryInfoSize[]{0, 0, 0, 0, 0};
   QnnSystemContext_Handle_t sysCtxHandle[]{nullptr, nullptr, nullptr, nullptr, nullptr};
 
   auto returnStatus = StatusCode::SUCCESS;
   for(size_t i=0; i<listOfModels.size(); i++){
-    
     if (QNN_SUCCESS != m_qnnFunctionPointers.qnnSystemInterface.systemContextCreate(&sysCtxHandle[i])) {
       QNN_ERROR("Could not create system handle.");
       returnStatus = StatusCode::FAILURE;
-    }
-    // read serialized binary into a byte buffer
-    tools::datautil::StatusCode status{tools::datautil::StatusCode::SUCCESS};
-    std::tie(status, bufferSize[i]) = tools::datautil::getFileSize(listOfModels[i]);
-    if (0 == bufferSize[i]) {
-      QNN_ERROR("Received path to an empty file. Nothing to deserialize.");
-      return StatusCode::FAILURE;
-    }
-    buffer[i] = std::shared_ptr<uint8_t>(new uint8_t[bufferSize[i]], std::default_delete<uint8_t[]>());
-    if (!buffer[i]) {
-      QNN_ERROR("Failed to allocate memory.");
-      return StatusCode::FAILURE;
+      break;
     }
 
-    status = tools::datautil::readBinaryFromFile(
-      listOfModels[i], reinterpret_cast<uint8_t*>(buffer[i].get()), bufferSize[i]);
-    if (status != tools::datautil::StatusCode::SUCCESS) {
-      QNN_ERROR("Failed to read binary data.");
-      return StatusCode::FAILURE;
+    // map the serialized binary
+    datautil::ModelBlob blob;
+    if (tools::datautil::StatusCode::SUCCESS != blob.load(listOfModels[i])) {
+      QNN_ERROR("Failed to load %s", listOfModels[i].c_str());
+      returnStatus = StatusCode::FAILURE;
+      break;
     }
 
     // inspect binary info
-    if (StatusCode::SUCCESS == returnStatus &&
-      QNN_SUCCESS != m_qnnFunctionPointers.qnnSystemInterface.systemContextGetBinaryInfo(
-                         sysCtxHandle[i],
-                         static_cast<void*>(buffer[i].get()),
-                         bufferSize[i],
-                         &binaryInfo[i],
-                         &binaryInfoSize[i])) {
+    if (QNN_SUCCESS != m_qnnFunctionPointers.qnnSystemInterface.systemContextGetBinaryInfo(
+                           sysCtxHandle[i],
+                           const_cast<void*>(blob.data()),
+                           blob.size(),
+                           &binaryInfo[i],
+                           &binaryInfoSize[i])) {
       QNN_ERROR("Failed to get context binary info");
       returnStatus = StatusCode::FAILURE;
+      break;
     }
+
+    const auto contextStart = std::chrono::steady_clock::now();
+    if (m_qnnFunctionPointers.qnnInterface.contextCreateFromBinary(
+        m_backendHandle,
+        m_deviceHandle,
+        (const QnnContext_Config_t**)m_contextConfig[i],
+        blob.data(),
+        blob.size(),
+        &m_context[i],
+        m_profileBackendHandle)) {
+      QNN_ERROR("Could not create context from binary.");
+      returnStatus = StatusCode::FAILURE;
+      break;
+    }
+    const double contextMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - contextStart).count();
+    QNN_INFO("speech_to_image -> %s: %llu bytes %s in %.1f ms, context created in %.1f ms, peak RSS %zu kB",
+             listOfModels[i].c_str(),
+             static_cast<unsigned long long>(blob.size()),
+             blob.isMapped() ? "mapped" : "read",
+             blob.loadTimeMs(),
+             contextMs,
+             datautil::getPeakRssKb());
+
+    // the context does not keep the binary (no QNN_CONTEXT_CONFIG_PERSISTENT_BINARY)
+    blob.release();
   }
-  
+
   // fill GraphInfo_t based on binary info
   if (StatusCode::SUCCESS == returnStatus &&
     !copyMetadataToGraphsInfo(listOfModels.size(), binaryInfo, m_graphsInfo, m_graphsCount)) {
@@ -216,28 +248,9 @@ speech_to_image::StatusCode speech_to_image::QnnSpeechToImage::createFromBinary(
   }
 
   for(size_t i=0; i<listOfModels.size();i++){
-    m_qnnFunctionPointers.qnnSystemInterface.systemContextFree(sysCtxHandle[i]);
-    sysCtxHandle[i] = nullptr;
-  }
-
-  if (StatusCode::SUCCESS == returnStatus &&
-    nullptr == m_qnnFunctionPointers.qnnInterface.contextCreateFromBinary) {
-    QNN_ERROR("contextCreateFromBinaryFnHandle is nullptr.");
-    returnStatus = StatusCode::FAILURE;
-  }
-
-  for(size_t i=0; i<listOfModels.size(); i++){
-    if (StatusCode::SUCCESS == returnStatus &&
-      m_qnnFunctionPointers.qnnInterface.contextCreateFromBinary(
-        m_backendHandle,
-        m_deviceHandle,
-        (const QnnContext_Config_t**)m_contextConfig[i],
-        static_cast<void*>(buffer[i].get()),
-        bufferSize[i],
-        &m_context[i],
-        m_profileBackendHandle)) {
-      QNN_ERROR("Could not create context from binary.");
-      returnStatus = StatusCode::FAILURE;
+    if (nullptr != sysCtxHandle[i]) {
+      m_qnnFunctionPointers.qnnSystemInterface.systemContextFree(sysCtxHandle[i]);
+      sysCtxHandle[i] = nullptr;
     }
   }
 
@@ -424,20 +437,19 @@ void speech_to_image::QnnSpeechToImage::executeLoop(){
   datautil::StatusCode datautilStatus{datautil::StatusCode::SUCCESS};
   std::tie(datautilStatus, length) = datautil::calculateLength(dims, QNN_TENSOR_GET_DATA_TYPE(output_tensors[1][0]));
 
-  //Reserve space for the buffer that will keep the unconditional noise prediction
-  uncondBuffer_noise_predict = QNN_CLIENT_BUFFER_INIT;
-  m_ioTensor.allocateBuffer(reinterpret_cast<uint8_t**>(&uncondBuffer_noise_predict.data),
-                                  dims,
-                                  QNN_TENSOR_GET_DATA_TYPE(output_tensors[1][0]));
-  uncondBuffer_noise_predict.dataSize = length;
+  //The scheduler keeps the unconditional noise prediction, the latent and the solver history, allocated for the first image
+  if(!m_scheduler){
+    m_scheduler.reset(new datautil::DpmSolverScheduler(
+        QNN_TENSOR_GET_CLIENT_BUF(input_tensors[1][0]).dataSize / sizeof(uint16_t)));
+  }
+  m_scheduler->reset();
 
-  uint8_t *unet_buff_out_ptr = reinterpret_cast<uint8_t*>(QNN_TENSOR_GET_CLIENT_BUF(output_tensors[1][0]).data);
-  uint8_t *uncond_buff_noisePredict_ptr = reinterpret_cast<uint8_t*>(uncondBuffer_noise_predict.data);
-  
-  std::vector<float> output;
-  std::vector<float> copy_output(16384);
+  //Float copy of the text embedding on its way from the text_encoder output to the unet input, reused on every step
+  std::vector<size_t> textEmbeddingDims;
+  m_ioTensor.fillDims(textEmbeddingDims, QNN_TENSOR_GET_DIMENSIONS(output_tensors[0][0]), QNN_TENSOR_GET_RANK(output_tensors[0][0]));
+  m_textEmbeddingFloat.resize(datautil::calculateElementCount(textEmbeddingDims));
 
-  for(size_t step=0; step<20; ++step){
+  for(size_t step=0; step<m_scheduler->numInferenceSteps(); ++step){
     if(stop_stable_diffusion){
       break;
     }
@@ -451,19 +463,20 @@ void speech_to_image::QnnSpeechToImage::executeLoop(){
     }
 
     //Copy the output of the text encoder (the unconditioned one) in the input of the unet model    
-    float *tmp_buff = nullptr;
-    m_ioTensor.convertToFloat(&tmp_buff, &(output_tensors[0][0]));
-    m_ioTensor.copyFromFloatToNative(tmp_buff, &(input_tensors[1][2]));
+    m_ioTensor.copyFromNativeToFloat(m_textEmbeddingFloat.data(), &(output_tensors[0][0]));
+    m_ioTensor.copyFromFloatToNative(m_textEmbeddingFloat.data(), &(input_tensors[1][2]));
     
-    //Generate the embeddings of the timeStep and put it in the corresponding input tensor
-    float timesteps_embeded[1280];
-    datautil::get_timestep_embedding(step, 1280, timesteps_embeded);
+    //Put the preloaded embedding of the timeStep in the corresponding input tensor
+    const float *timesteps_embeded = m_timestepEmbeddings.get(step);
+    if(nullptr == timesteps_embeded){
+      break;
+    }
     m_ioTensor.copyFromFloatToNative(timesteps_embeded, &(input_tensors[1][1]));
 
-    //Make the inference to get the unconditional noise prediction and copy the result in the corresponding buffer
+    //Make the inference to get the unconditional noise prediction and keep it in the scheduler
     m_qnnFunctionPointers.qnnInterface.graphExecute(graphInfo.graph, input_tensors[1], graphInfo.numInputTensors, output_tensors[1], graphInfo.numOutputTensors, m_profileBackendHandle, nullptr);
-    for(size_t i=0; i<length; i++){
-      *(uncond_buff_noisePredict_ptr + i) = *(unet_buff_out_ptr + i);
+    if(datautil::StatusCode::SUCCESS != m_scheduler->storeUncondPrediction(output_tensors[1][0])){
+      break;
     }
 
     //Copy the unconditional text embedded in the output of the text_encoder
@@ -474,39 +487,32 @@ void speech_to_image::QnnSpeechToImage::executeLoop(){
     }
 
     //Copy the output of the text encoder (the conditioned one) in the input of the unet model
-    tmp_buff = nullptr;
-    m_ioTensor.convertToFloat(&tmp_buff, &(output_tensors[0][0]));
-    m_ioTensor.copyFromFloatToNative(tmp_buff, &(input_tensors[1][2]));
+    m_ioTensor.copyFromNativeToFloat(m_textEmbeddingFloat.data(), &(output_tensors[0][0]));
+    m_ioTensor.copyFromFloatToNative(m_textEmbeddingFloat.data(), &(input_tensors[1][2]));
     //Make the inference to get the conditional noise prediction and copy the result in the corresponding buffer
     m_qnnFunctionPointers.qnnInterface.graphExecute(graphInfo.graph, input_tensors[1], graphInfo.numInputTensors, output_tensors[1], graphInfo.numOutputTensors, m_profileBackendHandle, nullptr);
 
-    //TODO: Invoke the scheduller reinterpreting the buffers as the corresponding output data type
-    output = datautil::run_scheduler(output_tensors[1][0],
-                            uncondBuffer_noise_predict,
-                            input_tensors[1][0],
-                            step);
-    
-
-    m_ioTensor.copyFromFloatToNative(output.data(), &(input_tensors[1][0]));
-
+    //Guidance, solver update and requantization of the latent (the first input of the unet model), in place
+    if(datautil::StatusCode::SUCCESS != m_scheduler->step(step, output_tensors[1][0], input_tensors[1][0])){
+      break;
+    }
   }
 
   //Select the graph corresponding to the vae_decoder model for execution
   graphInfo = (*m_graphsInfo)[2];
 
-  m_ioTensor.copyFromFloatToNative(output.data(), &(input_tensors[2][0]));
-
-  float *tmp_buff = nullptr;
-  m_ioTensor.convertToFloat(&tmp_buff, &(input_tensors[2][0]));
-
+  m_ioTensor.copyFromFloatToNative(m_scheduler->latent(), &(input_tensors[2][0]));
 
   m_qnnFunctionPointers.qnnInterface.graphExecute(graphInfo.graph, input_tensors[2], graphInfo.numInputTensors, output_tensors[2], graphInfo.numOutputTensors, m_profileBackendHandle, nullptr);
 
-  tmp_buff = nullptr;
-  m_ioTensor.convertToFloat(&tmp_buff, &(output_tensors[2][0]));
+  float *tmp_buff = nullptr;
+  if(iotensor::StatusCode::SUCCESS != m_ioTensor.convertToFloat(&tmp_buff, &(output_tensors[2][0]))){
+    return;
+  }
   //m_ioTensor.convertAndWriteOutputTensorInFloat(&(output_tensors[2][0]), {assets_path}, "output.raw");
 
   raw_image_to_png(tmp_buff, (assets_path + name_png).c_str());
+  free(tmp_buff);
 }
 
 //runWhisperEncoder
@@ -515,54 +521,21 @@ void speech_to_image::QnnSpeechToImage::runWhisperEncoder(){
     QNN_ERROR("runWhisperEncoder");
     m_qnnFunctionPointers.qnnInterface.graphExecute(graphInfo.graph, input_tensors[models::ENCODER], graphInfo.numInputTensors, output_tensors[models::ENCODER], graphInfo.numOutputTensors, m_profileBackendHandle, nullptr);
 
-    //copying k-cache encoder output in k-cache-cross decoder input
-    float* output_tensor_encoder = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::ENCODER][encoder_output::K_CACHE_CROSS_0]).data);
-    float* input_tensor_decoder  = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::K_CACHE_CROSS_0]).data);
-    for(size_t i=0; i<QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::K_CACHE_CROSS_0]).dataSize / 4; i++){
-        input_tensor_decoder[i] = output_tensor_encoder[i];
-    }
-
-    output_tensor_encoder = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::ENCODER][encoder_output::K_CACHE_CROSS_1]).data);
-    input_tensor_decoder  = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::K_CACHE_CROSS_1]).data);
-    for(size_t i=0; i<QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::K_CACHE_CROSS_1]).dataSize / 4; i++){
-        input_tensor_decoder[i] = output_tensor_encoder[i];
-    }
-
-    output_tensor_encoder = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::ENCODER][encoder_output::K_CACHE_CROSS_2]).data);
-    input_tensor_decoder  = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::K_CACHE_CROSS_2]).data);
-    for(size_t i=0; i<QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::K_CACHE_CROSS_2]).dataSize / 4; i++){
-        input_tensor_decoder[i] = output_tensor_encoder[i];
-    }
-
-    output_tensor_encoder = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::ENCODER][encoder_output::K_CACHE_CROSS_3]).data);
-    input_tensor_decoder  = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::K_CACHE_CROSS_3]).data);
-    for(size_t i=0; i<QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::K_CACHE_CROSS_3]).dataSize / 4; i++){
-        input_tensor_decoder[i] = output_tensor_encoder[i];
-    }
-
-    //copying v-cache encoder output in v-cache-cross decoder input
-    output_tensor_encoder = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::ENCODER][encoder_output::V_CACHE_CROSS_0]).data);
-    input_tensor_decoder = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::V_CACHE_CROSS_0]).data);
-    for(size_t i=0; i<QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::V_CACHE_CROSS_0]).dataSize / 4; i++){
-        input_tensor_decoder[i] = output_tensor_encoder[i];
-    }
-
-    output_tensor_encoder = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::ENCODER][encoder_output::V_CACHE_CROSS_1]).data);
-    input_tensor_decoder = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::V_CACHE_CROSS_1]).data);
-    for(size_t i=0; i<QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::V_CACHE_CROSS_1]).dataSize / 4; i++){
-        input_tensor_decoder[i] = output_tensor_encoder[i];
-    }
-
-    output_tensor_encoder = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::ENCODER][encoder_output::V_CACHE_CROSS_2]).data);
-    input_tensor_decoder = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::V_CACHE_CROSS_2]).data);
-    for(size_t i=0; i<QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::V_CACHE_CROSS_2]).dataSize / 4; i++){
-        input_tensor_decoder[i] = output_tensor_encoder[i];
-    }
-
-    output_tensor_encoder = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::ENCODER][encoder_output::V_CACHE_CROSS_3]).data);
-    input_tensor_decoder = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(input_tensors[models::DECODER][decoder_input::V_CACHE_CROSS_3]).data);
-    for(size_t i=0; i<QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::ENCODER][encoder_output::V_CACHE_CROSS_3]).dataSize / 4; i++){
-        input_tensor_decoder[i] = output_tensor_encoder[i];
+    //Bind the cross-attention caches of the encoder as inputs of the decoder: the client buffers
+    //are swapped instead of copying the caches
+    static const std::pair<int, int> crossCaches[] = {
+        {encoder_output::K_CACHE_CROSS_0, decoder_input::K_CACHE_CROSS_0},
+        {encoder_output::K_CACHE_CROSS_1, decoder_input::K_CACHE_CROSS_1},
+        {encoder_output::K_CACHE_CROSS_2, decoder_input::K_CACHE_CROSS_2},
+        {encoder_output::K_CACHE_CROSS_3, decoder_input::K_CACHE_CROSS_3},
+        {encoder_output::V_CACHE_CROSS_0, decoder_input::V_CACHE_CROSS_0},
+        {encoder_output::V_CACHE_CROSS_1, decoder_input::V_CACHE_CROSS_1},
+        {encoder_output::V_CACHE_CROSS_2, decoder_input::V_CACHE_CROSS_2},
+        {encoder_output::V_CACHE_CROSS_3, decoder_input::V_CACHE_CROSS_3},
+    };
+    for (const auto& cache : crossCaches) {
+        kvcache::handOver(output_tensors[models::ENCODER][cache.first],
+                          input_tensors[models::DECODER][cache.second]);
     }
 }
 
@@ -597,17 +570,6 @@ namespace qnn_utils {
         }
     }
 
-// Zero out a buffer
-    inline void zero_mem(void* dst, size_t bytes) {
-        std::memset(dst, 0, bytes);
-    }
-
-// Copy bytes (size-safe: copy min(dstBytes, srcBytes))
-    inline void copy_bytes(void* dst, size_t dstBytes, const void* src, size_t srcBytes) {
-        const size_t n = std::min(dstBytes, srcBytes);
-        std::memcpy(dst, src, n);
-    }
-
 } // namespace qnn_utils
 
 
@@ -637,59 +599,31 @@ std::string speech_to_image::QnnSpeechToImage::runWhisperDecoder() {
     size_t in_attention_bytes   = QNN_TENSOR_GET_CLIENT_BUF(in_attention_buf).dataSize;
     const bool hasAttention     = true;
 
-    // Self KV caches (IN/OUT)
-    // K self IN
-    void*  k_self_in_ptr [NUM_DECODER_LAYERS];
-    size_t k_self_in_bytes[NUM_DECODER_LAYERS];
-    k_self_in_ptr [0] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::K_CACHE_SELF_0]).data;
-    k_self_in_bytes[0] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::K_CACHE_SELF_0]).dataSize;
-    k_self_in_ptr [1] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::K_CACHE_SELF_1]).data;
-    k_self_in_bytes[1] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::K_CACHE_SELF_1]).dataSize;
-    k_self_in_ptr [2] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::K_CACHE_SELF_2]).data;
-    k_self_in_bytes[2] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::K_CACHE_SELF_2]).dataSize;
-    k_self_in_ptr [3] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::K_CACHE_SELF_3]).data;
-    k_self_in_bytes[3] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::K_CACHE_SELF_3]).dataSize;
-
-    // V self IN
-    void*  v_self_in_ptr [NUM_DECODER_LAYERS];
-    size_t v_self_in_bytes[NUM_DECODER_LAYERS];
-    v_self_in_ptr [0] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::V_CACHE_SELF_0]).data;
-    v_self_in_bytes[0] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::V_CACHE_SELF_0]).dataSize;
-    v_self_in_ptr [1] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::V_CACHE_SELF_1]).data;
-    v_self_in_bytes[1] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::V_CACHE_SELF_1]).dataSize;
-    v_self_in_ptr [2] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::V_CACHE_SELF_2]).data;
-    v_self_in_bytes[2] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::V_CACHE_SELF_2]).dataSize;
-    v_self_in_ptr [3] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::V_CACHE_SELF_3]).data;
-    v_self_in_bytes[3] = QNN_TENSOR_GET_CLIENT_BUF(input_tensors [models::DECODER][decoder_input ::V_CACHE_SELF_3]).dataSize;
+    // Self KV caches, double buffered between the IN and OUT tensors of every layer
+    static const std::pair<int, int> selfCaches[] = {
+        {decoder_input::K_CACHE_SELF_0, decoder_output::K_CACHE_SELF_0},
+        {decoder_input::V_CACHE_SELF_0, decoder_output::V_CACHE_SELF_0},
+        {decoder_input::K_CACHE_SELF_1, decoder_output::K_CACHE_SELF_1},
+        {decoder_input::V_CACHE_SELF_1, decoder_output::V_CACHE_SELF_1},
+        {decoder_input::K_CACHE_SELF_2, decoder_output::K_CACHE_SELF_2},
+        {decoder_input::V_CACHE_SELF_2, decoder_output::V_CACHE_SELF_2},
+        {decoder_input::K_CACHE_SELF_3, decoder_output::K_CACHE_SELF_3},
+        {decoder_input::V_CACHE_SELF_3, decoder_output::V_CACHE_SELF_3},
+    };
+    static_assert(sizeof(selfCaches) / sizeof(selfCaches[0]) == 2 * NUM_DECODER_LAYERS,
+                  "one K and one V cache per decoder layer");
+    kvcache::PingPong selfKvCache;
+    for (const auto& cache : selfCaches) {
+        selfKvCache.bind(&input_tensors[models::DECODER][cache.first],
+                         &output_tensors[models::DECODER][cache.second]);
+    }
+    if (selfKvCache.numSwapped() != 2 * NUM_DECODER_LAYERS) {
+        QNN_WARN("%zu of %d self KV caches have different IN/OUT tensors and are copied",
+                 2 * NUM_DECODER_LAYERS - selfKvCache.numSwapped(), 2 * NUM_DECODER_LAYERS);
+    }
 
     // Outputs
     auto& out_logits_buf   = output_tensors[models::DECODER][decoder_output::LOGITS];
-    const void* out_logits_ptr   = QNN_TENSOR_GET_CLIENT_BUF(out_logits_buf).data;
-    size_t      out_logits_bytes = QNN_TENSOR_GET_CLIENT_BUF(out_logits_buf).dataSize;
-
-    // K self OUT
-    const void* k_self_out_ptr [NUM_DECODER_LAYERS];
-    size_t      k_self_out_bytes[NUM_DECODER_LAYERS];
-    k_self_out_ptr [0] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::K_CACHE_SELF_0]).data;
-    k_self_out_bytes[0] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::K_CACHE_SELF_0]).dataSize;
-    k_self_out_ptr [1] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::K_CACHE_SELF_1]).data;
-    k_self_out_bytes[1] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::K_CACHE_SELF_1]).dataSize;
-    k_self_out_ptr [2] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::K_CACHE_SELF_2]).data;
-    k_self_out_bytes[2] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::K_CACHE_SELF_2]).dataSize;
-    k_self_out_ptr [3] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::K_CACHE_SELF_3]).data;
-    k_self_out_bytes[3] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::K_CACHE_SELF_3]).dataSize;
-
-    // V self OUT
-    const void* v_self_out_ptr [NUM_DECODER_LAYERS];
-    size_t      v_self_out_bytes[NUM_DECODER_LAYERS];
-    v_self_out_ptr [0] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::V_CACHE_SELF_0]).data;
-    v_self_out_bytes[0] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::V_CACHE_SELF_0]).dataSize;
-    v_self_out_ptr [1] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::V_CACHE_SELF_1]).data;
-    v_self_out_bytes[1] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::V_CACHE_SELF_1]).dataSize;
-    v_self_out_ptr [2] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::V_CACHE_SELF_2]).data;
-    v_self_out_bytes[2] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::V_CACHE_SELF_2]).dataSize;
-    v_self_out_ptr [3] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::V_CACHE_SELF_3]).data;
-    v_self_out_bytes[3] = QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::V_CACHE_SELF_3]).dataSize;
 
     // ---------------- Initial tokens & state ----------------
     {
@@ -707,10 +641,7 @@ std::string speech_to_image::QnnSpeechToImage::runWhisperDecoder() {
     }
 
     // Zero‑init self‑attention caches on first step
-    for (int L = 0; L < NUM_DECODER_LAYERS; ++L) {
-        qnn_utils::zero_mem(k_self_in_ptr[L], k_self_in_bytes[L]);
-        qnn_utils::zero_mem(v_self_in_ptr[L], v_self_in_bytes[L]);
-    }
+    selfKvCache.zeroInputs();
 
     std::string result;
 
@@ -723,21 +654,11 @@ std::string speech_to_image::QnnSpeechToImage::runWhisperDecoder() {
                 output_tensors[models::DECODER], graphInfo.numOutputTensors,
                 m_profileBackendHandle, nullptr);
 
-        // Re-read output pointers (some runtimes rewrite client buffers)
-        out_logits_ptr   = QNN_TENSOR_GET_CLIENT_BUF(out_logits_buf).data;
-        out_logits_bytes = QNN_TENSOR_GET_CLIENT_BUF(out_logits_buf).dataSize;
-
         // Calculating max logits index to get the token with higher probability
-        float* pointerToBuffer = reinterpret_cast<float*>(QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::LOGITS]).data);
-        float max = std::numeric_limits<float>::lowest();
-        size_t max_index = 0;
-
-        for(size_t i = 0; i < QNN_TENSOR_GET_CLIENT_BUF(output_tensors[models::DECODER][decoder_output::LOGITS]).dataSize / 4; i++){
-            if(pointerToBuffer[i] > max){
-                max = pointerToBuffer[i];
-                max_index = i;
-            }
-        }
+        // (output pointers are re-read, some runtimes rewrite client buffers)
+        const Qnn_ClientBuffer_t logits = QNN_TENSOR_GET_CLIENT_BUF(out_logits_buf);
+        const size_t max_index = datautil::argmax(reinterpret_cast<const float*>(logits.data),
+                                                  qnn_utils::num_elems(logits.dataSize, sizeof(float)));
 
         result += std::to_string(max_index);
         // EOS → stop
@@ -763,11 +684,8 @@ std::string speech_to_image::QnnSpeechToImage::runWhisperDecoder() {
             auto* input_ids_scalar = reinterpret_cast<int32_t*>(in_input_ids_ptr);
         }
 
-        // 3) Self KV cache hand‑off: *_OUT → *_IN for every layer
-        for (int L = 0; L < NUM_DECODER_LAYERS; ++L) {
-            qnn_utils::copy_bytes(k_self_in_ptr[L], k_self_in_bytes[L], k_self_out_ptr[L], k_self_out_bytes[L]);
-            qnn_utils::copy_bytes(v_self_in_ptr[L], v_self_in_bytes[L], v_self_out_ptr[L], v_self_out_bytes[L]);
-        }
+        // 3) Self KV cache hand‑off: *_OUT → *_IN for every layer, by swapping the buffers
+        selfKvCache.handOff();
 
         // 4) Attention mask progression (if present)
         if (hasAttention) {
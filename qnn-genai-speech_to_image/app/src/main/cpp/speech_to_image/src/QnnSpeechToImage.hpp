@@ -9,6 +9,7 @@
 #include <queue>
 #include <random>
 
+#include "DataUtil.hpp"
 #include "IOTensor.hpp"
 #include "SpeechToImageApp.hpp"
 
@@ -103,7 +104,10 @@ class QnnSpeechToImage {
 
   Qnn_ClientBuffer_t uncondBuffer_text_enc;
   Qnn_ClientBuffer_t condBuffer_text_enc;
-  Qnn_ClientBuffer_t uncondBuffer_noise_predict;
+
+  std::unique_ptr<datautil::DpmSolverScheduler> m_scheduler;
+  datautil::TimestepEmbeddings m_timestepEmbeddings;
+  std::vector<float> m_textEmbeddingFloat;
 
 };
 }  // namespace speech_to_image
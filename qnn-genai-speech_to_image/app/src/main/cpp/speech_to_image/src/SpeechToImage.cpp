@@ -20,6 +20,7 @@
 #include "DataUtil.hpp"
 #include "AndroidLogger.hpp"
 #include "SpeechToImage.hpp"
+#include "preprocess.hpp"
 
 static void* sg_backendHandle{nullptr};
 std::string assets_path;
@@ -48,6 +49,16 @@ std::string run_whisper(std::string path){
   return app->runWhisperDecoder();
 }
 
+// the recording at path is streamed into the log-mel spectrogram while it's being captured,
+// so run_whisper(path) can start the encoder right away
+void begin_whisper_stream(std::string path){
+  log_mel_stream_begin(path, cache_path);
+}
+
+void push_whisper_audio(const int16_t* samples, size_t n_samples){
+  log_mel_stream_push(samples, n_samples);
+}
+
 int free_app(){
   if (speech_to_image::StatusCode::SUCCESS != app->freeContext()) {
     return app->reportError("Context Free failure");
@@ -5,6 +5,8 @@
 
 #ifndef SPEECH_TO_IMAGE_HPP
 #define SPEECH_TO_IMAGE_HPP
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 extern std::vector<int32_t> tokensId;
@@ -16,6 +18,8 @@ char* tokenize(char* text, char* tokenizer_path);
 int initialize(std::string);
 void run_stable_diffusion(std::vector<int32_t>, std::string);
 std::string run_whisper(std::string path);
+void begin_whisper_stream(std::string path);
+void push_whisper_audio(const int16_t* samples, size_t n_samples);
 int free_app();
 
 #endif //SPEECH_TO_IMAGE_HPP
@@ -21,6 +21,11 @@
 #include <map>
 #include <fstream>
 #include <limits>
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #include "DataUtil.hpp"
 #include "Logger.hpp"
@@ -36,34 +41,10 @@
 using namespace qnn;
 using namespace qnn::tools;
 
-//double num_train_timesteps = 1000;
-//double beta_start = 0.00085;
-//double beta_end = 0.012;
-//double user_text_guidance = 7.5;
-
-std::string timestep_spacing = "linspace";
-std::string solver_type = "midpoint";
-std::string beta_schedule = "scaled_linear";
-std::string algorithm_type = "dpmsolver++";
-std::int32_t solver_order = 2;
-std::float_t beta_start = 0.00085;
-std::float_t beta_end = 0.012;
-std::int32_t num_train_timesteps = 1000;
-std::vector<float> betas;
-std::vector<float> alphas;
-std::vector<float> alphas_cumprod;
-std::vector<float> alpha_t;
-std::vector<float> sigma_t;
-std::vector<float> lambda_t;
-std::float_t init_noise_sigma = 1.0;
-std::vector<int> timesteps;
-std::int32_t num_inference_steps = 20;
-std::vector<float> sigmas;
-std::int32_t lower_order_nums = 0;
-std::float_t dynamic_thresholding_ratio = 0.995;
-std::float_t sample_max_value = 1.0;
-std::vector<std::vector<float>> model_outputs(2);
-int modelSize = 16384;
+static const float beta_start = 0.00085;
+static const float beta_end = 0.012;
+static const int32_t num_train_timesteps = 1000;
+static const int32_t solver_order = 2;
 
 extern std::string assets_path;
 
@@ -78,78 +59,6 @@ T clamp(const T& value, const T& min_val, const T& max_val) {
     }
 }
 
-std::vector<float> dpm_solver_first_order_update(std::vector<float> x0_pred, int prev_timestep, int timestep, std::vector<float> sample){
-        float lambda_t_here = lambda_t[prev_timestep];
-        float lambda_s = lambda_t[timestep];
-        float alpha_t_here = alpha_t[prev_timestep];
-        //float alpha_s = alpha_t[timestep];
-        float sigma_t_here = sigma_t[prev_timestep];
-        float sigma_s = sigma_t[timestep];
-        float h = lambda_t_here - lambda_s;
-        std::vector<float> x_t(sample.size());
-        for (size_t i = 0; i < sample.size(); ++i) {
-          x_t[i] = (sigma_t_here / sigma_s) * sample[i]
-                - (alpha_t_here * (std::exp(-h) - 1.0f)) * x0_pred[i];
-          
-        }
-        return x_t;
-}
-
-// Function to compute the sample tensor at the previous timestep
-std::vector<float> multistep_dpm_solver_second_order_update(
-    int prev_timestep,
-    const std::vector<int>& timestep_list,
-    std::vector<float> sample
-) {
-    std::vector<float> noise = {};
-    int t = prev_timestep;
-    int s0 = timestep_list.back();
-    int s1 = timestep_list[timestep_list.size() - 2];
-    std::vector<float> m0 = model_outputs.back();
-    std::vector<float> m1 = model_outputs[model_outputs.size() - 2];
-    float lambda_t_here = lambda_t[t];
-    float lambda_s0 = lambda_t[s0];
-    float lambda_s1 = lambda_t[s1];
-    float alpha_t_here = alpha_t[t];
-    float sigma_t_here = sigma_t[t];
-    float sigma_s0 = sigma_t[s0];
-    float h = lambda_t_here - lambda_s0;
-    float h_0 = lambda_s0 - lambda_s1;
-    float r0 = h_0 / h;
-    
-    if(m0.size() == 0){
-      for(size_t i=0; i< m1.size(); i++){
-        m0.push_back(0);
-      }
-    }
-
-    if(m1.size() == 0){
-      for(size_t i=0; i< m0.size(); i++){
-        m1.push_back(0);
-      }
-    }
-
-    std::vector<float> D0 = m0;
-    std::vector<float> D1(m0.size());
-    for (size_t i = 0; i < m0.size(); ++i) {
-        D1[i] = (1.0f / r0) * (m0[i] - m1[i]);
-    }
-    std::vector<float> x_t(sample.size());
-    for (size_t i = 0; i < sample.size(); ++i) {
-            x_t[i] = (sigma_t_here / sigma_s0) * sample[i]
-                - (alpha_t_here * (std::exp(-h) - 1.0f)) * D0[i]
-                - 0.5f * (alpha_t_here * (std::exp(-h) - 1.0f)) * D1[i];
-    }
-    return x_t;
-}
-
-
-// Function to find the index where lambda_min_clipped would be inserted
-int searchsorted(std::vector<float>& lambda_t) {
-    auto it = std::lower_bound(lambda_t.begin(), lambda_t.end(), -1*std::numeric_limits<float>::infinity());
-    return std::distance(lambda_t.begin(), it);
-}
-
 std::vector<float> compute_cumulative_product(const std::vector<float>& alphas) {
     std::vector<float> alphas_cumprod;
     float cumulative_product = 1.0;
@@ -181,114 +90,188 @@ std::vector<float> compute_betas() {
     return result;
 }
 
-void  datautil::initialize_scheduler(){
-
-    for(int i=0; i<modelSize; i++){
-      model_outputs[0].push_back(0);
-      model_outputs[1].push_back(0);
-    }
-
-    betas = compute_betas();
-    for(auto value:betas){
+datautil::DpmSolverScheduler::DpmSolverScheduler(size_t latentSize, float guidanceScale)
+    : m_guidanceScale(guidanceScale),
+      m_uncondPrediction(latentSize),
+      m_latent(latentSize),
+      m_prevX0(latentSize) {
+    std::vector<float> alphas;
+    for (auto value : compute_betas()) {
         alphas.push_back(1.0 - value);
     }
-    alphas_cumprod = compute_cumulative_product(alphas);
-    for (float alpha_cumprod : alphas_cumprod) {
+    for (float alpha_cumprod : compute_cumulative_product(alphas)) {
         float alpha = std::sqrt(alpha_cumprod);
         float sigma = std::sqrt(1.0f - alpha_cumprod);
-        float lambda = std::log(alpha) - std::log(sigma);
+        m_alphaT.push_back(alpha);
+        m_sigmaT.push_back(sigma);
+        m_lambdaT.push_back(std::log(alpha) - std::log(sigma));
+    }
+
+    // linspace over the 1000 train timesteps, 20 inference steps
+    m_timesteps = {999, 949, 899, 849, 799, 749, 699, 649, 599, 549,
+                   500, 450, 400, 350, 300, 250, 200, 150, 100, 50};
+}
+
+void datautil::DpmSolverScheduler::reset() {
+    m_lowerOrderNums = 0;
+    std::fill(m_prevX0.begin(), m_prevX0.end(), 0.0f);
+}
 
-        alpha_t.push_back(alpha);
-        sigma_t.push_back(sigma);
-        lambda_t.push_back(lambda);
+datautil::StatusCode datautil::DpmSolverScheduler::checkTensor(const Qnn_Tensor_t& tensor) const {
+    if (QNN_TENSOR_GET_DATA_TYPE(tensor) != QNN_DATATYPE_UFIXED_POINT_16) {
+        QNN_ERROR("DpmSolverScheduler: expected a UFIXED_POINT_16 tensor, got data type %d",
+                  (int)QNN_TENSOR_GET_DATA_TYPE(tensor));
+        return StatusCode::INVALID_DATA_TYPE;
     }
-    
-    for (float alpha_cumprod : alphas_cumprod) {
-        float sigma = std::sqrt((1.0f - alpha_cumprod) / alpha_cumprod);
-        sigmas.push_back(sigma);
+    if (QNN_TENSOR_GET_CLIENT_BUF(tensor).dataSize != m_latent.size() * sizeof(uint16_t)) {
+        QNN_ERROR("DpmSolverScheduler: expected %zu elements, got %u",
+                  m_latent.size(), QNN_TENSOR_GET_CLIENT_BUF(tensor).dataSize / 2);
+        return StatusCode::DATA_SIZE_MISMATCH;
     }
-    
-    timesteps.clear();
-    timesteps.push_back(999);
-    timesteps.push_back(949);
-    timesteps.push_back(899);
-    timesteps.push_back(849);
-    timesteps.push_back(799);
-    timesteps.push_back(749);
-    timesteps.push_back(699);
-    timesteps.push_back(649);
-    timesteps.push_back(599);
-    timesteps.push_back(549);
-    timesteps.push_back(500);
-    timesteps.push_back(450);
-    timesteps.push_back(400);
-    timesteps.push_back(350);
-    timesteps.push_back(300);
-    timesteps.push_back(250);
-    timesteps.push_back(200);
-    timesteps.push_back(150);
-    timesteps.push_back(100);
-    timesteps.push_back(50);
-}
-
-std::vector<float>  datautil::step(int step, std::vector<float> sample, std::vector<float> model_output){
-  int step_index = step;
-  step = timesteps[step];
-
-
-  std::vector<float> return_vector;
-  int prev_timestep = (step_index == (int)timesteps.size() - 1) ? 0 : timesteps[step_index + 1];
-
-  bool lower_order_final = (step_index == (int)timesteps.size() - 1) &&
-                               true && (int)timesteps.size() < 15;
-
-  float alpha_t_here = alpha_t[step];
-  float sigma_t_here = sigma_t[step];
-
-
-  std::vector<float> x0_pred(sample.size());
-  for (size_t i = 0; i < sample.size(); ++i) {
-      x0_pred[i] = (sample[i] - sigma_t_here * model_output[i]) / alpha_t_here;
-      
-  }
-  for (int i = 0; i < solver_order - 1; ++i) {
-    for(size_t j = 0; j < sample.size(); ++j){
-      model_outputs[i][j] = model_outputs[i + 1][j];
+    return StatusCode::SUCCESS;
+}
+
+datautil::StatusCode datautil::DpmSolverScheduler::storeUncondPrediction(const Qnn_Tensor_t& noisePred) {
+    StatusCode status = checkTensor(noisePred);
+    if (StatusCode::SUCCESS != status) {
+        return status;
     }
-      
-  }
-  for(size_t j = 0; j < sample.size(); ++j){
-    model_outputs[solver_order - 1][j] = x0_pred[j];
-  }
+    memcpy(m_uncondPrediction.data(), QNN_TENSOR_GET_CLIENT_BUF(noisePred).data,
+           m_uncondPrediction.size() * sizeof(uint16_t));
+    return StatusCode::SUCCESS;
+}
 
-  if(lower_order_nums < 1 || lower_order_final){
-    return_vector = dpm_solver_first_order_update(x0_pred, prev_timestep, step, sample);
-  }else{
-    std::vector<int> timestep_list = {timesteps[step_index - 1], step};
-    return_vector = multistep_dpm_solver_second_order_update(prev_timestep, timestep_list, sample);
-  }
+datautil::StatusCode datautil::DpmSolverScheduler::step(size_t step,
+                                                        const Qnn_Tensor_t& noisePredCond,
+                                                        Qnn_Tensor_t& latent) {
+    StatusCode status = checkTensor(noisePredCond);
+    if (StatusCode::SUCCESS == status) {
+        status = checkTensor(latent);
+    }
+    if (StatusCode::SUCCESS != status) {
+        return status;
+    }
+    if (step >= m_timesteps.size()) {
+        QNN_ERROR("DpmSolverScheduler: step %zu out of range", step);
+        return StatusCode::INVALID_DIMENSIONS;
+    }
 
-  if(lower_order_nums < solver_order){
-      lower_order_nums += 1;
-  }
-  return return_vector;
-}
- 
-void datautil::get_timestep_embedding(int timestep, int embedding_dim, float timesteps_embeded[]) {
+    const int32_t t = m_timesteps[step];
+    const int32_t prev_t = (step == m_timesteps.size() - 1) ? 0 : m_timesteps[step + 1];
+    const bool lower_order_final = (step == m_timesteps.size() - 1) && m_timesteps.size() < 15;
+    const bool first_order = m_lowerOrderNums < 1 || lower_order_final;
+
+    // x0 = (sample - sigma_s * noise) / alpha_s
+    const float sigma_s = m_sigmaT[t];
+    const float inv_alpha_s = 1.0f / m_alphaT[t];
+
+    // first order:  x_t = a * sample - b * x0
+    // second order: x_t = a * sample - b * D0 - 0.5 * b * D1, D0 = x0, D1 = (x0 - prev_x0) / r0
+    //                   = a * sample - (b + c) * x0 + c * prev_x0, c = 0.5 * b / r0
+    const float h = m_lambdaT[prev_t] - m_lambdaT[t];
+    const float a = m_sigmaT[prev_t] / sigma_s;
+    const float b = m_alphaT[prev_t] * (std::exp(-h) - 1.0f);
+    float c = 0.0f;
+    if (!first_order) {
+        const int32_t s1 = m_timesteps[step - 1];
+        const float r0 = (m_lambdaT[t] - m_lambdaT[s1]) / h;
+        c = 0.5f * b / r0;
+    }
+    const float x0_coeff = -(b + c);
+
+    // noise = uncond + g * (cond - uncond), both with the encoding of the UNet output
+    const Qnn_ScaleOffset_t noise_enc = QNN_TENSOR_GET_QUANT_PARAMS(noisePredCond).scaleOffsetEncoding;
+    const Qnn_ScaleOffset_t latent_enc = QNN_TENSOR_GET_QUANT_PARAMS(latent).scaleOffsetEncoding;
+    const float noise_offset = (float)noise_enc.offset;
+    const float latent_offset = (float)latent_enc.offset;
+    const float latent_inv_scale = 1.0f / latent_enc.scale;
+    const float g = m_guidanceScale;
+
+    const uint16_t* cond = static_cast<const uint16_t*>(QNN_TENSOR_GET_CLIENT_BUF(noisePredCond).data);
+    const uint16_t* uncond = m_uncondPrediction.data();
+    uint16_t* latent_q = static_cast<uint16_t*>(QNN_TENSOR_GET_CLIENT_BUF(latent).data);
+    float* latent_f = m_latent.data();
+    float* prev_x0 = m_prevX0.data();
+    const size_t count = m_latent.size();
+
+    size_t i = 0;
+#if defined(__aarch64__)
+    const float32x4_t v_noise_offset = vdupq_n_f32(noise_offset);
+    const float32x4_t v_noise_scale = vdupq_n_f32(noise_enc.scale);
+    const float32x4_t v_latent_offset = vdupq_n_f32(latent_offset);
+    const float32x4_t v_latent_scale = vdupq_n_f32(latent_enc.scale);
+    const float32x4_t v_latent_inv_scale = vdupq_n_f32(latent_inv_scale);
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t u = vmulq_f32(
+            vaddq_f32(vcvtq_f32_u32(vmovl_u16(vld1_u16(uncond + i))), v_noise_offset), v_noise_scale);
+        const float32x4_t cd = vmulq_f32(
+            vaddq_f32(vcvtq_f32_u32(vmovl_u16(vld1_u16(cond + i))), v_noise_offset), v_noise_scale);
+        const float32x4_t noise = vaddq_f32(u, vmulq_n_f32(vsubq_f32(cd, u), g));
+        const float32x4_t sample = vmulq_f32(
+            vaddq_f32(vcvtq_f32_u32(vmovl_u16(vld1_u16(latent_q + i))), v_latent_offset), v_latent_scale);
+        const float32x4_t x0 = vmulq_n_f32(vsubq_f32(sample, vmulq_n_f32(noise, sigma_s)), inv_alpha_s);
+        const float32x4_t prev = vld1q_f32(prev_x0 + i);
+        const float32x4_t x_t = vaddq_f32(vaddq_f32(vmulq_n_f32(sample, a), vmulq_n_f32(x0, x0_coeff)),
+                                          vmulq_n_f32(prev, c));
+        vst1q_f32(prev_x0 + i, x0);
+        vst1q_f32(latent_f + i, x_t);
+        // round half away from zero like round(), vqmovun saturates to [0, 65535]
+        const int32x4_t q = vcvtaq_s32_f32(vsubq_f32(vmulq_f32(x_t, v_latent_inv_scale), v_latent_offset));
+        vst1_u16(latent_q + i, vqmovun_s32(q));
+    }
+#endif
+    for (; i < count; i++) {
+        const float u = ((float)uncond[i] + noise_offset) * noise_enc.scale;
+        const float cd = ((float)cond[i] + noise_offset) * noise_enc.scale;
+        const float noise = u + ((cd - u) * g);
+        const float sample = ((float)latent_q[i] + latent_offset) * latent_enc.scale;
+        const float x0 = (sample - (noise * sigma_s)) * inv_alpha_s;
+        const float x_t = (sample * a) + (x0 * x0_coeff) + (prev_x0[i] * c);
+        prev_x0[i] = x0;
+        latent_f[i] = x_t;
+        const float q = std::round((x_t * latent_inv_scale) - latent_offset);
+        latent_q[i] = (uint16_t)clamp(q, 0.0f, 65535.0f);
+    }
 
-    uint64_t bufferSize;
-    uint8_t *buffer= nullptr;
-    tools::datautil::StatusCode status{tools::datautil::StatusCode::SUCCESS};
-    std::string path = assets_path + "t_emb_" + std::to_string(timestep) + ".raw";
-    std::tie(status, bufferSize) = tools::datautil::getFileSize(path);
-    buffer = new uint8_t[bufferSize];
-    status = tools::datautil::readBinaryFromFile(path, buffer, bufferSize);
+    if (m_lowerOrderNums < solver_order) {
+        m_lowerOrderNums += 1;
+    }
+    return StatusCode::SUCCESS;
+}
 
-    float *ptr = reinterpret_cast<float*>(buffer);
-    
-    for(int i = 0; i < embedding_dim; ++i){
-      timesteps_embeded[i] = *(ptr + i);
+datautil::StatusCode datautil::TimestepEmbeddings::load(const std::string& dirPath,
+                                                       size_t numSteps,
+                                                       size_t embeddingDim) {
+  const size_t embeddingBytes = embeddingDim * sizeof(float);
+  std::vector<float> data(numSteps * embeddingDim);
+  for (size_t step = 0; step < numSteps; ++step) {
+    std::string path = dirPath + "t_emb_" + std::to_string(step) + ".raw";
+    StatusCode status{StatusCode::SUCCESS};
+    size_t fileSize{0};
+    std::tie(status, fileSize) = getFileSize(path);
+    if (StatusCode::SUCCESS != status) {
+      return status;
+    }
+    if (fileSize != embeddingBytes) {
+      QNN_ERROR("Timestep embedding %s has %zu bytes, expected %zu", path.c_str(), fileSize, embeddingBytes);
+      return StatusCode::DATA_SIZE_MISMATCH;
+    }
+    status = readBinaryFromFile(path, reinterpret_cast<uint8_t*>(data.data() + step * embeddingDim), embeddingBytes);
+    if (StatusCode::SUCCESS != status) {
+      return status;
     }
+  }
+  m_numSteps     = numSteps;
+  m_embeddingDim = embeddingDim;
+  m_data.swap(data);
+  return StatusCode::SUCCESS;
+}
+
+const float* datautil::TimestepEmbeddings::get(size_t step) const {
+  if (step >= m_numSteps) {
+    return nullptr;
+  }
+  return m_data.data() + step * m_embeddingDim;
 }
 
 void fillDims(std::vector<size_t>& dims,
@@ -302,49 +285,6 @@ void fillDims(std::vector<size_t>& dims,
   }
 }
 
-std::vector<float> datautil::run_scheduler(Qnn_Tensor_t noise_pred_cond,
-              Qnn_ClientBuffer_t noise_pred_uncond,
-              Qnn_Tensor_t latent_in,
-              int timestep){
-
-  int lenght = QNN_TENSOR_GET_CLIENT_BUF(latent_in).dataSize/2;
-  std::vector<float> tmp_buf_noise(lenght);
-  std::vector<float> tmp_buf_noise_cond(lenght);
-  std::vector<float> tmp_buf_noise_uncond(lenght);
-  std::vector<float> tmp_buf_latent_in(lenght);
-
-      
-  datautil::tfNToFloat<uint16_t>(
-              tmp_buf_noise_cond.data(),
-              reinterpret_cast<uint16_t*>(QNN_TENSOR_GET_CLIENT_BUF(noise_pred_cond).data),
-              QNN_TENSOR_GET_QUANT_PARAMS(noise_pred_cond).scaleOffsetEncoding.offset,
-              QNN_TENSOR_GET_QUANT_PARAMS(noise_pred_cond).scaleOffsetEncoding.scale,
-             QNN_TENSOR_GET_CLIENT_BUF(noise_pred_cond).dataSize/2);
-
-  datautil::tfNToFloat<uint16_t>(
-              tmp_buf_noise_uncond.data(),
-              reinterpret_cast<uint16_t*>(noise_pred_uncond.data),
-              QNN_TENSOR_GET_QUANT_PARAMS(noise_pred_cond).scaleOffsetEncoding.offset,
-              QNN_TENSOR_GET_QUANT_PARAMS(noise_pred_cond).scaleOffsetEncoding.scale,
-              QNN_TENSOR_GET_CLIENT_BUF(noise_pred_cond).dataSize/2);
-
-  
-  datautil::tfNToFloat<uint16_t>(
-              tmp_buf_latent_in.data(),
-              reinterpret_cast<uint16_t*>(QNN_TENSOR_GET_CLIENT_BUF(latent_in).data),
-              QNN_TENSOR_GET_QUANT_PARAMS(latent_in).scaleOffsetEncoding.offset,
-              QNN_TENSOR_GET_QUANT_PARAMS(latent_in).scaleOffsetEncoding.scale,
-              QNN_TENSOR_GET_CLIENT_BUF(latent_in).dataSize/2);
-
-  //noise_pred_uncond + user_text_guidance * (noise_pred_text - noise_pred_uncond)
-  for(size_t i=0; i<QNN_TENSOR_GET_CLIENT_BUF(latent_in).dataSize/2; i++){
-    tmp_buf_noise[i] = tmp_buf_noise_uncond[i] +  7.5*(tmp_buf_noise_cond[i] - tmp_buf_noise_uncond[i]);
-  }
-
-  return step(timestep, std::vector<float>(tmp_buf_latent_in), std::vector<float>(tmp_buf_noise));
-  
-}
-
 std::string LoadBytesFromFile(const std::string& path) {
   std::ifstream fs(path, std::ios::in | std::ios::binary);
   if (fs.fail()) {
@@ -385,6 +325,38 @@ void datautil::generateNormalNumber(float mean, float stddev, int size, float *
   }
 }
 
+size_t datautil::argmax(const float* values, size_t numElements) {
+  // First pass finds the largest value, vectorized, the second one its first position
+  float maxValue = std::numeric_limits<float>::lowest();
+  size_t i = 0;
+#if defined(__aarch64__)
+  if (numElements >= 16) {
+    float32x4_t max0 = vdupq_n_f32(maxValue);
+    float32x4_t max1 = max0;
+    float32x4_t max2 = max0;
+    float32x4_t max3 = max0;
+    for (; i + 16 <= numElements; i += 16) {
+      max0 = vmaxnmq_f32(max0, vld1q_f32(values + i));
+      max1 = vmaxnmq_f32(max1, vld1q_f32(values + i + 4));
+      max2 = vmaxnmq_f32(max2, vld1q_f32(values + i + 8));
+      max3 = vmaxnmq_f32(max3, vld1q_f32(values + i + 12));
+    }
+    maxValue = vmaxnmvq_f32(vmaxnmq_f32(vmaxnmq_f32(max0, max1), vmaxnmq_f32(max2, max3)));
+  }
+#endif
+  for (; i < numElements; ++i) {
+    if (values[i] > maxValue) {
+      maxValue = values[i];
+    }
+  }
+  for (i = 0; i < numElements; ++i) {
+    if (values[i] == maxValue) {
+      return i;
+    }
+  }
+  return 0;
+}
+
 std::tuple<datautil::StatusCode, size_t> datautil::getDataTypeSizeInBytes(Qnn_DataType_t dataType) {
   if (g_dataTypeToSize.find(dataType) == g_dataTypeToSize.end()) {
     QNN_ERROR("Invalid qnn data type provided");
@@ -535,66 +507,157 @@ datautil::StatusCode datautil::writeBinaryToFile(std::string fileDir,
   return StatusCode::SUCCESS;
 }
 
+#if defined(__aarch64__)
+// Narrow 8 rounded int32 values to the quantized type, saturating
 template <typename T_QuantType>
-datautil::StatusCode datautil::floatToTfN(
-    T_QuantType* out, float* in, int32_t offset, float scale, size_t numElements) {
-  static_assert(std::is_unsigned<T_QuantType>::value, "floatToTfN supports unsigned only!");
+static inline void storeSaturated8(T_QuantType* out, int32x4_t lo, int32x4_t hi);
+
+template <>
+inline void storeSaturated8<uint8_t>(uint8_t* out, int32x4_t lo, int32x4_t hi) {
+  vst1_u8(out, vqmovn_u16(vcombine_u16(vqmovun_s32(lo), vqmovun_s32(hi))));
+}
+
+template <>
+inline void storeSaturated8<uint16_t>(uint16_t* out, int32x4_t lo, int32x4_t hi) {
+  vst1q_u16(out, vcombine_u16(vqmovun_s32(lo), vqmovun_s32(hi)));
+}
+
+template <>
+inline void storeSaturated8<int8_t>(int8_t* out, int32x4_t lo, int32x4_t hi) {
+  vst1_s8(out, vqmovn_s16(vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi))));
+}
 
+template <>
+inline void storeSaturated8<int16_t>(int16_t* out, int32x4_t lo, int32x4_t hi) {
+  vst1q_s16(out, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+}
+
+// Widen 8 quantized values to int32
+template <typename T_QuantType>
+static inline void load8(const T_QuantType* in, int32x4_t& lo, int32x4_t& hi);
+
+template <>
+inline void load8<uint8_t>(const uint8_t* in, int32x4_t& lo, int32x4_t& hi) {
+  const uint16x8_t v = vmovl_u8(vld1_u8(in));
+  lo = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v)));
+  hi = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(v)));
+}
+
+template <>
+inline void load8<uint16_t>(const uint16_t* in, int32x4_t& lo, int32x4_t& hi) {
+  const uint16x8_t v = vld1q_u16(in);
+  lo = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(v)));
+  hi = vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(v)));
+}
+
+template <>
+inline void load8<int8_t>(const int8_t* in, int32x4_t& lo, int32x4_t& hi) {
+  const int16x8_t v = vmovl_s8(vld1_s8(in));
+  lo = vmovl_s16(vget_low_s16(v));
+  hi = vmovl_s16(vget_high_s16(v));
+}
+
+template <>
+inline void load8<int16_t>(const int16_t* in, int32x4_t& lo, int32x4_t& hi) {
+  const int16x8_t v = vld1q_s16(in);
+  lo = vmovl_s16(vget_low_s16(v));
+  hi = vmovl_s16(vget_high_s16(v));
+}
+#endif
+
+// Quantization to the scale/offset encoding of QNN: q = round(x / scale - offset), rounding
+// half away from zero and saturating to the range of the type. The multiply-add runs in double
+// so the result is correctly rounded, a float intermediate is off by one for values close to a
+// .5 tie once x / scale is past a few thousand
+template <typename T_QuantType>
+datautil::StatusCode datautil::floatToTfN(
+    T_QuantType* out, const float* in, int32_t offset, float scale, size_t numElements) {
   if (nullptr == out || nullptr == in) {
     QNN_ERROR("Received a nullptr");
     return StatusCode::INVALID_BUFFER;
   }
 
-  size_t dataTypeSizeInBytes = sizeof(T_QuantType);
-  size_t bitWidth            = dataTypeSizeInBytes * g_bitsPerByte;
-  double trueBitWidthMax     = pow(2, bitWidth) - 1;
-  double encodingMin         = offset * scale;
-  double encodingMax         = (trueBitWidthMax + offset) * scale;
-  double encodingRange       = encodingMax - encodingMin;
-
-  for (size_t i = 0; i < numElements; ++i) {
-    int quantizedValue = round(trueBitWidthMax * (in[i] - encodingMin) / encodingRange);
-    //QNN_INFO("Original value: %0.5f. Quantized value: %d", in[i], quantizedValue);
-    if (quantizedValue < 0)
-      quantizedValue = 0;
-    else if (quantizedValue > (int)trueBitWidthMax)
-      quantizedValue = (int)trueBitWidthMax;
-    out[i] = static_cast<T_QuantType>(quantizedValue);
+  const double invScale = 1.0 / static_cast<double>(scale);
+  const double bias     = -static_cast<double>(offset);
+  const double minValue = static_cast<double>(std::numeric_limits<T_QuantType>::min());
+  const double maxValue = static_cast<double>(std::numeric_limits<T_QuantType>::max());
+
+  size_t i = 0;
+#if defined(__aarch64__)
+  const float64x2_t vInvScale = vdupq_n_f64(invScale);
+  const float64x2_t vBias     = vdupq_n_f64(bias);
+  for (; i + 8 <= numElements; i += 8) {
+    int32x4_t rounded[2];
+    for (int half = 0; half < 2; ++half) {
+      const float32x4_t x = vld1q_f32(in + i + 4 * half);
+      const float64x2_t lo = vfmaq_f64(vBias, vcvt_f64_f32(vget_low_f32(x)), vInvScale);
+      const float64x2_t hi = vfmaq_f64(vBias, vcvt_high_f64_f32(x), vInvScale);
+      rounded[half] = vcombine_s32(vqmovn_s64(vcvtaq_s64_f64(lo)), vqmovn_s64(vcvtaq_s64_f64(hi)));
+    }
+    storeSaturated8<T_QuantType>(out + i, rounded[0], rounded[1]);
+  }
+#endif
+  for (; i < numElements; ++i) {
+    const double quantizedValue = std::round(static_cast<double>(in[i]) * invScale + bias);
+    out[i] = static_cast<T_QuantType>(quantizedValue > minValue
+                                          ? (quantizedValue < maxValue ? quantizedValue : maxValue)
+                                          : minValue);
   }
   return StatusCode::SUCCESS;
 }
 
 template datautil::StatusCode datautil::floatToTfN<uint8_t>(
-    uint8_t* out, float* in, int32_t offset, float scale, size_t numElements);
+    uint8_t* out, const float* in, int32_t offset, float scale, size_t numElements);
 
 template datautil::StatusCode datautil::floatToTfN<uint16_t>(
-    uint16_t* out, float* in, int32_t offset, float scale, size_t numElements);
+    uint16_t* out, const float* in, int32_t offset, float scale, size_t numElements);
+
+template datautil::StatusCode datautil::floatToTfN<int8_t>(
+    int8_t* out, const float* in, int32_t offset, float scale, size_t numElements);
+
+template datautil::StatusCode datautil::floatToTfN<int16_t>(
+    int16_t* out, const float* in, int32_t offset, float scale, size_t numElements);
 
+// De-quantization: x = (q + offset) * scale. q + offset is exact in float, so the single float
+// multiply rounds exactly like the double computation did
 template <typename T_QuantType>
 datautil::StatusCode datautil::tfNToFloat(
-    float* out, T_QuantType* in, int32_t offset, float scale, size_t numElements) {
-  static_assert(std::is_unsigned<T_QuantType>::value, "tfNToFloat supports unsigned only!");
-
+    float* out, const T_QuantType* in, int32_t offset, float scale, size_t numElements) {
   if (nullptr == out || nullptr == in) {
     QNN_ERROR("Received a nullptr");
     return StatusCode::INVALID_BUFFER;
   }
-  for (size_t i = 0; i < numElements; i++) {
-    double quantizedValue = static_cast<double>(in[i]);
-    double offsetDouble   = static_cast<double>(offset);
-    out[i]                = static_cast<double>((quantizedValue + offsetDouble) * scale);
+
+  size_t i = 0;
+#if defined(__aarch64__)
+  const int32x4_t vOffset = vdupq_n_s32(offset);
+  for (; i + 8 <= numElements; i += 8) {
+    int32x4_t lo, hi;
+    load8<T_QuantType>(in + i, lo, hi);
+    vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vaddq_s32(lo, vOffset)), scale));
+    vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vaddq_s32(hi, vOffset)), scale));
+  }
+#endif
+  for (; i < numElements; i++) {
+    out[i] = static_cast<float>(static_cast<int32_t>(in[i]) + offset) * scale;
   }
   return StatusCode::SUCCESS;
 }
 
 template datautil::StatusCode datautil::tfNToFloat<uint8_t>(
-    float* out, uint8_t* in, int32_t offset, float scale, size_t numElements);
+    float* out, const uint8_t* in, int32_t offset, float scale, size_t numElements);
 
 template datautil::StatusCode datautil::tfNToFloat<uint16_t>(
-    float* out, uint16_t* in, int32_t offset, float scale, size_t numElements);
+    float* out, const uint16_t* in, int32_t offset, float scale, size_t numElements);
+
+template datautil::StatusCode datautil::tfNToFloat<int8_t>(
+    float* out, const int8_t* in, int32_t offset, float scale, size_t numElements);
+
+template datautil::StatusCode datautil::tfNToFloat<int16_t>(
+    float* out, const int16_t* in, int32_t offset, float scale, size_t numElements);
 
 template <typename T_QuantType>
-datautil::StatusCode datautil::castToFloat(float* out, T_QuantType* in, size_t numElements) {
+datautil::StatusCode datautil::castToFloat(float* out, const T_QuantType* in, size_t numElements) {
   if (nullptr == out || nullptr == in) {
     QNN_ERROR("Received a nullptr");
     return StatusCode::INVALID_BUFFER;
@@ -606,31 +669,31 @@ datautil::StatusCode datautil::castToFloat(float* out, T_QuantType* in, size_t n
 }
 
 template datautil::StatusCode datautil::castToFloat<uint8_t>(float* out,
-                                                             uint8_t* in,
+                                                             const uint8_t* in,
                                                              size_t numElements);
 
 template datautil::StatusCode datautil::castToFloat<uint16_t>(float* out,
-                                                              uint16_t* in,
+                                                              const uint16_t* in,
                                                               size_t numElements);
 
 template datautil::StatusCode datautil::castToFloat<uint32_t>(float* out,
-                                                              uint32_t* in,
+                                                              const uint32_t* in,
                                                               size_t numElements);
 
 template datautil::StatusCode datautil::castToFloat<int8_t>(float* out,
-                                                            int8_t* in,
+                                                            const int8_t* in,
                                                             size_t numElements);
 
 template datautil::StatusCode datautil::castToFloat<int16_t>(float* out,
-                                                             int16_t* in,
+                                                             const int16_t* in,
                                                              size_t numElements);
 
 template datautil::StatusCode datautil::castToFloat<int32_t>(float* out,
-                                                             int32_t* in,
+                                                             const int32_t* in,
                                                              size_t numElements);
 
 template <typename T_QuantType>
-datautil::StatusCode datautil::castFromFloat(T_QuantType* out, float* in, size_t numElements) {
+datautil::StatusCode datautil::castFromFloat(T_QuantType* out, const float* in, size_t numElements) {
   if (nullptr == out || nullptr == in) {
     QNN_ERROR("Received a nullptr");
     return StatusCode::INVALID_BUFFER;
@@ -642,25 +705,25 @@ datautil::StatusCode datautil::castFromFloat(T_QuantType* out, float* in, size_t
 }
 
 template datautil::StatusCode datautil::castFromFloat<uint8_t>(uint8_t* out,
-                                                               float* in,
+                                                               const float* in,
                                                                size_t numElements);
 
 template datautil::StatusCode datautil::castFromFloat<uint16_t>(uint16_t* out,
-                                                                float* in,
+                                                                const float* in,
                                                                 size_t numElements);
 
 template datautil::StatusCode datautil::castFromFloat<uint32_t>(uint32_t* out,
-                                                                float* in,
+                                                                const float* in,
                                                                 size_t numElements);
 
 template datautil::StatusCode datautil::castFromFloat<int8_t>(int8_t* out,
-                                                              float* in,
+                                                              const float* in,
                                                               size_t numElements);
 
 template datautil::StatusCode datautil::castFromFloat<int16_t>(int16_t* out,
-                                                               float* in,
+                                                               const float* in,
                                                                size_t numElements);
 
 template datautil::StatusCode datautil::castFromFloat<int32_t>(int32_t* out,
-                                                               float* in,
+                                                               const float* in,
                                                                size_t numElements);
\ No newline at end of file
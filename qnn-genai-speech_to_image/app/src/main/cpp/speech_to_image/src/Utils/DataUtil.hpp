@@ -37,6 +37,8 @@ enum class StatusCode {
 };
 
 const size_t g_bitsPerByte = 8;
+const size_t g_numInferenceSteps = 20;
+const size_t g_timestepEmbeddingDim = 1280;
 std::unordered_map<std::string, int> static encoder;
 std::unordered_map<int, std::string> static decoder;
 std::string static unk_token;
@@ -46,13 +48,62 @@ std::vector<int32_t> tokenize(std::string& text);
 
 void generateNormalNumber(float mean, float stddev, int size, float *output);
 
-void get_timestep_embedding(int timestep, int embedding_dim, float timesteps_embeded[]);
-std::vector<float> run_scheduler(Qnn_Tensor_t noise_pred_uncond,
-              Qnn_ClientBuffer_t noise_pred_cond,
-              Qnn_Tensor_t latent_in,
-              int timestep);
-void initialize_scheduler();
-std::vector<float> step(int step, std::vector<float> sample, std::vector<float> model_output);
+// Index of the first largest value (NaN is skipped), 0 if there is none
+size_t argmax(const float* values, size_t numElements);
+
+// Timestep embeddings of the denoising schedule (t_emb_<step>.raw in the assets folder).
+// They are read once into a single buffer, a step only gets a view on its embedding.
+class TimestepEmbeddings {
+ public:
+  StatusCode load(const std::string& dirPath, size_t numSteps, size_t embeddingDim);
+
+  bool isLoaded() const { return !m_data.empty(); }
+
+  // Embedding of a step, nullptr if the step is not part of the loaded schedule
+  const float* get(size_t step) const;
+
+ private:
+  size_t m_numSteps     = 0;
+  size_t m_embeddingDim = 0;
+  std::vector<float> m_data;
+};
+
+// DPM-Solver++ scheduler (2nd order multistep, midpoint) of the Stable Diffusion loop.
+// The latent, the unconditional noise prediction and the x0 history are allocated once.
+// A step reads the UNet outputs and the quantized latent straight from the tensors and
+// does the guidance, the solver update and the requantization of the latent in one pass.
+class DpmSolverScheduler {
+ public:
+  explicit DpmSolverScheduler(size_t latentSize, float guidanceScale = 7.5f);
+
+  // Start a new image (the first step is first order again)
+  void reset();
+
+  size_t numInferenceSteps() const { return m_timesteps.size(); }
+
+  // Keep the unconditional noise prediction (UNet output) for the next step()
+  StatusCode storeUncondPrediction(const Qnn_Tensor_t& noisePred);
+
+  // Denoise the latent (UNet input, updated in place) with the conditional noise prediction
+  StatusCode step(size_t step, const Qnn_Tensor_t& noisePredCond, Qnn_Tensor_t& latent);
+
+  // Float latent after the last step
+  float* latent() { return m_latent.data(); }
+
+ private:
+  StatusCode checkTensor(const Qnn_Tensor_t& tensor) const;
+
+  float m_guidanceScale;
+  std::vector<float> m_alphaT;
+  std::vector<float> m_sigmaT;
+  std::vector<float> m_lambdaT;
+  std::vector<int32_t> m_timesteps;
+  int32_t m_lowerOrderNums = 0;
+
+  std::vector<uint16_t> m_uncondPrediction;
+  std::vector<float> m_latent;
+  std::vector<float> m_prevX0;
+};
 
 using ReadBatchDataRetType_t = std::tuple<StatusCode, size_t, size_t>;
 
@@ -90,17 +141,17 @@ StatusCode writeBinaryToFile(std::string fileDir,
 
 template <typename T_QuantType>
 datautil::StatusCode floatToTfN(
-    T_QuantType* out, float* in, int32_t offset, float scale, size_t numElements);
+    T_QuantType* out, const float* in, int32_t offset, float scale, size_t numElements);
 
 template <typename T_QuantType>
 datautil::StatusCode tfNToFloat(
-    float* out, T_QuantType* in, int32_t offset, float scale, size_t numElements);
+    float* out, const T_QuantType* in, int32_t offset, float scale, size_t numElements);
 
 template <typename T_QuantType>
-datautil::StatusCode castToFloat(float* out, T_QuantType* in, size_t numElements);
+datautil::StatusCode castToFloat(float* out, const T_QuantType* in, size_t numElements);
 
 template <typename T_QuantType>
-datautil::StatusCode castFromFloat(T_QuantType* out, float* in, size_t numElements);
+datautil::StatusCode castFromFloat(T_QuantType* out, const float* in, size_t numElements);
 
 const std::map<Qnn_DataType_t, size_t> g_dataTypeToSize = {
     {QNN_DATATYPE_INT_8, 1},
@@ -27,42 +27,73 @@
 using namespace qnn;
 using namespace qnn::tools;
 
+// Number of elements of a tensor, without building a dims vector on every conversion.
+static size_t tensorElementCount(const Qnn_Tensor_t* tensor) {
+  const uint32_t* dimensions = QNN_TENSOR_GET_DIMENSIONS(tensor);
+  const uint32_t rank        = QNN_TENSOR_GET_RANK(tensor);
+  if (nullptr == dimensions || 0 == rank) {
+    return 0;
+  }
+  size_t elementCount = 1;
+  for (uint32_t r = 0; r < rank; r++) {
+    elementCount *= dimensions[r];
+  }
+  return elementCount;
+}
+
 // Helper method to copy a float buffer, quantize it, and copy
-// it to a tensor (Qnn_Tensor_t) buffer.
-iotensor::StatusCode iotensor::IOTensor::copyFromFloatToNative(float* floatBuffer,
+// it to a tensor (Qnn_Tensor_t) buffer. The data type is resolved once
+// for the whole tensor, the conversion itself runs in the bulk kernels
+// of DataUtil / float16.
+iotensor::StatusCode iotensor::IOTensor::copyFromFloatToNative(const float* floatBuffer,
                                                                Qnn_Tensor_t* tensor) {
   if (nullptr == floatBuffer || nullptr == tensor) {
     QNN_ERROR("copyFromFloatToNative(): received a nullptr");
     return StatusCode::FAILURE;
   }
 
-  StatusCode returnStatus = StatusCode::SUCCESS;
-  std::vector<size_t> dims;
-  fillDims(dims, QNN_TENSOR_GET_DIMENSIONS(tensor), QNN_TENSOR_GET_RANK(tensor));
+  StatusCode returnStatus   = StatusCode::SUCCESS;
+  const size_t elementCount = tensorElementCount(tensor);
+  void* data                = QNN_TENSOR_GET_CLIENT_BUF(tensor).data;
+  const auto encoding       = QNN_TENSOR_GET_QUANT_PARAMS(tensor).scaleOffsetEncoding;
+  if (nullptr == data) {
+    QNN_ERROR("copyFromFloatToNative(): tensor has no client buffer");
+    return StatusCode::FAILURE;
+  }
 
   switch (QNN_TENSOR_GET_DATA_TYPE(tensor)) {
+    case QNN_DATATYPE_FLOAT_32:
+      memcpy(data, floatBuffer, elementCount * sizeof(float));
+      break;
+
+    case QNN_DATATYPE_FLOAT_16:
+      fp32_to_fp16(static_cast<float16*>(data), floatBuffer, elementCount);
+      break;
+
     case QNN_DATATYPE_UFIXED_POINT_8:
-      datautil::floatToTfN<uint8_t>(static_cast<uint8_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-                                    floatBuffer,
-                                    QNN_TENSOR_GET_QUANT_PARAMS(tensor).scaleOffsetEncoding.offset,
-                                    QNN_TENSOR_GET_QUANT_PARAMS(tensor).scaleOffsetEncoding.scale,
-                                    datautil::calculateElementCount(dims));
+      datautil::floatToTfN<uint8_t>(
+          static_cast<uint8_t*>(data), floatBuffer, encoding.offset, encoding.scale, elementCount);
       break;
 
     case QNN_DATATYPE_UFIXED_POINT_16:
-      datautil::floatToTfN<uint16_t>(static_cast<uint16_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-                                     floatBuffer,
-                                     QNN_TENSOR_GET_QUANT_PARAMS(tensor).scaleOffsetEncoding.offset,
-                                     QNN_TENSOR_GET_QUANT_PARAMS(tensor).scaleOffsetEncoding.scale,
-                                     datautil::calculateElementCount(dims));
+      datautil::floatToTfN<uint16_t>(
+          static_cast<uint16_t*>(data), floatBuffer, encoding.offset, encoding.scale, elementCount);
+      break;
+
+    case QNN_DATATYPE_SFIXED_POINT_8:
+      datautil::floatToTfN<int8_t>(
+          static_cast<int8_t*>(data), floatBuffer, encoding.offset, encoding.scale, elementCount);
+      break;
+
+    case QNN_DATATYPE_SFIXED_POINT_16:
+      datautil::floatToTfN<int16_t>(
+          static_cast<int16_t*>(data), floatBuffer, encoding.offset, encoding.scale, elementCount);
       break;
 
     case QNN_DATATYPE_UINT_8:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castFromFloat<uint8_t>(
-              static_cast<uint8_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              floatBuffer,
-              datautil::calculateElementCount(dims))) {
+              static_cast<uint8_t*>(data), floatBuffer, elementCount)) {
         QNN_ERROR("failure in castFromFloat<uint8_t>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -71,9 +102,7 @@ iotensor::StatusCode iotensor::IOTensor::copyFromFloatToNative(float* floatBuffe
     case QNN_DATATYPE_UINT_16:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castFromFloat<uint16_t>(
-              static_cast<uint16_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              floatBuffer,
-              datautil::calculateElementCount(dims))) {
+              static_cast<uint16_t*>(data), floatBuffer, elementCount)) {
         QNN_ERROR("failure in castFromFloat<uint16_t>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -82,9 +111,7 @@ iotensor::StatusCode iotensor::IOTensor::copyFromFloatToNative(float* floatBuffe
     case QNN_DATATYPE_UINT_32:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castFromFloat<uint32_t>(
-              static_cast<uint32_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              floatBuffer,
-              datautil::calculateElementCount(dims))) {
+              static_cast<uint32_t*>(data), floatBuffer, elementCount)) {
         QNN_ERROR("failure in castFromFloat<uint32_t>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -93,9 +120,7 @@ iotensor::StatusCode iotensor::IOTensor::copyFromFloatToNative(float* floatBuffe
     case QNN_DATATYPE_INT_8:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castFromFloat<int8_t>(
-              static_cast<int8_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              floatBuffer,
-              datautil::calculateElementCount(dims))) {
+              static_cast<int8_t*>(data), floatBuffer, elementCount)) {
         QNN_ERROR("failure in castFromFloat<int8_t>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -104,9 +129,7 @@ iotensor::StatusCode iotensor::IOTensor::copyFromFloatToNative(float* floatBuffe
     case QNN_DATATYPE_INT_16:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castFromFloat<int16_t>(
-              static_cast<int16_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              floatBuffer,
-              datautil::calculateElementCount(dims))) {
+              static_cast<int16_t*>(data), floatBuffer, elementCount)) {
         QNN_ERROR("failure in castFromFloat<int16_t>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -115,9 +138,7 @@ iotensor::StatusCode iotensor::IOTensor::copyFromFloatToNative(float* floatBuffe
     case QNN_DATATYPE_INT_32:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castFromFloat<int32_t>(
-              static_cast<int32_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              floatBuffer,
-              datautil::calculateElementCount(dims))) {
+              static_cast<int32_t*>(data), floatBuffer, elementCount)) {
         QNN_ERROR("failure in castFromFloat<int32_t>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -126,9 +147,7 @@ iotensor::StatusCode iotensor::IOTensor::copyFromFloatToNative(float* floatBuffe
     case QNN_DATATYPE_BOOL_8:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castFromFloat<uint8_t>(
-              static_cast<uint8_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              floatBuffer,
-              datautil::calculateElementCount(dims))) {
+              static_cast<uint8_t*>(data), floatBuffer, elementCount)) {
         QNN_ERROR("failure in castFromFloat<bool>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -379,32 +398,37 @@ iotensor::StatusCode iotensor::IOTensor::tearDownInputAndOutputTensors(Qnn_Tenso
   return StatusCode::SUCCESS;
 }
 
-// Convert data to float or de-quantization. This is used when
-// user requests for float output and the model produces
-// non-float output.
-iotensor::StatusCode iotensor::IOTensor::convertToFloat(float** out, Qnn_Tensor_t* tensor) {
-  if (nullptr == tensor) {
-    QNN_ERROR("tensors is nullptr");
+// Convert data to float or de-quantization into a caller provided buffer
+// of at least the element count of the tensor. Used on every denoising
+// step, so it does not allocate.
+iotensor::StatusCode iotensor::IOTensor::copyFromNativeToFloat(float* out, const Qnn_Tensor_t* tensor) {
+  if (nullptr == out || nullptr == tensor) {
+    QNN_ERROR("copyFromNativeToFloat(): received a nullptr");
     return StatusCode::FAILURE;
   }
-  std::vector<size_t> dims;
-  fillDims(dims, QNN_TENSOR_GET_DIMENSIONS(tensor), QNN_TENSOR_GET_RANK(tensor));
-  auto returnStatus   = StatusCode::SUCCESS;
-  size_t elementCount = datautil::calculateElementCount(dims);
-  returnStatus        = allocateBuffer<float>(out, elementCount);
-  if (StatusCode::SUCCESS != returnStatus) {
-    QNN_ERROR("failure in allocateBuffer<float>");
-    return returnStatus;
+
+  auto returnStatus         = StatusCode::SUCCESS;
+  const size_t elementCount = tensorElementCount(tensor);
+  const void* data          = QNN_TENSOR_GET_CLIENT_BUF(tensor).data;
+  const auto encoding       = QNN_TENSOR_GET_QUANT_PARAMS(tensor).scaleOffsetEncoding;
+  if (nullptr == data) {
+    QNN_ERROR("copyFromNativeToFloat(): tensor has no client buffer");
+    return StatusCode::FAILURE;
   }
+
   switch (QNN_TENSOR_GET_DATA_TYPE(tensor)) {
+    case QNN_DATATYPE_FLOAT_32:
+      memcpy(out, data, elementCount * sizeof(float));
+      break;
+
+    case QNN_DATATYPE_FLOAT_16:
+      fp16_to_fp32(out, static_cast<const float16*>(data), elementCount);
+      break;
+
     case QNN_DATATYPE_UFIXED_POINT_8:
       if (datautil::StatusCode::SUCCESS !=
           datautil::tfNToFloat<uint8_t>(
-              *out,
-              reinterpret_cast<uint8_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              QNN_TENSOR_GET_QUANT_PARAMS(tensor).scaleOffsetEncoding.offset,
-              QNN_TENSOR_GET_QUANT_PARAMS(tensor).scaleOffsetEncoding.scale,
-              elementCount)) {
+              out, static_cast<const uint8_t*>(data), encoding.offset, encoding.scale, elementCount)) {
         QNN_ERROR("failure in tfNToFloat<uint8_t>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -413,22 +437,35 @@ iotensor::StatusCode iotensor::IOTensor::convertToFloat(float** out, Qnn_Tensor_
     case QNN_DATATYPE_UFIXED_POINT_16:
       if (datautil::StatusCode::SUCCESS !=
           datautil::tfNToFloat<uint16_t>(
-              *out,
-              reinterpret_cast<uint16_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              QNN_TENSOR_GET_QUANT_PARAMS(tensor).scaleOffsetEncoding.offset,
-              QNN_TENSOR_GET_QUANT_PARAMS(tensor).scaleOffsetEncoding.scale,
-              elementCount)) {
-        QNN_ERROR("failure in tfNToFloat<uint8_t>");
+              out, static_cast<const uint16_t*>(data), encoding.offset, encoding.scale, elementCount)) {
+        QNN_ERROR("failure in tfNToFloat<uint16_t>");
+        returnStatus = StatusCode::FAILURE;
+      }
+      break;
+
+    case QNN_DATATYPE_SFIXED_POINT_8:
+      if (datautil::StatusCode::SUCCESS !=
+          datautil::tfNToFloat<int8_t>(
+              out, static_cast<const int8_t*>(data), encoding.offset, encoding.scale, elementCount)) {
+        QNN_ERROR("failure in tfNToFloat<int8_t>");
+        returnStatus = StatusCode::FAILURE;
+      }
+      break;
+
+    case QNN_DATATYPE_SFIXED_POINT_16:
+      if (datautil::StatusCode::SUCCESS !=
+          datautil::tfNToFloat<int16_t>(
+              out, static_cast<const int16_t*>(data), encoding.offset, encoding.scale, elementCount)) {
+        QNN_ERROR("failure in tfNToFloat<int16_t>");
         returnStatus = StatusCode::FAILURE;
       }
       break;
 
     case QNN_DATATYPE_UINT_8:
+    case QNN_DATATYPE_BOOL_8:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castToFloat<uint8_t>(
-              *out,
-              reinterpret_cast<uint8_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              elementCount)) {
+              out, static_cast<const uint8_t*>(data), elementCount)) {
         QNN_ERROR("failure in castToFloat<uint8_t>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -437,9 +474,7 @@ iotensor::StatusCode iotensor::IOTensor::convertToFloat(float** out, Qnn_Tensor_
     case QNN_DATATYPE_UINT_16:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castToFloat<uint16_t>(
-              *out,
-              reinterpret_cast<uint16_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              elementCount)) {
+              out, static_cast<const uint16_t*>(data), elementCount)) {
         QNN_ERROR("failure in castToFloat<uint16_t>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -448,9 +483,7 @@ iotensor::StatusCode iotensor::IOTensor::convertToFloat(float** out, Qnn_Tensor_
     case QNN_DATATYPE_UINT_32:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castToFloat<uint32_t>(
-              *out,
-              reinterpret_cast<uint32_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              elementCount)) {
+              out, static_cast<const uint32_t*>(data), elementCount)) {
         QNN_ERROR("failure in castToFloat<uint32_t>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -459,9 +492,7 @@ iotensor::StatusCode iotensor::IOTensor::convertToFloat(float** out, Qnn_Tensor_
     case QNN_DATATYPE_INT_8:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castToFloat<int8_t>(
-              *out,
-              reinterpret_cast<int8_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              elementCount)) {
+              out, static_cast<const int8_t*>(data), elementCount)) {
         QNN_ERROR("failure in castToFloat<int8_t>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -470,9 +501,7 @@ iotensor::StatusCode iotensor::IOTensor::convertToFloat(float** out, Qnn_Tensor_
     case QNN_DATATYPE_INT_16:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castToFloat<int16_t>(
-              *out,
-              reinterpret_cast<int16_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              elementCount)) {
+              out, static_cast<const int16_t*>(data), elementCount)) {
         QNN_ERROR("failure in castToFloat<int16_t>");
         returnStatus = StatusCode::FAILURE;
       }
@@ -481,30 +510,35 @@ iotensor::StatusCode iotensor::IOTensor::convertToFloat(float** out, Qnn_Tensor_
     case QNN_DATATYPE_INT_32:
       if (datautil::StatusCode::SUCCESS !=
           datautil::castToFloat<int32_t>(
-              *out,
-              reinterpret_cast<int32_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              elementCount)) {
+              out, static_cast<const int32_t*>(data), elementCount)) {
         QNN_ERROR("failure in castToFloat<int32_t>");
         returnStatus = StatusCode::FAILURE;
       }
       break;
 
-    case QNN_DATATYPE_BOOL_8:
-      if (datautil::StatusCode::SUCCESS !=
-          datautil::castToFloat<uint8_t>(
-              *out,
-              reinterpret_cast<uint8_t*>(QNN_TENSOR_GET_CLIENT_BUF(tensor).data),
-              elementCount)) {
-        QNN_ERROR("failure in castToFloat<bool>");
-        returnStatus = StatusCode::FAILURE;
-      }
-      break;
-
     default:
       QNN_ERROR("Datatype not supported yet!");
       returnStatus = StatusCode::FAILURE;
       break;
   }
+  return returnStatus;
+}
+
+// Convert data to float or de-quantization. This is used when
+// user requests for float output and the model produces
+// non-float output. The caller owns (and frees) *out.
+iotensor::StatusCode iotensor::IOTensor::convertToFloat(float** out, Qnn_Tensor_t* tensor) {
+  if (nullptr == tensor) {
+    QNN_ERROR("tensors is nullptr");
+    return StatusCode::FAILURE;
+  }
+  size_t elementCount = tensorElementCount(tensor);
+  auto returnStatus   = allocateBuffer<float>(out, elementCount);
+  if (StatusCode::SUCCESS != returnStatus) {
+    QNN_ERROR("failure in allocateBuffer<float>");
+    return returnStatus;
+  }
+  returnStatus = copyFromNativeToFloat(*out, tensor);
   if (StatusCode::SUCCESS != returnStatus) {
     QNN_DEBUG("freeing *out");
     if (*out != nullptr) {
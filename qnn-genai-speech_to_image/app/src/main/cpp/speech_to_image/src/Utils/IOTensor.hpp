@@ -68,7 +68,7 @@ class IOTensor {
 
   StatusCode allocateBuffer(uint8_t **buffer, std::vector<size_t> dims, Qnn_DataType_t dataType);
 
-  StatusCode copyFromFloatToNative(float *floatBuffer, Qnn_Tensor_t *tensor);
+  StatusCode copyFromFloatToNative(const float *floatBuffer, Qnn_Tensor_t *tensor);
 
   StatusCode writeOutputTensor(Qnn_Tensor_t *output,
                                std::vector<std::string> outputPaths,
@@ -77,6 +77,7 @@ StatusCode convertAndWriteOutputTensorInFloat(Qnn_Tensor_t *output,
                                                 std::vector<std::string> outputPaths,
                                                 std::string fileName);
  StatusCode convertToFloat(float **out, Qnn_Tensor_t *output);
+ StatusCode copyFromNativeToFloat(float *out, const Qnn_Tensor_t *tensor);
 
  private:
   PopulateInputTensorsRetType_t populateInputTensor(uint32_t graphIdx,
@@ -0,0 +1,112 @@
+//============================================================================
+// Copyright (c) 2026 Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause-Clear
+//============================================================================
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "QnnTypeMacros.hpp"
+
+namespace qnn {
+namespace tools {
+namespace kvcache {
+
+// Two tensors can exchange their client buffers when the bytes mean the same thing in both:
+// same size, data type and quantization encoding
+inline bool canSwapClientBuffers(const Qnn_Tensor_t& a, const Qnn_Tensor_t& b) {
+  if (QNN_TENSOR_GET_CLIENT_BUF(a).dataSize != QNN_TENSOR_GET_CLIENT_BUF(b).dataSize ||
+      QNN_TENSOR_GET_DATA_TYPE(a) != QNN_TENSOR_GET_DATA_TYPE(b)) {
+    return false;
+  }
+  const Qnn_QuantizeParams_t qa = QNN_TENSOR_GET_QUANT_PARAMS(a);
+  const Qnn_QuantizeParams_t qb = QNN_TENSOR_GET_QUANT_PARAMS(b);
+  if (qa.encodingDefinition != qb.encodingDefinition ||
+      qa.quantizationEncoding != qb.quantizationEncoding) {
+    return false;
+  }
+  switch (qa.quantizationEncoding) {
+    case QNN_QUANTIZATION_ENCODING_UNDEFINED:
+      return true;
+    case QNN_QUANTIZATION_ENCODING_SCALE_OFFSET:
+      return qa.scaleOffsetEncoding.scale == qb.scaleOffsetEncoding.scale &&
+             qa.scaleOffsetEncoding.offset == qb.scaleOffsetEncoding.offset;
+    default:
+      return false;
+  }
+}
+
+inline void swapClientBuffers(Qnn_Tensor_t& a, Qnn_Tensor_t& b) {
+  const Qnn_ClientBuffer_t bufferA = QNN_TENSOR_GET_CLIENT_BUF(a);
+  QNN_TENSOR_SET_CLIENT_BUF(a, QNN_TENSOR_GET_CLIENT_BUF(b));
+  QNN_TENSOR_SET_CLIENT_BUF(b, bufferA);
+}
+
+// Copy as much of the data as fits (the previous hand-off for mismatching tensors)
+inline void copyClientBuffer(const Qnn_Tensor_t& from, Qnn_Tensor_t& to) {
+  const Qnn_ClientBuffer_t src = QNN_TENSOR_GET_CLIENT_BUF(from);
+  const Qnn_ClientBuffer_t dst = QNN_TENSOR_GET_CLIENT_BUF(to);
+  std::memcpy(dst.data, src.data, std::min(src.dataSize, dst.dataSize));
+}
+
+// Make the data of `from` (an output) the data of `to` (an input of the next graph execution).
+// The buffers are swapped when possible, so `from` is left with the previous buffer of `to`,
+// which the next execution overwrites anyway. Each buffer keeps exactly one owner, so the
+// tensors are torn down as before.
+inline void handOver(Qnn_Tensor_t& from, Qnn_Tensor_t& to) {
+  if (canSwapClientBuffers(from, to)) {
+    swapClientBuffers(from, to);
+  } else {
+    copyClientBuffer(from, to);
+  }
+}
+
+// Self-attention KV cache of an autoregressive decoder. Every cache is double buffered between
+// its input and its output tensor: after a step the client buffers are swapped, so the cache the
+// step produced is the input of the next one without copying it.
+class PingPong {
+ public:
+  void clear() { m_pairs.clear(); }
+
+  void bind(Qnn_Tensor_t* input, Qnn_Tensor_t* output) {
+    m_pairs.push_back({input, output, canSwapClientBuffers(*input, *output)});
+  }
+
+  // Empty cache before the first step
+  void zeroInputs() {
+    for (const Pair& pair : m_pairs) {
+      const Qnn_ClientBuffer_t buffer = QNN_TENSOR_GET_CLIENT_BUF(pair.input);
+      std::memset(buffer.data, 0, buffer.dataSize);
+    }
+  }
+
+  // Outputs of the step that just ran become the inputs of the next one
+  void handOff() {
+    for (const Pair& pair : m_pairs) {
+      if (pair.swap) {
+        swapClientBuffers(*pair.output, *pair.input);
+      } else {
+        copyClientBuffer(*pair.output, *pair.input);
+      }
+    }
+  }
+
+  size_t numSwapped() const {
+    return std::count_if(m_pairs.begin(), m_pairs.end(), [](const Pair& pair) { return pair.swap; });
+  }
+
+ private:
+  struct Pair {
+    Qnn_Tensor_t* input;
+    Qnn_Tensor_t* output;
+    bool swap;
+  };
+  std::vector<Pair> m_pairs;
+};
+
+}  // namespace kvcache
+}  // namespace tools
+}  // namespace qnn
@@ -0,0 +1,123 @@
+//============================================================================
+// Copyright (c) 2026 Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause-Clear
+//============================================================================
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <tuple>
+
+#include "Logger.hpp"
+#include "ModelBlob.hpp"
+
+using namespace qnn;
+using namespace qnn::tools;
+
+datautil::StatusCode datautil::ModelBlob::load(const std::string& filePath, ModelBlobLoadMode mode) {
+  release();
+  const auto start = std::chrono::steady_clock::now();
+
+  StatusCode status{StatusCode::SUCCESS};
+  if (ModelBlobLoadMode::READ == mode) {
+    status = read(filePath);
+  } else {
+    const int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      QNN_ERROR("Failed to open model file: %s", filePath.c_str());
+      return StatusCode::FILE_OPEN_FAIL;
+    }
+    struct stat fileStat;
+    if (0 != ::fstat(fd, &fileStat)) {
+      QNN_ERROR("Failed to get the size of %s", filePath.c_str());
+      ::close(fd);
+      return StatusCode::FILE_OPEN_FAIL;
+    }
+    if (0 == fileStat.st_size) {
+      QNN_ERROR("Received path to an empty file. Nothing to deserialize.");
+      ::close(fd);
+      return StatusCode::DATA_READ_FAIL;
+    }
+    const size_t size = static_cast<size_t>(fileStat.st_size);
+    void* mapping     = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+
+    if (MAP_FAILED == mapping) {
+      QNN_WARN("Could not map %s (%s), reading it instead", filePath.c_str(), strerror(errno));
+      status = read(filePath);
+    } else {
+      if (ModelBlobLoadMode::MMAP_PREFETCH == mode &&
+          0 != ::madvise(mapping, size, MADV_WILLNEED)) {
+        QNN_DEBUG("madvise(MADV_WILLNEED) failed for %s", filePath.c_str());
+      }
+      m_data   = mapping;
+      m_size   = size;
+      m_mapped = true;
+    }
+  }
+
+  m_loadTimeMs =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return status;
+}
+
+datautil::StatusCode datautil::ModelBlob::read(const std::string& filePath) {
+  StatusCode status{StatusCode::SUCCESS};
+  size_t size{0};
+  std::tie(status, size) = getFileSize(filePath);
+  if (StatusCode::SUCCESS != status) {
+    return status;
+  }
+  if (0 == size) {
+    QNN_ERROR("Received path to an empty file. Nothing to deserialize.");
+    return StatusCode::DATA_READ_FAIL;
+  }
+  m_buffer.reset(new (std::nothrow) uint8_t[size]);
+  if (!m_buffer) {
+    QNN_ERROR("Failed to allocate memory.");
+    return StatusCode::INVALID_BUFFER;
+  }
+  status = readBinaryFromFile(filePath, m_buffer.get(), size);
+  if (StatusCode::SUCCESS != status) {
+    QNN_ERROR("Failed to read binary data.");
+    m_buffer.reset();
+    return status;
+  }
+  m_data = m_buffer.get();
+  m_size = size;
+  return StatusCode::SUCCESS;
+}
+
+void datautil::ModelBlob::release() {
+  if (m_mapped) {
+    ::munmap(const_cast<void*>(m_data), m_size);
+  }
+  m_buffer.reset();
+  m_data   = nullptr;
+  m_size   = 0;
+  m_mapped = false;
+}
+
+size_t datautil::getPeakRssKb() {
+  FILE* status = std::fopen("/proc/self/status", "r");
+  if (nullptr == status) {
+    return 0;
+  }
+  size_t peakKb = 0;
+  char line[128];
+  while (std::fgets(line, sizeof(line), status)) {
+    if (1 == std::sscanf(line, "VmHWM: %zu kB", &peakKb)) {
+      break;
+    }
+  }
+  std::fclose(status);
+  return peakKb;
+}
@@ -0,0 +1,64 @@
+//============================================================================
+// Copyright (c) 2026 Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause-Clear
+//============================================================================
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "DataUtil.hpp"
+
+namespace qnn {
+namespace tools {
+namespace datautil {
+
+enum class ModelBlobLoadMode {
+  MMAP,           // map the file read-only, pages are read on first use
+  MMAP_PREFETCH,  // map the file and ask the kernel to start reading it ahead (madvise)
+  READ,           // read the whole file into a heap buffer
+};
+
+// A model file (context binary) in memory. Mapping it keeps the bytes in the page cache instead
+// of a private heap copy: the pages are clean and reclaimable, and there is no read of the whole
+// file before the first byte is used. If the file cannot be mapped it is read into a buffer.
+class ModelBlob {
+ public:
+  ModelBlob() = default;
+  ~ModelBlob() { release(); }
+
+  ModelBlob(const ModelBlob&)            = delete;
+  ModelBlob& operator=(const ModelBlob&) = delete;
+
+  StatusCode load(const std::string& filePath,
+                  ModelBlobLoadMode mode = ModelBlobLoadMode::MMAP_PREFETCH);
+
+  // Unmap / free the bytes, e.g. once the context has been created from them
+  void release();
+
+  const void* data() const { return m_data; }
+  uint64_t size() const { return m_size; }
+  bool isMapped() const { return m_mapped; }
+
+  // Time load() took, in milliseconds
+  double loadTimeMs() const { return m_loadTimeMs; }
+
+ private:
+  StatusCode read(const std::string& filePath);
+
+  const void* m_data = nullptr;
+  uint64_t m_size    = 0;
+  bool m_mapped      = false;
+  std::unique_ptr<uint8_t[]> m_buffer;
+  double m_loadTimeMs = 0.0;
+};
+
+// Peak resident set size of the process (VmHWM) in kB, 0 where it is not available
+size_t getPeakRssKb();
+
+}  // namespace datautil
+}  // namespace tools
+}  // namespace qnn
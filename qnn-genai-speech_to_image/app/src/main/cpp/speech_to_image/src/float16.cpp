@@ -3,37 +3,111 @@
 // SPDX-License-Identifier: BSD-3-Clause-Clear
 //============================================================================
 
-#include "float16.hpp"
+#include <cstring>
 
-float16 get_16bit_float(float n) {
-    uint32_t intn = *reinterpret_cast<uint32_t*>(&n);
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__F16C__)
+#include <immintrin.h>
+#endif
 
+#include "float16.hpp"
 
-    uint16_t sign = (intn >> 16) & 0x8000;
+static inline uint32_t float_bits(float f) {
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    return u;
+}
 
-    int32_t exponent = ((intn >> 23) & 0xFF) - 127 + 15;
-    if (exponent <= 0) {
-        exponent = 0;
-    } else if (exponent >= 31) {
-        exponent = 31;
-    }
-    exponent = (exponent & 0x1F) << 10;
+static inline float bits_float(uint32_t u) {
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
 
-    uint16_t mantissa = (intn >> 13) & 0x3FF;
+float16 get_16bit_float(float n) {
+    const uint32_t f32_inf = 255u << 23;
+    const uint32_t f16_overflow = (127u + 16) << 23;          // 2^16, everything above rounds to inf
+    const uint32_t f16_min_normal = (127u - 14) << 23;        // 2^-14
+    const uint32_t denorm_magic = ((127u - 15) + (23 - 10) + 1) << 23;
 
-    uint16_t result = sign | exponent | mantissa;
+    uint32_t intn = float_bits(n);
+    const uint16_t sign = (intn >> 16) & 0x8000;
+    intn &= 0x7FFFFFFF;
 
-    return result;
+    uint16_t result;
+    if (intn >= f16_overflow) {
+        // NaN stays a (quiet) NaN, the rest overflows to infinity
+        result = (intn > f32_inf) ? 0x7E00 : 0x7C00;
+    } else if (intn < f16_min_normal) {
+        // Subnormal or zero: adding the magic number lets the FPU do the round to nearest even
+        // on the 10 bit mantissa
+        result = (uint16_t)(float_bits(bits_float(intn) + bits_float(denorm_magic)) - denorm_magic);
+    } else {
+        // Normal: rebias the exponent and round the 13 dropped bits to nearest even.
+        // A carry out of the mantissa correctly bumps the exponent (up to infinity)
+        const uint32_t mantissa_odd = (intn >> 13) & 1;
+        intn += ((uint32_t)(15 - 127) << 23) + 0xFFF + mantissa_odd;
+        result = (uint16_t)(intn >> 13);
+    }
+    return result | sign;
 }
 
 float get_32bit_float(float16 n) {
-    uint32_t sign = (n & 0x8000) << 16;
-    uint32_t exponent = (((n & 0x7C00) >> 10) + 127 - 15) << 23;
-    uint32_t mantissa = (n & 0x3FF) << 13;
+    const uint32_t shifted_exponent = 0x7C00u << 13;
+    const float denorm_magic = bits_float(113u << 23);
+
+    uint32_t representation32bits = (n & 0x7FFFu) << 13;
+    const uint32_t exponent = representation32bits & shifted_exponent;
+    representation32bits += (uint32_t)(127 - 15) << 23;
+
+    if (exponent == shifted_exponent) {
+        // Infinity or NaN
+        representation32bits += (uint32_t)(128 - 16) << 23;
+    } else if (exponent == 0) {
+        // Zero or subnormal: renormalize through the FPU
+        representation32bits += 1u << 23;
+        representation32bits = float_bits(bits_float(representation32bits) - denorm_magic);
+    }
+    representation32bits |= (uint32_t)(n & 0x8000u) << 16;
 
-    uint32_t representation32bits = sign | exponent | mantissa;
+    return bits_float(representation32bits);
+}
 
-    float result = *reinterpret_cast<float*>(&representation32bits);
+void fp32_to_fp16(float16* out, const float* in, size_t numElements) {
+    size_t i = 0;
+#if defined(__aarch64__)
+    for (; i + 8 <= numElements; i += 8) {
+        const float16x4_t lo = vcvt_f16_f32(vld1q_f32(in + i));
+        const float16x4_t hi = vcvt_f16_f32(vld1q_f32(in + i + 4));
+        vst1q_u16(out + i, vreinterpretq_u16_f16(vcombine_f16(lo, hi)));
+    }
+#elif defined(__F16C__)
+    for (; i + 8 <= numElements; i += 8) {
+        const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), h);
+    }
+#endif
+    for (; i < numElements; ++i) {
+        out[i] = get_16bit_float(in[i]);
+    }
+}
 
-    return result;
-}
\ No newline at end of file
+void fp16_to_fp32(float* out, const float16* in, size_t numElements) {
+    size_t i = 0;
+#if defined(__aarch64__)
+    for (; i + 8 <= numElements; i += 8) {
+        const float16x8_t h = vreinterpretq_f16_u16(vld1q_u16(in + i));
+        vst1q_f32(out + i, vcvt_f32_f16(vget_low_f16(h)));
+        vst1q_f32(out + i + 4, vcvt_f32_f16(vget_high_f16(h)));
+    }
+#elif defined(__F16C__)
+    for (; i + 8 <= numElements; i += 8) {
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+    }
+#endif
+    for (; i < numElements; ++i) {
+        out[i] = get_32bit_float(in[i]);
+    }
+}
@@ -4,12 +4,18 @@
 //============================================================================
 
 #pragma once
+#include <cstddef>
 #include <cstdint>
-#include <bitset>
 
 
 typedef uint16_t float16;
 
+// IEEE 754 conversions, rounding to nearest even, with subnormals, infinities and NaN
 float16 get_16bit_float(float n);
 
-float get_32bit_float(float16 n);
\ No newline at end of file
+float get_32bit_float(float16 n);
+
+// Bulk conversions of a whole buffer (NEON on AArch64, F16C on x86 when enabled)
+void fp32_to_fp16(float16* out, const float* in, size_t numElements);
+
+void fp16_to_fp32(float* out, const float16* in, size_t numElements);
@@ -49,6 +49,8 @@ object SpeechToImageNativeJNI {
     external fun initializeApp(cacheDir: String) : Int
     private external fun runStableDiffusion(condTokens : LongArray, fileName: String)
     private external fun runWhisper(audioPath: String): String;
+    external fun beginWhisperStream(audioPath: String)
+    external fun pushWhisperAudio(pcm: ByteArray, length: Int)
     external fun freeApp(): Int
     external fun stopStableDiffusion();
 }
\ No newline at end of file
@@ -34,6 +34,9 @@ object WAV {
             bufferSize
         )
 
+        // the log-mel spectrogram is computed while recording, see pushWhisperAudio()
+        SpeechToImageNativeJNI.beginWhisperStream(filepath)
+
         audioRecorder?.startRecording()
 
         recordingThread = Thread {
@@ -42,10 +45,10 @@ object WAV {
     }
 
     fun stopRecordingWAV(){
-        audioRecorder?.apply {
-            stop()
-            release()
-        }
+        audioRecorder?.stop()
+        // let the writer push the last buffer and finish the WAV header before anyone reads it
+        recordingThread?.join()
+        audioRecorder?.release()
         audioRecorder = null
         recordingThread = null
     }
@@ -57,6 +60,7 @@ object WAV {
                 val read = audioRecorder?.read(data, 0, data.size) ?: 0
                 if (read > 0) {
                     fos.write(data, 0, read)
+                    SpeechToImageNativeJNI.pushWhisperAudio(data, read)
                 }
             }
         }
@@ -0,0 +1,376 @@
+//============================================================================
+// Copyright (c) 2026 Qualcomm Innovation Center, Inc. All rights reserved.
+// SPDX-License-Identifier: BSD-3-Clause-Clear
+//============================================================================
+
+// Host check for the LogMel sources against the previous implementation (the recursive
+// radix-2 / naive DFT fft() and the per-frame loop, copied below as the reference):
+//
+//  - fft_plan(400).rfft() against fft() on random frames
+//  - the pooled spectrogram (load_audio_chunk() / compute() with 1, 2 and 4 threads)
+//  - the streaming spectrogram (stream_push() / stream_push_pcm16() in random chunk sizes,
+//    then stream_finish())
+//
+// over seeded synthetic audio of several lengths. Spectrograms have to agree within
+// 1e-4 (they are (log10 + 4) / 4, so about 0..2), and streaming has to give exactly the
+// batch result. Exits with 1 on any difference. Times are one thread for the reference and
+// four pool threads for the new code.
+//
+//   logmel_check [--filters mel_80.bin]
+//
+// Without --filters the 80 Slaney mel filters Whisper uses are generated.
+
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "fft_plan.hpp"
+#include "log_mel_spectrogram.hpp"
+
+#define WHISPER_N_FFT 400
+#define WHISPER_HOP_LENGTH 160
+#define WHISPER_SAMPLE_RATE 16000
+#define WHISPER_N_MEL 80
+#define N_SAMPLES (30 * WHISPER_SAMPLE_RATE)
+
+namespace reference {
+
+// previous fft(): radix-2 down to an odd length, then a naive DFT
+void fft(const float* in, int N, float* out) {
+    if (N == 1) {
+        out[0] = in[0];
+        out[1] = 0;
+        return;
+    }
+
+    const int half_N = N / 2;
+    if (N - half_N * 2 == 1) {
+        for (int k = 0; k < N; k++) {
+            float re = 0;
+            float im = 0;
+            for (int n = 0; n < N; n++) {
+                double theta = -2.0 * M_PI * k * n / N;
+                re += in[n] * cos(theta);
+                im += in[n] * sin(theta);
+            }
+            out[2 * k] = re;
+            out[2 * k + 1] = im;
+        }
+        return;
+    }
+
+    std::vector<float> even(N);
+    std::vector<float> odd(N);
+    for (int i = 0; i < half_N; ++i) {
+        even[i] = in[2 * i];
+        odd[i] = in[2 * i + 1];
+    }
+
+    std::vector<float> even_fft(2 * N);
+    std::vector<float> odd_fft(2 * N);
+    fft(even.data(), half_N, even_fft.data());
+    fft(odd.data(), half_N, odd_fft.data());
+
+    for (int k = 0; k < half_N; ++k) {
+        double theta = -2.0 * M_PI * k / N;
+        float re = cos(theta);
+        float im = sin(theta);
+        float re_odd = odd_fft[2 * k];
+        float im_odd = odd_fft[2 * k + 1];
+
+        out[2 * k] = even_fft[2 * k] + re * re_odd - im * im_odd;
+        out[2 * k + 1] = even_fft[2 * k + 1] + re * im_odd + im * re_odd;
+        out[2 * (k + half_N)] = even_fft[2 * k] - re * re_odd + im * im_odd;
+        out[2 * (k + half_N) + 1] = even_fft[2 * k + 1] - re * im_odd - im * re_odd;
+    }
+}
+
+// previous mel_calc_cpu::calculate() on one thread (the threads only split the frames)
+std::vector<float> log_mel_spectrogram(const std::vector<float>& samples, const std::vector<float>& filters) {
+    const int n_fft = WHISPER_N_FFT / 2 + 1;
+    const int stage_1_pad = WHISPER_SAMPLE_RATE * 30;
+    const int stage_2_pad = WHISPER_N_FFT / 2;
+    const int n_samples = static_cast<int>(samples.size());
+
+    float hann[WHISPER_N_FFT];
+    for (int i = 0; i < WHISPER_N_FFT; i++) {
+        hann[i] = 0.5 * (1.0 - cosf((2.0 * M_PI * i) / WHISPER_N_FFT));
+    }
+
+    std::vector<float> padded(n_samples + stage_1_pad + stage_2_pad * 2, 0.0f);
+    std::copy(samples.begin(), samples.end(), padded.begin() + stage_2_pad);
+    std::reverse_copy(samples.begin(), samples.begin() + stage_2_pad, padded.begin());
+
+    const int n_len = 2 + (n_samples + stage_2_pad - WHISPER_N_FFT) / WHISPER_HOP_LENGTH;
+    const int n_padded = n_samples + stage_2_pad;
+    std::vector<float> mel(n_len * WHISPER_N_MEL);
+
+    std::vector<float> fft_in(WHISPER_N_FFT, 0.0f);
+    std::vector<float> fft_out(WHISPER_N_FFT * 2, 0.0f);
+    int i = 0;
+    for (; i < std::min(n_padded / WHISPER_HOP_LENGTH + 1, n_len); i++) {
+        const int offset = i * WHISPER_HOP_LENGTH;
+        for (int j = 0; j < std::min(WHISPER_N_FFT, n_padded - offset); j++) {
+            fft_in[j] = hann[j] * padded[offset + j];
+        }
+        if (n_padded - offset < WHISPER_N_FFT) {
+            std::fill(fft_in.begin() + (n_padded - offset), fft_in.end(), 0.0f);
+        }
+
+        fft(fft_in.data(), WHISPER_N_FFT, fft_out.data());
+
+        for (int j = 0; j < n_fft; j++) {
+            fft_out[j] = (fft_out[2 * j] * fft_out[2 * j] + fft_out[2 * j + 1] * fft_out[2 * j + 1]);
+        }
+        for (int j = 0; j < WHISPER_N_MEL; j++) {
+            double sum = 0.0;
+            for (int k = 0; k < n_fft; k++) {
+                sum += fft_out[k] * filters[j * n_fft + k];
+            }
+            mel[j * n_len + i] = static_cast<float>(log10(std::max(sum, 1e-10)));
+        }
+    }
+    for (; i < n_len; i++) {
+        for (int j = 0; j < WHISPER_N_MEL; j++) {
+            mel[j * n_len + i] = static_cast<float>(log10(1e-10));
+        }
+    }
+
+    double mmax = -1e20;
+    for (float v : mel) {
+        mmax = std::max(mmax, static_cast<double>(v));
+    }
+    mmax -= 8.0;
+    for (float& v : mel) {
+        if (v < mmax) {
+            v = static_cast<float>(mmax);
+        }
+        v = (v + 4.0f) / 4.0f;
+    }
+    return mel;
+}
+
+}
+
+static double hz_to_mel(double f) {
+    const double f_sp = 200.0 / 3;
+    return f >= 1000 ? (1000 / f_sp) + (log(f / 1000) / (log(6.4) / 27)) : f / f_sp;
+}
+
+static double mel_to_hz(double m) {
+    const double f_sp = 200.0 / 3;
+    const double min_log_mel = 1000 / f_sp;
+    return m >= min_log_mel ? 1000 * exp((log(6.4) / 27) * (m - min_log_mel)) : f_sp * m;
+}
+
+// librosa.filters.mel(sr=16000, n_fft=400, n_mels=80), what mel_80.bin holds
+static std::vector<float> slaney_mel_filters() {
+    const int n_fft = WHISPER_N_FFT / 2 + 1;
+    std::vector<double> mel_f(WHISPER_N_MEL + 2);
+    const double lo = hz_to_mel(0);
+    const double hi = hz_to_mel(WHISPER_SAMPLE_RATE / 2);
+    for (int i = 0; i < WHISPER_N_MEL + 2; i++) {
+        mel_f[i] = mel_to_hz(lo + ((hi - lo) * i / (WHISPER_N_MEL + 1)));
+    }
+
+    std::vector<float> filters(WHISPER_N_MEL * n_fft);
+    for (int i = 0; i < WHISPER_N_MEL; i++) {
+        for (int k = 0; k < n_fft; k++) {
+            double f = (WHISPER_SAMPLE_RATE / 2.0) * k / (n_fft - 1);
+            double lower = (f - mel_f[i]) / (mel_f[i + 1] - mel_f[i]);
+            double upper = (mel_f[i + 2] - f) / (mel_f[i + 2] - mel_f[i + 1]);
+            double weight = std::max(0.0, std::min(lower, upper));
+            filters[i * n_fft + k] = static_cast<float>(weight * 2.0 / (mel_f[i + 2] - mel_f[i]));
+        }
+    }
+    return filters;
+}
+
+// a chirp with noise, as 16-bit PCM so the float and the PCM streaming paths see the same audio
+static std::vector<int16_t> synthetic_pcm(size_t n_samples, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> noise(0.0, 0.05);
+    std::vector<int16_t> pcm(n_samples);
+    for (size_t i = 0; i < n_samples; i++) {
+        double t = static_cast<double>(i) / WHISPER_SAMPLE_RATE;
+        double x = (0.3 * sin(2 * M_PI * (200 + (300 * t)) * t)) + noise(rng);
+        pcm[i] = static_cast<int16_t>(std::max(-1.0, std::min(1.0, x)) * 32767);
+    }
+    return pcm;
+}
+
+static double max_abs_diff(const std::vector<float>& a, const std::vector<float>& b) {
+    if (a.size() != b.size()) {
+        return INFINITY;
+    }
+    double diff = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        diff = std::max(diff, fabs(static_cast<double>(a[i]) - b[i]));
+    }
+    return diff;
+}
+
+static double now_ms() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool check_fft_plan() {
+    mel_spectrogram::fft_plan plan(WHISPER_N_FFT);
+    std::vector<float> in(WHISPER_N_FFT);
+    std::vector<float> expected(WHISPER_N_FFT * 2);
+    std::vector<mel_spectrogram::fft_complex> actual(plan.n_bins());
+    std::vector<mel_spectrogram::fft_complex> scratch(plan.scratch_size());
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> sample(-1.0f, 1.0f);
+
+    double max_rel_diff = 0;
+    for (int frame = 0; frame < 200; frame++) {
+        for (float& v : in) {
+            v = sample(rng);
+        }
+        reference::fft(in.data(), WHISPER_N_FFT, expected.data());
+        plan.rfft(in.data(), actual.data(), scratch.data());
+
+        double peak = 0;
+        double diff = 0;
+        for (int k = 0; k < plan.n_bins(); k++) {
+            peak = std::max(peak, static_cast<double>(std::hypot(expected[2 * k], expected[2 * k + 1])));
+            diff = std::max(diff, static_cast<double>(std::hypot(actual[k].r - expected[2 * k], actual[k].i - expected[2 * k + 1])));
+        }
+        max_rel_diff = std::max(max_rel_diff, diff / peak);
+    }
+
+    bool ok = max_rel_diff <= 1e-5;
+    printf("fft_plan(400) vs fft(): 200 frames, max diff %.2e of the peak bin %s\n", max_rel_diff, ok ? "" : "MISMATCH");
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const char* filters_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filters") == 0 && i + 1 < argc) {
+            filters_path = argv[++i];
+        } else {
+            printf("Usage: %s [--filters mel_80.bin]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // LogMelSpectrogram reads the filters from a file
+    std::vector<float> filters;
+    std::string temp_path;
+    if (filters_path) {
+        FILE* f = fopen(filters_path, "rb");
+        if (!f) {
+            printf("Failed to open %s\n", filters_path);
+            return 1;
+        }
+        filters.resize(WHISPER_N_MEL * (WHISPER_N_FFT / 2 + 1));
+        size_t n = fread(filters.data(), sizeof(float), filters.size(), f);
+        fclose(f);
+        if (n != filters.size()) {
+            printf("%s has %zu values, expected %zu\n", filters_path, n, filters.size());
+            return 1;
+        }
+    } else {
+        filters = slaney_mel_filters();
+        char path[] = "/tmp/logmel_check_XXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0 || write(fd, filters.data(), filters.size() * sizeof(float)) != static_cast<ssize_t>(filters.size() * sizeof(float))) {
+            printf("Failed to write the mel filters to %s\n", path);
+            return 1;
+        }
+        close(fd);
+        temp_path = path;
+        filters_path = temp_path.c_str();
+    }
+
+    bool ok = check_fft_plan();
+
+    std::vector<mel_spectrogram::LogMelSpectrogram*> pooled;
+    for (int n_threads : { 1, 2, 4 }) {
+        pooled.push_back(new mel_spectrogram::LogMelSpectrogram(filters_path, n_threads));
+    }
+    mel_spectrogram::LogMelSpectrogram& streamed = *pooled.back();
+
+    printf("%-28s %11s %11s %11s %11s %s\n", "audio", "old (ms)", "new (ms)", "max diff", "stream diff", "");
+    std::mt19937 rng(5);
+    uint32_t seed = 0;
+    for (double seconds : { 0.5, 7.3, 30.0, 35.0 }) {
+        std::vector<int16_t> pcm = synthetic_pcm(static_cast<size_t>(seconds * WHISPER_SAMPLE_RATE), seed++);
+        std::vector<float> audio(pcm.size());
+        std::transform(pcm.begin(), pcm.end(), audio.begin(), [](int16_t a) { return static_cast<float>(a) / 32767.f; });
+
+        // load_audio_chunk() pads or trims to 30 s, compute() takes the audio as it is
+        for (bool padded : { true, false }) {
+            std::vector<float> input = audio;
+            if (padded) {
+                input.resize(N_SAMPLES, 0.0f);
+            }
+            double start = now_ms();
+            std::vector<float> expected = reference::log_mel_spectrogram(input, filters);
+            double old_ms = now_ms() - start;
+
+            double pooled_ms = 0;
+            double diff = 0;
+            std::vector<float> batch;
+            for (mel_spectrogram::LogMelSpectrogram* lms : pooled) {
+                start = now_ms();
+                std::vector<float> actual = padded ? lms->load_audio_chunk(audio) : lms->compute(audio);
+                pooled_ms = now_ms() - start;
+                diff = std::max(diff, max_abs_diff(actual, expected));
+                if (lms == &streamed) {
+                    batch = actual;
+                }
+            }
+
+            // streaming always pads to 30 s, alternate float and PCM pushes in random chunk sizes
+            double stream_diff = 0;
+            if (padded) {
+                streamed.stream_begin();
+                for (size_t p = 0; p < pcm.size();) {
+                    size_t n = std::min<size_t>(pcm.size() - p, 1 + rng() % 3000);
+                    if (rng() % 2) {
+                        streamed.stream_push(audio.data() + p, n);
+                    } else {
+                        streamed.stream_push_pcm16(pcm.data() + p, n);
+                    }
+                    p += n;
+                }
+                std::vector<float> actual = streamed.stream_finish();
+                stream_diff = max_abs_diff(actual, batch);
+                diff = std::max(diff, max_abs_diff(actual, expected));
+            }
+
+            bool same = diff <= 1e-4 && stream_diff == 0;
+            ok = ok && same;
+
+            char name[64];
+            snprintf(name, sizeof(name), "%.1f s, %s", seconds, padded ? "load_audio_chunk" : "compute");
+            char stream[16] = "-";
+            if (padded) {
+                snprintf(stream, sizeof(stream), "%.1e", stream_diff);
+            }
+            printf("%-28s %11.1f %11.1f %11.1e %11s %s\n", name, old_ms, pooled_ms, diff, stream, same ? "" : "MISMATCH");
+        }
+    }
+
+    for (mel_spectrogram::LogMelSpectrogram* lms : pooled) {
+        delete lms;
+    }
+    if (!temp_path.empty()) {
+        unlink(temp_path.c_str());
+    }
+
+    printf("log-mel spectrogram %s the previous implementation\n", ok ? "matches" : "DOES NOT match");
+    return ok ? 0 : 1;
+}